@@ -0,0 +1,125 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <getopt.h>
+
+#include <iostream>
+
+#include "cli.hpp"
+
+#include "trace_parser.hpp"
+#include "trace_bytecode.hpp"
+
+
+static const char *synopsis = "Compile a trace into replay bytecode.";
+
+static void
+usage(void)
+{
+    std::cout
+        << "usage: apitrace compile [options] <in-trace-file> <out-bytecode-file>\n"
+        << synopsis << "\n"
+        << "\n"
+        << "Bytecode is uncompressed and mapped, so it replays with\n"
+        << "`glretrace --bytecode` with next to no overhead besides the driver's,\n"
+        << "at the expense of disk space.  It is only meant to be replayed on\n"
+        << "the same kind of machine it was compiled on.\n"
+        << "\n"
+        << "    -h, --help   Show this help message and exit\n"
+        << "\n";
+}
+
+const static char *
+shortOptions = "h";
+
+const static struct option
+longOptions[] = {
+    {"help", no_argument, 0, 'h'},
+    {0, 0, 0, 0}
+};
+
+
+static int
+compile(const char *inFileName, const char *outFileName)
+{
+    trace::Parser parser;
+    if (!parser.open(inFileName)) {
+        std::cerr << "error: failed to open " << inFileName << "\n";
+        return 1;
+    }
+
+    trace::BytecodeWriter writer;
+    if (!writer.open(outFileName, parser.getVersion())) {
+        std::cerr << "error: failed to create " << outFileName << "\n";
+        return 1;
+    }
+
+    trace::Call *call;
+    while (!writer.failed() && (call = parser.parse_call())) {
+        writer.writeCall(call);
+        delete call;
+    }
+
+    if (!writer.close()) {
+        std::cerr << "error: failed to write " << outFileName << "\n";
+        return 1;
+    }
+
+    return 0;
+}
+
+
+static int
+command(int argc, char *argv[])
+{
+    int opt;
+    while ((opt = getopt_long(argc, argv, shortOptions, longOptions, NULL)) != -1) {
+        switch (opt) {
+        case 'h':
+            usage();
+            return 0;
+        default:
+            std::cerr << "error: unexpected option `" << (char)opt << "`\n";
+            usage();
+            return 1;
+        }
+    }
+
+    if (argc != optind + 2) {
+        std::cerr << "error: insufficient number of arguments\n";
+        usage();
+        return 1;
+    }
+
+    return compile(argv[optind], argv[optind + 1]);
+}
+
+const Command compile_command = {
+    "compile",
+    synopsis,
+    usage,
+    command
+};
@@ -25,16 +25,36 @@
  *
  *********************************************************************/
 
+#include <limits.h> // for CHAR_MAX
+#include <stddef.h>
+#include <stdint.h>
 #include <string.h>
+#include <wchar.h>
+#include <getopt.h>
+
+#include <algorithm>
 #include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include "cli.hpp"
+#include "cli_diff_script.hpp"
+#include "cli_pager.hpp"
 #include "os_string.hpp"
 #include "os_process.hpp"
 #include "cli_resources.hpp"
 
+#include "trace_parser.hpp"
+#include "trace_dump.hpp"
+#include "trace_callset.hpp"
+#include "trace_option.hpp"
+
+
 static const char *synopsis = "Identify differences between two traces.";
 
+
 static os::String
 find_command(void)
 {
@@ -44,19 +64,63 @@ find_command(void)
 static void
 usage(void)
 {
-    os::String command = find_command();
+    std::cout
+        << "usage: apitrace diff [OPTIONS] REF_TRACE SRC_TRACE\n"
+        << synopsis << "\n"
+        "\n"
+        "    -h, --help               show this help message and exit\n"
+        "    -c, --calls=CALLSET      calls to compare [default: all]\n"
+        "    --ref-calls=CALLSET      calls to compare from reference trace\n"
+        "    --src-calls=CALLSET      calls to compare from source trace\n"
+        "    --call-nos               dump call numbers\n"
+        "    --ignore-pointers        consider all non-null pointers equal\n"
+        "    --ignore-blobs           consider all blobs equal\n"
+        "    -U, --unified=N          show N calls of context [default: 3]\n"
+        "    -y, --side-by-side       output in two columns\n"
+        "    -w, --width=N            output width for side-by-side [default: 130]\n"
+        "    --suppress-common-lines  do not output common calls in side-by-side\n"
+        "    -t, --tool=TOOL          use scripts/tracediff.py with the given\n"
+        "                             tool: diff, sdiff, wdiff, or python\n"
+        "\n"
+        "Exit status is 0 if the traces are the same, 1 if different, 2 on error.\n"
+    ;
+}
 
-    char *args[4];
-    args[0] = (char *) APITRACE_PYTHON_EXECUTABLE;
-    args[1] = (char *) command.str();
-    args[2] = (char *) "--help";
-    args[3] = NULL;
+enum {
+    REF_CALLS_OPT = CHAR_MAX + 1,
+    SRC_CALLS_OPT,
+    CALL_NOS_OPT,
+    IGNORE_POINTERS_OPT,
+    IGNORE_BLOBS_OPT,
+    SUPPRESS_COMMON_LINES_OPT,
+};
 
-    os::execute(args);
-}
+const static char *
+shortOptions = "hc:U:yw:t:";
+
+const static struct option
+longOptions[] = {
+    {"help", no_argument, 0, 'h'},
+    {"calls", required_argument, 0, 'c'},
+    {"ref-calls", required_argument, 0, REF_CALLS_OPT},
+    {"src-calls", required_argument, 0, SRC_CALLS_OPT},
+    {"call-nos", no_argument, 0, CALL_NOS_OPT},
+    {"ignore-pointers", no_argument, 0, IGNORE_POINTERS_OPT},
+    {"ignore-blobs", no_argument, 0, IGNORE_BLOBS_OPT},
+    {"unified", required_argument, 0, 'U'},
+    {"side-by-side", no_argument, 0, 'y'},
+    {"width", required_argument, 0, 'w'},
+    {"suppress-common-lines", no_argument, 0, SUPPRESS_COMMON_LINES_OPT},
+    {"tool", required_argument, 0, 't'},
+    {0, 0, 0, 0}
+};
 
+
+/*
+ * Run scripts/tracediff.py, for the external diff tools it supports.
+ */
 static int
-command(int argc, char *argv[])
+run_script(int argc, char *argv[])
 {
     int i;
 
@@ -77,6 +141,547 @@ command(int argc, char *argv[])
     return os::execute((char * const *)&args[0]);
 }
 
+
+/*
+ * Sequence of the compared calls of a trace: the calls in the call set,
+ * except verbose ones, like `apitrace dump` shows them.
+ */
+class CallStream
+{
+    trace::Parser parser;
+    trace::CallSet &calls;
+    trace::CallNo lastCallNo;
+
+public:
+    size_t position = 0;
+
+    CallStream(trace::CallSet &_calls) :
+        calls(_calls),
+        lastCallNo(_calls.getLast())
+    {
+    }
+
+    bool
+    open(const char *filename) {
+        return parser.open(filename);
+    }
+
+    trace::Call *
+    next(void) {
+        trace::Call *call;
+        while ((call = parser.parse_call())) {
+            if (calls.contains(*call) &&
+                !(call->flags & trace::CALL_FLAG_VERBOSE)) {
+                ++position;
+                return call;
+            }
+            bool done = call->no > lastCallNo;
+            delete call;
+            if (done) {
+                break;
+            }
+        }
+        return NULL;
+    }
+
+    void
+    skipTo(size_t target) {
+        while (position < target) {
+            trace::Call *call = next();
+            if (!call) {
+                break;
+            }
+            delete call;
+        }
+    }
+};
+
+
+/*
+ * FNV-1a hash of a call's function, arguments, and return value.
+ */
+class CallHasher : public trace::Visitor
+{
+    uint64_t h;
+
+    void
+    mix(const void *data, size_t size) {
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; ++i) {
+            h ^= p[i];
+            h *= 0x100000001b3ULL;
+        }
+    }
+
+    template< class T >
+    void
+    mix(char tag, const T &value) {
+        mix(&tag, sizeof tag);
+        mix(&value, sizeof value);
+    }
+
+    void
+    mixValue(trace::Value *value) {
+        if (value) {
+            value->visit(*this);
+        } else {
+            mix('-', 0);
+        }
+    }
+
+public:
+    bool ignorePointers = false;
+    bool ignoreBlobs = false;
+
+    uint64_t
+    hash(trace::Call *call) {
+        h = 0xcbf29ce484222325ULL;
+        mix(call->sig->name, strlen(call->sig->name));
+        mix('(', call->args.size());
+        for (auto & arg : call->args) {
+            mixValue(arg.value);
+        }
+        mixValue(call->ret);
+        return h;
+    }
+
+    void visit(trace::Null *) override {
+        mix('N', 0);
+    }
+
+    void visit(trace::Bool *node) override {
+        mix('B', node->value);
+    }
+
+    void visit(trace::SInt *node) override {
+        mix('I', node->value);
+    }
+
+    void visit(trace::UInt *node) override {
+        mix('U', node->value);
+    }
+
+    void visit(trace::Float *node) override {
+        mix('F', node->value);
+    }
+
+    void visit(trace::Double *node) override {
+        mix('D', node->value);
+    }
+
+    void visit(trace::String *node) override {
+        size_t len = strlen(node->value);
+        mix('S', len);
+        mix(node->value, len);
+    }
+
+    void visit(trace::WString *node) override {
+        size_t len = wcslen(node->value);
+        mix('W', len);
+        mix(node->value, len * sizeof(wchar_t));
+    }
+
+    void visit(trace::Enum *node) override {
+        mix('E', node->value);
+    }
+
+    void visit(trace::Bitmask *node) override {
+        mix('M', node->value);
+    }
+
+    void visit(trace::Struct *node) override {
+        mix('{', node->members.size());
+        for (auto member : node->members) {
+            mixValue(member);
+        }
+    }
+
+    void visit(trace::Array *node) override {
+        mix('[', node->values.size());
+        for (auto value : node->values) {
+            mixValue(value);
+        }
+    }
+
+    void visit(trace::Blob *node) override {
+        if (ignoreBlobs) {
+            mix('b', 0);
+        } else {
+            mix('b', node->size);
+            mix(node->buf, node->size);
+        }
+    }
+
+    void visit(trace::Pointer *node) override {
+        if (ignorePointers) {
+            mix('P', node->value != 0);
+        } else {
+            mix('P', node->value);
+        }
+    }
+
+    void visit(trace::Repr *node) override {
+        mix('R', 0);
+        mixValue(node->humanValue);
+        mixValue(node->machineValue);
+    }
+};
+
+
+struct CallHashes
+{
+    std::vector<uint64_t> hashes;
+    std::vector<trace::CallNo> callNos;
+};
+
+
+static bool
+hashTrace(const char *filename, trace::CallSet &calls,
+          CallHasher &hasher, CallHashes &result)
+{
+    CallStream stream(calls);
+    if (!stream.open(filename)) {
+        return false;
+    }
+
+    trace::Call *call;
+    while ((call = stream.next())) {
+        result.hashes.push_back(hasher.hash(call));
+        result.callNos.push_back(call->no);
+        delete call;
+    }
+
+    return true;
+}
+
+
+/*
+ * A run of common calls followed by a change.
+ */
+struct DiffBlock
+{
+    size_t equal = 0;
+    size_t deleted = 0;
+    size_t inserted = 0;
+};
+
+
+static void
+groupBlocks(const DiffScript &script, std::vector<DiffBlock> &blocks)
+{
+    DiffBlock block;
+    for (auto & run : script) {
+        switch (run.op) {
+        case DIFF_EQUAL:
+            if (block.deleted || block.inserted) {
+                blocks.push_back(block);
+                block = DiffBlock();
+            }
+            block.equal += run.count;
+            break;
+        case DIFF_DELETE:
+            block.deleted += run.count;
+            break;
+        case DIFF_INSERT:
+            block.inserted += run.count;
+            break;
+        }
+    }
+    if (block.equal || block.deleted || block.inserted) {
+        blocks.push_back(block);
+    }
+}
+
+
+class DiffPrinter
+{
+    CallStream &ref;
+    CallStream &src;
+    trace::DumpFlags dumpFlags;
+    std::ostringstream ss;
+
+    std::string
+    format(CallStream &stream) {
+        std::unique_ptr<trace::Call> call(stream.next());
+        if (!call) {
+            return std::string();
+        }
+        ss.str(std::string());
+        trace::dump(*call, ss, dumpFlags);
+        return ss.str();
+    }
+
+    void
+    printColumns(const std::string &left, char marker, const std::string &right) {
+        std::string line = left.substr(0, columnWidth);
+        line.resize(columnWidth, ' ');
+        line += ' ';
+        line += marker;
+        if (!right.empty()) {
+            line += ' ';
+            line += right.substr(0, columnWidth);
+        }
+        std::cout << line << '\n';
+    }
+
+public:
+    size_t columnWidth = 0;
+
+    DiffPrinter(CallStream &_ref, CallStream &_src, bool callNos) :
+        ref(_ref),
+        src(_src)
+    {
+        dumpFlags = trace::DUMP_FLAG_NO_COLOR |
+                    trace::DUMP_FLAG_NO_ARG_NAMES |
+                    trace::DUMP_FLAG_NO_MULTILINE;
+        if (!callNos) {
+            dumpFlags |= trace::DUMP_FLAG_NO_CALL_NO;
+        }
+    }
+
+    void
+    seek(size_t refPosition, size_t srcPosition) {
+        ref.skipTo(refPosition);
+        src.skipTo(srcPosition);
+    }
+
+    void
+    unified(const DiffBlock &block, size_t equal) {
+        for (size_t i = 0; i < equal; ++i) {
+            ref.skipTo(ref.position + 1);
+            std::cout << ' ' << format(src) << '\n';
+        }
+        for (size_t i = 0; i < block.deleted; ++i) {
+            std::cout << '-' << format(ref) << '\n';
+        }
+        for (size_t i = 0; i < block.inserted; ++i) {
+            std::cout << '+' << format(src) << '\n';
+        }
+    }
+
+    void
+    sideBySide(const DiffBlock &block, bool suppressCommon) {
+        if (suppressCommon) {
+            seek(ref.position + block.equal, src.position + block.equal);
+        } else {
+            for (size_t i = 0; i < block.equal; ++i) {
+                std::string left = format(ref);
+                printColumns(left, ' ', format(src));
+            }
+        }
+        size_t i = 0;
+        for (; i < block.deleted && i < block.inserted; ++i) {
+            std::string left = format(ref);
+            printColumns(left, '|', format(src));
+        }
+        for (; i < block.deleted; ++i) {
+            printColumns(format(ref), '<', std::string());
+        }
+        for (; i < block.inserted; ++i) {
+            printColumns(std::string(), '>', format(src));
+        }
+    }
+};
+
+
+static trace::CallNo
+callNoAt(const CallHashes &hashes, size_t position)
+{
+    if (position < hashes.callNos.size()) {
+        return hashes.callNos[position];
+    }
+    return hashes.callNos.empty() ? 0 : hashes.callNos.back() + 1;
+}
+
+
+static void
+printUnified(DiffPrinter &printer,
+             const char *refName, const CallHashes &refHashes,
+             const char *srcName, const CallHashes &srcHashes,
+             const std::vector<DiffBlock> &blocks,
+             size_t context)
+{
+    std::cout << "--- " << refName << '\n'
+              << "+++ " << srcName << '\n';
+
+    size_t x = 0;
+    size_t y = 0;
+    size_t i = 0;
+    while (i < blocks.size() && (blocks[i].deleted || blocks[i].inserted)) {
+        // Merge the following changes closer than twice the context
+        size_t j = i;
+        while (j + 1 < blocks.size() &&
+               (blocks[j + 1].deleted || blocks[j + 1].inserted) &&
+               blocks[j + 1].equal <= 2 * context) {
+            ++j;
+        }
+
+        size_t leading = std::min(context, blocks[i].equal);
+        size_t trailing = j + 1 < blocks.size() ? std::min(context, blocks[j + 1].equal) : 0;
+
+        size_t refStart = x + blocks[i].equal - leading;
+        size_t srcStart = y + blocks[i].equal - leading;
+        size_t refCount = leading + trailing;
+        size_t srcCount = leading + trailing;
+        for (size_t k = i; k <= j; ++k) {
+            if (k > i) {
+                refCount += blocks[k].equal;
+                srcCount += blocks[k].equal;
+            }
+            refCount += blocks[k].deleted;
+            srcCount += blocks[k].inserted;
+        }
+
+        std::cout << "@@ -" << callNoAt(refHashes, refStart) << ',' << refCount
+                  << " +" << callNoAt(srcHashes, srcStart) << ',' << srcCount
+                  << " @@\n";
+
+        printer.seek(refStart, srcStart);
+        for (size_t k = i; k <= j; ++k) {
+            printer.unified(blocks[k], k > i ? blocks[k].equal : leading);
+            x += blocks[k].equal + blocks[k].deleted;
+            y += blocks[k].equal + blocks[k].inserted;
+        }
+        printer.unified(DiffBlock(), trailing);
+
+        i = j + 1;
+    }
+}
+
+
+static int
+command(int argc, char *argv[])
+{
+    trace::CallSet calls(trace::FREQUENCY_ALL);
+    const char *refCalls = NULL;
+    const char *srcCalls = NULL;
+    bool callNos = false;
+    bool sideBySide = false;
+    bool suppressCommonLines = false;
+    size_t context = 3;
+    size_t width = 130;
+    bool useScript = false;
+    CallHasher hasher;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, shortOptions, longOptions, NULL)) != -1) {
+        switch (opt) {
+        case 'h':
+            usage();
+            return 0;
+        case 'c':
+            calls.merge(optarg);
+            break;
+        case REF_CALLS_OPT:
+            refCalls = optarg;
+            break;
+        case SRC_CALLS_OPT:
+            srcCalls = optarg;
+            break;
+        case CALL_NOS_OPT:
+            callNos = true;
+            break;
+        case IGNORE_POINTERS_OPT:
+            hasher.ignorePointers = true;
+            break;
+        case IGNORE_BLOBS_OPT:
+            hasher.ignoreBlobs = true;
+            break;
+        case 'U':
+            context = trace::intOption(optarg, 3);
+            break;
+        case 'y':
+            sideBySide = true;
+            break;
+        case 'w':
+            width = trace::intOption(optarg, 130);
+            break;
+        case SUPPRESS_COMMON_LINES_OPT:
+            suppressCommonLines = true;
+            break;
+        case 't':
+            useScript = true;
+            break;
+        default:
+            std::cerr << "error: unexpected option `" << (char)opt << "`\n";
+            usage();
+            return 2;
+        }
+    }
+
+    if (useScript) {
+        return run_script(argc, argv);
+    }
+
+    if (argc - optind != 2) {
+        std::cerr << "error: expected two trace files\n";
+        usage();
+        return 2;
+    }
+
+    const char *refName = argv[optind];
+    const char *srcName = argv[optind + 1];
+
+    trace::CallSet refCallSet(calls);
+    trace::CallSet srcCallSet(calls);
+    if (refCalls) {
+        refCallSet = trace::CallSet(trace::FREQUENCY_ALL);
+        refCallSet.merge(refCalls);
+    }
+    if (srcCalls) {
+        srcCallSet = trace::CallSet(trace::FREQUENCY_ALL);
+        srcCallSet.merge(srcCalls);
+    }
+
+    CallHashes refHashes;
+    CallHashes srcHashes;
+    if (!hashTrace(refName, refCallSet, hasher, refHashes) ||
+        !hashTrace(srcName, srcCallSet, hasher, srcHashes)) {
+        return 2;
+    }
+
+    DiffScript script;
+    diffHashes(refHashes.hashes, srcHashes.hashes, script);
+
+    std::vector<DiffBlock> blocks;
+    groupBlocks(script, blocks);
+
+    bool different = script.size() > 1 ||
+                     (script.size() == 1 && script[0].op != DIFF_EQUAL);
+    if (!different && !(sideBySide && !suppressCommonLines)) {
+        return 0;
+    }
+
+    CallStream ref(refCallSet);
+    CallStream src(srcCallSet);
+    if (!ref.open(refName) || !src.open(srcName)) {
+        return 2;
+    }
+
+#ifndef _WIN32
+    pipepager();
+#endif
+
+    std::ios::sync_with_stdio(false);
+
+    DiffPrinter printer(ref, src, callNos);
+    if (sideBySide) {
+        printer.columnWidth = width > 3 ? (width - 3) / 2 : 1;
+        for (auto & block : blocks) {
+            printer.sideBySide(block, suppressCommonLines);
+        }
+    } else {
+        printUnified(printer,
+                     refName, refHashes,
+                     srcName, srcHashes,
+                     blocks, context);
+    }
+
+    std::cout.flush();
+
+    return different ? 1 : 0;
+}
+
 const Command diff_command = {
     "diff",
     synopsis,
@@ -25,52 +25,622 @@
  *
  *********************************************************************/
 
+#include <limits.h> // for CHAR_MAX
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <getopt.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include "cli.hpp"
 #include "os_string.hpp"
-#include "os_process.hpp"
-#include "cli_resources.hpp"
+#include "os_thread.hpp"
+#include "thread_pool.hpp"
+#include "trace_option.hpp"
+#include "image.hpp"
+
 
 static const char *synopsis = "Identify differences between two image dumps.";
 
-static os::String
-find_command(void)
+static const unsigned thumbSize = 320;
+
+static void
+usage(void)
+{
+    std::cout
+        << "usage: apitrace diff-images [OPTIONS] REF_PREFIX SRC_PREFIX\n"
+        << synopsis << "\n"
+        "\n"
+        "    -h, --help             show this help message and exit\n"
+        "    -v, --verbose          verbose output\n"
+        "    -o, --output=FILE      output filename, an HTML report unless it ends\n"
+        "                           in .json [default: index.html]\n"
+        "    -f, --fuzz=RATIO       fuzz ratio [default: 0.05]\n"
+        "    -a, --alpha            take alpha channel in consideration\n"
+        "    -j, --jobs=N           compare on N threads [default: number of CPUs]\n"
+        "    --overwrite            overwrite images\n"
+        "    --show-all             show all images, including similar ones\n"
+        "    --diff-images[=BOOL]   write .diff.png images [default: yes]\n"
+        "\n"
+        "Exit status is 1 if any image is missing or mismatches.\n"
+    ;
+}
+
+enum {
+    OVERWRITE_OPT = CHAR_MAX + 1,
+    SHOW_ALL_OPT,
+    DIFF_IMAGES_OPT,
+};
+
+const static char *
+shortOptions = "hvo:f:aj:";
+
+const static struct option
+longOptions[] = {
+    {"help", no_argument, 0, 'h'},
+    {"verbose", no_argument, 0, 'v'},
+    {"output", required_argument, 0, 'o'},
+    {"fuzz", required_argument, 0, 'f'},
+    {"alpha", no_argument, 0, 'a'},
+    {"jobs", required_argument, 0, 'j'},
+    {"overwrite", no_argument, 0, OVERWRITE_OPT},
+    {"show-all", no_argument, 0, SHOW_ALL_OPT},
+    {"diff-images", optional_argument, 0, DIFF_IMAGES_OPT},
+    {0, 0, 0, 0}
+};
+
+
+struct Options
+{
+    double fuzz = 0.05;
+    bool alpha = false;
+    bool overwrite = false;
+    bool showAll = false;
+    bool diffImages = true;
+};
+
+
+static bool
+fileExists(const std::string &path, time_t *mtime = NULL)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+    if (mtime) {
+        *mtime = st.st_mtime;
+    }
+    return true;
+}
+
+
+static bool
+isDirectory(const std::string &path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && (st.st_mode & S_IFMT) == S_IFDIR;
+}
+
+
+static std::string
+joinPath(const std::string &dir, const std::string &name)
+{
+    if (dir.empty() || dir.back() == '/' || dir.back() == OS_DIR_SEP) {
+        return dir + name;
+    }
+    return dir + OS_DIR_SEP + name;
+}
+
+
+static time_t
+fileTime(const std::string &path)
+{
+    time_t mtime = 0;
+    fileExists(path, &mtime);
+    return mtime;
+}
+
+
+static std::string
+extension(const std::string &path)
+{
+    size_t dot = path.rfind('.');
+    size_t sep = path.find_last_of("/\\");
+    if (dot == std::string::npos || (sep != std::string::npos && dot < sep)) {
+        return std::string();
+    }
+    return path.substr(dot);
+}
+
+
+static std::string
+stripExtension(const std::string &path)
+{
+    return path.substr(0, path.size() - extension(path).size());
+}
+
+
+/*
+ * Snapshots written by glretrace, but not the images this command writes.
+ */
+static bool
+isImage(const std::string &path)
 {
-    return findScript("snapdiff.py");
+    std::string ext1 = extension(path);
+    std::string ext2 = extension(stripExtension(path));
+    return (ext1 == ".png" || ext1 == ".qoi") &&
+           ext2 != ".diff" && ext2 != ".thumb";
 }
 
+
 static void
-usage(void)
+walk(const std::string &dir, std::vector<std::string> &files)
+{
+#ifdef _WIN32
+    WIN32_FIND_DATAA data;
+    HANDLE handle = FindFirstFileA((dir + "\\*").c_str(), &data);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    do {
+        std::string name = data.cFileName;
+        if (name == "." || name == "..") {
+            continue;
+        }
+        std::string path = joinPath(dir, name);
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            walk(path, files);
+        } else {
+            files.push_back(path);
+        }
+    } while (FindNextFileA(handle, &data));
+    FindClose(handle);
+#else
+    DIR *d = opendir(dir.c_str());
+    if (!d) {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(d))) {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..") {
+            continue;
+        }
+        std::string path = joinPath(dir, name);
+        if (isDirectory(path)) {
+            walk(path, files);
+        } else {
+            files.push_back(path);
+        }
+    }
+    closedir(d);
+#endif
+}
+
+
+/*
+ * Image names, relative to the prefix, which may be a directory or a
+ * directory plus the start of file names.
+ */
+static void
+findImages(const std::string &prefix, std::vector<std::string> &images)
+{
+    std::string dir;
+    if (isDirectory(prefix)) {
+        dir = prefix;
+    } else {
+        size_t sep = prefix.find_last_of("/\\");
+        dir = sep == std::string::npos ? "." : prefix.substr(0, sep);
+    }
+
+    std::vector<std::string> files;
+    walk(dir, files);
+    for (auto & file : files) {
+        if (dir == "." && file.compare(0, 2, "./") == 0) {
+            file = file.substr(2);
+        }
+        if (file.compare(0, prefix.size(), prefix) == 0 && isImage(file)) {
+            images.push_back(file.substr(prefix.size()));
+        }
+    }
+}
+
+
+static image::Image *
+readImage(const std::string &path)
+{
+    if (extension(path) != ".qoi") {
+        return image::readPNG(path.c_str());
+    }
+
+    std::ifstream stream(path.c_str(), std::ifstream::binary);
+    if (!stream) {
+        return NULL;
+    }
+    std::stringstream buffer;
+    buffer << stream.rdbuf();
+    std::string data = buffer.str();
+    return image::readQOI(data.data(), data.size());
+}
+
+
+/*
+ * HTML table cell showing an image, through a thumbnail if it is larger
+ * than thumbSize.
+ */
+static std::string
+surface(const std::string &path, const image::Image *decoded)
+{
+    // Browsers don't show QOI, so their thumbnails are always PNG
+    std::string ext = extension(path);
+    std::string thumb = stripExtension(path) + ".thumb" + (ext == ".qoi" ? ".png" : ext);
+
+    time_t imageTime;
+    if (fileExists(path, &imageTime) &&
+        (!fileExists(thumb) || fileTime(thumb) < imageTime)) {
+        std::unique_ptr<image::Image> owned;
+        if (!decoded) {
+            owned.reset(readImage(path));
+            decoded = owned.get();
+        }
+        if (decoded) {
+            unsigned width = decoded->width;
+            unsigned height = decoded->height;
+            if (ext != ".qoi" && width <= thumbSize && height <= thumbSize) {
+                if (width >= height) {
+                    height = height*thumbSize/width;
+                    width = thumbSize;
+                } else {
+                    width = width*thumbSize/height;
+                    height = thumbSize;
+                }
+                std::ostringstream ss;
+                ss << "        <td><img src=\"" << path << "\" width=\"" << width
+                   << "\" height=\"" << height << "\"/></td>\n";
+                return ss.str();
+            }
+
+            std::unique_ptr<image::Image> thumbnail(image::thumbnail(*decoded, thumbSize));
+            thumbnail->writePNG(thumb.c_str());
+        }
+    }
+
+    return "        <td><a href=\"" + path + "\"><img src=\"" + thumb + "\"/></a></td>\n";
+}
+
+
+enum Result {
+    RESULT_MATCH,
+    RESULT_MISMATCH,
+    RESULT_MISSING,
+};
+
+static const char *
+resultName(Result result)
+{
+    switch (result) {
+    case RESULT_MATCH:
+        return "MATCH";
+    case RESULT_MISMATCH:
+        return "MISMATCH";
+    case RESULT_MISSING:
+    default:
+        return "MISSING";
+    }
+}
+
+
+struct Comparison
+{
+    std::string name;
+    std::string refImage;
+    std::string srcImage;
+    std::string deltaImage;
+
+    Result result = RESULT_MISSING;
+    bool sizeMismatch = false;
+    bool deltaWritten = false;
+    image::Difference difference;
+
+    // Image cells of the HTML report
+    std::string cells;
+
+    bool done = false;
+};
+
+
+static void
+compareImages(const Options &options, bool html, Comparison &comparison)
+{
+    std::unique_ptr<image::Image> ref;
+    std::unique_ptr<image::Image> src;
+
+    if (fileExists(comparison.refImage) && fileExists(comparison.srcImage)) {
+        ref.reset(readImage(comparison.refImage));
+        src.reset(readImage(comparison.srcImage));
+        if (!ref || !src) {
+            std::cerr << "warning: failed to read " << (ref ? comparison.srcImage : comparison.refImage) << "\n";
+            comparison.result = RESULT_MISMATCH;
+        } else {
+            unsigned threshold = (unsigned)(255 * options.fuzz);
+            if (image::compare(*ref, *src, comparison.difference, threshold, options.alpha)) {
+                comparison.result = comparison.difference.mismatches ? RESULT_MISMATCH : RESULT_MATCH;
+            } else {
+                comparison.sizeMismatch = true;
+                comparison.result = RESULT_MISMATCH;
+            }
+        }
+    }
+
+    if (comparison.result == RESULT_MATCH && !options.showAll) {
+        return;
+    }
+
+    if (ref && src && options.diffImages) {
+        time_t deltaTime;
+        if (options.overwrite ||
+            !fileExists(comparison.deltaImage, &deltaTime) ||
+            (deltaTime < fileTime(comparison.refImage) &&
+             deltaTime < fileTime(comparison.srcImage))) {
+            std::unique_ptr<image::Image> delta(
+                image::highlightDifferences(*ref, *src, options.fuzz, options.alpha));
+            if (delta) {
+                comparison.deltaWritten = delta->writePNG(comparison.deltaImage.c_str());
+            }
+        }
+    }
+
+    if (html) {
+        comparison.cells += surface(comparison.refImage, ref.get());
+        comparison.cells += surface(comparison.srcImage, src.get());
+        comparison.cells += surface(comparison.deltaImage, NULL);
+    }
+}
+
+
+static void
+writeJSONString(std::ostream &os, const std::string &s)
+{
+    os << '"';
+    for (unsigned char c : s) {
+        switch (c) {
+        case '"':
+            os << "\\\"";
+            break;
+        case '\\':
+            os << "\\\\";
+            break;
+        default:
+            if (c < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof buf, "\\u%04x", c);
+                os << buf;
+            } else {
+                os << c;
+            }
+        }
+    }
+    os << '"';
+}
+
+
+static void
+writeJSONNumber(std::ostream &os, double value)
 {
-    os::String command = find_command();
+    if (isfinite(value)) {
+        char buf[32];
+        snprintf(buf, sizeof buf, "%.10g", value);
+        os << buf;
+    } else {
+        os << "null";
+    }
+}
 
-    char *args[4];
-    args[0] = (char *) APITRACE_PYTHON_EXECUTABLE;
-    args[1] = (char *) command.str();
-    args[2] = (char *) "--help";
-    args[3] = NULL;
 
-    os::execute(args);
+static void
+writeJSONEntry(std::ostream &os, const Comparison &comparison, bool first)
+{
+    os << (first ? "\n" : ",\n") << "    {\"name\": ";
+    writeJSONString(os, comparison.name);
+    os << ", \"result\": \"" << resultName(comparison.result) << "\", \"ref\": ";
+    writeJSONString(os, comparison.refImage);
+    os << ", \"src\": ";
+    writeJSONString(os, comparison.srcImage);
+    if (comparison.deltaWritten) {
+        os << ", \"diff\": ";
+        writeJSONString(os, comparison.deltaImage);
+    }
+    const image::Difference &difference = comparison.difference;
+    if (comparison.result != RESULT_MISSING && !comparison.sizeMismatch && difference.samples) {
+        os << ", \"mismatched_pixels\": " << difference.mismatches
+           << ", \"max_error\": " << difference.maxError
+           << ", \"psnr\": ";
+        writeJSONNumber(os, difference.psnr());
+        os << ", \"precision\": ";
+        writeJSONNumber(os, difference.precision());
+    }
+    if (comparison.sizeMismatch) {
+        os << ", \"size_mismatch\": true";
+    }
+    os << "}";
 }
 
+
 static int
 command(int argc, char *argv[])
 {
-    int i;
+    Options options;
+    bool verbose = false;
+    std::string output = "index.html";
+    unsigned numJobs = 0;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, shortOptions, longOptions, NULL)) != -1) {
+        switch (opt) {
+        case 'h':
+            usage();
+            return 0;
+        case 'v':
+            verbose = true;
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        case 'f':
+            options.fuzz = atof(optarg);
+            break;
+        case 'a':
+            options.alpha = true;
+            break;
+        case 'j':
+            numJobs = trace::intOption(optarg, 0);
+            break;
+        case OVERWRITE_OPT:
+            options.overwrite = true;
+            break;
+        case SHOW_ALL_OPT:
+            options.showAll = true;
+            break;
+        case DIFF_IMAGES_OPT:
+            options.diffImages = trace::boolOption(optarg);
+            break;
+        default:
+            std::cerr << "error: unexpected option `" << (char)opt << "`\n";
+            usage();
+            return 1;
+        }
+    }
+
+    if (argc - optind != 2) {
+        std::cerr << "error: incorrect number of arguments\n";
+        usage();
+        return 1;
+    }
+
+    std::string refPrefix = argv[optind];
+    std::string srcPrefix = argv[optind + 1];
+
+    std::vector<std::string> images;
+    findImages(refPrefix, images);
+    findImages(srcPrefix, images);
+    std::sort(images.begin(), images.end());
+    images.erase(std::unique(images.begin(), images.end()), images.end());
+
+    bool json = extension(output) == ".json";
+
+    std::ofstream file;
+    std::ostream *os = &std::cout;
+    if (!output.empty() && output != "-") {
+        file.open(output.c_str());
+        if (!file) {
+            std::cerr << "error: failed to open " << output << "\n";
+            return 1;
+        }
+        os = &file;
+    }
+
+    std::vector<Comparison> comparisons(images.size());
+    for (size_t i = 0; i < images.size(); ++i) {
+        Comparison &comparison = comparisons[i];
+        comparison.name = images[i];
+        comparison.refImage = refPrefix + images[i];
+        comparison.srcImage = srcPrefix + images[i];
+        comparison.deltaImage = stripExtension(comparison.srcImage) + ".diff.png";
+    }
+
+    if (numJobs == 0) {
+        numJobs = std::max(os::thread::hardware_concurrency(), 1U);
+    }
+
+    // Compare on the pool, and report in order as comparisons complete
+    os::mutex mutex;
+    os::condition_variable cond;
+    std::unique_ptr<ThreadPool> pool(new ThreadPool(numJobs));
+    for (auto & comparison : comparisons) {
+        pool->enqueue([&options, json, &comparison, &mutex, &cond] {
+            compareImages(options, !json, comparison);
+            os::unique_lock<os::mutex> lock(mutex);
+            comparison.done = true;
+            cond.notify_all();
+        });
+    }
+
+    if (json) {
+        *os << "{\n  \"ref\": ";
+        writeJSONString(*os, refPrefix);
+        *os << ",\n  \"src\": ";
+        writeJSONString(*os, srcPrefix);
+        *os << ",\n  \"images\": [";
+    } else {
+        *os << "<html>\n"
+               "  <body>\n"
+               "    <table border=\"1\">\n"
+               "      <tr><th>File</th><th>" << refPrefix << "</th><th>" << srcPrefix << "</th><th>&Delta;</th></tr>\n";
+    }
+
+    unsigned failures = 0;
+    for (size_t i = 0; i < comparisons.size(); ++i) {
+        Comparison &comparison = comparisons[i];
+        {
+            os::unique_lock<os::mutex> lock(mutex);
+            while (!comparison.done) {
+                cond.wait(lock);
+            }
+        }
+
+        bool match = comparison.result == RESULT_MATCH;
+        if (!match) {
+            ++failures;
+        }
+
+        if (verbose) {
+            std::cout << "Comparing " << comparison.refImage << " and " << comparison.srcImage
+                      << " ... " << resultName(comparison.result) << "\n";
+        }
+
+        if (json) {
+            writeJSONEntry(*os, comparison, i == 0);
+        } else {
+            *os << "      <tr>\n"
+                   "        <td bgcolor=\"" << (match ? "#20ff20" : "#ff2020") << "\"><a href=\""
+                << comparison.refImage << "\">" << comparison.name << "<a/></td>\n"
+                << comparison.cells
+                << "      </tr>\n";
+        }
+        os->flush();
+
+        // Release memory early on large runs
+        comparison.cells.clear();
+        comparison.cells.shrink_to_fit();
+    }
 
-    os::String command = find_command();
+    pool.reset();
 
-    std::vector<const char *> args;
-    args.push_back(APITRACE_PYTHON_EXECUTABLE);
-    args.push_back(command.str());
-    for (i = 1; i < argc; i++) {
-        args.push_back(argv[i]);
+    if (json) {
+        *os << (comparisons.empty() ? "]" : "\n  ]") << ",\n  \"failures\": " << failures << "\n}\n";
+    } else {
+        *os << "    </table>\n"
+               "  </body>\n"
+               "</html>\n";
     }
-    args.push_back(NULL);
+    os->flush();
 
-    return os::execute((char * const *)&args[0]);
+    return failures ? 1 : 0;
 }
 
 const Command diff_images_command = {
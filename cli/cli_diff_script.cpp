@@ -0,0 +1,342 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "cli_diff_script.hpp"
+
+
+/*
+ * Calls are compared by a 64-bit hash of their function and arguments, and
+ * the hash sequences are diffed with Myers' greedy algorithm.  To bound
+ * memory and time on traces with millions of calls, the algorithm only looks
+ * at `diffWindow` calls of each trace ahead at a time, and gives up on
+ * finding the shortest edit script after `diffMaxCost` edits, committing to
+ * the furthest reaching path instead.
+ *
+ * Where the traces have diverged that path barely advances, so when a window
+ * that hit the cost cap has hardly any calls in common (judging by
+ * `diffSamples` of them) it is replaced in bulk instead, without searching
+ * again for as long as that lasts.
+ */
+static const size_t diffWindow = 1 << 16;
+static const size_t diffMaxCost = 2048;
+static const size_t diffSamples = 1024;
+
+
+static void
+appendRun(DiffScript &script, DiffOp op, size_t count)
+{
+    if (!count) {
+        return;
+    }
+    if (!script.empty() && script.back().op == op) {
+        script.back().count += count;
+    } else {
+        DiffRun run = {op, count};
+        script.push_back(run);
+    }
+}
+
+
+/*
+ * Furthest x reachable on diagonal k with d edits, from the row of d - 1
+ * edits, or -1 if none.  Moves that would leave the n by m grid are not
+ * taken.
+ */
+static inline ptrdiff_t
+myersStep(const int32_t *prev, ptrdiff_t d, ptrdiff_t k,
+          size_t n, size_t m, bool &down)
+{
+    ptrdiff_t xDown = -1;
+    ptrdiff_t xRight = -1;
+    if (k != d && prev[k + 1] >= 0 && prev[k + 1] - (k + 1) < (ptrdiff_t)m) {
+        xDown = prev[k + 1];
+    }
+    if (k != -d && prev[k - 1] >= 0 && prev[k - 1] < (ptrdiff_t)n) {
+        xRight = prev[k - 1] + 1;
+    }
+    down = xDown >= xRight;
+    return std::max(xDown, xRight);
+}
+
+
+/*
+ * Greedy Myers diff of a[0, n) against b[0, m), where either sequence may
+ * be a truncated window of a longer one.  The path stops at (n, m), or as
+ * soon as it exhausts a sequence whose counterpart was truncated, or, after
+ * maxCost edits, at the furthest reaching point.  Appends the runs of the
+ * path to `path`.
+ */
+static bool
+diffWindowed(const uint64_t *a, size_t n, bool truncatedA,
+             const uint64_t *b, size_t m, bool truncatedB,
+             size_t maxCost,
+             std::vector<int32_t> &trace,
+             DiffScript &path)
+{
+    // `trace` holds the furthest reaching x of each diagonal k, for every
+    // cost d, with row d stored at offset d*d.  It is reserved by the caller
+    // for maxCost, so growing it never reallocates.
+    assert(trace.capacity() >= (maxCost + 1) * (maxCost + 1));
+
+    ptrdiff_t endD = -1;
+    ptrdiff_t endK = 0;
+
+    for (ptrdiff_t d = 0; d <= (ptrdiff_t)maxCost && endD < 0; ++d) {
+        trace.resize((d + 1) * (d + 1));
+        int32_t *row = &trace[d * d + d];
+        const int32_t *prev = d ? &trace[(d - 1) * (d - 1) + d - 1] : NULL;
+
+        for (ptrdiff_t k = -d; k <= d; k += 2) {
+            ptrdiff_t x = 0;
+            if (d) {
+                bool down;
+                x = myersStep(prev, d, k, n, m, down);
+                if (x < 0) {
+                    row[k] = -1;
+                    continue;
+                }
+            }
+            ptrdiff_t y = x - k;
+            while (x < (ptrdiff_t)n && y < (ptrdiff_t)m && a[x] == b[y]) {
+                ++x;
+                ++y;
+            }
+            row[k] = x;
+            bool endA = x >= (ptrdiff_t)n;
+            bool endB = y >= (ptrdiff_t)m;
+            if ((endA && endB) || (endA && truncatedB) || (endB && truncatedA)) {
+                endD = d;
+                endK = k;
+                break;
+            }
+        }
+    }
+
+    bool found = endD >= 0;
+    if (!found) {
+        endD = maxCost;
+        const int32_t *row = &trace[endD * endD + endD];
+        ptrdiff_t best = -1;
+        for (ptrdiff_t k = -endD; k <= endD; k += 2) {
+            ptrdiff_t progress = 2 * (ptrdiff_t)row[k] - k;
+            if (row[k] >= 0 && progress > best) {
+                best = progress;
+                endK = k;
+            }
+        }
+    }
+
+    // Walk back the path
+    DiffScript reversed;
+    ptrdiff_t k = endK;
+    ptrdiff_t x = trace[endD * endD + endD + k];
+    for (ptrdiff_t d = endD; d > 0; --d) {
+        const int32_t *prev = &trace[(d - 1) * (d - 1) + d - 1];
+        bool down;
+        myersStep(prev, d, k, n, m, down);
+        ptrdiff_t prevK = down ? k + 1 : k - 1;
+        ptrdiff_t prevX = prev[prevK];
+        ptrdiff_t midX = down ? prevX : prevX + 1;
+        appendRun(reversed, DIFF_EQUAL, x - midX);
+        appendRun(reversed, down ? DIFF_INSERT : DIFF_DELETE, 1);
+        x = prevX;
+        k = prevK;
+    }
+    assert(k == 0);
+    appendRun(reversed, DIFF_EQUAL, x);
+
+    for (auto it = reversed.rbegin(); it != reversed.rend(); ++it) {
+        appendRun(path, it->op, it->count);
+    }
+
+    return found;
+}
+
+
+/*
+ * Whether hardly any of a sample of the hashes in a[0, n) occur in b[0, m).
+ */
+static bool
+hardlyShared(const uint64_t *a, size_t n,
+             const uint64_t *b, size_t m)
+{
+    // Open addressing table of the samples, indexed by their low bits as
+    // hashes are well mixed already.  There are less than 2 * diffSamples
+    // samples, so it is never more than half full.
+    enum { EMPTY, SAMPLED, SHARED };
+    const size_t tableSize = 4 * diffSamples;
+    const size_t mask = tableSize - 1;
+    static_assert((tableSize & mask) == 0, "table size must be a power of two");
+    std::vector<uint64_t> table(tableSize);
+    std::vector<uint8_t> state(tableSize, EMPTY);
+
+    size_t numSamples = 0;
+    size_t step = std::max<size_t>(1, n / diffSamples);
+    for (size_t i = 0; i < n; i += step) {
+        size_t slot = a[i] & mask;
+        while (state[slot] != EMPTY && table[slot] != a[i]) {
+            slot = (slot + 1) & mask;
+        }
+        if (state[slot] == EMPTY) {
+            table[slot] = a[i];
+            state[slot] = SAMPLED;
+            ++numSamples;
+        }
+    }
+
+    size_t numShared = 0;
+    for (size_t j = 0; j < m; ++j) {
+        size_t slot = b[j] & mask;
+        while (state[slot] != EMPTY) {
+            if (table[slot] == b[j]) {
+                if (state[slot] == SAMPLED) {
+                    state[slot] = SHARED;
+                    if (++numShared * 16 >= numSamples) {
+                        return false;
+                    }
+                }
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
+    }
+
+    return true;
+}
+
+
+/*
+ * Diff two hash sequences, sliding a window over them.
+ */
+void
+diffHashes(const std::vector<uint64_t> &a,
+           const std::vector<uint64_t> &b,
+           DiffScript &script)
+{
+    size_t n = a.size();
+    size_t m = b.size();
+
+    size_t suffix = 0;
+    while (suffix < n && suffix < m && a[n - 1 - suffix] == b[m - 1 - suffix]) {
+        ++suffix;
+    }
+    n -= suffix;
+    m -= suffix;
+
+    std::vector<int32_t> trace;
+    trace.reserve((diffMaxCost + 1) * (diffMaxCost + 1));
+
+    bool diverged = false;
+    size_t x = 0;
+    size_t y = 0;
+    while (true) {
+        size_t prefix = 0;
+        while (x + prefix < n && y + prefix < m && a[x + prefix] == b[y + prefix]) {
+            ++prefix;
+        }
+        appendRun(script, DIFF_EQUAL, prefix);
+        x += prefix;
+        y += prefix;
+        if (prefix) {
+            diverged = false;
+        }
+
+        if (x == n || y == m) {
+            break;
+        }
+
+        size_t windowN = std::min(n - x, diffWindow);
+        size_t windowM = std::min(m - y, diffWindow);
+        bool truncatedA = windowN < n - x;
+        bool truncatedB = windowM < m - y;
+
+        // When the window cut either sequence short, only commit the first
+        // half of it, as what lies beyond may change how the path ends.
+        size_t limit = truncatedA || truncatedB ? diffWindow / 2 : SIZE_MAX;
+        size_t bulkN = std::min(windowN, limit);
+        size_t bulkM = std::min(windowM, limit);
+
+        DiffScript path;
+        bool bulk = diverged &&
+                    hardlyShared(&a[x], bulkN, &b[y], windowM) &&
+                    hardlyShared(&b[y], bulkM, &a[x], windowN);
+        if (!bulk) {
+            bool found = diffWindowed(&a[x], windowN, truncatedA,
+                                      &b[y], windowM, truncatedB,
+                                      diffMaxCost, trace, path);
+            bulk = !found && !diverged &&
+                   hardlyShared(&a[x], bulkN, &b[y], windowM) &&
+                   hardlyShared(&b[y], bulkM, &a[x], windowN);
+        }
+        diverged = bulk;
+
+        if (bulk) {
+            appendRun(script, DIFF_DELETE, bulkN);
+            appendRun(script, DIFF_INSERT, bulkM);
+            x += bulkN;
+            y += bulkM;
+            continue;
+        }
+
+        size_t dx = 0;
+        size_t dy = 0;
+        for (auto & run : path) {
+            size_t count = run.count;
+            if (run.op != DIFF_INSERT) {
+                count = std::min(count, limit - dx);
+            }
+            if (run.op != DIFF_DELETE) {
+                count = std::min(count, limit - dy);
+            }
+            if (!count) {
+                break;
+            }
+            appendRun(script, run.op, count);
+            if (run.op != DIFF_INSERT) {
+                dx += count;
+            }
+            if (run.op != DIFF_DELETE) {
+                dy += count;
+            }
+            if (count < run.count) {
+                break;
+            }
+        }
+        x += dx;
+        y += dy;
+    }
+
+    appendRun(script, DIFF_DELETE, n - x);
+    appendRun(script, DIFF_INSERT, m - y);
+    appendRun(script, DIFF_EQUAL, suffix);
+}
@@ -0,0 +1,61 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Edit scripts between sequences of call hashes, for `apitrace diff`.
+ */
+
+#pragma once
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+
+enum DiffOp {
+    DIFF_EQUAL,
+    DIFF_DELETE,
+    DIFF_INSERT,
+};
+
+struct DiffRun
+{
+    DiffOp op;
+    size_t count;
+};
+
+typedef std::vector<DiffRun> DiffScript;
+
+
+/**
+ * Diff two hash sequences, appending the runs of the edit script to
+ * `script`.
+ */
+void
+diffHashes(const std::vector<uint64_t> &a,
+           const std::vector<uint64_t> &b,
+           DiffScript &script);
@@ -0,0 +1,185 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <stdint.h>
+
+#include <chrono>
+#include <vector>
+
+#include "cli_diff_script.hpp"
+
+#include "gtest/gtest.h"
+
+
+typedef std::vector<uint64_t> Hashes;
+
+
+static uint64_t
+splitmix64(uint64_t &state)
+{
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+
+static Hashes
+randomHashes(size_t count, uint64_t seed)
+{
+    Hashes hashes(count);
+    for (auto & hash : hashes) {
+        hash = splitmix64(seed);
+    }
+    return hashes;
+}
+
+
+/*
+ * Checks that the script turns a into b, and returns its number of edits.
+ */
+static size_t
+applyScript(const Hashes &a, const Hashes &b, const DiffScript &script)
+{
+    size_t x = 0;
+    size_t y = 0;
+    size_t cost = 0;
+    for (auto & run : script) {
+        EXPECT_GT(run.count, 0);
+        switch (run.op) {
+        case DIFF_EQUAL:
+            for (size_t i = 0; i < run.count; ++i) {
+                EXPECT_LT(x, a.size());
+                EXPECT_LT(y, b.size());
+                if (x >= a.size() || y >= b.size() || a[x] != b[y]) {
+                    return SIZE_MAX;
+                }
+                ++x;
+                ++y;
+            }
+            break;
+        case DIFF_DELETE:
+            x += run.count;
+            cost += run.count;
+            break;
+        case DIFF_INSERT:
+            y += run.count;
+            cost += run.count;
+            break;
+        }
+    }
+    EXPECT_EQ(a.size(), x);
+    EXPECT_EQ(b.size(), y);
+    return cost;
+}
+
+
+TEST(DiffScript, Identical)
+{
+    Hashes a = randomHashes(100000, 1);
+
+    DiffScript script;
+    diffHashes(a, a, script);
+    ASSERT_EQ(1, script.size());
+    EXPECT_EQ(DIFF_EQUAL, script[0].op);
+    EXPECT_EQ(a.size(), script[0].count);
+}
+
+
+TEST(DiffScript, Minimal)
+{
+    Hashes a = randomHashes(1000, 1);
+    Hashes b = a;
+    b.erase(b.begin() + 800);
+    b[500] = 42;
+    b.insert(b.begin() + 100, 43);
+
+    DiffScript script;
+    diffHashes(a, b, script);
+    EXPECT_EQ(4, applyScript(a, b, script));
+}
+
+
+TEST(DiffScript, BeyondMaxCost)
+{
+    // More insertions in one place than a window searches for
+    Hashes a = randomHashes(200000, 1);
+    Hashes b = a;
+    Hashes inserted = randomHashes(3000, 2);
+    b.insert(b.begin() + 20000, inserted.begin(), inserted.end());
+
+    DiffScript script;
+    diffHashes(a, b, script);
+    EXPECT_EQ(inserted.size(), applyScript(a, b, script));
+}
+
+
+TEST(DiffScript, Diverged)
+{
+    // Traces that diverge for a while, and then agree again
+    Hashes common = randomHashes(10000, 1);
+    Hashes a = common;
+    Hashes b = common;
+    Hashes divergedA = randomHashes(300000, 2);
+    Hashes divergedB = randomHashes(250000, 3);
+    a.insert(a.begin() + 5000, divergedA.begin(), divergedA.end());
+    b.insert(b.begin() + 5000, divergedB.begin(), divergedB.end());
+
+    DiffScript script;
+    diffHashes(a, b, script);
+    EXPECT_EQ(divergedA.size() + divergedB.size(), applyScript(a, b, script));
+    ASSERT_FALSE(script.empty());
+    EXPECT_EQ(DIFF_EQUAL, script.front().op);
+    EXPECT_EQ(5000, script.front().count);
+    EXPECT_EQ(DIFF_EQUAL, script.back().op);
+    EXPECT_EQ(5000, script.back().count);
+}
+
+
+TEST(DiffScript, FullyDivergent)
+{
+    // Two 2M call traces with nothing in common, as when every pointer
+    // differs.  Searching every window up to the cost cap took tens of
+    // seconds on these.
+    Hashes a = randomHashes(2000000, 1);
+    Hashes b = randomHashes(2000000, 2);
+
+    auto start = std::chrono::steady_clock::now();
+    DiffScript script;
+    diffHashes(a, b, script);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    EXPECT_EQ(a.size() + b.size(), applyScript(a, b, script));
+    EXPECT_LT(elapsed.count(), 2.0);
+}
+
+
+int
+main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -34,8 +34,11 @@
 #endif
 
 #include <memory>
+#include <deque>
 #include <fstream>
+#include <sstream>
 #include <string>
+#include <vector>
 
 #include "cxx_compat.hpp" // for std::to_string, std::make_unique
 
@@ -46,6 +49,8 @@
 #include "trace_dump_internal.hpp"
 #include "trace_callset.hpp"
 #include "trace_option.hpp"
+#include "os_thread.hpp"
+#include "thread_pool.hpp"
 
 
 enum ColorOption {
@@ -60,6 +65,11 @@ static bool verbose = false;
 
 static trace::CallSet calls(trace::FREQUENCY_ALL);
 
+static unsigned numJobs = 0;
+
+/* Number of calls formatted by a single worker task. */
+static const size_t batchSize = 1024;
+
 static const char *synopsis = "Dump given trace(s) to standard output.";
 
 static void
@@ -71,6 +81,7 @@ usage(void)
         "\n"
         "    -h, --help           show this help message and exit\n"
         "    -v, --verbose        verbose output\n"
+        "    -j, --jobs=N         format calls on N threads [default: number of CPUs]\n"
         "    --calls=CALLSET      only dump specified calls\n"
         "    --color[=WHEN]\n"
         "    --colour[=WHEN]      colored syntax highlighting\n"
@@ -93,12 +104,13 @@ enum {
 };
 
 const static char *
-shortOptions = "hv";
+shortOptions = "hvj:";
 
 const static struct option
 longOptions[] = {
     {"help", no_argument, 0, 'h'},
     {"verbose", no_argument, 0, 'v'},
+    {"jobs", required_argument, 0, 'j'},
     {"calls", required_argument, 0, CALLS_OPT},
     {"colour", optional_argument, 0, COLOR_OPT},
     {"color", optional_argument, 0, COLOR_OPT},
@@ -146,6 +158,129 @@ public:
 };
 
 
+static trace::Dumper *
+createDumper(std::ostream &os, trace::DumpFlags flags, bool blobs)
+{
+    if (blobs) {
+        return new BlobDumper(os, flags);
+    } else {
+        return new trace::Dumper(os, flags);
+    }
+}
+
+
+/*
+ * Formats calls on a thread pool while preserving their order.
+ *
+ * The parser is inherently sequential (signatures are defined inline on
+ * first use), so calls are still parsed on the calling thread, but they
+ * are handed over in batches to worker threads, each of which renders its
+ * batch into a private string buffer.  Finished buffers are written to
+ * standard output strictly in submission order.
+ */
+class ParallelDumper
+{
+    struct Batch {
+        std::vector<trace::Call *> calls;
+        std::string text;
+        bool done = false;
+    };
+
+    trace::DumpFlags flags;
+    bool blobs;
+    unsigned maxPending;
+
+    os::mutex mutex;
+    os::condition_variable cond;
+    std::deque<std::shared_ptr<Batch>> pending;
+    std::shared_ptr<Batch> current;
+
+    ThreadPool pool;
+
+    void
+    format(std::shared_ptr<Batch> batch) {
+        std::ostringstream os;
+        {
+            std::unique_ptr<trace::Dumper> dumper(createDumper(os, flags, blobs));
+            for (trace::Call *call : batch->calls) {
+                dumper->visit(call);
+                delete call;
+            }
+        }
+        batch->calls.clear();
+
+        os::unique_lock<os::mutex> lock(mutex);
+        batch->text = os.str();
+        batch->done = true;
+        cond.notify_all();
+    }
+
+    void
+    submit(void) {
+        std::shared_ptr<Batch> batch;
+        batch.swap(current);
+        pending.push_back(batch);
+        pool.enqueue(&ParallelDumper::format, this, batch);
+    }
+
+    /* Write finished batches; block until at most `limit` remain. */
+    void
+    drain(size_t limit) {
+        while (!pending.empty()) {
+            std::shared_ptr<Batch> batch = pending.front();
+            {
+                os::unique_lock<os::mutex> lock(mutex);
+                if (!batch->done) {
+                    if (pending.size() <= limit) {
+                        return;
+                    }
+                    cond.wait(lock, [&batch]{ return batch->done; });
+                }
+            }
+            std::cout.write(batch->text.data(), batch->text.size());
+            pending.pop_front();
+        }
+    }
+
+public:
+    ParallelDumper(unsigned jobs, trace::DumpFlags _flags, bool _blobs) :
+        flags(_flags),
+        blobs(_blobs),
+        maxPending(2 * jobs),
+        pool(jobs)
+    {
+    }
+
+    ~ParallelDumper() {
+        flush();
+    }
+
+    void
+    dump(trace::Call *call) {
+        if (!current) {
+            current = std::make_shared<Batch>();
+            current->calls.reserve(batchSize);
+        }
+        current->calls.push_back(call);
+        if (current->calls.size() >= batchSize) {
+            submit();
+            drain(maxPending);
+        }
+    }
+
+    /* Output everything submitted so far.  Must be called before the
+     * parser that produced the calls is closed. */
+    void
+    flush(void) {
+        if (current) {
+            submit();
+        }
+        drain(0);
+        std::cout.flush();
+    }
+};
+
+
 static int
 command(int argc, char *argv[])
 {
@@ -161,6 +296,16 @@ command(int argc, char *argv[])
         case 'v':
             verbose = true;
             break;
+        case 'j':
+        {
+            int jobs = trace::intOption(optarg, 0);
+            if (jobs <= 0) {
+                std::cerr << "error: invalid number of jobs " << optarg << "\n";
+                return 1;
+            }
+            numJobs = jobs;
+            break;
+        }
         case CALLS_OPT:
             calls.merge(optarg);
             break;
@@ -221,16 +366,27 @@ command(int argc, char *argv[])
         dumpFlags |= trace::DUMP_FLAG_NO_COLOR;
     }
 
+    if (numJobs == 0) {
+        numJobs = os::thread::hardware_concurrency();
+    }
+#ifdef _WIN32
+    // The Windows console highlighter changes the console attributes
+    // directly, so colored output can't be buffered.
+    if (color == COLOR_OPTION_ALWAYS) {
+        numJobs = 1;
+    }
+#endif
+
     std::unique_ptr<trace::Dumper> dumper;
+    std::unique_ptr<ParallelDumper> parallelDumper;
 
-    if (blobs) {
-        dumper = std::make_unique<BlobDumper>(std::cout, dumpFlags);
+    if (numJobs > 1) {
+        parallelDumper = std::make_unique<ParallelDumper>(numJobs, dumpFlags, blobs);
     } else {
-        dumper = std::make_unique<trace::Dumper>(std::cout, dumpFlags);
+        dumper.reset(createDumper(std::cout, dumpFlags, blobs));
     }
 
     int lastCallno = calls.getLast();
-   // printf("lastCallno=%d\n", lastCallno);
 
     for (int i = optind; i < argc; ++i) {
         trace::Parser p;
@@ -239,21 +395,34 @@ command(int argc, char *argv[])
             return 1;
         }
 
+        bool done = false;
         trace::Call *call;
         while ((call = p.parse_call())) {
             if (calls.contains(*call)) {
                 if (verbose ||
                     !(call->flags & trace::CALL_FLAG_VERBOSE)) {
+                    if (parallelDumper) {
+                        // ownership passes to the worker
+                        parallelDumper->dump(call);
+                        continue;
+                    }
                     dumper->visit(call);
-		  
                 }
+            } else if (call->no > lastCallno) {
+                delete call;
+                done = true;
+                break;
             }
-	    else if (call->no > lastCallno)
-	    {
-		return 0;
-	    }
             delete call;
         }
+
+        if (parallelDumper) {
+            parallelDumper->flush();
+        }
+
+        if (done) {
+            return 0;
+        }
     }
 
     return 0;
@@ -0,0 +1,110 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <string.h>
+#include <getopt.h>
+
+#include <fstream>
+#include <iostream>
+
+#include "cli.hpp"
+
+#include "trace_profiler.hpp"
+
+
+static const char *synopsis = "Convert a binary profile to text.";
+
+static void
+usage(void)
+{
+    std::cout
+        << "usage: apitrace dump-profile [OPTIONS] PROFILE\n"
+        << synopsis << "\n"
+        "\n"
+        "PROFILE is the output of `glretrace --profile-format=binary`.  The\n"
+        "result has the same layout as the text profile output.\n"
+        "\n"
+        "    -h, --help             show this help message and exit\n"
+        "\n";
+}
+
+const static char *
+shortOptions = "h";
+
+const static struct option
+longOptions[] = {
+    {"help", no_argument, 0, 'h'},
+    {0, 0, 0, 0}
+};
+
+static int
+command(int argc, char *argv[])
+{
+    int opt;
+    while ((opt = getopt_long(argc, argv, shortOptions, longOptions, NULL)) != -1) {
+        switch (opt) {
+        case 'h':
+            usage();
+            return 0;
+        default:
+            std::cerr << "error: unexpected option `" << (char)opt << "`\n";
+            usage();
+            return 1;
+        }
+    }
+
+    if (argc != optind + 1) {
+        std::cerr << "error: apitrace dump-profile requires a single profile file as an argument.\n";
+        usage();
+        return 1;
+    }
+
+    const char *fileName = argv[optind];
+
+    std::ifstream file(fileName, std::ios::in | std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "error: failed to open " << fileName << "\n";
+        return 1;
+    }
+
+    trace::ProfileTextWriter writer(std::cout);
+    writer.writeHeader();
+
+    trace::BinaryProfileParser parser;
+    if (!parser.parse(file, writer)) {
+        std::cerr << "error: " << fileName << " is not a valid binary profile\n";
+        return 1;
+    }
+
+    return 0;
+}
+
+const Command dump_profile_command = {
+    "dump-profile",
+    synopsis,
+    usage,
+    command
+};
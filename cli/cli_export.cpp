@@ -0,0 +1,410 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <string.h>
+#include <limits.h> // for CHAR_MAX
+#include <getopt.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cli.hpp"
+#include "cli_parquet.hpp"
+
+#include "os_string.hpp"
+
+#include "trace_callset.hpp"
+#include "trace_option.hpp"
+#include "trace_parser.hpp"
+
+
+static const char *synopsis = "Export a trace's call table for analysis.";
+
+static void
+usage(void)
+{
+    std::cout
+        << "usage: apitrace export --columnar [OPTIONS] TRACE_FILE\n"
+        << synopsis << "\n"
+        "\n"
+        "    -h, --help               Show detailed help for export options and exit\n"
+        "        --columnar           Write an Apache Parquet file [default]\n"
+        "        --calls=CALLSET      Only export specified calls\n"
+        "        --arg=NAME[:TYPE]    Add a column with the value of argument NAME,\n"
+        "                             where TYPE is 'int' [default] or 'double'\n"
+        "        --row-group-size=N   Rows per row group [default: 1048576]\n"
+        "    -o, --output=FILE        Output file [default: TRACE_FILE.parquet]\n"
+        "\n"
+        "Each call becomes a row with the columns call_no, thread, frame,\n"
+        "function_id, function, flags and blob_bytes (the total size of all blobs\n"
+        "in the arguments and return value), plus one nullable arg_NAME column per\n"
+        "--arg option.  The function column is dictionary-encoded.\n"
+        "\n"
+        "Example:\n"
+        "\n"
+        "    apitrace export --columnar --arg=mode --arg=count application.trace\n"
+        "    duckdb -c \"SELECT function, sum(blob_bytes) FROM 'application.parquet'\n"
+        "               GROUP BY function ORDER BY 2 DESC\"\n"
+    ;
+}
+
+enum {
+    COLUMNAR_OPT = CHAR_MAX + 1,
+    CALLS_OPT,
+    ARG_OPT,
+    ROW_GROUP_SIZE_OPT,
+};
+
+const static char *
+shortOptions = "ho:";
+
+const static struct option
+longOptions[] = {
+    {"help", no_argument, 0, 'h'},
+    {"columnar", no_argument, 0, COLUMNAR_OPT},
+    {"calls", required_argument, 0, CALLS_OPT},
+    {"arg", required_argument, 0, ARG_OPT},
+    {"row-group-size", required_argument, 0, ROW_GROUP_SIZE_OPT},
+    {"output", required_argument, 0, 'o'},
+    {0, 0, 0, 0}
+};
+
+
+struct ArgColumn {
+    std::string name;
+    parquet::Type type;
+    unsigned column;
+};
+
+
+/*
+ * Extracts a scalar from an argument value, looking through Repr nodes.
+ */
+class ScalarVisitor : public trace::Visitor
+{
+public:
+    enum Kind {
+        NONE,
+        INTEGER,
+        REAL,
+    };
+
+    Kind kind = NONE;
+    long long i = 0;
+    double d = 0.0;
+
+    void visit(trace::Null *) override { kind = NONE; }
+    void visit(trace::Bool *node) override { setInt(node->value); }
+    void visit(trace::SInt *node) override { setInt(node->value); }
+    void visit(trace::UInt *node) override { setInt(node->value); }
+    void visit(trace::Float *node) override { setReal(node->value); }
+    void visit(trace::Double *node) override { setReal(node->value); }
+    void visit(trace::String *) override { kind = NONE; }
+    void visit(trace::WString *) override { kind = NONE; }
+    void visit(trace::Enum *node) override { setInt(node->value); }
+    void visit(trace::Bitmask *node) override { setInt(node->value); }
+    void visit(trace::Struct *) override { kind = NONE; }
+    void visit(trace::Array *) override { kind = NONE; }
+    void visit(trace::Blob *) override { kind = NONE; }
+    void visit(trace::Pointer *node) override { setInt(node->value); }
+    void visit(trace::Repr *node) override { _visit(node->machineValue); }
+
+    void
+    extract(trace::Value *value) {
+        kind = NONE;
+        _visit(value);
+    }
+
+private:
+    void setInt(long long value) { kind = INTEGER; i = value; }
+    void setReal(double value) { kind = REAL; d = value; }
+};
+
+
+/*
+ * Sums the sizes of all blobs reachable from a value.
+ */
+class BlobSizeVisitor : public trace::Visitor
+{
+public:
+    unsigned long long bytes = 0;
+
+    void visit(trace::Null *) override {}
+    void visit(trace::Bool *) override {}
+    void visit(trace::SInt *) override {}
+    void visit(trace::UInt *) override {}
+    void visit(trace::Float *) override {}
+    void visit(trace::Double *) override {}
+    void visit(trace::String *) override {}
+    void visit(trace::WString *) override {}
+    void visit(trace::Enum *) override {}
+    void visit(trace::Bitmask *) override {}
+    void visit(trace::Pointer *) override {}
+
+    void visit(trace::Struct *s) override {
+        for (auto member : s->members) {
+            _visit(member);
+        }
+    }
+
+    void visit(trace::Array *array) override {
+        for (auto value : array->values) {
+            _visit(value);
+        }
+    }
+
+    void visit(trace::Blob *blob) override {
+        bytes += blob->size;
+    }
+
+    void visit(trace::Repr *node) override {
+        _visit(node->machineValue);
+    }
+
+    void
+    count(trace::Value *value) {
+        _visit(value);
+    }
+};
+
+
+static int
+export_columnar(const char *filename,
+                const std::string &output,
+                trace::CallSet &calls,
+                std::vector<ArgColumn> &args,
+                size_t rowGroupSize)
+{
+    trace::Parser p;
+    if (!p.open(filename)) {
+        std::cerr << "error: failed to open " << filename << "\n";
+        return 1;
+    }
+
+    parquet::Writer writer;
+    writer.setRowGroupSize(rowGroupSize);
+
+    unsigned callNoColumn = writer.addColumn("call_no", parquet::TYPE_INT64);
+    unsigned threadColumn = writer.addColumn("thread", parquet::TYPE_INT32);
+    unsigned frameColumn = writer.addColumn("frame", parquet::TYPE_INT32);
+    unsigned functionIdColumn = writer.addColumn("function_id", parquet::TYPE_INT32);
+    unsigned functionColumn = writer.addColumn("function", parquet::TYPE_STRING);
+    unsigned flagsColumn = writer.addColumn("flags", parquet::TYPE_INT32);
+    unsigned blobBytesColumn = writer.addColumn("blob_bytes", parquet::TYPE_INT64);
+    for (ArgColumn &arg : args) {
+        arg.column = writer.addColumn("arg_" + arg.name, arg.type, true);
+    }
+
+    if (!writer.open(output.c_str())) {
+        std::cerr << "error: failed to create " << output << "\n";
+        return 1;
+    }
+
+    /* Argument index of each --arg column, per function signature id
+     * (-1 if the function has no argument with that name). */
+    std::vector<std::vector<int>> argIndices;
+
+    ScalarVisitor scalar;
+    unsigned frame = 0;
+    trace::Call *call;
+    while ((call = p.parse_call())) {
+        if (calls.contains(*call)) {
+            writer.appendInt64(callNoColumn, call->no);
+            writer.appendInt32(threadColumn, call->thread_id);
+            writer.appendInt32(frameColumn, frame);
+            writer.appendInt32(functionIdColumn, call->sig->id);
+            writer.appendString(functionColumn, call->sig->name);
+            writer.appendInt32(flagsColumn, call->flags);
+
+            BlobSizeVisitor blobSize;
+            for (auto &arg : call->args) {
+                blobSize.count(arg.value);
+            }
+            blobSize.count(call->ret);
+            writer.appendInt64(blobBytesColumn, blobSize.bytes);
+
+            if (!args.empty()) {
+                if (argIndices.size() <= call->sig->id) {
+                    argIndices.resize(call->sig->id + 1);
+                }
+                std::vector<int> &indices = argIndices[call->sig->id];
+                if (indices.empty()) {
+                    for (const ArgColumn &arg : args) {
+                        int index = -1;
+                        for (unsigned i = 0; i < call->sig->num_args; ++i) {
+                            if (arg.name == call->sig->arg_names[i]) {
+                                index = i;
+                                break;
+                            }
+                        }
+                        indices.push_back(index);
+                    }
+                }
+
+                for (size_t i = 0; i < args.size(); ++i) {
+                    int index = indices[i];
+                    if (index >= 0 && unsigned(index) < call->args.size()) {
+                        scalar.extract(call->args[index].value);
+                    } else {
+                        scalar.kind = ScalarVisitor::NONE;
+                    }
+
+                    unsigned column = args[i].column;
+                    if (scalar.kind == ScalarVisitor::NONE) {
+                        writer.appendNull(column);
+                    } else if (args[i].type == parquet::TYPE_DOUBLE) {
+                        writer.appendDouble(column, scalar.kind == ScalarVisitor::REAL ? scalar.d : double(scalar.i));
+                    } else {
+                        writer.appendInt64(column, scalar.kind == ScalarVisitor::INTEGER ? scalar.i : (long long)scalar.d);
+                    }
+                }
+            }
+
+            writer.endRow();
+        }
+
+        if (call->flags & trace::CALL_FLAG_END_FRAME) {
+            ++frame;
+        }
+
+        delete call;
+    }
+
+    if (!writer.close()) {
+        std::cerr << "error: failed to write " << output << "\n";
+        return 1;
+    }
+
+    std::cerr << "Exported " << writer.totalRows() << " calls to " << output << "\n";
+
+    return 0;
+}
+
+
+static int
+command(int argc, char *argv[])
+{
+    std::string output;
+    trace::CallSet calls(trace::FREQUENCY_ALL);
+    std::vector<ArgColumn> args;
+    size_t rowGroupSize = 1024 * 1024;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, shortOptions, longOptions, NULL)) != -1) {
+        switch (opt) {
+        case 'h':
+            usage();
+            return 0;
+        case COLUMNAR_OPT:
+            break;
+        case CALLS_OPT:
+            calls.merge(optarg);
+            break;
+        case ARG_OPT:
+        {
+            ArgColumn arg;
+            arg.type = parquet::TYPE_INT64;
+            arg.column = 0;
+            const char *colon = strchr(optarg, ':');
+            if (colon) {
+                arg.name.assign(optarg, colon - optarg);
+                if (strcmp(colon + 1, "double") == 0) {
+                    arg.type = parquet::TYPE_DOUBLE;
+                } else if (strcmp(colon + 1, "int") != 0) {
+                    std::cerr << "error: unknown argument type " << colon + 1 << "\n";
+                    return 1;
+                }
+            } else {
+                arg.name = optarg;
+            }
+            if (arg.name.empty()) {
+                std::cerr << "error: empty argument name\n";
+                return 1;
+            }
+            for (const ArgColumn &other : args) {
+                if (other.name == arg.name) {
+                    std::cerr << "error: argument " << arg.name << " given more than once\n";
+                    return 1;
+                }
+            }
+            args.push_back(arg);
+            break;
+        }
+        case ROW_GROUP_SIZE_OPT:
+        {
+            int rows = trace::intOption(optarg, 0);
+            if (rows <= 0) {
+                std::cerr << "error: invalid row group size " << optarg << "\n";
+                return 1;
+            }
+            rowGroupSize = rows;
+            break;
+        }
+        case 'o':
+            output = optarg;
+            break;
+        default:
+            std::cerr << "error: unexpected option `" << (char)opt << "`\n";
+            usage();
+            return 1;
+        }
+    }
+
+    if (optind >= argc) {
+        std::cerr << "error: apitrace export requires a trace file as an argument.\n";
+        usage();
+        return 1;
+    }
+
+    if (argc > optind + 1) {
+        std::cerr << "error: extraneous arguments:";
+        for (int i = optind + 1; i < argc; i++) {
+            std::cerr << " " << argv[i];
+        }
+        std::cerr << "\n";
+        usage();
+        return 1;
+    }
+
+    const char *filename = argv[optind];
+
+    if (output.empty()) {
+        os::String base(filename);
+        base.trimExtension();
+
+        output = std::string(base.str()) + std::string(".parquet");
+    }
+
+    return export_columnar(filename, output, calls, args, rowGroupSize);
+}
+
+const Command export_command = {
+    "export",
+    synopsis,
+    usage,
+    command
+};
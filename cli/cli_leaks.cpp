@@ -25,56 +25,750 @@
  *
  *********************************************************************/
 
+/*
+ * Native object leak checker.
+ *
+ * The trace is scanned once, fully parsing only the handful of calls that
+ * create, delete, or bind objects and contexts (see
+ * trace::Parser::setScanFilter).  Live object names are kept in one hash
+ * table per namespace, where a namespace is either a share group (for
+ * shareable objects like textures and buffers) or a single context (for
+ * objects that are never shared, like vertex arrays and framebuffers), so
+ * every call is handled in constant time regardless of how many objects are
+ * alive.
+ */
+
+
+#include <assert.h>
+#include <limits.h> // for CHAR_MAX
 #include <string.h>
+#include <getopt.h>
+
+#include <algorithm>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
 
 #include "cli.hpp"
-#include "os_string.hpp"
-#include "os_process.hpp"
-#include "cli_resources.hpp"
+
+#include "trace_parser.hpp"
+
 
 static const char *synopsis = "Check trace for object leaks.";
 
-static os::String
-find_command(void)
+static void
+usage(void)
 {
-    return findScript("leaks.py");
+    std::cout
+        << "usage: apitrace leaks [OPTIONS] TRACE_FILE\n"
+        << synopsis << "\n"
+        "\n"
+        "    -h, --help           Show this help message and exit\n"
+        "    --no-backtraces      Do not print the backtraces of leaked objects' creation\n"
+        "\n"
+        "Leaks are reported on stderr, one per line, as\n"
+        "\n"
+        "    CALLNO: error: KIND NAME was not destroyed until CALLNO|<EOF>\n"
+        "\n";
 }
 
-static void
-usage(void)
+enum {
+    NO_BACKTRACES_OPT = CHAR_MAX + 1,
+};
+
+const static char *
+shortOptions = "h";
+
+const static struct option
+longOptions[] = {
+    {"help", no_argument, 0, 'h'},
+    {"no-backtraces", no_argument, 0, NO_BACKTRACES_OPT},
+    {0, 0, 0, 0}
+};
+
+
+enum ObjectKind {
+    KIND_BUFFER,
+    KIND_TEXTURE,
+    KIND_RENDERBUFFER,
+    KIND_SAMPLER,
+    KIND_SHADER,
+    KIND_PROGRAM,
+    KIND_FRAMEBUFFER,
+    KIND_VERTEX_ARRAY,
+    KIND_QUERY,
+    KIND_TRANSFORM_FEEDBACK,
+    KIND_PROGRAM_PIPELINE,
+    NUM_KINDS
+};
+
+struct ObjectKindInfo {
+    const char *name;
+    // Plural noun of glGen*/glCreate*/glDelete* functions, if any.
+    const char *noun;
+    // Whether objects of this kind are shared among the contexts of a share
+    // group, as opposed to being private to the context that created them.
+    bool shared;
+};
+
+static const ObjectKindInfo
+kinds[NUM_KINDS] = {
+    {"buffer",             "Buffers",            true},
+    {"texture",            "Textures",           true},
+    {"renderbuffer",       "Renderbuffers",      true},
+    {"sampler",            "Samplers",           true},
+    {"shader",             NULL,                 true},
+    {"program",            NULL,                 true},
+    {"framebuffer",        "Framebuffers",       false},
+    {"vertex array",       "VertexArrays",       false},
+    {"query",              "Queries",            false},
+    {"transform feedback", "TransformFeedbacks", false},
+    {"program pipeline",   "ProgramPipelines",   false},
+};
+
+
+enum Action {
+    ACTION_GEN_OBJECTS,     // (..., n, names)
+    ACTION_DELETE_OBJECTS,  // (..., n, names)
+    ACTION_CREATE_OBJECT,   // name returned
+    ACTION_DELETE_OBJECT,   // name in first argument
+    ACTION_CREATE_CONTEXT,
+    ACTION_DESTROY_CONTEXT,
+    ACTION_MAKE_CURRENT,
+    ACTION_SHARE_LISTS,
+};
+
+enum {
+    RETURN_VALUE = -1,
+    NO_ARG = -2,
+};
+
+// glDeleteObjectARB takes either shaders or programs.
+#define KIND_SHADER_OR_PROGRAM NUM_KINDS
+
+struct FunctionInfo {
+    const char *name;
+    Action action;
+    int kind;
+    // Argument index of the context handle (for context functions.)
+    int context;
+    // Argument index of the context to share objects with.
+    int share;
+};
+
+static const FunctionInfo
+functions[] = {
+    {"glCreateShader",             ACTION_CREATE_OBJECT, KIND_SHADER,  RETURN_VALUE, NO_ARG},
+    {"glCreateShaderObjectARB",    ACTION_CREATE_OBJECT, KIND_SHADER,  RETURN_VALUE, NO_ARG},
+    {"glCreateProgram",            ACTION_CREATE_OBJECT, KIND_PROGRAM, RETURN_VALUE, NO_ARG},
+    {"glCreateProgramObjectARB",   ACTION_CREATE_OBJECT, KIND_PROGRAM, RETURN_VALUE, NO_ARG},
+    {"glCreateShaderProgramv",     ACTION_CREATE_OBJECT, KIND_PROGRAM, RETURN_VALUE, NO_ARG},
+    {"glCreateShaderProgramEXT",   ACTION_CREATE_OBJECT, KIND_PROGRAM, RETURN_VALUE, NO_ARG},
+    {"glCreateShaderProgramvEXT",  ACTION_CREATE_OBJECT, KIND_PROGRAM, RETURN_VALUE, NO_ARG},
+    {"glDeleteShader",             ACTION_DELETE_OBJECT, KIND_SHADER,  NO_ARG, NO_ARG},
+    {"glDeleteProgram",            ACTION_DELETE_OBJECT, KIND_PROGRAM, NO_ARG, NO_ARG},
+    {"glDeleteObjectARB",          ACTION_DELETE_OBJECT, KIND_SHADER_OR_PROGRAM, NO_ARG, NO_ARG},
+
+    {"CGLCreateContext",               ACTION_CREATE_CONTEXT, 0, 2, 1},
+    {"eglCreateContext",               ACTION_CREATE_CONTEXT, 0, RETURN_VALUE, 2},
+    {"glXCreateContext",               ACTION_CREATE_CONTEXT, 0, RETURN_VALUE, 2},
+    {"glXCreateContextAttribsARB",     ACTION_CREATE_CONTEXT, 0, RETURN_VALUE, 2},
+    {"glXCreateNewContext",            ACTION_CREATE_CONTEXT, 0, RETURN_VALUE, 3},
+    {"glXCreateContextWithConfigSGIX", ACTION_CREATE_CONTEXT, 0, RETURN_VALUE, 3},
+    {"wglCreateContext",               ACTION_CREATE_CONTEXT, 0, RETURN_VALUE, NO_ARG},
+    {"wglCreateLayerContext",          ACTION_CREATE_CONTEXT, 0, RETURN_VALUE, NO_ARG},
+    {"wglCreateContextAttribsARB",     ACTION_CREATE_CONTEXT, 0, RETURN_VALUE, 1},
+
+    {"CGLDestroyContext",  ACTION_DESTROY_CONTEXT, 0, 0, NO_ARG},
+    {"eglDestroyContext",  ACTION_DESTROY_CONTEXT, 0, 1, NO_ARG},
+    {"glXDestroyContext",  ACTION_DESTROY_CONTEXT, 0, 1, NO_ARG},
+    {"wglDeleteContext",   ACTION_DESTROY_CONTEXT, 0, 0, NO_ARG},
+
+    {"CGLSetCurrentContext",     ACTION_MAKE_CURRENT, 0, 0, NO_ARG},
+    {"eglMakeCurrent",           ACTION_MAKE_CURRENT, 0, 3, NO_ARG},
+    {"glXMakeCurrent",           ACTION_MAKE_CURRENT, 0, 2, NO_ARG},
+    {"glXMakeContextCurrent",    ACTION_MAKE_CURRENT, 0, 3, NO_ARG},
+    {"glXMakeCurrentReadSGI",    ACTION_MAKE_CURRENT, 0, 3, NO_ARG},
+    {"wglMakeCurrent",           ACTION_MAKE_CURRENT, 0, 1, NO_ARG},
+    {"wglMakeContextCurrentARB", ACTION_MAKE_CURRENT, 0, 2, NO_ARG},
+    {"wglMakeContextCurrentEXT", ACTION_MAKE_CURRENT, 0, 2, NO_ARG},
+
+    // wglShareLists(hglrc1, hglrc2) makes hglrc2 share hglrc1's objects.
+    {"wglShareLists",            ACTION_SHARE_LISTS, 0, 1, 0},
+};
+
+
+static FunctionInfo genFunctions[NUM_KINDS];
+static FunctionInfo deleteFunctions[NUM_KINDS];
+
+
+/*
+ * Match gl(Gen|Create|Delete)<Noun>[A-Z]*, where the optional suffix is the
+ * vendor of the extension (ARB, EXT, OES, APPLE, ...).
+ */
+static const FunctionInfo *
+lookupGenDeleteFunction(const char *name)
 {
-    os::String command = find_command();
+    FunctionInfo *table;
+    if (strncmp(name, "glGen", 5) == 0) {
+        name += 5;
+        table = genFunctions;
+    } else if (strncmp(name, "glCreate", 8) == 0) {
+        name += 8;
+        table = genFunctions;
+    } else if (strncmp(name, "glDelete", 8) == 0) {
+        name += 8;
+        table = deleteFunctions;
+    } else {
+        return NULL;
+    }
 
-    char *args[4];
-    args[0] = (char *) APITRACE_PYTHON_EXECUTABLE;
-    args[1] = (char *) command.str();
-    args[2] = (char *) "--help";
-    args[3] = NULL;
+    for (int kind = 0; kind < NUM_KINDS; ++kind) {
+        const char *noun = kinds[kind].noun;
+        if (!noun) {
+            continue;
+        }
+        size_t length = strlen(noun);
+        if (strncmp(name, noun, length) == 0) {
+            const char *suffix = name + length;
+            while (*suffix >= 'A' && *suffix <= 'Z') {
+                ++suffix;
+            }
+            if (*suffix == '\0') {
+                FunctionInfo *info = &table[kind];
+                info->action = table == genFunctions ? ACTION_GEN_OBJECTS : ACTION_DELETE_OBJECTS;
+                info->kind = kind;
+                return info;
+            }
+        }
+    }
 
-    os::execute(args);
+    return NULL;
+}
+
+
+static const FunctionInfo *
+lookupFunction(const char *name)
+{
+    for (auto & info : functions) {
+        if (strcmp(name, info.name) == 0) {
+            return &info;
+        }
+    }
+    return lookupGenDeleteFunction(name);
+}
+
+
+static bool
+scanFilter(const char *name)
+{
+    return lookupFunction(name) != NULL;
 }
 
+
+/*
+ * Extract an object name or context handle from a value, whatever its
+ * representation in the trace (integer handles, opaque pointers, or output
+ * pointers to either.)
+ */
+class HandleGetter : public trace::Visitor
+{
+public:
+    unsigned long long handle = 0;
+
+    void visit(trace::Null *) override { handle = 0; }
+    void visit(trace::Bool *node) override { handle = node->value; }
+    void visit(trace::SInt *node) override { handle = node->value; }
+    void visit(trace::UInt *node) override { handle = node->value; }
+    void visit(trace::Enum *node) override { handle = node->value; }
+    void visit(trace::Pointer *node) override { handle = node->value; }
+    void visit(trace::Float *) override { handle = 0; }
+    void visit(trace::Double *) override { handle = 0; }
+    void visit(trace::String *) override { handle = 0; }
+    void visit(trace::WString *) override { handle = 0; }
+    void visit(trace::Struct *) override { handle = 0; }
+    void visit(trace::Blob *) override { handle = 0; }
+    void visit(trace::Array *node) override {
+        if (node->size()) {
+            _visit(node->values[0]);
+        } else {
+            handle = 0;
+        }
+    }
+};
+
+static unsigned long long
+getHandle(trace::Value *value)
+{
+    HandleGetter getter;
+    if (value) {
+        value->visit(getter);
+    }
+    return getter.handle;
+}
+
+
+typedef std::unordered_map<unsigned long long, unsigned> Namespace;
+
+struct ShareGroup {
+    unsigned numContexts = 0;
+    Namespace objects[NUM_KINDS];
+};
+
+struct Context {
+    ShareGroup *shareGroup = nullptr;
+    Namespace objects[NUM_KINDS];
+
+    Namespace &
+    getNamespace(int kind) {
+        return kinds[kind].shared ? shareGroup->objects[kind] : objects[kind];
+    }
+};
+
+struct Leak {
+    unsigned callNo;
+    int kind;
+    unsigned long long name;
+
+    bool operator < (const Leak &other) const {
+        if (callNo != other.callNo) {
+            return callNo < other.callNo;
+        }
+        if (kind != other.kind) {
+            return kind < other.kind;
+        }
+        return name < other.name;
+    }
+};
+
+
+class LeakChecker
+{
+    trace::Parser parser;
+
+    bool showBacktraces = true;
+
+    std::vector<const FunctionInfo *> functionInfos;
+    std::vector<bool> functionInfosKnown;
+
+    std::unordered_map<unsigned long long, Context *> contexts;
+    std::unordered_map<unsigned, Context *> currentContexts;
+
+    // Objects used without any (known) context current.
+    Context *defaultContext = nullptr;
+
+    // Backtraces of the creation calls that still have live objects, along
+    // with how many.
+    struct Creation {
+        trace::Backtrace *backtrace;
+        unsigned numObjects;
+    };
+    std::unordered_map<unsigned, Creation> creations;
+
+    std::vector<Leak> leaks;
+
+public:
+    LeakChecker(bool _showBacktraces) :
+        showBacktraces(_showBacktraces)
+    {
+        parser.setScanFilter(scanFilter);
+    }
+
+    ~LeakChecker() {
+        for (auto & entry : creations) {
+            delete entry.second.backtrace;
+        }
+        for (auto & entry : contexts) {
+            releaseContext(entry.second);
+        }
+        if (defaultContext) {
+            releaseContext(defaultContext);
+        }
+    }
+
+    bool
+    open(const char *filename) {
+        return parser.open(filename);
+    }
+
+    void
+    run(void) {
+        trace::Call *call;
+        while ((call = parser.scan_call())) {
+            const FunctionInfo *info = getFunctionInfo(call->sig);
+            if (info &&
+                !(call->flags & trace::CALL_FLAG_NO_SIDE_EFFECTS)) {
+                handleCall(call, info);
+            }
+            delete call;
+        }
+
+        // Reached the end of the trace -- report any live objects
+        for (auto & entry : contexts) {
+            collectLeaks(entry.second, true);
+        }
+        if (defaultContext) {
+            collectLeaks(defaultContext, true);
+        }
+        reportLeaks(NULL);
+    }
+
+protected:
+    const FunctionInfo *
+    getFunctionInfo(const trace::FunctionSig *sig) {
+        unsigned id = sig->id;
+        if (id >= functionInfos.size()) {
+            functionInfos.resize(id + 1);
+            functionInfosKnown.resize(id + 1);
+        }
+        if (!functionInfosKnown[id]) {
+            functionInfos[id] = lookupFunction(sig->name);
+            functionInfosKnown[id] = true;
+        }
+        return functionInfos[id];
+    }
+
+    static trace::Value *
+    getArg(trace::Call *call, int index) {
+        if (index == RETURN_VALUE) {
+            return call->ret;
+        }
+        if (index < 0 || unsigned(index) >= call->args.size()) {
+            return NULL;
+        }
+        return call->args[index].value;
+    }
+
+    Context *
+    getCurrentContext(unsigned threadId) {
+        auto it = currentContexts.find(threadId);
+        if (it != currentContexts.end() && it->second) {
+            return it->second;
+        }
+        if (!defaultContext) {
+            defaultContext = newContext(NULL);
+        }
+        return defaultContext;
+    }
+
+    static Context *
+    newContext(ShareGroup *shareGroup) {
+        Context *context = new Context;
+        if (!shareGroup) {
+            shareGroup = new ShareGroup;
+        }
+        context->shareGroup = shareGroup;
+        ++shareGroup->numContexts;
+        return context;
+    }
+
+    /*
+     * Look up a context by handle, implicitly creating contexts that were
+     * created before the trace started or by unknown functions.
+     */
+    Context *
+    lookupContext(unsigned long long handle) {
+        Context * &context = contexts[handle];
+        if (!context) {
+            context = newContext(NULL);
+        }
+        return context;
+    }
+
+    // Take a context out of its share group, freeing the group with the last.
+    static void
+    leaveShareGroup(Context *context) {
+        ShareGroup *shareGroup = context->shareGroup;
+        context->shareGroup = nullptr;
+        assert(shareGroup->numContexts > 0);
+        if (--shareGroup->numContexts == 0) {
+            delete shareGroup;
+        }
+    }
+
+    static void
+    releaseContext(Context *context) {
+        leaveShareGroup(context);
+        delete context;
+    }
+
+    void
+    handleCall(trace::Call *call, const FunctionInfo *info) {
+        switch (info->action) {
+        case ACTION_GEN_OBJECTS:
+        case ACTION_DELETE_OBJECTS:
+            {
+                // All these functions end with (GLsizei n, GLuint *names)
+                size_t numArgs = call->args.size();
+                if (numArgs < 2) {
+                    break;
+                }
+                trace::Value *count = call->args[numArgs - 2].value;
+                trace::Value *names = call->args[numArgs - 1].value;
+                const trace::Array *array = names ? names->toArray() : NULL;
+                if (!count || !array) {
+                    break;
+                }
+                size_t n = std::min<size_t>(getHandle(count), array->size());
+                Namespace &objects = getCurrentContext(call->thread_id)->getNamespace(info->kind);
+                for (size_t i = 0; i < n; ++i) {
+                    unsigned long long name = getHandle(array->values[i]);
+                    if (info->action == ACTION_GEN_OBJECTS) {
+                        createObject(call, objects, name);
+                    } else {
+                        deleteObject(objects, name);
+                    }
+                }
+            }
+            break;
+        case ACTION_CREATE_OBJECT:
+            {
+                unsigned long long name = getHandle(call->ret);
+                if (name) {
+                    Context *context = getCurrentContext(call->thread_id);
+                    createObject(call, context->getNamespace(info->kind), name);
+                }
+            }
+            break;
+        case ACTION_DELETE_OBJECT:
+            {
+                unsigned long long name = getHandle(getArg(call, 0));
+                Context *context = getCurrentContext(call->thread_id);
+                if (info->kind == KIND_SHADER_OR_PROGRAM) {
+                    if (!deleteObject(context->getNamespace(KIND_SHADER), name)) {
+                        deleteObject(context->getNamespace(KIND_PROGRAM), name);
+                    }
+                } else {
+                    deleteObject(context->getNamespace(info->kind), name);
+                }
+            }
+            break;
+        case ACTION_CREATE_CONTEXT:
+            {
+                unsigned long long handle = getHandle(getArg(call, info->context));
+                if (!handle) {
+                    // Failed context creation
+                    break;
+                }
+                unsigned long long shareHandle = getHandle(getArg(call, info->share));
+                ShareGroup *shareGroup = NULL;
+                if (shareHandle) {
+                    shareGroup = lookupContext(shareHandle)->shareGroup;
+                }
+                if (contexts.count(handle)) {
+                    // Stale handle, presumably destroyed by unknown means
+                    destroyContext(call, handle);
+                }
+                contexts[handle] = newContext(shareGroup);
+            }
+            break;
+        case ACTION_DESTROY_CONTEXT:
+            {
+                unsigned long long handle = getHandle(getArg(call, info->context));
+                if (handle) {
+                    destroyContext(call, handle);
+                }
+            }
+            break;
+        case ACTION_MAKE_CURRENT:
+            {
+                unsigned long long handle = getHandle(getArg(call, info->context));
+                currentContexts[call->thread_id] = handle ? lookupContext(handle) : NULL;
+            }
+            break;
+        case ACTION_SHARE_LISTS:
+            {
+                unsigned long long handle = getHandle(getArg(call, info->context));
+                unsigned long long shareHandle = getHandle(getArg(call, info->share));
+                if (!handle || !shareHandle || handle == shareHandle) {
+                    break;
+                }
+                Context *context = lookupContext(handle);
+                ShareGroup *shareGroup = lookupContext(shareHandle)->shareGroup;
+                if (context->shareGroup == shareGroup) {
+                    break;
+                }
+                ShareGroup *oldShareGroup = context->shareGroup;
+                if (oldShareGroup->numContexts == 1) {
+                    // wglShareLists fails if hglrc2 already has objects, but
+                    // report them regardless of the outcome.
+                    collectSharedLeaks(oldShareGroup);
+                    reportLeaks(call);
+                }
+                leaveShareGroup(context);
+                context->shareGroup = shareGroup;
+                ++shareGroup->numContexts;
+            }
+            break;
+        }
+    }
+
+    void
+    createObject(trace::Call *call, Namespace &objects, unsigned long long name) {
+        auto result = objects.insert(Namespace::value_type(name, call->no));
+        if (!result.second) {
+            // Regenerated without being deleted first
+            releaseCreation(result.first->second);
+            result.first->second = call->no;
+        }
+
+        if (call->backtrace && showBacktraces) {
+            auto it = creations.find(call->no);
+            if (it == creations.end()) {
+                // The frames themselves are owned by the parser
+                Creation creation;
+                creation.backtrace = new trace::Backtrace(*call->backtrace);
+                creation.numObjects = 0;
+                it = creations.insert(std::make_pair(call->no, creation)).first;
+            }
+            ++it->second.numObjects;
+        }
+    }
+
+    bool
+    deleteObject(Namespace &objects, unsigned long long name) {
+        auto it = objects.find(name);
+        if (it == objects.end()) {
+            // Ignore names that were never generated
+            return false;
+        }
+        releaseCreation(it->second);
+        objects.erase(it);
+        return true;
+    }
+
+    void
+    releaseCreation(unsigned callNo) {
+        if (creations.empty()) {
+            return;
+        }
+        auto it = creations.find(callNo);
+        if (it != creations.end()) {
+            assert(it->second.numObjects > 0);
+            if (--it->second.numObjects == 0) {
+                delete it->second.backtrace;
+                creations.erase(it);
+            }
+        }
+    }
+
+    void
+    destroyContext(trace::Call *call, unsigned long long handle) {
+        auto it = contexts.find(handle);
+        if (it == contexts.end()) {
+            return;
+        }
+        Context *context = it->second;
+        contexts.erase(it);
+
+        for (auto & entry : currentContexts) {
+            if (entry.second == context) {
+                entry.second = NULL;
+            }
+        }
+
+        bool lastInShareGroup = context->shareGroup->numContexts == 1;
+        collectLeaks(context, lastInShareGroup);
+        reportLeaks(call);
+        releaseContext(context);
+    }
+
+    void
+    collectLeaks(Namespace &objects, int kind) {
+        for (auto & entry : objects) {
+            Leak leak;
+            leak.callNo = entry.second;
+            leak.kind = kind;
+            leak.name = entry.first;
+            leaks.push_back(leak);
+        }
+        objects.clear();
+    }
+
+    void
+    collectSharedLeaks(ShareGroup *shareGroup) {
+        for (int kind = 0; kind < NUM_KINDS; ++kind) {
+            collectLeaks(shareGroup->objects[kind], kind);
+        }
+    }
+
+    void
+    collectLeaks(Context *context, bool lastInShareGroup) {
+        for (int kind = 0; kind < NUM_KINDS; ++kind) {
+            if (!kinds[kind].shared) {
+                collectLeaks(context->objects[kind], kind);
+            }
+        }
+        if (lastInShareGroup) {
+            collectSharedLeaks(context->shareGroup);
+        }
+    }
+
+    void
+    reportLeaks(const trace::Call *call) {
+        std::sort(leaks.begin(), leaks.end());
+        for (auto & leak : leaks) {
+            std::cerr << leak.callNo << ": error: "
+                      << kinds[leak.kind].name << " " << leak.name
+                      << " was not destroyed until ";
+            if (call) {
+                std::cerr << call->no;
+            } else {
+                std::cerr << "<EOF>";
+            }
+            std::cerr << "\n";
+
+            auto it = creations.find(leak.callNo);
+            if (it != creations.end()) {
+                for (auto & frame : *it->second.backtrace) {
+                    std::cerr << "    ";
+                    frame->dump(std::cerr);
+                    std::cerr << "\n";
+                }
+                releaseCreation(leak.callNo);
+            }
+        }
+        leaks.clear();
+    }
+};
+
+
 static int
 command(int argc, char *argv[])
 {
-    int i;
+    bool showBacktraces = true;
 
-    os::String command = find_command();
+    int opt;
+    while ((opt = getopt_long(argc, argv, shortOptions, longOptions, NULL)) != -1) {
+        switch (opt) {
+        case 'h':
+            usage();
+            return 0;
+        case NO_BACKTRACES_OPT:
+            showBacktraces = false;
+            break;
+        default:
+            std::cerr << "error: unexpected option `" << (char)opt << "`\n";
+            usage();
+            return 1;
+        }
+    }
 
-    os::String apitracePath = os::getProcessName();
+    if (argc != optind + 1) {
+        std::cerr << "error: incorrect number of arguments\n";
+        usage();
+        return 1;
+    }
 
-    std::vector<const char *> args;
-    args.push_back("python");
-    args.push_back(command.str());
-    args.push_back("--apitrace");
-    args.push_back(apitracePath.str());
-    for (i = 1; i < argc; i++) {
-        args.push_back(argv[i]);
+    LeakChecker checker(showBacktraces);
+    if (!checker.open(argv[optind])) {
+        std::cerr << "error: failed to open " << argv[optind] << "\n";
+        return 1;
     }
-    args.push_back(NULL);
 
-    return os::execute((char * const *)&args[0]);
+    checker.run();
+
+    return 0;
 }
 
 const Command leaks_command = {
@@ -66,16 +66,21 @@ const Command help_command = {
 };
 
 static const Command * commands[] = {
+    &compile_command,
     &diff_command,
     &diff_state_command,
     &diff_images_command,
     &dump_command,
     &dump_images_command,
+    &dump_profile_command,
+    &export_command,
     &leaks_command,
+    &parallel_replay_command,
     &pickle_command,
     &sed_command,
     &repack_command,
     &retrace_command,
+    &stats_command,
     &trace_command,
     &trim_command,
     &trim_auto_command,
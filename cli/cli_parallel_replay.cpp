@@ -0,0 +1,460 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <limits.h> // for CHAR_MAX
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "os_process.hpp"
+#include "os_string.hpp"
+#include "os_thread.hpp"
+#include "os_time.hpp"
+
+#include "trace_parser.hpp"
+
+#include "cli.hpp"
+#include "cli_retrace.hpp"
+
+
+static const char *synopsis = "Replay frame ranges of a trace in parallel processes.";
+
+static void
+usage(void)
+{
+    std::cout
+        << "usage: apitrace parallel-replay [OPTIONS] TRACE_FILE [-- RETRACE_OPTIONS]\n"
+        << synopsis << "\n"
+        "\n"
+        "The trace is split into ranges of frames (shards), each replayed by its own\n"
+        "retrace process with RETRACE_OPTIONS.  Every process fast-forwards to the\n"
+        "start of its range (creating resources and changing state, but not rendering\n"
+        "to the window) and stops at its end.  A process fails if its range reads back\n"
+        "window contents it didn't render.  Snapshots (e.g., `-- -s PREFIX`) are named\n"
+        "after call numbers, so shards don't overwrite each other's, and text profiles\n"
+        "(e.g., `-- --pgpu`) are merged in frame order onto the standard output.\n"
+        "\n"
+        "    -h, --help        show this help message and exit\n"
+        "    -j, --jobs=N      number of processes to run at once\n"
+        "                      (default is the number of CPUs)\n"
+        "        --shards=N    number of frame ranges (default is the number of jobs)\n"
+        "        --check       also replay the trace serially, and check that the\n"
+        "                      snapshots match (they are hashed rather than written)\n"
+        "\n";
+}
+
+enum {
+    SHARDS_OPT = CHAR_MAX + 1,
+    CHECK_OPT,
+};
+
+const static char *
+shortOptions = "+hj:";
+
+const static struct option
+longOptions[] = {
+    {"help", no_argument, 0, 'h'},
+    {"jobs", required_argument, 0, 'j'},
+    {"shards", required_argument, 0, SHARDS_OPT},
+    {"check", no_argument, 0, CHECK_OPT},
+    {0, 0, 0, 0}
+};
+
+
+struct Shard
+{
+    // Frames [startFrame, endFrame), and the calls they span
+    unsigned startFrame;
+    unsigned endFrame;
+    trace::CallNo startCall;
+    trace::CallNo endCall;
+
+    std::string fastForwardOption;
+    std::string endFrameOption;
+    std::string outputFilename;
+    std::string errorFilename;
+
+    int status;
+    unsigned numSnapshots;
+};
+
+
+/**
+ * Find where each frame starts.
+ */
+static bool
+scanFrames(const char *traceName, std::vector<trace::CallNo> &frameStarts, trace::API &api)
+{
+    trace::Parser p;
+    if (!p.open(traceName)) {
+        std::cerr << "error: failed to open " << traceName << "\n";
+        return false;
+    }
+
+    bool frameStart = true;
+    trace::Call *call;
+    while ((call = p.parse_call())) {
+        if (frameStart) {
+            frameStarts.push_back(call->no);
+        }
+        frameStart = call->flags & trace::CALL_FLAG_END_FRAME;
+        delete call;
+    }
+
+    api = p.api;
+
+    return true;
+}
+
+
+static std::string
+getTemporaryDirectory(void)
+{
+    const char *names[] = {"TMPDIR", "TEMP", "TMP"};
+    for (unsigned i = 0; i < sizeof names / sizeof names[0]; ++i) {
+        const char *value = getenv(names[i]);
+        if (value && value[0]) {
+            return value;
+        }
+    }
+#ifdef _WIN32
+    return ".";
+#else
+    return "/tmp";
+#endif
+}
+
+
+/**
+ * Whether the line is a snapshot hash, as written by --snapshot-format=XXH64.
+ */
+static bool
+isSnapshotHash(const std::string &line)
+{
+    return line.size() == 16 &&
+           line.find_first_not_of("0123456789abcdefABCDEF") == std::string::npos;
+}
+
+
+static void
+readSnapshotHashes(const std::string &filename, std::vector<std::string> &hashes)
+{
+    std::ifstream is(filename.c_str());
+    std::string line;
+    while (std::getline(is, line)) {
+        if (isSnapshotHash(line)) {
+            hashes.push_back(line);
+        }
+    }
+}
+
+
+/**
+ * Append a file to the standard error.
+ */
+static void
+forwardErrors(const std::string &filename)
+{
+    std::ifstream is(filename.c_str());
+    std::string line;
+    while (std::getline(is, line)) {
+        std::cerr << line << "\n";
+    }
+}
+
+
+/**
+ * Append a shard's output to the standard output, dropping profile lines of
+ * calls replayed while fast-forwarding, repeated profile headers, and the
+ * per-process frame rate.  Snapshot hashes are collected too.
+ */
+static void
+mergeOutput(Shard &shard, bool first, std::vector<std::string> &hashes)
+{
+    std::ifstream is(shard.outputFilename.c_str());
+    std::string line;
+    shard.numSnapshots = 0;
+    while (std::getline(is, line)) {
+        if (isSnapshotHash(line)) {
+            hashes.push_back(line);
+            ++shard.numSnapshots;
+        }
+        if (line.compare(0, 1, "#") == 0) {
+            if (!first) {
+                continue;
+            }
+        } else if (line.compare(0, 5, "call ") == 0) {
+            trace::CallNo no = strtoul(line.c_str() + 5, NULL, 10);
+            if (no < shard.startCall || no >= shard.endCall) {
+                continue;
+            }
+        } else if (line.compare(0, 9, "Rendered ") == 0) {
+            continue;
+        }
+        std::cout << line << "\n";
+    }
+}
+
+
+/**
+ * Replay the whole trace in a single process, and compare its snapshots with
+ * the shards'.
+ */
+static bool
+checkSnapshots(const char *traceName,
+               trace::API api,
+               const std::vector<const char *> &retraceOptions,
+               const std::string &outputFilename,
+               const std::vector<Shard> &shards,
+               const std::vector<std::string> &hashes)
+{
+    int status = executeRetrace(retraceOptions, traceName, api, outputFilename.c_str());
+    std::vector<std::string> serialHashes;
+    readSnapshotHashes(outputFilename, serialHashes);
+    remove(outputFilename.c_str());
+    if (status != 0) {
+        std::cerr << "error: serial replay failed with exit code " << status << "\n";
+        return false;
+    }
+
+    size_t i = 0;
+    for (auto & shard : shards) {
+        for (unsigned j = 0; j < shard.numSnapshots; ++j, ++i) {
+            if (i >= serialHashes.size() || hashes[i] != serialHashes[i]) {
+                std::cerr << "error: snapshot " << i << " (frames " << shard.startFrame << "-"
+                          << shard.endFrame - 1 << ") differs from the serial replay's\n";
+                return false;
+            }
+        }
+    }
+    if (i != serialHashes.size()) {
+        std::cerr << "error: the serial replay took " << serialHashes.size()
+                  << " snapshots, but the parallel replay " << i << "\n";
+        return false;
+    }
+
+    std::cerr << "info: " << i << " snapshots match the serial replay's\n";
+    return true;
+}
+
+
+static int
+parallelReplay(const char *traceName,
+               std::vector<const char *> retraceOptions,
+               unsigned numJobs,
+               unsigned numShards,
+               bool check)
+{
+    std::vector<trace::CallNo> frameStarts;
+    trace::API api;
+    if (!scanFrames(traceName, frameStarts, api)) {
+        return 1;
+    }
+
+    unsigned numFrames = frameStarts.size();
+    if (numFrames == 0) {
+        std::cerr << "error: " << traceName << " has no calls\n";
+        return 1;
+    }
+    if (!numShards) {
+        numShards = numJobs;
+    }
+    numShards = std::min(numShards, numFrames);
+    numJobs = std::min(numJobs, numShards);
+
+    if (check) {
+        retraceOptions.push_back("--snapshot-format=XXH64");
+        retraceOptions.push_back("--snapshot-prefix=-");
+    }
+
+    std::string tmpDir = getTemporaryDirectory();
+    std::ostringstream tmpPrefix;
+    tmpPrefix << tmpDir << OS_DIR_SEP << "apitrace-" << os::getCurrentProcessId() << "-";
+    std::vector<Shard> shards(numShards);
+    for (unsigned i = 0; i < numShards; ++i) {
+        Shard &shard = shards[i];
+        shard.startFrame = (unsigned long long)numFrames * i / numShards;
+        shard.endFrame = (unsigned long long)numFrames * (i + 1) / numShards;
+        shard.startCall = frameStarts[shard.startFrame];
+        shard.endCall = shard.endFrame < numFrames ? frameStarts[shard.endFrame] : ~trace::CallNo(0);
+
+        std::ostringstream ss;
+        ss << "--fast-forward=" << shard.startFrame;
+        shard.fastForwardOption = ss.str();
+        ss.str("");
+        ss << "--end-frame=" << shard.endFrame;
+        shard.endFrameOption = ss.str();
+        shard.outputFilename = tmpPrefix.str() + std::to_string(i) + ".txt";
+        shard.errorFilename = tmpPrefix.str() + std::to_string(i) + ".err";
+
+        shard.status = -1;
+        shard.numSnapshots = 0;
+    }
+
+    // Hand out shards in order to whichever process finishes first
+    os::mutex mutex;
+    unsigned nextShard = 0;
+    auto worker = [&] () {
+        while (true) {
+            unsigned i;
+            {
+                os::unique_lock<os::mutex> lock(mutex);
+                if (nextShard >= numShards) {
+                    return;
+                }
+                i = nextShard++;
+            }
+            Shard &shard = shards[i];
+
+            std::vector<const char *> opts(retraceOptions);
+            if (shard.startFrame) {
+                opts.push_back(shard.fastForwardOption.c_str());
+                // Rather than silently differing from a serial replay
+                opts.push_back("--fast-forward-strict");
+            }
+            if (i + 1 < numShards) {
+                opts.push_back(shard.endFrameOption.c_str());
+            }
+            shard.status = executeRetrace(opts, traceName, api,
+                                          shard.outputFilename.c_str(),
+                                          shard.errorFilename.c_str());
+        }
+    };
+
+    long long startTime = os::getTime();
+
+    std::vector<os::thread> threads;
+    for (unsigned i = 0; i < numJobs; ++i) {
+        threads.push_back(os::thread(worker));
+    }
+    for (unsigned i = 0; i < numJobs; ++i) {
+        threads[i].join();
+    }
+
+    long long endTime = os::getTime();
+    float timeInterval = (endTime - startTime) * (1.0 / os::timeFrequency);
+
+    int ret = 0;
+    std::vector<std::string> hashes;
+    for (unsigned i = 0; i < numShards; ++i) {
+        Shard &shard = shards[i];
+        forwardErrors(shard.errorFilename);
+        remove(shard.errorFilename.c_str());
+        if (shard.status != 0) {
+            std::cerr << "error: replay of frames " << shard.startFrame << "-" << shard.endFrame - 1
+                      << " failed with exit code " << shard.status << "\n";
+            ret = 1;
+        }
+        mergeOutput(shard, i == 0, hashes);
+        remove(shard.outputFilename.c_str());
+    }
+
+    std::cout <<
+        "Rendered " << numFrames << " frames"
+        " in " << timeInterval << " secs"
+        " using " << numJobs << " processes,"
+        " average of " << (numFrames/timeInterval) << " fps\n";
+
+    if (check && ret == 0 &&
+        !checkSnapshots(traceName, api, retraceOptions, tmpPrefix.str() + "serial.txt", shards, hashes)) {
+        ret = 1;
+    }
+
+    return ret;
+}
+
+
+static int
+command(int argc, char *argv[])
+{
+    unsigned numJobs = os::thread::hardware_concurrency();
+    unsigned numShards = 0;
+    bool check = false;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, shortOptions, longOptions, NULL)) != -1) {
+        switch (opt) {
+        case 'h':
+            usage();
+            return 0;
+        case 'j':
+            numJobs = atoi(optarg);
+            break;
+        case SHARDS_OPT:
+            numShards = atoi(optarg);
+            break;
+        case CHECK_OPT:
+            check = true;
+            break;
+        default:
+            std::cerr << "error: unexpected option `" << (char)opt << "`\n";
+            usage();
+            return 1;
+        }
+    }
+
+    if (optind >= argc) {
+        std::cerr << "error: apitrace parallel-replay requires a trace file as an argument.\n";
+        usage();
+        return 1;
+    }
+
+    if (numJobs < 1) {
+        numJobs = 1;
+    }
+
+    const char *traceName = argv[optind++];
+
+    std::vector<const char *> retraceOptions;
+    if (optind < argc && strcmp(argv[optind], "--") == 0) {
+        ++optind;
+    }
+    for (int i = optind; i < argc; ++i) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--snapshot-prefix=-") == 0 ||
+            (strcmp(arg, "-s") == 0 && i + 1 < argc && strcmp(argv[i + 1], "-") == 0)) {
+            std::cerr << "error: snapshots can't be written to the standard output\n";
+            return 1;
+        }
+        retraceOptions.push_back(arg);
+    }
+
+    return parallelReplay(traceName, retraceOptions, numJobs, numShards, check);
+}
+
+const Command parallel_replay_command = {
+    "parallel-replay",
+    synopsis,
+    usage,
+    command
+};
@@ -0,0 +1,559 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <assert.h>
+#include <string.h>
+
+#include <snappy.h>
+
+#include "cli_parquet.hpp"
+
+
+namespace parquet {
+
+
+enum {
+    PAGE_DATA = 0,
+    PAGE_DICTIONARY = 2,
+};
+
+enum {
+    ENCODING_PLAIN = 0,
+    ENCODING_RLE = 3,
+    ENCODING_RLE_DICTIONARY = 8,
+};
+
+enum {
+    CODEC_SNAPPY = 1,
+};
+
+enum {
+    CONVERTED_UTF8 = 0,
+};
+
+enum {
+    REPETITION_REQUIRED = 0,
+    REPETITION_OPTIONAL = 1,
+};
+
+
+/*
+ * Thrift compact protocol encoder.
+ *
+ * https://github.com/apache/thrift/blob/master/doc/specs/thrift-compact-protocol.md
+ */
+class ThriftEncoder
+{
+    std::string &buf;
+    std::vector<int16_t> fieldStack;
+    int16_t lastField = 0;
+
+public:
+    enum {
+        CT_TRUE = 1,
+        CT_FALSE = 2,
+        CT_I32 = 5,
+        CT_I64 = 6,
+        CT_BINARY = 8,
+        CT_LIST = 9,
+        CT_STRUCT = 12,
+    };
+
+    ThriftEncoder(std::string &_buf) :
+        buf(_buf)
+    {}
+
+    void
+    varint(uint64_t value) {
+        while (value >= 0x80) {
+            buf.push_back(char(value | 0x80));
+            value >>= 7;
+        }
+        buf.push_back(char(value));
+    }
+
+    static uint64_t
+    zigzag(int64_t value) {
+        return (uint64_t(value) << 1) ^ uint64_t(value >> 63);
+    }
+
+    void
+    field(int16_t id, uint8_t type) {
+        int delta = id - lastField;
+        if (delta > 0 && delta <= 15) {
+            buf.push_back(char((delta << 4) | type));
+        } else {
+            buf.push_back(char(type));
+            varint(zigzag(id));
+        }
+        lastField = id;
+    }
+
+    void
+    i32(int16_t id, int32_t value) {
+        field(id, CT_I32);
+        varint(zigzag(value));
+    }
+
+    void
+    i64(int16_t id, int64_t value) {
+        field(id, CT_I64);
+        varint(zigzag(value));
+    }
+
+    void
+    binary(int16_t id, const std::string &value) {
+        field(id, CT_BINARY);
+        elementBinary(value);
+    }
+
+    void
+    list(int16_t id, uint8_t elementType, size_t size) {
+        field(id, CT_LIST);
+        if (size < 15) {
+            buf.push_back(char((size << 4) | elementType));
+        } else {
+            buf.push_back(char(0xf0 | elementType));
+            varint(size);
+        }
+    }
+
+    void
+    elementI32(int32_t value) {
+        varint(zigzag(value));
+    }
+
+    void
+    elementBinary(const std::string &value) {
+        varint(value.size());
+        buf.append(value);
+    }
+
+    /* Begin a struct that is a list element or the top-level object. */
+    void
+    beginStruct(void) {
+        fieldStack.push_back(lastField);
+        lastField = 0;
+    }
+
+    void
+    beginStruct(int16_t id) {
+        field(id, CT_STRUCT);
+        beginStruct();
+    }
+
+    void
+    endStruct(void) {
+        buf.push_back(0);
+        lastField = fieldStack.back();
+        fieldStack.pop_back();
+    }
+};
+
+
+static inline unsigned
+bitWidth(uint32_t maxValue)
+{
+    unsigned width = 1;
+    while (width < 32 && (maxValue >> width)) {
+        ++width;
+    }
+    return width;
+}
+
+
+/*
+ * RLE/bit-packing hybrid encoding, used for definition levels and
+ * dictionary indices.  Constant runs become a single RLE run, anything else
+ * is bit-packed, which Snappy then takes care of.
+ */
+static void
+encodeHybrid(std::string &out, const std::vector<uint32_t> &values, unsigned width)
+{
+    size_t count = values.size();
+    if (count == 0) {
+        return;
+    }
+
+    ThriftEncoder varint(out);
+
+    bool constant = true;
+    for (size_t i = 1; i < count; ++i) {
+        if (values[i] != values[0]) {
+            constant = false;
+            break;
+        }
+    }
+
+    if (constant) {
+        varint.varint(uint64_t(count) << 1);
+        for (unsigned i = 0; i < (width + 7) / 8; ++i) {
+            out.push_back(char(values[0] >> (8 * i)));
+        }
+        return;
+    }
+
+    size_t numGroups = (count + 7) / 8;
+    varint.varint((uint64_t(numGroups) << 1) | 1);
+
+    uint64_t acc = 0;
+    unsigned bits = 0;
+    for (size_t i = 0; i < numGroups * 8; ++i) {
+        uint64_t value = i < count ? values[i] : 0;
+        acc |= value << bits;
+        bits += width;
+        while (bits >= 8) {
+            out.push_back(char(acc));
+            acc >>= 8;
+            bits -= 8;
+        }
+    }
+    assert(bits == 0);
+}
+
+
+static inline void
+appendLE32(std::string &out, uint32_t value)
+{
+    char bytes[4] = {
+        char(value), char(value >> 8), char(value >> 16), char(value >> 24)
+    };
+    out.append(bytes, sizeof bytes);
+}
+
+
+Writer::Writer() :
+    stream(nullptr),
+    offset(0),
+    rowGroupSize(1024 * 1024),
+    numRows(0),
+    totalNumRows(0),
+    failed(false)
+{
+}
+
+
+Writer::~Writer()
+{
+    if (stream) {
+        close();
+    }
+}
+
+
+unsigned
+Writer::addColumn(const std::string &name, Type type, bool optional)
+{
+    assert(!stream);
+    Column col;
+    col.name = name;
+    col.type = type;
+    col.optional = optional;
+    columns.push_back(col);
+    return columns.size() - 1;
+}
+
+
+bool
+Writer::open(const char *filename)
+{
+    stream = fopen(filename, "wb");
+    if (!stream) {
+        return false;
+    }
+    failed = false;
+    offset = 0;
+    write("PAR1");
+    return !failed;
+}
+
+
+void
+Writer::write(const std::string &data)
+{
+    if (fwrite(data.data(), 1, data.size(), stream) != data.size()) {
+        failed = true;
+    }
+    offset += data.size();
+}
+
+
+void
+Writer::appendInt32(unsigned column, int32_t value)
+{
+    Column &col = columns[column];
+    assert(col.type == TYPE_INT32);
+    appendDefined(col);
+    col.values.append(reinterpret_cast<const char *>(&value), sizeof value);
+}
+
+
+void
+Writer::appendInt64(unsigned column, int64_t value)
+{
+    Column &col = columns[column];
+    assert(col.type == TYPE_INT64);
+    appendDefined(col);
+    col.values.append(reinterpret_cast<const char *>(&value), sizeof value);
+}
+
+
+void
+Writer::appendDouble(unsigned column, double value)
+{
+    Column &col = columns[column];
+    assert(col.type == TYPE_DOUBLE);
+    appendDefined(col);
+    col.values.append(reinterpret_cast<const char *>(&value), sizeof value);
+}
+
+
+void
+Writer::appendString(unsigned column, const char *value)
+{
+    Column &col = columns[column];
+    assert(col.type == TYPE_STRING);
+    appendDefined(col);
+
+    scratch.assign(value);
+    auto it = col.dictionary.find(scratch);
+    uint32_t index;
+    if (it == col.dictionary.end()) {
+        index = col.dictionary.size();
+        col.dictionary.emplace(scratch, index);
+        appendLE32(col.dictionaryValues, scratch.size());
+        col.dictionaryValues.append(scratch);
+    } else {
+        index = it->second;
+    }
+    col.indices.push_back(index);
+}
+
+
+void
+Writer::appendNull(unsigned column)
+{
+    Column &col = columns[column];
+    assert(col.optional);
+    col.defLevels.push_back(0);
+}
+
+
+/* Write a page and return its offset. */
+int64_t
+Writer::writePage(ColumnChunkInfo &info, int pageType, int encoding,
+                  const std::string &body, uint32_t numValues)
+{
+    std::string compressed;
+    snappy::Compress(body.data(), body.size(), &compressed);
+
+    std::string header;
+    ThriftEncoder e(header);
+    e.beginStruct();
+    e.i32(1, pageType);
+    e.i32(2, body.size());
+    e.i32(3, compressed.size());
+    if (pageType == PAGE_DATA) {
+        e.beginStruct(5);
+        e.i32(1, numValues);
+        e.i32(2, encoding);
+        e.i32(3, ENCODING_RLE);
+        e.i32(4, ENCODING_RLE);
+        e.endStruct();
+    } else {
+        e.beginStruct(7);
+        e.i32(1, numValues);
+        e.i32(2, encoding);
+        e.endStruct();
+    }
+    e.endStruct();
+
+    int64_t pageOffset = offset;
+    write(header);
+    write(compressed);
+
+    info.uncompressedSize += header.size() + body.size();
+    info.compressedSize += header.size() + compressed.size();
+
+    return pageOffset;
+}
+
+
+void
+Writer::flushRowGroup(void)
+{
+    if (numRows == 0) {
+        return;
+    }
+
+    RowGroupInfo rowGroup;
+    rowGroup.numRows = numRows;
+
+    std::string body;
+    std::string levels;
+    for (Column &col : columns) {
+        ColumnChunkInfo info;
+        info.numValues = numRows;
+        info.dictionaryPageOffset = -1;
+        info.uncompressedSize = 0;
+        info.compressedSize = 0;
+
+        body.clear();
+        if (col.optional) {
+            assert(col.defLevels.size() == numRows);
+            levels.clear();
+            encodeHybrid(levels, col.defLevels, 1);
+            appendLE32(body, levels.size());
+            body.append(levels);
+        }
+
+        int encoding;
+        if (col.type == TYPE_STRING) {
+            info.dictionaryPageOffset =
+                writePage(info, PAGE_DICTIONARY, ENCODING_PLAIN,
+                          col.dictionaryValues, col.dictionary.size());
+            unsigned width = bitWidth(col.dictionary.empty() ? 0 : col.dictionary.size() - 1);
+            body.push_back(char(width));
+            encodeHybrid(body, col.indices, width);
+            encoding = ENCODING_RLE_DICTIONARY;
+        } else {
+            body.append(col.values);
+            encoding = ENCODING_PLAIN;
+        }
+
+        info.dataPageOffset = writePage(info, PAGE_DATA, encoding, body, numRows);
+
+        rowGroup.columns.push_back(info);
+
+        col.defLevels.clear();
+        col.values.clear();
+        col.dictionary.clear();
+        col.dictionaryValues.clear();
+        col.indices.clear();
+    }
+
+    rowGroups.push_back(rowGroup);
+    totalNumRows += numRows;
+    numRows = 0;
+}
+
+
+void
+Writer::writeFooter(void)
+{
+    std::string footer;
+    ThriftEncoder e(footer);
+
+    // FileMetaData
+    e.beginStruct();
+    e.i32(1, 1);  // version
+
+    // Flat schema: a root element followed by the leaf columns.
+    e.list(2, ThriftEncoder::CT_STRUCT, columns.size() + 1);
+    e.beginStruct();
+    e.binary(4, "schema");
+    e.i32(5, columns.size());
+    e.endStruct();
+    for (const Column &col : columns) {
+        e.beginStruct();
+        e.i32(1, col.type);
+        e.i32(3, col.optional ? REPETITION_OPTIONAL : REPETITION_REQUIRED);
+        e.binary(4, col.name);
+        if (col.type == TYPE_STRING) {
+            e.i32(6, CONVERTED_UTF8);
+        }
+        e.endStruct();
+    }
+
+    e.i64(3, totalNumRows);
+
+    e.list(4, ThriftEncoder::CT_STRUCT, rowGroups.size());
+    for (const RowGroupInfo &rowGroup : rowGroups) {
+        e.beginStruct();
+        e.list(1, ThriftEncoder::CT_STRUCT, columns.size());
+        int64_t totalSize = 0;
+        for (size_t i = 0; i < columns.size(); ++i) {
+            const Column &col = columns[i];
+            const ColumnChunkInfo &info = rowGroup.columns[i];
+            bool hasDictionary = info.dictionaryPageOffset >= 0;
+
+            // ColumnChunk
+            e.beginStruct();
+            e.i64(2, hasDictionary ? info.dictionaryPageOffset : info.dataPageOffset);
+
+            // ColumnMetaData
+            e.beginStruct(3);
+            e.i32(1, col.type);
+            e.list(2, ThriftEncoder::CT_I32, hasDictionary ? 3 : 2);
+            e.elementI32(ENCODING_PLAIN);
+            e.elementI32(ENCODING_RLE);
+            if (hasDictionary) {
+                e.elementI32(ENCODING_RLE_DICTIONARY);
+            }
+            e.list(3, ThriftEncoder::CT_BINARY, 1);
+            e.elementBinary(col.name);
+            e.i32(4, CODEC_SNAPPY);
+            e.i64(5, info.numValues);
+            e.i64(6, info.uncompressedSize);
+            e.i64(7, info.compressedSize);
+            e.i64(9, info.dataPageOffset);
+            if (hasDictionary) {
+                e.i64(11, info.dictionaryPageOffset);
+            }
+            e.endStruct();
+
+            e.endStruct();
+
+            totalSize += info.uncompressedSize;
+        }
+        e.i64(2, totalSize);
+        e.i64(3, rowGroup.numRows);
+        e.endStruct();
+    }
+
+    e.binary(6, "apitrace");
+    e.endStruct();
+
+    appendLE32(footer, footer.size());
+    footer.append("PAR1");
+    write(footer);
+}
+
+
+bool
+Writer::close(void)
+{
+    flushRowGroup();
+    writeFooter();
+    if (fclose(stream) != 0) {
+        failed = true;
+    }
+    stream = nullptr;
+    return !failed;
+}
+
+
+} /* namespace parquet */
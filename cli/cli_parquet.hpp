@@ -0,0 +1,166 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Minimal Apache Parquet writer.
+ *
+ * Only what is needed to export flat call tables is implemented: flat
+ * schemas of required/optional INT32, INT64, DOUBLE and UTF8 columns,
+ * PLAIN encoding (dictionary encoding for strings), data page v1 and
+ * Snappy compression.  The file metadata is serialized with a hand
+ * written Thrift compact protocol encoder, so there are no external
+ * dependencies.
+ *
+ * See https://github.com/apache/parquet-format for the specification.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace parquet {
+
+
+enum Type {
+    TYPE_INT32 = 1,
+    TYPE_INT64 = 2,
+    TYPE_DOUBLE = 5,
+    TYPE_STRING = 6,  // BYTE_ARRAY with UTF8 annotation
+};
+
+
+class Writer
+{
+public:
+    Writer();
+    ~Writer();
+
+    /**
+     * Declare a column.  All columns must be added before open().
+     *
+     * Returns the column index to use with the append methods.
+     */
+    unsigned
+    addColumn(const std::string &name, Type type, bool optional = false);
+
+    /** Number of rows buffered before a row group is written. */
+    void
+    setRowGroupSize(size_t rows) {
+        rowGroupSize = rows ? rows : 1;
+    }
+
+    bool
+    open(const char *filename);
+
+    bool
+    close(void);
+
+    /*
+     * Each row must get exactly one value (or null) per column, followed
+     * by endRow().
+     */
+    void appendInt32(unsigned column, int32_t value);
+    void appendInt64(unsigned column, int64_t value);
+    void appendDouble(unsigned column, double value);
+    void appendString(unsigned column, const char *value);
+    void appendNull(unsigned column);
+
+    void
+    endRow(void) {
+        if (++numRows >= rowGroupSize) {
+            flushRowGroup();
+        }
+    }
+
+    uint64_t
+    totalRows(void) const {
+        return totalNumRows;
+    }
+
+private:
+    struct ColumnChunkInfo {
+        int64_t numValues;
+        int64_t dataPageOffset;
+        int64_t dictionaryPageOffset;  // -1 if none
+        int64_t uncompressedSize;
+        int64_t compressedSize;
+    };
+
+    struct RowGroupInfo {
+        int64_t numRows;
+        std::vector<ColumnChunkInfo> columns;
+    };
+
+    struct Column {
+        std::string name;
+        Type type;
+        bool optional;
+
+        /* Definition levels (only for optional columns). */
+        std::vector<uint32_t> defLevels;
+
+        /* PLAIN encoded non-null values. */
+        std::string values;
+
+        /* Dictionary state for string columns. */
+        std::unordered_map<std::string, uint32_t> dictionary;
+        std::string dictionaryValues;
+        std::vector<uint32_t> indices;
+    };
+
+    std::vector<Column> columns;
+    std::vector<RowGroupInfo> rowGroups;
+
+    FILE *stream;
+    int64_t offset;
+    size_t rowGroupSize;
+    size_t numRows;
+    uint64_t totalNumRows;
+    bool failed;
+
+    std::string scratch;
+
+    void write(const std::string &data);
+    int64_t writePage(ColumnChunkInfo &info, int pageType, int encoding,
+                      const std::string &body, uint32_t numValues);
+    void flushRowGroup(void);
+    void writeFooter(void);
+
+    void
+    appendDefined(Column &col) {
+        if (col.optional) {
+            col.defLevels.push_back(1);
+        }
+    }
+};
+
+
+} /* namespace parquet */
@@ -0,0 +1,309 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "cli_parquet.hpp"
+
+#include "gtest/gtest.h"
+
+
+/*
+ * Generic Thrift compact protocol decoder, to check the writer's footer
+ * against the specification rather than against the encoder itself.
+ */
+struct ThriftValue
+{
+    int64_t i = 0;
+    std::string s;
+    std::vector<ThriftValue> list;
+    std::map<int16_t, ThriftValue> fields;
+
+    const ThriftValue &
+    operator [] (int16_t id) const {
+        static const ThriftValue missing;
+        auto it = fields.find(id);
+        return it == fields.end() ? missing : it->second;
+    }
+
+    bool
+    has(int16_t id) const {
+        return fields.find(id) != fields.end();
+    }
+};
+
+
+class ThriftDecoder
+{
+    const std::string &buf;
+    size_t pos;
+
+public:
+    bool ok = true;
+
+    ThriftDecoder(const std::string &_buf, size_t _pos) :
+        buf(_buf),
+        pos(_pos)
+    {}
+
+    size_t
+    tell(void) const {
+        return pos;
+    }
+
+    uint8_t
+    byte(void) {
+        if (pos >= buf.size()) {
+            ok = false;
+            return 0;
+        }
+        return uint8_t(buf[pos++]);
+    }
+
+    uint64_t
+    varint(void) {
+        uint64_t value = 0;
+        for (unsigned shift = 0; shift < 64 && ok; shift += 7) {
+            uint8_t b = byte();
+            value |= uint64_t(b & 0x7f) << shift;
+            if (!(b & 0x80)) {
+                break;
+            }
+        }
+        return value;
+    }
+
+    int64_t
+    zigzag(void) {
+        uint64_t value = varint();
+        return int64_t(value >> 1) ^ -int64_t(value & 1);
+    }
+
+    ThriftValue
+    value(uint8_t type) {
+        ThriftValue v;
+        switch (type) {
+        case 1: // true
+            v.i = 1;
+            break;
+        case 2: // false
+            break;
+        case 3: // byte
+            v.i = int8_t(byte());
+            break;
+        case 4: // i16
+        case 5: // i32
+        case 6: // i64
+            v.i = zigzag();
+            break;
+        case 7: // double
+            for (unsigned i = 0; i < 8; ++i) {
+                byte();
+            }
+            break;
+        case 8: // binary
+            {
+                uint64_t size = varint();
+                if (size > buf.size() - pos) {
+                    ok = false;
+                    break;
+                }
+                v.s = buf.substr(pos, size);
+                pos += size;
+            }
+            break;
+        case 9: // list
+            {
+                uint8_t header = byte();
+                uint64_t size = header >> 4;
+                if (size == 15) {
+                    size = varint();
+                }
+                uint8_t elementType = header & 0xf;
+                for (uint64_t i = 0; i < size && ok; ++i) {
+                    // Booleans are a byte each within lists
+                    v.list.push_back(value(elementType == 1 || elementType == 2 ? 3 : elementType));
+                }
+            }
+            break;
+        case 12: // struct
+            {
+                int16_t id = 0;
+                while (ok) {
+                    uint8_t header = byte();
+                    if (header == 0) {
+                        break;
+                    }
+                    uint8_t delta = header >> 4;
+                    id = delta ? id + delta : int16_t(zigzag());
+                    v.fields[id] = value(header & 0xf);
+                }
+            }
+            break;
+        default:
+            ok = false;
+            break;
+        }
+        return v;
+    }
+};
+
+
+static uint32_t
+readLE32(const std::string &buf, size_t pos)
+{
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(buf.data() + pos);
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24);
+}
+
+
+TEST(parquet, layout)
+{
+    const char *filename = "cli_parquet_test.parquet";
+
+    parquet::Writer writer;
+    writer.setRowGroupSize(2);
+    unsigned noColumn = writer.addColumn("call_no", parquet::TYPE_INT64);
+    unsigned nameColumn = writer.addColumn("function", parquet::TYPE_STRING);
+    unsigned argColumn = writer.addColumn("arg_count", parquet::TYPE_DOUBLE, true);
+    ASSERT_TRUE(writer.open(filename));
+
+    const char *names[] = {"glDrawArrays", "glClear", "glDrawArrays"};
+    for (unsigned i = 0; i < 3; ++i) {
+        writer.appendInt64(noColumn, i);
+        writer.appendString(nameColumn, names[i]);
+        if (i == 1) {
+            writer.appendNull(argColumn);
+        } else {
+            writer.appendDouble(argColumn, 3.0 * i);
+        }
+        writer.endRow();
+    }
+    ASSERT_TRUE(writer.close());
+    EXPECT_EQ(3, writer.totalRows());
+
+    std::ifstream is(filename, std::ios::binary);
+    std::string file((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+    is.close();
+    remove(filename);
+
+    // PAR1, column chunks, footer, footer length, PAR1
+    ASSERT_GT(file.size(), 12);
+    EXPECT_EQ("PAR1", file.substr(0, 4));
+    EXPECT_EQ("PAR1", file.substr(file.size() - 4));
+    uint32_t footerSize = readLE32(file, file.size() - 8);
+    ASSERT_LE(footerSize, file.size() - 12);
+    size_t footerStart = file.size() - 8 - footerSize;
+
+    ThriftDecoder decoder(file, footerStart);
+    ThriftValue metadata = decoder.value(12);
+    ASSERT_TRUE(decoder.ok);
+    EXPECT_EQ(file.size() - 8, decoder.tell());
+
+    EXPECT_EQ(1, metadata[1].i);  // version
+    EXPECT_EQ(3, metadata[3].i);  // num_rows
+    EXPECT_EQ("apitrace", metadata[6].s);  // created_by
+
+    // Flat schema: root, then one leaf per column
+    const std::vector<ThriftValue> &schema = metadata[2].list;
+    ASSERT_EQ(4, schema.size());
+    EXPECT_EQ("schema", schema[0][4].s);
+    EXPECT_EQ(3, schema[0][5].i);  // num_children
+    const char *columnNames[] = {"call_no", "function", "arg_count"};
+    const int64_t columnTypes[] = {2 /* INT64 */, 6 /* BYTE_ARRAY */, 5 /* DOUBLE */};
+    for (unsigned i = 0; i < 3; ++i) {
+        const ThriftValue &element = schema[i + 1];
+        EXPECT_EQ(columnNames[i], element[4].s);
+        EXPECT_EQ(columnTypes[i], element[1].i);
+        EXPECT_EQ(i == 2 ? 1 /* OPTIONAL */ : 0 /* REQUIRED */, element[3].i);
+    }
+    EXPECT_TRUE(schema[2].has(6));  // UTF8
+    EXPECT_FALSE(schema[1].has(6));
+
+    // Row groups of 2 and 1 rows, whose column chunks tile the file between
+    // the leading magic and the footer
+    const std::vector<ThriftValue> &rowGroups = metadata[4].list;
+    ASSERT_EQ(2, rowGroups.size());
+    int64_t offset = 4;
+    for (unsigned i = 0; i < rowGroups.size(); ++i) {
+        const ThriftValue &rowGroup = rowGroups[i];
+        int64_t numRows = i == 0 ? 2 : 1;
+        EXPECT_EQ(numRows, rowGroup[3].i);
+
+        const std::vector<ThriftValue> &chunks = rowGroup[1].list;
+        ASSERT_EQ(3, chunks.size());
+        int64_t totalSize = 0;
+        for (unsigned j = 0; j < chunks.size(); ++j) {
+            const ThriftValue &meta = chunks[j][3];
+            EXPECT_EQ(columnTypes[j], meta[1].i);
+            ASSERT_EQ(1, meta[3].list.size());
+            EXPECT_EQ(columnNames[j], meta[3].list[0].s);
+            EXPECT_EQ(1, meta[4].i);  // SNAPPY
+            EXPECT_EQ(numRows, meta[5].i);
+
+            // Strings are dictionary encoded, the dictionary page first
+            int64_t start = meta[9].i;
+            if (j == 1) {
+                ASSERT_TRUE(meta.has(11));
+                EXPECT_LT(meta[11].i, meta[9].i);
+                start = meta[11].i;
+            } else {
+                EXPECT_FALSE(meta.has(11));
+            }
+            EXPECT_EQ(offset, start);
+            EXPECT_EQ(start, chunks[j][2].i);  // file_offset
+            offset = start + meta[7].i;
+            totalSize += meta[6].i;
+
+            // The data page header, with as many values as rows
+            ThriftDecoder pageDecoder(file, meta[9].i);
+            ThriftValue page = pageDecoder.value(12);
+            ASSERT_TRUE(pageDecoder.ok);
+            EXPECT_EQ(0, page[1].i);  // DATA_PAGE
+            EXPECT_EQ(numRows, page[5][1].i);
+            // ... which is last in the chunk
+            EXPECT_EQ(start + meta[7].i, int64_t(pageDecoder.tell()) + page[3].i);
+        }
+        EXPECT_EQ(totalSize, rowGroup[2].i);
+    }
+    EXPECT_EQ(int64_t(footerStart), offset);
+}
+
+
+int
+main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
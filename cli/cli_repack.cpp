@@ -27,16 +27,23 @@
 #include <string.h>
 #include <getopt.h>
 
+#include <deque>
 #include <iostream>
 #include <memory>
+#include <string>
 
 #include "cli.hpp"
 
 #include <brotli/enc/encode.h>
-#include <zlib.h>  // for crc32
+#include <snappy.h>
+#include <zlib.h>
 
+#include "os_thread.hpp"
+#include "thread_pool.hpp"
 #include "trace_file.hpp"
+#include "trace_option.hpp"
 #include "trace_ostream.hpp"
+#include "trace_snappy.hpp"
 
 
 static const char *synopsis = "Repack a trace file with different compression.";
@@ -53,17 +60,21 @@ usage(void)
         << "\n"
         << "    -b,--brotli  Use Brotli compression\n"
         << "    -z,--zlib    Use ZLib compression\n"
+        << "    -j,--jobs=N  Compress on N threads [default: number of CPUs, or 1 for\n"
+        << "                 Brotli, whose multithreaded output older versions of\n"
+        << "                 apitrace can't read]\n"
         << "\n";
 }
 
 const static char *
-shortOptions = "hbz";
+shortOptions = "hbzj:";
 
 const static struct option
 longOptions[] = {
     {"help", no_argument, 0, 'h'},
     {"brotli", optional_argument, 0, 'b'},
     {"zlib", no_argument, 0, 'z'},
+    {"jobs", required_argument, 0, 'j'},
     {0, 0, 0, 0}
 };
 
@@ -106,7 +117,7 @@ public:
             eof = true;
             return nullptr;
         }
-        crc32(crc, reinterpret_cast<const Bytef *>(buf), *bytes_read);
+        crc = crc32(crc, reinterpret_cast<const Bytef *>(buf), *bytes_read);
         return buf;
     }
 };
@@ -129,8 +140,8 @@ repack_generic(trace::File *inFile, trace::OutStream *outFile)
 }
 
 
-static int
-repack_brotli(trace::File *inFile, const char *outFileName, int quality)
+static brotli::BrotliParams
+brotliParams(int quality)
 {
     brotli::BrotliParams params;
 
@@ -151,6 +162,40 @@ repack_brotli(trace::File *inFile, const char *outFileName, int quality)
         params.quality = quality;
     }
 
+    return params;
+}
+
+
+/* Check that the brotli trace just written decompresses to data with the
+ * given CRC. */
+static int
+verify_brotli(const char *outFileName, uLong crc)
+{
+    std::unique_ptr<trace::File> outFileIn(trace::File::createBrotli());
+    if (!outFileIn->open(outFileName)) {
+        std::cerr << "error: failed to open " << outFileName << " for reading\n";
+        return EXIT_FAILURE;
+    }
+    BrotliTraceIn outIn(outFileIn.get());
+    size_t bytes_read;
+    do {
+        outIn.Read(65536, &bytes_read);
+    } while (bytes_read > 0);
+
+    if (crc != outIn.crc) {
+        std::cerr << "error: CRC mismatch reading " << outFileName << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+static int
+repack_brotli(trace::File *inFile, const char *outFileName, int quality)
+{
+    brotli::BrotliParams params = brotliParams(quality);
+
     BrotliTraceIn in(inFile);
     FILE *fout = fopen(outFileName, "wb");
     if (!fout) {
@@ -164,27 +209,232 @@ repack_brotli(trace::File *inFile, const char *outFileName, int quality)
     }
     fclose(fout);
 
-    std::unique_ptr<trace::File> outFileIn(trace::File::createBrotli());
-    if (!outFileIn->open(outFileName)) {
-        std::cerr << "error: failed to open " << outFileName << " for reading\n";
-        return EXIT_FAILURE;
+    return verify_brotli(outFileName, in.crc);
+}
+
+
+/*
+ * Compress the trace in fixed-size chunks on a thread pool, and write them
+ * out in order.  Each chunk is compressed independently, as a snappy chunk,
+ * a gzip member, or a whole brotli stream, so that the result is still read
+ * as one stream.
+ */
+class ParallelRepacker
+{
+    struct Chunk {
+        std::string data;
+        bool done = false;
+        bool failed = false;
+    };
+
+    Format format;
+    int quality;
+    unsigned maxPending;
+
+    os::mutex mutex;
+    os::condition_variable cond;
+    std::deque<std::shared_ptr<Chunk>> pending;
+
+    ThreadPool pool;
+
+    bool
+    compressSnappy(const std::string &data, std::string &out) {
+        size_t length;
+        out.resize(snappy::MaxCompressedLength(data.size()));
+        snappy::RawCompress(data.data(), data.size(), &out[0], &length);
+        out.resize(length);
+        return true;
     }
-    BrotliTraceIn outIn(outFileIn.get());
-    size_t bytes_read;
-    do {
-        outIn.Read(65536, &bytes_read);
-    } while (bytes_read > 0);
 
-    if (in.crc != outIn.crc) {
-        std::cerr << "error: CRC mismatch reading " << outFileName << "\n";
+    bool
+    compressZLib(const std::string &data, std::string &out) {
+        z_stream stream;
+        memset(&stream, 0, sizeof stream);
+
+        // 16 + MAX_WBITS for a gzip header, which makes chunks members
+        if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED,
+                         16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            return false;
+        }
+
+        out.resize(deflateBound(&stream, data.size()));
+        stream.next_in = (Bytef *)data.data();
+        stream.avail_in = data.size();
+        stream.next_out = (Bytef *)&out[0];
+        stream.avail_out = out.size();
+        int ret = deflate(&stream, Z_FINISH);
+        out.resize(stream.total_out);
+        deflateEnd(&stream);
+
+        return ret == Z_STREAM_END;
+    }
+
+    bool
+    compressBrotli(const std::string &data, std::string &out) {
+        brotli::BrotliMemIn in(data.data(), data.size());
+        brotli::BrotliStringOut sink(&out, 2 * data.size() + 1024);
+        return brotli::BrotliCompress(brotliParams(quality), &in, &sink);
+    }
+
+    void
+    compress(std::shared_ptr<Chunk> chunk) {
+        std::string out;
+        bool ok;
+        switch (format) {
+        case FORMAT_SNAPPY:
+            ok = compressSnappy(chunk->data, out);
+            break;
+        case FORMAT_ZLIB:
+            ok = compressZLib(chunk->data, out);
+            break;
+        case FORMAT_BROTLI:
+            ok = compressBrotli(chunk->data, out);
+            break;
+        default:
+            ok = false;
+            break;
+        }
+
+        os::unique_lock<os::mutex> lock(mutex);
+        chunk->data.swap(out);
+        chunk->failed = !ok;
+        chunk->done = true;
+        cond.notify_all();
+    }
+
+    /* Write compressed chunks; block until at most `limit` remain. */
+    template<class Sink>
+    bool
+    drain(size_t limit, Sink sink) {
+        while (!pending.empty()) {
+            std::shared_ptr<Chunk> chunk = pending.front();
+            {
+                os::unique_lock<os::mutex> lock(mutex);
+                if (!chunk->done) {
+                    if (pending.size() <= limit) {
+                        return true;
+                    }
+                    cond.wait(lock, [&chunk]{ return chunk->done; });
+                }
+            }
+            pending.pop_front();
+            if (chunk->failed || !sink(chunk->data)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+public:
+    ParallelRepacker(unsigned jobs, Format _format, int _quality) :
+        format(_format),
+        quality(_quality),
+        maxPending(2 * jobs),
+        pool(jobs)
+    {
+    }
+
+    ~ParallelRepacker() {
+        drain(0, [](const std::string &) { return true; });
+    }
+
+    /* Size of the uncompressed chunks: snappy readers can't take more, and
+     * for the others it's a trade-off between memory and compression ratio,
+     * (for brotli it matches the window size). */
+    size_t
+    chunkSize(void) const {
+        switch (format) {
+        case FORMAT_SNAPPY:
+            return SNAPPY_CHUNK_SIZE;
+        case FORMAT_ZLIB:
+            return 4 * 1024 * 1024;
+        default:
+            return 16 * 1024 * 1024;
+        }
+    }
+
+    /* Compress all of inFile, passing the compressed chunks to `sink` in
+     * order, and return the CRC of the uncompressed data. */
+    template<class Sink>
+    bool
+    repack(trace::File *inFile, Sink sink, uLong &crc) {
+        crc = crc32(0L, Z_NULL, 0);
+
+        while (true) {
+            std::shared_ptr<Chunk> chunk = std::make_shared<Chunk>();
+            chunk->data.resize(chunkSize());
+
+            size_t size = 0;
+            size_t read;
+            while (size < chunk->data.size() &&
+                   (read = inFile->read(&chunk->data[size], chunk->data.size() - size)) != 0) {
+                size += read;
+            }
+            if (size == 0) {
+                break;
+            }
+            chunk->data.resize(size);
+            crc = crc32(crc, reinterpret_cast<const Bytef *>(chunk->data.data()), size);
+
+            pending.push_back(chunk);
+            pool.enqueue(&ParallelRepacker::compress, this, chunk);
+
+            if (!drain(maxPending, sink)) {
+                return false;
+            }
+        }
+
+        return drain(0, sink);
+    }
+};
+
+
+static int
+repack_parallel(trace::File *inFile, const char *outFileName, Format format, int quality, unsigned jobs)
+{
+    ParallelRepacker repacker(jobs, format, quality);
+    uLong crc;
+
+    if (format == FORMAT_SNAPPY) {
+        std::unique_ptr<trace::OutStream> outFile(trace::createSnappyStream(outFileName));
+        if (!outFile) {
+            return EXIT_FAILURE;
+        }
+        auto sink = [&outFile](const std::string &chunk) {
+            return outFile->writeRawChunk(chunk.data(), chunk.size());
+        };
+        if (!repacker.repack(inFile, sink, crc)) {
+            std::cerr << "error: failed to write " << outFileName << "\n";
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    FILE *fout = fopen(outFileName, "wb");
+    if (!fout) {
+        return EXIT_FAILURE;
+    }
+    auto sink = [fout](const std::string &chunk) {
+        return fwrite(chunk.data(), 1, chunk.size(), fout) == chunk.size();
+    };
+    bool ok = repacker.repack(inFile, sink, crc);
+    if (fclose(fout) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        std::cerr << "error: failed to write " << outFileName << "\n";
         return EXIT_FAILURE;
     }
 
+    if (format == FORMAT_BROTLI) {
+        return verify_brotli(outFileName, crc);
+    }
+
     return EXIT_SUCCESS;
 }
 
 static int
-repack(const char *inFileName, const char *outFileName, Format format, int quality)
+repack(const char *inFileName, const char *outFileName, Format format, int quality, unsigned jobs)
 {
     int ret = EXIT_FAILURE;
 
@@ -193,6 +443,12 @@ repack(const char *inFileName, const char *outFileName, Format format, int quali
         return 1;
     }
 
+    if (jobs > 1) {
+        ret = repack_parallel(inFile, outFileName, format, quality, jobs);
+        delete inFile;
+        return ret;
+    }
+
     trace::OutStream *outFile = nullptr;
     if (format == FORMAT_SNAPPY) {
         outFile = trace::createSnappyStream(outFileName);
@@ -219,6 +475,7 @@ command(int argc, char *argv[])
     Format format = FORMAT_SNAPPY;
     int opt;
     int quality = -1;
+    unsigned jobs = 0;
     while ((opt = getopt_long(argc, argv, shortOptions, longOptions, NULL)) != -1) {
         switch (opt) {
         case 'h':
@@ -233,6 +490,16 @@ command(int argc, char *argv[])
         case 'z':
             format = FORMAT_ZLIB;
             break;
+        case 'j':
+        {
+            int value = trace::intOption(optarg, 0);
+            if (value <= 0) {
+                std::cerr << "error: invalid number of jobs " << optarg << "\n";
+                return 1;
+            }
+            jobs = value;
+            break;
+        }
         default:
             std::cerr << "error: unexpected option `" << (char)opt << "`\n";
             usage();
@@ -246,7 +513,11 @@ command(int argc, char *argv[])
         return 1;
     }
 
-    return repack(argv[optind], argv[optind + 1], format, quality);
+    if (jobs == 0) {
+        jobs = format == FORMAT_BROTLI ? 1 : os::thread::hardware_concurrency();
+    }
+
+    return repack(argv[optind], argv[optind + 1], format, quality, jobs);
 }
 
 const Command repack_command = {
@@ -64,7 +64,9 @@ guessApi(const char *filename)
 int
 executeRetrace(const std::vector<const char *> & opts,
                const char *traceName,
-               trace::API api) {
+               trace::API api,
+               const char *outputFilename,
+               const char *errorFilename) {
     const char *retraceName;
     switch (api) {
     case trace::API_GL:
@@ -102,7 +104,7 @@ executeRetrace(const std::vector<const char *> & opts,
     }
     command.push_back(NULL);
 
-    return os::execute((char * const *)&command[0]);
+    return os::execute((char * const *)&command[0], outputFilename, errorFilename);
 }
 
 int
@@ -35,7 +35,9 @@
 int
 executeRetrace(const std::vector<const char *> & opts,
                const char *traceName,
-               trace::API api);
+               trace::API api,
+               const char *outputFilename = NULL,
+               const char *errorFilename = NULL);
 
 int
 executeRetrace(const std::vector<const char *> & opts,
@@ -0,0 +1,617 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Byte accounting for traces.
+ *
+ * The trace is scanned without decoding call arguments, and the size of
+ * every call's events (as reported by the parser in Call::encodedSize and
+ * Call::blobSize) is accumulated per function, per frame, and per thread.
+ */
+
+
+#include <limits.h> // for CHAR_MAX
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cli.hpp"
+
+#include "trace_parser.hpp"
+
+
+static const char *synopsis = "Report where the bytes of a trace go.";
+
+static void
+usage(void)
+{
+    std::cout
+        << "usage: apitrace stats [OPTIONS] TRACE_FILE\n"
+        << synopsis << "\n"
+        "\n"
+        "    -h, --help           Show this help message and exit\n"
+        "    -o, --output=FILE    Write the report to FILE [default: stdout]\n"
+        "    --json               Write the report as JSON, including the size of\n"
+        "                         every function and frame\n"
+        "    -n, --top=N          List the N biggest functions and frames in the\n"
+        "                         text report, or all with 0 [default: 20]\n"
+        "\n"
+        "Sizes are of the uncompressed trace.  Each call accounts for its enter\n"
+        "and leave events, including the signatures and backtrace frames defined\n"
+        "there, and blob bytes are the part of it taken by blob arguments, (such\n"
+        "as buffer or texture data.)  Calls after the last end of frame count as\n"
+        "one more frame.\n"
+        "\n";
+}
+
+enum {
+    JSON_OPT = CHAR_MAX + 1,
+};
+
+const static char *
+shortOptions = "ho:n:";
+
+const static struct option
+longOptions[] = {
+    {"help", no_argument, 0, 'h'},
+    {"output", required_argument, 0, 'o'},
+    {"json", no_argument, 0, JSON_OPT},
+    {"top", required_argument, 0, 'n'},
+    {0, 0, 0, 0}
+};
+
+
+struct FunctionStats {
+    std::string name;
+    uint64_t calls = 0;
+    uint64_t bytes = 0;
+    uint64_t blobCalls = 0;
+    uint64_t blobBytes = 0;
+};
+
+struct FrameStats {
+    unsigned firstCall = 0;
+    uint64_t calls = 0;
+    uint64_t bytes = 0;
+    uint64_t blobBytes = 0;
+};
+
+struct ThreadStats {
+    uint64_t calls = 0;
+    uint64_t bytes = 0;
+};
+
+struct TraceStats {
+    uint64_t fileSize = 0;
+    uint64_t bytes = 0;
+    uint64_t calls = 0;
+    uint64_t blobBytes = 0;
+
+    // Indexed by signature id
+    std::vector<FunctionStats> functions;
+    std::vector<FrameStats> frames;
+    // Indexed by thread id
+    std::vector<ThreadStats> threads;
+};
+
+
+static bool
+collectStats(const char *filename, TraceStats &stats)
+{
+    {
+        std::ifstream stream(filename, std::ios::binary | std::ios::ate);
+        if (stream) {
+            stats.fileSize = stream.tellg();
+        }
+    }
+
+    trace::Parser parser;
+    if (!parser.open(filename)) {
+        std::cerr << "error: failed to open " << filename << "\n";
+        return false;
+    }
+
+    // Parsing can't be split across chunks, as events straddle them and
+    // signatures are only defined on first use, but decompression can.
+    parser.enableReadAhead();
+
+    FrameStats frame;
+    bool frameStarted = false;
+
+    trace::Call *call;
+    while ((call = parser.scan_call())) {
+        unsigned id = call->sig->id;
+        if (id >= stats.functions.size()) {
+            stats.functions.resize(id + 1);
+        }
+        FunctionStats &function = stats.functions[id];
+        if (!function.calls) {
+            // Signatures don't outlive the parser
+            function.name = call->sig->name;
+        }
+        ++function.calls;
+        function.bytes += call->encodedSize;
+        if (call->blobSize) {
+            ++function.blobCalls;
+            function.blobBytes += call->blobSize;
+        }
+
+        if (call->thread_id >= stats.threads.size()) {
+            stats.threads.resize(call->thread_id + 1);
+        }
+        ThreadStats &thread = stats.threads[call->thread_id];
+        ++thread.calls;
+        thread.bytes += call->encodedSize;
+
+        if (!frameStarted) {
+            frame.firstCall = call->no;
+            frameStarted = true;
+        }
+        ++frame.calls;
+        frame.bytes += call->encodedSize;
+        frame.blobBytes += call->blobSize;
+        if (call->flags & trace::CALL_FLAG_END_FRAME) {
+            stats.frames.push_back(frame);
+            frame = FrameStats();
+            frameStarted = false;
+        }
+
+        ++stats.calls;
+        stats.blobBytes += call->blobSize;
+
+        delete call;
+    }
+
+    if (frameStarted) {
+        stats.frames.push_back(frame);
+    }
+
+    stats.bytes = parser.bytesRead();
+
+    return true;
+}
+
+
+static std::string
+formatBytes(uint64_t bytes)
+{
+    static const char *units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    char buf[32];
+    if (bytes < 1024) {
+        snprintf(buf, sizeof buf, "%u B", unsigned(bytes));
+    } else {
+        double value = bytes;
+        unsigned unit = 0;
+        while (value >= 1024 && unit + 1 < sizeof units / sizeof units[0]) {
+            value /= 1024;
+            ++unit;
+        }
+        snprintf(buf, sizeof buf, "%.1f %s", value, units[unit]);
+    }
+    return buf;
+}
+
+
+static std::string
+formatPercent(uint64_t part, uint64_t total)
+{
+    char buf[16];
+    snprintf(buf, sizeof buf, "%.1f%%", total ? 100.0 * part / total : 0.0);
+    return buf;
+}
+
+
+static unsigned
+log2Bucket(uint64_t value)
+{
+    unsigned bucket = 0;
+    while (value > 1) {
+        value >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+
+/*
+ * Print a histogram of the values in power of two buckets.
+ */
+static void
+writeHistogram(std::ostream &os, const std::vector<uint64_t> &values, bool bytes)
+{
+    std::vector<uint64_t> counts;
+    unsigned minBucket = UINT_MAX;
+    for (uint64_t value : values) {
+        unsigned bucket = log2Bucket(value);
+        if (bucket >= counts.size()) {
+            counts.resize(bucket + 1);
+        }
+        ++counts[bucket];
+        minBucket = std::min(minBucket, bucket);
+    }
+    if (counts.empty()) {
+        return;
+    }
+
+    uint64_t maxCount = *std::max_element(counts.begin(), counts.end());
+    const unsigned barWidth = 40;
+    for (unsigned bucket = minBucket; bucket < counts.size(); ++bucket) {
+        uint64_t lower = bucket ? uint64_t(1) << bucket : 0;
+        uint64_t upper = (uint64_t(1) << (bucket + 1)) - 1;
+        std::string range;
+        if (bytes) {
+            range = formatBytes(lower) + " - " + formatBytes(upper + 1);
+        } else {
+            range = std::to_string(lower) + " - " + std::to_string(upper);
+        }
+        char buf[64];
+        snprintf(buf, sizeof buf, "    %-24s %10llu  ", range.c_str(),
+                 (unsigned long long)counts[bucket]);
+        os << buf
+           << std::string((counts[bucket] * barWidth + maxCount - 1) / maxCount, '#')
+           << "\n";
+    }
+}
+
+
+static void
+writeDistribution(std::ostream &os, const char *title, std::vector<uint64_t> values, bool bytes)
+{
+    if (values.empty()) {
+        return;
+    }
+
+    std::sort(values.begin(), values.end());
+    auto percentile = [&values] (unsigned p) {
+        return values[(values.size() - 1) * p / 100];
+    };
+    auto format = [bytes] (uint64_t value) {
+        return bytes ? formatBytes(value) : std::to_string(value);
+    };
+
+    os << title << ": min " << format(values.front())
+       << ", median " << format(percentile(50))
+       << ", p90 " << format(percentile(90))
+       << ", p99 " << format(percentile(99))
+       << ", max " << format(values.back()) << "\n";
+    writeHistogram(os, values, bytes);
+    os << "\n";
+}
+
+
+static void
+writeText(std::ostream &os, const char *filename, const TraceStats &stats, size_t top)
+{
+    char buf[256];
+
+    os << "Trace: " << filename << "\n";
+    os << "  File size:     " << formatBytes(stats.fileSize);
+    if (stats.fileSize) {
+        snprintf(buf, sizeof buf, " (compression ratio %.1f:1)",
+                 double(stats.bytes) / stats.fileSize);
+        os << buf;
+    }
+    os << "\n";
+    os << "  Uncompressed:  " << formatBytes(stats.bytes) << "\n";
+    os << "  Blob data:     " << formatBytes(stats.blobBytes)
+       << " (" << formatPercent(stats.blobBytes, stats.bytes) << ")\n";
+    os << "  Calls:         " << stats.calls << "\n";
+    os << "  Frames:        " << stats.frames.size() << "\n";
+    os << "\n";
+
+    std::vector<const FunctionStats *> functions;
+    for (auto & function : stats.functions) {
+        if (function.calls) {
+            functions.push_back(&function);
+        }
+    }
+    size_t count = top ? std::min(top, functions.size()) : functions.size();
+
+    std::sort(functions.begin(), functions.end(),
+              [] (const FunctionStats *a, const FunctionStats *b) {
+                  return a->bytes > b->bytes;
+              });
+    os << "Functions by size:\n";
+    snprintf(buf, sizeof buf, "  %12s %12s %7s %12s %7s %10s  %s\n",
+             "calls", "bytes", "", "blob bytes", "", "bytes/call", "function");
+    os << buf;
+    for (size_t i = 0; i < count; ++i) {
+        const FunctionStats &function = *functions[i];
+        snprintf(buf, sizeof buf, "  %12llu %12s %7s %12s %7s %10llu  %s\n",
+                 (unsigned long long)function.calls,
+                 formatBytes(function.bytes).c_str(),
+                 formatPercent(function.bytes, stats.bytes).c_str(),
+                 formatBytes(function.blobBytes).c_str(),
+                 formatPercent(function.blobBytes, stats.bytes).c_str(),
+                 (unsigned long long)(function.bytes / function.calls),
+                 function.name.c_str());
+        os << buf;
+    }
+    if (count < functions.size()) {
+        os << "  ... (" << functions.size() - count << " more)\n";
+    }
+    os << "\n";
+
+    std::sort(functions.begin(), functions.end(),
+              [] (const FunctionStats *a, const FunctionStats *b) {
+                  return a->blobBytes > b->blobBytes;
+              });
+    if (stats.blobBytes) {
+        os << "Blob data by function:\n";
+        snprintf(buf, sizeof buf, "  %12s %12s %7s %12s  %s\n",
+                 "blobs", "blob bytes", "", "bytes/blob", "function");
+        os << buf;
+        for (size_t i = 0; i < count && functions[i]->blobBytes; ++i) {
+            const FunctionStats &function = *functions[i];
+            snprintf(buf, sizeof buf, "  %12llu %12s %7s %12s  %s\n",
+                     (unsigned long long)function.blobCalls,
+                     formatBytes(function.blobBytes).c_str(),
+                     formatPercent(function.blobBytes, stats.blobBytes).c_str(),
+                     formatBytes(function.blobBytes / function.blobCalls).c_str(),
+                     function.name.c_str());
+            os << buf;
+        }
+        os << "\n";
+    }
+
+    if (!stats.frames.empty()) {
+        std::vector<uint64_t> frameBytes;
+        std::vector<uint64_t> frameCalls;
+        frameBytes.reserve(stats.frames.size());
+        frameCalls.reserve(stats.frames.size());
+        for (auto & frame : stats.frames) {
+            frameBytes.push_back(frame.bytes);
+            frameCalls.push_back(frame.calls);
+        }
+        writeDistribution(os, "Bytes per frame", frameBytes, true);
+        writeDistribution(os, "Calls per frame", frameCalls, false);
+
+        std::vector<size_t> frames(stats.frames.size());
+        for (size_t i = 0; i < frames.size(); ++i) {
+            frames[i] = i;
+        }
+        size_t frameCount = top ? std::min(top, frames.size()) : frames.size();
+        std::partial_sort(frames.begin(), frames.begin() + frameCount, frames.end(),
+                          [&stats] (size_t a, size_t b) {
+                              return stats.frames[a].bytes > stats.frames[b].bytes;
+                          });
+        os << "Biggest frames:\n";
+        snprintf(buf, sizeof buf, "  %10s %12s %12s %12s %12s\n",
+                 "frame", "first call", "calls", "bytes", "blob bytes");
+        os << buf;
+        for (size_t i = 0; i < frameCount; ++i) {
+            const FrameStats &frame = stats.frames[frames[i]];
+            snprintf(buf, sizeof buf, "  %10llu %12u %12llu %12s %12s\n",
+                     (unsigned long long)frames[i],
+                     frame.firstCall,
+                     (unsigned long long)frame.calls,
+                     formatBytes(frame.bytes).c_str(),
+                     formatBytes(frame.blobBytes).c_str());
+            os << buf;
+        }
+        os << "\n";
+    }
+
+    os << "Threads:\n";
+    snprintf(buf, sizeof buf, "  %10s %12s %7s %12s %7s\n",
+             "thread", "calls", "", "bytes", "");
+    os << buf;
+    for (size_t id = 0; id < stats.threads.size(); ++id) {
+        const ThreadStats &thread = stats.threads[id];
+        if (!thread.calls) {
+            continue;
+        }
+        snprintf(buf, sizeof buf, "  %10llu %12llu %7s %12s %7s\n",
+                 (unsigned long long)id,
+                 (unsigned long long)thread.calls,
+                 formatPercent(thread.calls, stats.calls).c_str(),
+                 formatBytes(thread.bytes).c_str(),
+                 formatPercent(thread.bytes, stats.bytes).c_str());
+        os << buf;
+    }
+}
+
+
+static void
+writeJSONString(std::ostream &os, const char *s)
+{
+    os << '"';
+    for (; *s; ++s) {
+        unsigned char c = *s;
+        switch (c) {
+        case '"':
+            os << "\\\"";
+            break;
+        case '\\':
+            os << "\\\\";
+            break;
+        default:
+            if (c < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof buf, "\\u%04x", c);
+                os << buf;
+            } else {
+                os << c;
+            }
+        }
+    }
+    os << '"';
+}
+
+
+template< class T >
+static void
+writeJSONArray(std::ostream &os, const std::vector<FrameStats> &frames, T FrameStats::*member)
+{
+    os << "[";
+    for (size_t i = 0; i < frames.size(); ++i) {
+        if (i) {
+            os << ",";
+        }
+        os << frames[i].*member;
+    }
+    os << "]";
+}
+
+
+static void
+writeJSON(std::ostream &os, const char *filename, const TraceStats &stats)
+{
+    os << "{\n";
+    os << "  \"file\": ";
+    writeJSONString(os, filename);
+    os << ",\n";
+    os << "  \"fileSize\": " << stats.fileSize << ",\n";
+    os << "  \"bytes\": " << stats.bytes << ",\n";
+    os << "  \"blobBytes\": " << stats.blobBytes << ",\n";
+    os << "  \"calls\": " << stats.calls << ",\n";
+
+    std::vector<const FunctionStats *> functions;
+    for (auto & function : stats.functions) {
+        if (function.calls) {
+            functions.push_back(&function);
+        }
+    }
+    std::sort(functions.begin(), functions.end(),
+              [] (const FunctionStats *a, const FunctionStats *b) {
+                  return a->bytes > b->bytes;
+              });
+    os << "  \"functions\": [";
+    for (size_t i = 0; i < functions.size(); ++i) {
+        const FunctionStats &function = *functions[i];
+        os << (i ? ",\n" : "\n") << "    {\"name\": ";
+        writeJSONString(os, function.name.c_str());
+        os << ", \"calls\": " << function.calls
+           << ", \"bytes\": " << function.bytes
+           << ", \"blobCalls\": " << function.blobCalls
+           << ", \"blobBytes\": " << function.blobBytes << "}";
+    }
+    os << "\n  ],\n";
+
+    os << "  \"frames\": {\n";
+    os << "    \"count\": " << stats.frames.size() << ",\n";
+    os << "    \"firstCall\": ";
+    writeJSONArray(os, stats.frames, &FrameStats::firstCall);
+    os << ",\n    \"calls\": ";
+    writeJSONArray(os, stats.frames, &FrameStats::calls);
+    os << ",\n    \"bytes\": ";
+    writeJSONArray(os, stats.frames, &FrameStats::bytes);
+    os << ",\n    \"blobBytes\": ";
+    writeJSONArray(os, stats.frames, &FrameStats::blobBytes);
+    os << "\n  },\n";
+
+    os << "  \"threads\": [";
+    bool first = true;
+    for (size_t id = 0; id < stats.threads.size(); ++id) {
+        const ThreadStats &thread = stats.threads[id];
+        if (!thread.calls) {
+            continue;
+        }
+        os << (first ? "\n" : ",\n")
+           << "    {\"id\": " << id
+           << ", \"calls\": " << thread.calls
+           << ", \"bytes\": " << thread.bytes << "}";
+        first = false;
+    }
+    os << "\n  ]\n";
+    os << "}\n";
+}
+
+
+static int
+command(int argc, char *argv[])
+{
+    const char *output = NULL;
+    bool json = false;
+    size_t top = 20;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, shortOptions, longOptions, NULL)) != -1) {
+        switch (opt) {
+        case 'h':
+            usage();
+            return 0;
+        case 'o':
+            output = optarg;
+            break;
+        case JSON_OPT:
+            json = true;
+            break;
+        case 'n':
+            top = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            std::cerr << "error: unexpected option `" << (char)opt << "`\n";
+            usage();
+            return 1;
+        }
+    }
+
+    if (argc != optind + 1) {
+        std::cerr << "error: incorrect number of arguments\n";
+        usage();
+        return 1;
+    }
+
+    const char *filename = argv[optind];
+
+    TraceStats stats;
+    if (!collectStats(filename, stats)) {
+        return 1;
+    }
+
+    std::ofstream file;
+    if (output) {
+        file.open(output);
+        if (!file) {
+            std::cerr << "error: failed to open " << output << "\n";
+            return 1;
+        }
+    }
+    std::ostream &os = output ? file : std::cout;
+
+    if (json) {
+        writeJSON(os, filename, stats);
+    } else {
+        writeText(os, filename, stats, top);
+    }
+
+    return 0;
+}
+
+const Command stats_command = {
+    "stats",
+    synopsis,
+    usage,
+    command
+};
@@ -24,7 +24,10 @@
  *
  **************************************************************************/
 
+#include <memory>
 #include <sstream>
+#include <string>
+#include <vector>
 #include <string.h>
 #include <limits.h> // for CHAR_MAX
 #include <getopt.h>
@@ -34,6 +37,8 @@
 #include "os_string.hpp"
 
 #include "trace_callset.hpp"
+#include "trace_file.hpp"
+#include "trace_format.hpp"
 #include "trace_parser.hpp"
 #include "trace_writer.hpp"
 
@@ -93,6 +98,137 @@ struct trim_options {
     int thread;
 };
 
+/* There's no use doing any work past the last call and frame requested by
+ * the user. */
+static bool
+past_end(struct trim_options *options, trace::Call *call, unsigned frame)
+{
+    return (options->calls.empty() || call->no > options->calls.getLast()) &&
+           (options->frames.empty() || frame > options->frames.getLast());
+}
+
+static bool
+keep_call(struct trim_options *options, trace::Call *call, unsigned frame)
+{
+    /* If requested, ignore all calls not belonging to the specified thread. */
+    if (options->thread != -1 && call->thread_id != options->thread) {
+        return false;
+    }
+
+    /* If this call is included in the user-specified call set,
+     * then require it (and all dependencies) in the trimmed
+     * output. */
+    return options->calls.contains(*call) ||
+           options->frames.contains(frame, call->flags);
+}
+
+
+/*
+ * Scan (i.e., without decoding arguments) through the leading calls of the
+ * trace, to find:
+ *
+ * - the end of the longest prefix of the trace where all calls are kept,
+ *   which can be copied verbatim;
+ *
+ * - where full parsing must resume, either at the end of the prefix, or
+ *   right before the first kept call after it.
+ *
+ * Both are clean boundaries, without any calls entered but not left.
+ *
+ * Events past the prefix can't be copied verbatim, because leave events
+ * refer to calls by number, and calls get renumbered once some are dropped.
+ */
+static void
+scan_trace(trace::Parser &p, struct trim_options *options,
+           trace::ParseBookmark &prefixEnd,
+           trace::ParseBookmark &resume, unsigned &resumeFrame)
+{
+    trace::ParseBookmark clean;
+    unsigned frame = 0;
+    unsigned cleanFrame = 0;
+    bool inPrefix = true;
+    bool keptSinceClean = false;
+
+    p.getBookmark(clean);
+
+    trace::Call *call;
+    while ((call = p.scan_call())) {
+        bool stop = past_end(options, call, frame) ||
+                    (call->flags & trace::CALL_FLAG_INCOMPLETE);
+        bool kept = !stop && keep_call(options, call, frame);
+
+        if (call->flags & trace::CALL_FLAG_END_FRAME) {
+            frame++;
+        }
+
+        delete call;
+
+        if (stop) {
+            break;
+        }
+
+        if (inPrefix) {
+            if (!kept) {
+                inPrefix = false;
+                prefixEnd = clean;
+                if (keptSinceClean) {
+                    break;
+                }
+            }
+            keptSinceClean = kept;
+        } else if (kept) {
+            break;
+        }
+
+        if (!p.hasPendingCalls()) {
+            p.getBookmark(clean);
+            cleanFrame = frame;
+            keptSinceClean = false;
+        }
+    }
+
+    if (inPrefix) {
+        prefixEnd = clean;
+    }
+    resume = clean;
+    resumeFrame = cleanFrame;
+}
+
+
+/* Copy the start of the trace, up to the given offset, verbatim. */
+static bool
+copy_prefix(const char *filename, const trace::File::Offset &start,
+            const trace::File::Offset &end, trace::Writer &writer)
+{
+    std::unique_ptr<trace::File> file(trace::File::createForRead(filename));
+    if (!file) {
+        return false;
+    }
+
+    /* Whole chunks are copied without decompressing them... */
+    std::string data;
+    uint64_t chunkOffset = start.chunk;
+    while (chunkOffset < end.chunk) {
+        if (!file->readRawChunk(chunkOffset, data) ||
+            !writer.writeRawChunk(data.data(), data.size())) {
+            return false;
+        }
+    }
+
+    /* ...but the last one is usually only partially included. */
+    if (end.offsetInChunk) {
+        file->setCurrentOffset(trace::File::Offset(end.chunk, 0));
+        data.resize(end.offsetInChunk);
+        if (file->read(&data[0], data.size()) != data.size()) {
+            return false;
+        }
+        writer.writeRaw(data.data(), data.size());
+    }
+
+    return true;
+}
+
+
 static int
 trim_trace(const char *filename, struct trim_options *options)
 {
@@ -112,41 +248,56 @@ trim_trace(const char *filename, struct trim_options *options)
         options->output = std::string(base.str()) + std::string("-trim.trace");
     }
 
+    frame = 0;
+
+    /* With seekable traces in the current format, copy the leading calls
+     * verbatim and skip over the unwanted ones without decoding them. */
+    bool seekable = p.supportsOffsets() && p.getVersion() == TRACE_VERSION;
+    trace::ParseBookmark start;
+    trace::ParseBookmark prefixEnd;
+    trace::ParseBookmark resume;
+    if (seekable) {
+        p.getBookmark(start);
+        prefixEnd = start;
+        scan_trace(p, options, prefixEnd, resume, frame);
+    }
+    bool copyPrefix = seekable && prefixEnd.next_call_no > 0;
+
     trace::Writer writer;
-    if (!writer.open(options->output.c_str())) {
+    if (!writer.open(options->output.c_str(), !copyPrefix)) {
         std::cerr << "error: failed to create " << options->output << "\n";
         return 1;
     }
 
+    if (copyPrefix) {
+        /* Copying from the start of the first chunk includes the header. */
+        trace::File::Offset headerOffset(start.offset.chunk, 0);
+        if (!copy_prefix(filename, headerOffset, prefixEnd.offset, writer)) {
+            std::cerr << "error: failed to copy " << filename << "\n";
+            return 1;
+        }
+
+        std::vector<bool> functions, structs, enums, bitmasks, frames;
+        p.getDefinitions(prefixEnd.offset, functions, structs, enums, bitmasks, frames);
+        writer.resync(prefixEnd.next_call_no, functions, structs, enums, bitmasks, frames);
+    }
+
+    if (seekable) {
+        p.setBookmark(resume);
+    }
 
-    frame = 0;
     trace::Call *call;
     while ((call = p.parse_call())) {
 
-        /* There's no use doing any work past the last call and frame
-         * requested by the user. */
-        if ((options->calls.empty() || call->no > options->calls.getLast()) &&
-            (options->frames.empty() || frame > options->frames.getLast())) {
-
+        if (past_end(options, call, frame)) {
             delete call;
             break;
         }
 
-        /* If requested, ignore all calls not belonging to the specified thread. */
-        if (options->thread != -1 && call->thread_id != options->thread) {
-            goto NEXT;
-        }
-
-        /* If this call is included in the user-specified call set,
-         * then require it (and all dependencies) in the trimmed
-         * output. */
-        if (options->calls.contains(*call) ||
-            options->frames.contains(frame, call->flags)) {
-
+        if (keep_call(options, call, frame)) {
             writer.writeCall(call);
         }
 
-    NEXT:
         if (call->flags & trace::CALL_FLAG_END_FRAME) {
             frame++;
         }
@@ -92,6 +92,10 @@ usage(void)
         "\n"
         "        --thread=THREAD_ID   Only retain calls from specified thread\n"
         "\n"
+        "        --out-of-core        Keep the dependency analysis state in a temporary\n"
+        "                             file rather than in memory, so that memory use\n"
+        "                             does not grow with the length of the trace.\n"
+        "\n"
         "    -o, --output=TRACE_FILE  Output trace file\n"
         "\n"
     ;
@@ -106,7 +110,8 @@ enum {
     NO_PRUNE_OPT,
     THREAD_OPT,
     PRINT_CALLSET_OPT,
-    TRIM_SPEC_OPT
+    TRIM_SPEC_OPT,
+    OUT_OF_CORE_OPT
 };
 
 const static char *
@@ -125,6 +130,7 @@ longOptions[] = {
     {"output", required_argument, 0, 'o'},
     {"print-callset", no_argument, 0, PRINT_CALLSET_OPT},
     {"trim-spec", required_argument, 0, TRIM_SPEC_OPT},
+    {"out-of-core", no_argument, 0, OUT_OF_CORE_OPT},
     {0, 0, 0, 0}
 };
 
@@ -158,6 +164,9 @@ struct trim_auto_options {
 
     /* What kind of trimming to perform. */
     TrimFlags trim_flags;
+
+    /* Whether to keep the analysis state on disk. */
+    bool out_of_core;
 };
 
 static int
@@ -175,6 +184,11 @@ trim_trace(const char *filename, struct trim_auto_options *options)
         return 1;
     }
 
+    if (options->out_of_core && !analyzer.spillToDisk()) {
+        std::cerr << "error: failed to create temporary file\n";
+        return 1;
+    }
+
     /* Mark the beginning so we can return here for pass 2. */
     p.getBookmark(beginning);
 
@@ -343,6 +357,7 @@ command(int argc, char *argv[])
     options.thread = -1;
     options.print_callset = 0;
     options.trim_flags = -1;
+    options.out_of_core = false;
 
     int opt;
     while ((opt = getopt_long(argc, argv, shortOptions, longOptions, NULL)) != -1) {
@@ -377,6 +392,9 @@ command(int argc, char *argv[])
         case PRINT_CALLSET_OPT:
             options.print_callset = 1;
             break;
+        case OUT_OF_CORE_OPT:
+            options.out_of_core = true;
+            break;
         case TRIM_SPEC_OPT:
             if (parse_trim_spec(optarg, &options.trim_flags)) {
                 std::cerr << "error: illegal value for trim-spec: " << optarg << "\n";
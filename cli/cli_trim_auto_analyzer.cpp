@@ -23,11 +23,16 @@
  *
  **************************************************************************/
 
-#include <sstream>
+#include <assert.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <iostream>
 
 #include "cli_trim_auto_analyzer.hpp"
 
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
 #define STRNCMP_LITERAL(var, literal) strncmp((var), (literal), sizeof (literal) -1)
 
 /* Rendering often has no side effects, but it can in some cases,
@@ -39,131 +44,364 @@ TraceAnalyzer::renderingHasSideEffect(void)
     return transformFeedbackActive || framebufferObjectActive;
 }
 
+#ifdef _WIN32
+#define fseek64 _fseeki64
+#else
+#define fseek64 fseeko
+#endif
+
+/* Maximum number of runs each resource keeps in memory when spilling. */
+#define SPILL_RUNS 4096
+
+CallRangeSpill::~CallRangeSpill()
+{
+    if (file) {
+        fclose(file);
+    }
+}
+
+bool
+CallRangeSpill::open(void)
+{
+    file = tmpfile();
+    return file != NULL;
+}
+
+uint64_t
+CallRangeSpill::write(const CallRange *ranges, size_t count)
+{
+    uint64_t offset = end;
+
+    if (fseek64(file, offset, SEEK_SET) != 0 ||
+        fwrite(ranges, sizeof *ranges, count, file) != count) {
+        std::cerr << "error: failed to write temporary file\n";
+        exit(1);
+    }
+
+    end += count * sizeof *ranges;
+    return offset;
+}
+
+void
+CallRangeSpill::read(uint64_t offset, CallRange *ranges, size_t count)
+{
+    if (fseek64(file, offset, SEEK_SET) != 0 ||
+        fread(ranges, sizeof *ranges, count, file) != count) {
+        std::cerr << "error: failed to read temporary file\n";
+        exit(1);
+    }
+}
+
+void
+CallRanges::add(const CallRange &range)
+{
+    /* Common case: append a run, or extend the last one. */
+    if (ranges.empty() || range.first > ranges.back().second + 1) {
+        ranges.push_back(range);
+        if (spill && ranges.size() >= SPILL_RUNS) {
+            spillRuns();
+        }
+        return;
+    }
+
+    if (range.first >= ranges.back().first) {
+        ranges.back().second = MAX(ranges.back().second, range.second);
+        return;
+    }
+
+    /* Otherwise insert before the last run, coalescing with any run
+     * the new one overlaps or touches. */
+    std::vector<CallRange>::iterator lo, hi;
+
+    lo = std::lower_bound(ranges.begin(), ranges.end(), range,
+                          [](const CallRange &r, const CallRange &x) {
+                              return r.second + 1 < x.first;
+                          });
+    hi = lo;
+    CallRange merged = range;
+    while (hi != ranges.end() && hi->first <= range.second + 1) {
+        merged.first = MIN(merged.first, hi->first);
+        merged.second = MAX(merged.second, hi->second);
+        ++hi;
+    }
+
+    if (lo == hi) {
+        ranges.insert(lo, merged);
+        if (spill && ranges.size() >= SPILL_RUNS) {
+            spillRuns();
+        }
+    } else {
+        *lo = merged;
+        ranges.erase(lo + 1, hi);
+    }
+}
+
+void
+CallRanges::add(const CallRanges &other, size_t first, size_t last)
+{
+    other.forEach(first, last, [this](const CallRange *runs, size_t count) {
+        merge(runs, count);
+    });
+}
+
+/* Add sorted runs to the ones in memory. */
+void
+CallRanges::merge(const CallRange *runs, size_t count)
+{
+    /* Insert a few runs in place, but merge many at once, as they
+     * would otherwise each move the tail of the vector. */
+    if (ranges.empty() ||
+        count <= 8 ||
+        runs[0].first > ranges.back().second + 1) {
+        for (size_t i = 0; i < count; ++i) {
+            add(runs[i]);
+        }
+        return;
+    }
+
+    std::vector<CallRange> merged;
+    merged.reserve(ranges.size() + count);
+
+    std::vector<CallRange>::const_iterator a = ranges.begin();
+    const CallRange *b = runs;
+    const CallRange *b_end = runs + count;
+    while (a != ranges.end() || b != b_end) {
+        const CallRange &next = b == b_end || (a != ranges.end() && a->first <= b->first) ? *a++ : *b++;
+        if (!merged.empty() && next.first <= merged.back().second + 1) {
+            merged.back().second = MAX(merged.back().second, next.second);
+        } else {
+            merged.push_back(next);
+        }
+    }
+
+    ranges.swap(merged);
+
+    if (spill && ranges.size() >= SPILL_RUNS) {
+        spillRuns();
+    }
+}
+
+/* Write all runs but the last out to the spill file. */
+void
+CallRanges::spillRuns(void)
+{
+    Segment segment;
+    segment.count = ranges.size() - 1;
+    segment.offset = spill->write(&ranges[0], segment.count);
+    segments.push_back(segment);
+    spilled += segment.count;
+
+    ranges.erase(ranges.begin(), ranges.end() - 1);
+}
+
+void
+CallRanges::clear(void)
+{
+    std::vector<CallRange>().swap(ranges);
+    std::vector<Segment>().swap(segments);
+    spilled = 0;
+}
+
+/* Intern: Return the id of the given resource, allocating it on first
+ * use. */
+TraceAnalyzer::ResourceId
+TraceAnalyzer::intern(ResourceKind kind, unsigned a, unsigned b)
+{
+    uint64_t key = (uint64_t)kind << 56 | (uint64_t)a << 24 | b;
+
+    std::pair<std::unordered_map<uint64_t, ResourceId>::iterator, bool> result;
+    result = resourceIds.insert(std::make_pair(key, (ResourceId)resources.size()));
+    if (result.second) {
+        resources.push_back(CallRanges(spill));
+        dependencies.push_back(std::vector<ResourceId>());
+        visitMarks.push_back(0);
+    }
+
+    return result.first->second;
+}
+
 /* Provide: Record that the given call affects the given resource
  * as a side effect. */
 void
-TraceAnalyzer::provide(std::string resource, trace::CallNo call_no)
+TraceAnalyzer::provide(ResourceId resource, trace::CallNo call_no)
 {
-    resources[resource].insert(call_no);
+    /* Calls are analyzed in order, so this only ever appends. */
+    resources[resource].add(call_no);
 }
 
-/* Like provide, but with a simply-formatted string, (appending an
- * integer to the given string). */
+/* Accumulate: Record that all calls currently providing 'source',
+ * (including linked dependencies), also provide 'resource'.
+ *
+ * Rather than copying the calls, only remember how much of each
+ * source has been seen, (its resources only grow by appending until
+ * rewritten, see flush()). The calls are copied when 'resource' is
+ * consumed, so accumulating into a framebuffer which ends up not being
+ * required costs nothing but the graph walk. */
 void
-TraceAnalyzer::providef(std::string resource,
-                        int resource_no,
-                        trace::CallNo call_no)
+TraceAnalyzer::accumulate(ResourceId resource, ResourceId source)
 {
-    std::stringstream ss;
-    ss << resource << resource_no;
-    provide(ss.str(), call_no);
+    if (accumulations.size() <= resource) {
+        accumulations.resize(resource + 1);
+    }
+
+    Accumulation &accumulation = accumulations[resource];
+
+    const std::vector<ResourceId> &ids = resolve(source);
+    for (ResourceId id : ids) {
+        const CallRanges &calls = resources[id];
+        if (id == resource || calls.empty()) {
+            continue;
+        }
+
+        if (accumulation.seen.size() <= id) {
+            Snapshot none = {0, CallRange(0, 0), false};
+            accumulation.seen.resize(resources.size(), none);
+        }
+
+        Snapshot &snapshot = accumulation.seen[id];
+        if (!snapshot.listed) {
+            accumulation.sources.push_back(id);
+            snapshot.listed = true;
+        }
+        snapshot.size = calls.size();
+        snapshot.last = calls.back();
+    }
 }
 
-/* Link: Establish a dependency between resource 'resource' and
- * resource 'dependency'. This dependency is captured by name so
- * that if the list of calls that provide 'dependency' grows
- * before 'resource' is consumed, those calls will still be
- * captured. */
+/* Copy the calls accumulated from 'source' into 'resource'. */
 void
-TraceAnalyzer::link(std::string resource, std::string dependency)
+TraceAnalyzer::materialize(ResourceId resource, ResourceId source)
 {
-    dependencies[resource].insert(dependency);
+    Snapshot &snapshot = accumulations[resource].seen[source];
+    if (snapshot.size == 0) {
+        return;
+    }
+
+    const CallRanges &other = resources[source];
+    CallRanges &calls = resources[resource];
+
+    calls.add(other, 0, snapshot.size - 1);
+    calls.add(snapshot.last);
+
+    snapshot.size = 0;
 }
 
-/* Like link, but with a simply-formatted string, (appending an
- * integer to the given string). */
+/* Flush: Materialize every accumulation of 'resource', before its
+ * calls are changed other than by appending. */
 void
-TraceAnalyzer::linkf(std::string resource, std::string dependency, int dep_no)
+TraceAnalyzer::flush(ResourceId resource)
 {
+    for (ResourceId target = 0; target < accumulations.size(); ++target) {
+        if (resource < accumulations[target].seen.size()) {
+            materialize(target, resource);
+        }
+    }
+}
+
+/* Erase: Forget all calls providing 'resource', (including the ones
+ * accumulated into it). */
+void
+TraceAnalyzer::erase(ResourceId resource)
+{
+    flush(resource);
+
+    resources[resource].clear();
 
-    std::stringstream ss;
-    ss << dependency << dep_no;
-    link(resource, ss.str());
+    if (resource < accumulations.size()) {
+        Accumulation &accumulation = accumulations[resource];
+        for (ResourceId id : accumulation.sources) {
+            accumulation.seen[id].size = 0;
+            accumulation.seen[id].listed = false;
+        }
+        accumulation.sources.clear();
+    }
 }
 
-/* Unlink: Remove dependency from 'resource' on 'dependency'. */
+/* Link: Establish a dependency between resource 'resource' and
+ * resource 'dependency'. This dependency is captured by id so
+ * that if the list of calls that provide 'dependency' grows
+ * before 'resource' is consumed, those calls will still be
+ * captured. */
 void
-TraceAnalyzer::unlink(std::string resource, std::string dependency)
+TraceAnalyzer::link(ResourceId resource, ResourceId dependency)
 {
-    dependencies[resource].erase(dependency);
-    if (dependencies[resource].size() == 0) {
-        dependencies.erase(resource);
+    std::vector<ResourceId> &deps = dependencies[resource];
+
+    if (std::find(deps.begin(), deps.end(), dependency) == deps.end()) {
+        deps.push_back(dependency);
     }
 }
 
-/* Like unlink, but with a simply-formated string, (appending an
- * integer to the given string). */
+/* Unlink: Remove dependency from 'resource' on 'dependency'. */
 void
-TraceAnalyzer::unlinkf(std::string resource, std::string dependency, int dep_no)
+TraceAnalyzer::unlink(ResourceId resource, ResourceId dependency)
 {
+    std::vector<ResourceId> &deps = dependencies[resource];
 
-    std::stringstream ss;
-    ss << dependency << dep_no;
-    unlink(resource, ss.str());
+    deps.erase(std::remove(deps.begin(), deps.end(), dependency), deps.end());
 }
 
 /* Unlink all: Remove dependencies from 'resource' to all other
  * resources. */
 void
-TraceAnalyzer::unlinkAll(std::string resource)
+TraceAnalyzer::unlinkAll(ResourceId resource)
 {
-    dependencies.erase(resource);
+    dependencies[resource].clear();
 }
 
-/* Resolve: Recursively compute all calls providing 'resource',
- * (including linked dependencies of 'resource' on other
- * resources). */
-std::set<unsigned>
-TraceAnalyzer::resolve(std::string resource)
+/* Resolve: Compute all resources whose calls provide 'resource',
+ * (that is 'resource' itself and, recursively, its linked
+ * dependencies). The result is only valid until the next call. */
+const std::vector<TraceAnalyzer::ResourceId> &
+TraceAnalyzer::resolve(ResourceId resource)
 {
-    std::set<std::string> *deps;
-    std::set<std::string>::iterator dep;
-
-    std::set<unsigned> *calls;
-    std::set<unsigned>::iterator call;
+    if (++visitMark == 0) {
+        std::fill(visitMarks.begin(), visitMarks.end(), 0);
+        visitMark = 1;
+    }
 
-    std::set<unsigned> result, deps_set;
+    reachable.clear();
+    reachable.push_back(resource);
+    visitMarks[resource] = visitMark;
 
-    /* Recursively chase dependencies. */
-    if (dependencies.count(resource)) {
-        deps = &dependencies[resource];
-        for (dep = deps->begin(); dep != deps->end(); dep++) {
-            deps_set = resolve(*dep);
-            for (call = deps_set.begin(); call != deps_set.end(); call++) {
-                result.insert(*call);
+    for (size_t i = 0; i < reachable.size(); ++i) {
+        const std::vector<ResourceId> &deps = dependencies[reachable[i]];
+        for (ResourceId dep : deps) {
+            if (visitMarks[dep] != visitMark) {
+                visitMarks[dep] = visitMark;
+                reachable.push_back(dep);
             }
         }
     }
 
-    /* Also look for calls that directly provide 'resource' */
-    if (resources.count(resource)) {
-        calls = &resources[resource];
-        for (call = calls->begin(); call != calls->end(); call++) {
-            result.insert(*call);
-        }
-    }
-
-    return result;
+    return reachable;
 }
 
 /* Consume: Resolve all calls that provide the given resource, and
  * add them to the required list. Then clear the call list for
  * 'resource' along with any dependencies. */
 void
-TraceAnalyzer::consume(std::string resource)
+TraceAnalyzer::consume(ResourceId resource)
 {
+    if (resource < accumulations.size()) {
+        Accumulation &accumulation = accumulations[resource];
+        for (ResourceId id : accumulation.sources) {
+            materialize(resource, id);
+        }
+    }
 
-    std::set<unsigned> calls;
-    std::set<unsigned>::iterator call;
-
-    calls = resolve(resource);
-
-    dependencies.erase(resource);
-    resources.erase(resource);
+    const std::vector<ResourceId> &ids = resolve(resource);
 
-    for (call = calls.begin(); call != calls.end(); call++) {
-        required.add(*call);
+    for (ResourceId id : ids) {
+        resources[id].forEach(0, resources[id].size(), [this](const CallRange *runs, size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                required.add(runs[i].first, runs[i].second);
+            }
+        });
     }
+
+    unlinkAll(resource);
+    erase(resource);
 }
 
 void
@@ -253,8 +491,8 @@ TraceAnalyzer::stateTrackPostCall(trace::Call *call)
      * next frame. */
     if (call->flags & trace::CALL_FLAG_SWAP_RENDERTARGET &&
         call->flags & trace::CALL_FLAG_END_FRAME) {
-        dependencies.erase("framebuffer");
-        resources.erase("framebuffer");
+        unlinkAll(framebufferId);
+        erase(framebufferId);
         return;
     }
 
@@ -286,7 +524,7 @@ TraceAnalyzer::recordTextureSideEffects(trace::Call *call, const char *name)
         if (textures) {
             for (i = 0; i < textures->size(); i++) {
                 texture = textures->values[i]->toUInt();
-                providef("texture-", texture, call->no);
+                provide(this->texture(texture), call->no);
             }
         }
         return true;
@@ -301,28 +539,26 @@ TraceAnalyzer::recordTextureSideEffects(trace::Call *call, const char *name)
 
         texture = call->arg(3).toUInt();
 
-        linkf("render-state", "texture-", texture);
+        link(renderStateId, this->texture(texture));
 
-        provide("state", call->no);
+        provide(stateId, call->no);
     }
 
     if (strcmp(name, "glBindTexture") == 0) {
         GLenum target;
         GLuint texture;
 
-        std::stringstream ss_target, ss_texture;
-
         target = static_cast<GLenum>(call->arg(0).toSInt());
         texture = call->arg(1).toUInt();
 
-        ss_target << "texture-unit-" << activeTextureUnit << "-target-" << target;
-        ss_texture << "texture-" << texture;
+        ResourceId unit_target = textureUnitTarget(activeTextureUnit, target);
+        ResourceId bound = this->texture(texture);
 
-        resources.erase(ss_target.str());
-        provide(ss_target.str(), call->no);
+        erase(unit_target);
+        provide(unit_target, call->no);
 
-        unlinkAll(ss_target.str());
-        link(ss_target.str(), ss_texture.str());
+        unlinkAll(unit_target);
+        link(unit_target, bound);
 
         /* FIXME: This really shouldn't be necessary. The effect
          * this provide() has is that all glBindTexture calls will
@@ -336,7 +572,7 @@ TraceAnalyzer::recordTextureSideEffects(trace::Call *call, const char *name)
          *
          * More investigation is necessary, but for now, be
          * conservative and don't trim. */
-        provide("state", call->no);
+        provide(stateId, call->no);
 
         return true;
     }
@@ -351,25 +587,17 @@ TraceAnalyzer::recordTextureSideEffects(trace::Call *call, const char *name)
         strcmp(name, "glInvalidateTexImage") == 0 ||
         strcmp(name, "glInvalidateTexSubImage") == 0) {
 
-        std::set<unsigned> *calls;
-        std::set<unsigned>::iterator c;
-        std::stringstream ss_target, ss_texture;
-
         GLenum target = static_cast<GLenum>(call->arg(0).toSInt());
 
-        ss_target << "texture-unit-" << activeTextureUnit << "-target-" << target;
-        ss_texture << "texture-" << texture_map[target];
+        std::map<GLenum, unsigned>::const_iterator bound = texture_map.find(target);
+        ResourceId unit_target = textureUnitTarget(activeTextureUnit, target);
+        ResourceId texture = this->texture(bound == texture_map.end() ? 0 : bound->second);
 
         /* The texture resource depends on this call and any calls
          * providing the given texture target. */
-        provide(ss_texture.str(), call->no);
-
-        if (resources.count(ss_target.str())) {
-            calls = &resources[ss_target.str()];
-            for (c = calls->begin(); c != calls->end(); c++) {
-                provide(ss_texture.str(), *c);
-            }
-        }
+        flush(texture);
+        resources[texture].add(resources[unit_target]);
+        provide(texture, call->no);
 
         return true;
     }
@@ -384,14 +612,10 @@ TraceAnalyzer::recordTextureSideEffects(trace::Call *call, const char *name)
             cap == GL_TEXTURE_3D ||
             cap == GL_TEXTURE_CUBE_MAP)
         {
-            std::stringstream ss;
-
-            ss << "texture-unit-" << activeTextureUnit << "-target-" << cap;
-
-            link("render-state", ss.str());
+            link(renderStateId, textureUnitTarget(activeTextureUnit, cap));
         }
 
-        provide("state", call->no);
+        provide(stateId, call->no);
         return true;
     }
 
@@ -405,14 +629,10 @@ TraceAnalyzer::recordTextureSideEffects(trace::Call *call, const char *name)
             cap == GL_TEXTURE_3D ||
             cap == GL_TEXTURE_CUBE_MAP)
         {
-            std::stringstream ss;
-
-            ss << "texture-unit-" << activeTextureUnit << "-target-" << cap;
-
-            unlink("render-state", ss.str());
+            unlink(renderStateId, textureUnitTarget(activeTextureUnit, cap));
         }
 
-        provide("state", call->no);
+        provide(stateId, call->no);
         return true;
     }
 
@@ -427,7 +647,7 @@ TraceAnalyzer::recordShaderSideEffects(trace::Call *call, const char *name)
         strcmp(name, "glCreateShaderObjectARB") == 0) {
 
         GLuint shader = call->ret->toUInt();
-        providef("shader-", shader, call->no);
+        provide(this->shader(shader), call->no);
         return true;
     }
 
@@ -439,7 +659,7 @@ TraceAnalyzer::recordShaderSideEffects(trace::Call *call, const char *name)
         strcmp(name, "glGetShaderInfoLog") == 0) {
 
         GLuint shader = call->arg(0).toUInt();
-        providef("shader-", shader, call->no);
+        provide(this->shader(shader), call->no);
         return true;
     }
 
@@ -447,7 +667,7 @@ TraceAnalyzer::recordShaderSideEffects(trace::Call *call, const char *name)
         strcmp(name, "glCreateProgramObjectARB") == 0) {
 
         GLuint program = call->ret->toUInt();
-        providef("program-", program, call->no);
+        provide(this->program(program), call->no);
         return true;
     }
 
@@ -455,16 +675,12 @@ TraceAnalyzer::recordShaderSideEffects(trace::Call *call, const char *name)
         strcmp(name, "glAttachObjectARB") == 0) {
 
         GLuint program, shader;
-        std::stringstream ss_program, ss_shader;
 
         program = call->arg(0).toUInt();
         shader = call->arg(1).toUInt();
 
-        ss_program << "program-" << program;
-        ss_shader << "shader-" << shader;
-
-        link(ss_program.str(), ss_shader.str());
-        provide(ss_program.str(), call->no);
+        link(this->program(program), this->shader(shader));
+        provide(this->program(program), call->no);
 
         return true;
     }
@@ -473,15 +689,11 @@ TraceAnalyzer::recordShaderSideEffects(trace::Call *call, const char *name)
         strcmp(name, "glDetachObjectARB") == 0) {
 
         GLuint program, shader;
-        std::stringstream ss_program, ss_shader;
 
         program = call->arg(0).toUInt();
         shader = call->arg(1).toUInt();
 
-        ss_program << "program-" << program;
-        ss_shader << "shader-" << shader;
-
-        unlink(ss_program.str(), ss_shader.str());
+        unlink(this->program(program), this->shader(shader));
 
         return true;
     }
@@ -493,20 +705,16 @@ TraceAnalyzer::recordShaderSideEffects(trace::Call *call, const char *name)
 
         program = call->arg(0).toUInt();
 
-        unlinkAll("render-program-state");
+        unlinkAll(renderProgramStateId);
 
         if (program == 0) {
-            unlink("render-state", "render-program-state");
-            provide("state", call->no);
+            unlink(renderStateId, renderProgramStateId);
+            provide(stateId, call->no);
         } else {
-            std::stringstream ss;
+            link(renderStateId, renderProgramStateId);
+            link(renderProgramStateId, this->program(program));
 
-            ss << "program-" << program;
-
-            link("render-state", "render-program-state");
-            link("render-program-state", ss.str());
-
-            provide(ss.str(), call->no);
+            provide(this->program(program), call->no);
         }
 
         return true;
@@ -523,7 +731,7 @@ TraceAnalyzer::recordShaderSideEffects(trace::Call *call, const char *name)
 
         GLuint program = call->arg(0).toUInt();
 
-        providef("program-", program, call->no);
+        provide(this->program(program), call->no);
 
         return true;
     }
@@ -534,7 +742,7 @@ TraceAnalyzer::recordShaderSideEffects(trace::Call *call, const char *name)
     if (call->sig->num_args > 0 &&
         strcmp(call->sig->arg_names[0], "location") == 0) {
 
-        providef("program-", activeProgram, call->no);
+        provide(program(activeProgram), call->no);
 
         /* We can't easily tell if this uniform is being used to
          * associate a sampler in the shader with a texture
@@ -550,23 +758,19 @@ TraceAnalyzer::recordShaderSideEffects(trace::Call *call, const char *name)
             GLint max_unit = MAX(GL_MAX_TEXTURE_COORDS, GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS);
 
             GLint unit = call->arg(1).toSInt();
-            std::stringstream ss_program;
-            std::stringstream ss_texture;
 
             if (unit < max_unit) {
-
-                ss_program << "program-" << activeProgram;
-
-                ss_texture << "texture-unit-" << GL_TEXTURE0 + unit << "-target-";
+                ResourceId program = this->program(activeProgram);
+                GLenum texture_unit = GL_TEXTURE0 + unit;
 
                 /* We don't know what target(s) might get bound to
                  * this texture unit, so conservatively link to
                  * all. Only bound textures will actually get inserted
                  * into the output call stream. */
-                linkf(ss_program.str(), ss_texture.str(), GL_TEXTURE_1D);
-                linkf(ss_program.str(), ss_texture.str(), GL_TEXTURE_2D);
-                linkf(ss_program.str(), ss_texture.str(), GL_TEXTURE_3D);
-                linkf(ss_program.str(), ss_texture.str(), GL_TEXTURE_CUBE_MAP);
+                link(program, textureUnitTarget(texture_unit, GL_TEXTURE_1D));
+                link(program, textureUnitTarget(texture_unit, GL_TEXTURE_2D));
+                link(program, textureUnitTarget(texture_unit, GL_TEXTURE_3D));
+                link(program, textureUnitTarget(texture_unit, GL_TEXTURE_CUBE_MAP));
             }
         }
 
@@ -589,7 +793,7 @@ TraceAnalyzer::recordShaderSideEffects(trace::Call *call, const char *name)
           strcmp(call->sig->arg_names[0], "programObj") == 0))) {
 
         GLuint program = call->arg(0).toUInt();
-        providef("program-", program, call->no);
+        provide(this->program(program), call->no);
         return true;
     }
 
@@ -606,24 +810,14 @@ TraceAnalyzer::recordDrawingSideEffects(trace::Call *call, const char *name)
     if (call->flags & trace::CALL_FLAG_RENDER ||
         insideBeginEnd) {
 
-        std::set<unsigned> calls;
-        std::set<unsigned>::iterator c;
-
-        provide("framebuffer", call->no);
-
-        calls = resolve("render-state");
-
-        for (c = calls.begin(); c != calls.end(); c++) {
-            provide("framebuffer", *c);
-        }
+        provide(framebufferId, call->no);
+        accumulate(framebufferId, renderStateId);
 
         /* In some cases, rendering has side effects beyond the
          * framebuffer update. */
         if (renderingHasSideEffect()) {
-            provide("state", call->no);
-            for (c = calls.begin(); c != calls.end(); c++) {
-                provide("state", *c);
-            }
+            provide(stateId, call->no);
+            accumulate(stateId, renderStateId);
         }
 
         return true;
@@ -656,14 +850,14 @@ TraceAnalyzer::recordSideEffects(trace::Call *call)
      * lists will work, but does not trim out unused display
      * lists. */
     if (insideNewEndList != 0) {
-        provide("state", call->no);
+        provide(stateId, call->no);
 
         /* Also, any texture bound inside a display list is
          * conservatively considered required. */
         if (strcmp(name, "glBindTexture") == 0) {
             GLuint texture = call->arg(1).toUInt();
 
-            linkf("state", "texture-", texture);
+            link(stateId, this->texture(texture));
         }
 
         return;
@@ -698,7 +892,7 @@ TraceAnalyzer::recordSideEffects(trace::Call *call)
     }
 
     /* By default, assume this call affects the state somehow. */
-    resources["state"].insert(call->no);
+    provide(stateId, call->no);
 }
 
 void
@@ -708,27 +902,52 @@ TraceAnalyzer::requireDependencies(trace::Call *call)
     /* Swap-buffers calls depend on framebuffer state. */
     if (call->flags & trace::CALL_FLAG_SWAP_RENDERTARGET &&
         call->flags & trace::CALL_FLAG_END_FRAME) {
-        consume("framebuffer");
+        consume(framebufferId);
     }
 
     /* By default, just assume this call depends on generic state. */
-    consume("state");
+    consume(stateId);
 }
 
 TraceAnalyzer::TraceAnalyzer(TrimFlags trimFlagsOpt):
+    visitMark(0),
     transformFeedbackActive(false),
     framebufferObjectActive(false),
     insideBeginEnd(false),
     insideNewEndList(0),
     activeTextureUnit(GL_TEXTURE0),
-    trimFlags(trimFlagsOpt)
+    activeProgram(0),
+    trimFlags(trimFlagsOpt),
+    spill(NULL)
 {
-    /* Nothing needed. */
+    stateId = intern(RESOURCE_STATE);
+    framebufferId = intern(RESOURCE_FRAMEBUFFER);
+    renderStateId = intern(RESOURCE_RENDER_STATE);
+    renderProgramStateId = intern(RESOURCE_RENDER_PROGRAM_STATE);
 }
 
 TraceAnalyzer::~TraceAnalyzer()
 {
-    /* Nothing needed. */
+    delete spill;
+}
+
+bool
+TraceAnalyzer::spillToDisk(void)
+{
+    assert(!spill);
+
+    spill = new CallRangeSpill;
+    if (!spill->open()) {
+        delete spill;
+        spill = NULL;
+        return false;
+    }
+
+    for (CallRanges &calls : resources) {
+        calls = CallRanges(spill);
+    }
+
+    return true;
 }
 
 /* Analyze this call by tracking state and recording all the
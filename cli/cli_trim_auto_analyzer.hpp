@@ -23,7 +23,14 @@
  *
  **************************************************************************/
 
-#include <set>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <GL/gl.h>
 #include <GL/glext.h>
@@ -52,10 +59,138 @@ enum {
     TRIM_FLAG_DRAWING			= (1 << 3),
 };
 
+typedef std::pair<trace::CallNo, trace::CallNo> CallRange;
+
+/* Temporary file where call runs are spilled to, for out-of-core
+ * analysis. */
+class CallRangeSpill {
+private:
+    FILE *file;
+    uint64_t end;
+
+public:
+    CallRangeSpill() : file(NULL), end(0) {}
+    ~CallRangeSpill();
+
+    bool open(void);
+
+    /* Append runs to the file, returning their offset. */
+    uint64_t write(const CallRange *ranges, size_t count);
+    void read(uint64_t offset, CallRange *ranges, size_t count);
+};
+
+/* Set of call numbers, kept as sorted, disjoint runs of consecutive
+ * calls.
+ *
+ * When given a spill file, all but the last run are written out
+ * whenever too many accumulate in memory.  Spilled runs are sorted
+ * within each segment, but may overlap later ones; the set is their
+ * union.  Run indices are stable as long as calls are only appended. */
+class CallRanges {
+private:
+    struct Segment {
+        uint64_t offset;
+        size_t count;
+    };
+
+    std::vector<CallRange> ranges;
+    std::vector<Segment> segments;
+    size_t spilled;
+    CallRangeSpill *spill;
+
+    void merge(const CallRange *runs, size_t count);
+    void spillRuns(void);
+
+public:
+    CallRanges(CallRangeSpill *spill = NULL) : spilled(0), spill(spill) {}
+
+    void add(trace::CallNo call_no) { add(CallRange(call_no, call_no)); }
+    void add(const CallRange &range);
+
+    /* Add the runs of 'other' with index in [first, last). */
+    void add(const CallRanges &other, size_t first = 0, size_t last = ~(size_t)0);
+
+    void clear(void);
+
+    bool empty(void) const { return spilled == 0 && ranges.empty(); }
+    size_t size(void) const { return spilled + ranges.size(); }
+
+    /* The last run, which is always kept in memory. */
+    const CallRange &back(void) const { return ranges.back(); }
+
+    /* Call f(runs, count) over consecutive chunks of the runs with
+     * index in [first, last). */
+    template<class F>
+    void
+    forEach(size_t first, size_t last, F f) const {
+        std::vector<CallRange> buffer;
+        size_t index = 0;
+        last = std::min(last, size());
+        for (const Segment &segment : segments) {
+            size_t lo = std::max(first, index);
+            size_t hi = std::min(last, index + segment.count);
+            if (lo < hi) {
+                buffer.resize(hi - lo);
+                spill->read(segment.offset + (lo - index) * sizeof(CallRange), &buffer[0], hi - lo);
+                f(&buffer[0], hi - lo);
+            }
+            index += segment.count;
+        }
+        size_t lo = std::max(first, spilled);
+        if (lo < last) {
+            f(&ranges[lo - spilled], last - lo);
+        }
+    }
+};
+
 class TraceAnalyzer {
 private:
-    std::map<std::string, std::set<unsigned> > resources;
-    std::map<std::string, std::set<std::string> > dependencies;
+    /* Resources are interned into dense ids, which index the vectors
+     * below. */
+    typedef unsigned ResourceId;
+
+    enum ResourceKind {
+        RESOURCE_STATE,
+        RESOURCE_FRAMEBUFFER,
+        RESOURCE_RENDER_STATE,
+        RESOURCE_RENDER_PROGRAM_STATE,
+        RESOURCE_TEXTURE,
+        RESOURCE_TEXTURE_UNIT_TARGET,
+        RESOURCE_SHADER,
+        RESOURCE_PROGRAM,
+    };
+
+    std::unordered_map<uint64_t, ResourceId> resourceIds;
+
+    /* Calls directly providing each resource. */
+    std::vector<CallRanges> resources;
+
+    /* Resources each resource is linked to. */
+    std::vector<std::vector<ResourceId> > dependencies;
+
+    /* For resources that accumulate the resolved calls of others
+     * (framebuffer and state), how many runs of each source have been
+     * seen, and where the last of them ended. */
+    struct Snapshot {
+        size_t size;
+        CallRange last;
+        bool listed;
+    };
+    struct Accumulation {
+        std::vector<Snapshot> seen;
+        std::vector<ResourceId> sources;
+    };
+    std::vector<Accumulation> accumulations;
+
+    ResourceId stateId;
+    ResourceId framebufferId;
+    ResourceId renderStateId;
+    ResourceId renderProgramStateId;
+
+    /* Scratch space for resolve(). */
+    std::vector<unsigned> visitMarks;
+    unsigned visitMark;
+    std::vector<ResourceId> reachable;
 
     std::map<GLenum, unsigned> texture_map;
 
@@ -69,15 +204,23 @@ private:
     GLuint activeProgram;
     unsigned int trimFlags;
 
-    void provide(std::string resource, trace::CallNo call_no);
-    void providef(std::string resource, int resource_no, trace::CallNo call_no);
+    CallRangeSpill *spill;
 
-    void link(std::string resource, std::string dependency);
-    void linkf(std::string resource, std::string dependency, int dep_no);
+    ResourceId intern(ResourceKind kind, unsigned a = 0, unsigned b = 0);
+    ResourceId texture(GLuint texture) { return intern(RESOURCE_TEXTURE, texture); }
+    ResourceId textureUnitTarget(GLenum unit, GLenum target) { return intern(RESOURCE_TEXTURE_UNIT_TARGET, unit, target); }
+    ResourceId shader(GLuint shader) { return intern(RESOURCE_SHADER, shader); }
+    ResourceId program(GLuint program) { return intern(RESOURCE_PROGRAM, program); }
 
-    void unlink(std::string resource, std::string dependency);
-    void unlinkf(std::string resource, std::string dependency, int dep_no);
-    void unlinkAll(std::string resource);
+    void provide(ResourceId resource, trace::CallNo call_no);
+    void accumulate(ResourceId resource, ResourceId source);
+    void materialize(ResourceId resource, ResourceId source);
+    void flush(ResourceId resource);
+    void erase(ResourceId resource);
+
+    void link(ResourceId resource, ResourceId dependency);
+    void unlink(ResourceId resource, ResourceId dependency);
+    void unlinkAll(ResourceId resource);
 
     void stateTrackPreCall(trace::Call *call);
 
@@ -90,15 +233,21 @@ private:
     void stateTrackPostCall(trace::Call *call);
 
     bool renderingHasSideEffect(void);
-    std::set<unsigned> resolve(std::string resource);
+    const std::vector<ResourceId> &resolve(ResourceId resource);
 
-    void consume(std::string resource);
+    void consume(ResourceId resource);
     void requireDependencies(trace::Call *call);
 
 public:
     TraceAnalyzer(TrimFlags trimFlags = -1);
     ~TraceAnalyzer();
 
+    /* Keep the calls providing each resource in a temporary file
+     * rather than in memory, so that memory use is bounded by the
+     * number of resources instead of the length of the trace. Must be
+     * called before analyzing any call. */
+    bool spillToDisk(void);
+
     /* Analyze this call by tracking state and recording all the
      * resources provided by this call as side effects.. */
     void analyze(trace::Call *call);
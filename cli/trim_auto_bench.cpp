@@ -0,0 +1,278 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Measure how fast TraceAnalyzer (i.e. `apitrace trim-auto`) processes a
+ * synthetic trace, and how much memory it needs.
+ *
+ * Usage: trim_auto_bench [-f FRAMES] [-d DRAWS] [-t TEXTURES] [-p PROGRAMS]
+ *                        [-o OUT_OF_CORE]
+ *
+ * The synthetic trace creates TEXTURES textures and PROGRAMS programs up
+ * front, then renders FRAMES frames of DRAWS draws each, binding random
+ * programs and textures, and occasionally updating textures.  The last frame
+ * is required, as `apitrace trim-auto --frames=FRAMES-1` would do.  With
+ * "-o 1" the analyzer spills to disk, as with `trim-auto --out-of-core`.
+ */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include <chrono>
+#include <iostream>
+
+#include "cli_trim_auto_analyzer.hpp"
+
+
+static const char *argNames[] = {"arg0", "arg1", "arg2", "arg3"};
+static const char *locationArgNames[] = {"location", "v0"};
+
+
+/*
+ * Synthesizes calls one at a time, just like the parser would.
+ */
+class TraceSynthesizer
+{
+    enum {
+        GEN_TEXTURES,
+        BIND_TEXTURE,
+        TEX_IMAGE_2D,
+        TEX_SUB_IMAGE_2D,
+        ACTIVE_TEXTURE,
+        CREATE_SHADER,
+        SHADER_SOURCE,
+        COMPILE_SHADER,
+        CREATE_PROGRAM,
+        ATTACH_SHADER,
+        LINK_PROGRAM,
+        USE_PROGRAM,
+        UNIFORM_1I,
+        ENABLE,
+        VIEWPORT,
+        DRAW_ARRAYS,
+        SWAP_BUFFERS,
+        NUM_SIGS
+    };
+
+    trace::FunctionSig sigs[NUM_SIGS];
+    trace::CallFlags flags[NUM_SIGS];
+
+    unsigned callNo = 0;
+    uint32_t seed = 1;
+
+    void
+    sig(unsigned id, const char *name, unsigned numArgs, const char **names = argNames) {
+        sigs[id].id = id;
+        sigs[id].name = name;
+        sigs[id].num_args = numArgs;
+        sigs[id].arg_names = names;
+        flags[id] = trace::Parser::lookupCallFlags(name);
+    }
+
+    unsigned
+    random(unsigned n) {
+        seed = seed * 1103515245 + 12345;
+        return (seed >> 8) % n;
+    }
+
+    trace::Call *
+    call(unsigned id, unsigned long long arg0 = 0, unsigned long long arg1 = 0) {
+        trace::Call *call = new trace::Call(&sigs[id], flags[id], 0);
+        call->no = callNo++;
+        for (unsigned i = 0; i < call->args.size(); ++i) {
+            call->args[i].value = new trace::UInt(i == 0 ? arg0 : i == 1 ? arg1 : 0);
+        }
+        return call;
+    }
+
+public:
+    unsigned numTextures = 1000;
+    unsigned numPrograms = 100;
+    unsigned drawsPerFrame = 1000;
+
+    TraceSynthesizer() {
+        sig(GEN_TEXTURES, "glGenTextures", 2);
+        sig(BIND_TEXTURE, "glBindTexture", 2);
+        sig(TEX_IMAGE_2D, "glTexImage2D", 4);
+        sig(TEX_SUB_IMAGE_2D, "glTexSubImage2D", 4);
+        sig(ACTIVE_TEXTURE, "glActiveTexture", 1);
+        sig(CREATE_SHADER, "glCreateShader", 1);
+        sig(SHADER_SOURCE, "glShaderSource", 4);
+        sig(COMPILE_SHADER, "glCompileShader", 1);
+        sig(CREATE_PROGRAM, "glCreateProgram", 0);
+        sig(ATTACH_SHADER, "glAttachShader", 2);
+        sig(LINK_PROGRAM, "glLinkProgram", 1);
+        sig(USE_PROGRAM, "glUseProgram", 1);
+        sig(UNIFORM_1I, "glUniform1i", 2, locationArgNames);
+        sig(ENABLE, "glEnable", 1);
+        sig(VIEWPORT, "glViewport", 4);
+        sig(DRAW_ARRAYS, "glDrawArrays", 3);
+        sig(SWAP_BUFFERS, "glXSwapBuffers", 2);
+    }
+
+    /* Calls creating all textures and programs. */
+    template<class F>
+    void
+    setup(F f) {
+        for (unsigned t = 1; t <= numTextures; ++t) {
+            trace::Call *gen = call(GEN_TEXTURES, 1);
+            trace::Array *textures = new trace::Array(1);
+            textures->values[0] = new trace::UInt(t);
+            delete gen->args[1].value;
+            gen->args[1].value = textures;
+            f(gen);
+            f(call(BIND_TEXTURE, GL_TEXTURE_2D, t));
+            f(call(TEX_IMAGE_2D, GL_TEXTURE_2D));
+        }
+        for (unsigned p = 1; p <= numPrograms; ++p) {
+            unsigned program = 1000000 + p;
+            trace::Call *create = call(CREATE_PROGRAM);
+            create->ret = new trace::UInt(program);
+            f(create);
+            for (unsigned s = 0; s < 2; ++s) {
+                unsigned shader = 2 * p + s;
+                trace::Call *createShader = call(CREATE_SHADER, GL_VERTEX_SHADER + s);
+                createShader->ret = new trace::UInt(shader);
+                f(createShader);
+                f(call(SHADER_SOURCE, shader));
+                f(call(COMPILE_SHADER, shader));
+                f(call(ATTACH_SHADER, program, shader));
+            }
+            f(call(LINK_PROGRAM, program));
+        }
+    }
+
+    /* Calls rendering one frame. */
+    template<class F>
+    void
+    frame(F f) {
+        f(call(VIEWPORT));
+        f(call(ENABLE, GL_TEXTURE_2D));
+        for (unsigned d = 0; d < drawsPerFrame; ++d) {
+            if (random(4) == 0) {
+                f(call(USE_PROGRAM, 1000001 + random(numPrograms)));
+                f(call(UNIFORM_1I, 0, random(4)));
+            }
+            unsigned unit = random(4);
+            f(call(ACTIVE_TEXTURE, GL_TEXTURE0 + unit));
+            unsigned texture = 1 + random(numTextures);
+            f(call(BIND_TEXTURE, GL_TEXTURE_2D, texture));
+            if (random(16) == 0) {
+                f(call(TEX_SUB_IMAGE_2D, GL_TEXTURE_2D));
+            }
+            f(call(DRAW_ARRAYS, GL_TRIANGLES, 0));
+        }
+        f(call(SWAP_BUFFERS));
+    }
+
+    unsigned
+    numCalls(void) const {
+        return callNo;
+    }
+};
+
+
+int
+main(int argc, char **argv)
+{
+    unsigned numFrames = 100;
+    bool outOfCore = false;
+    TraceSynthesizer synth;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        unsigned value = atoi(argv[i + 1]);
+        if (strcmp(argv[i], "-f") == 0) {
+            numFrames = value;
+        } else if (strcmp(argv[i], "-d") == 0) {
+            synth.drawsPerFrame = value;
+        } else if (strcmp(argv[i], "-t") == 0) {
+            synth.numTextures = value;
+        } else if (strcmp(argv[i], "-p") == 0) {
+            synth.numPrograms = value;
+        } else if (strcmp(argv[i], "-o") == 0) {
+            outOfCore = value != 0;
+        } else {
+            std::cerr << "usage: trim_auto_bench [-f FRAMES] [-d DRAWS] [-t TEXTURES] [-p PROGRAMS] [-o OUT_OF_CORE]\n";
+            return 1;
+        }
+    }
+
+    TraceAnalyzer analyzer(-1);
+    if (outOfCore && !analyzer.spillToDisk()) {
+        std::cerr << "error: failed to create temporary file\n";
+        return 1;
+    }
+    unsigned frame = 0;
+
+    auto analyze = [&](trace::Call *call) {
+        if (frame + 1 == numFrames) {
+            analyzer.require(call);
+        }
+        analyzer.analyze(call);
+        delete call;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+
+    synth.setup(analyze);
+    for (frame = 0; frame < numFrames; ++frame) {
+        synth.frame(analyze);
+    }
+
+    trace::FastCallSet *required = analyzer.get_required();
+    unsigned numRequired = 0;
+    uint32_t checksum = 2166136261u;
+    for (unsigned no = 0; no < synth.numCalls(); ++no) {
+        if (required->contains(no)) {
+            ++numRequired;
+            checksum = (checksum ^ no) * 16777619u;
+        }
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+
+    char line[256];
+    snprintf(line, sizeof line,
+             "%u calls in %.3f s (%.0f calls/s), %u required (checksum %08x)\n",
+             synth.numCalls(), seconds, synth.numCalls() / seconds,
+             numRequired, checksum);
+    std::cout << line;
+
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        std::cout << "peak RSS " << usage.ru_maxrss / 1024 << " MB\n";
+    }
+#endif
+
+    return 0;
+}
@@ -116,13 +116,15 @@ ApiSurface::imageFromData(const QByteArray &dataArray)
     image::Image *image;
 
     /*
-     * Detect the PNG vs PFM images.
+     * Detect the PNG vs QOI vs PFM images.
      */
     const char pngSignature[] = {(char)0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A, 0};
     if (dataArray.startsWith(pngSignature)) {
         ByteArrayBuf buf(dataArray);
         std::istream istr(&buf);
         image = image::readPNG(istr);
+    } else if (dataArray.startsWith("qoif")) {
+        image = image::readQOI(dataArray.data(), dataArray.size());
     } else {
         image = image::readPNM(dataArray.data(), dataArray.size());
     }
@@ -3,6 +3,7 @@
 #include "apitrace.h"
 #include "traceloader.h"
 #include "trace_model.hpp"
+#include "os_shm.hpp"
 
 #include <QDebug>
 #include <QLocale>
@@ -436,6 +437,26 @@ ApiTraceState::ApiTraceState()
 {
 }
 
+/*
+ * Image data is either inline, or left by the retracer in a shared memory
+ * segment, which Retracer::run removes afterwards.
+ */
+static QByteArray getImageData(QVariantMap const &image)
+{
+    QVariantMap::const_iterator shmItr = image.find(QLatin1String("__shm__"));
+    if (shmItr != image.constEnd()) {
+        os::SharedMemory shm;
+        QByteArray name = shmItr.value().toString().toLocal8Bit();
+        if (!shm.open(name.constData())) {
+            qDebug() << "error: failed to map image" << name;
+            return QByteArray();
+        }
+        return QByteArray((const char *)shm.data(), int(shm.size()));
+    }
+
+    return image[QLatin1String("__data__")].toByteArray();
+}
+
 static ApiTexture getTextureFrom(QVariantMap const &image, QString label)
 {
     QSize size(image[QLatin1String("__width__")].toInt(),
@@ -446,8 +467,7 @@ static ApiTexture getTextureFrom(QVariantMap const &image, QString label)
     QString formatName =
         image[QLatin1String("__format__")].toString();
 
-    QByteArray dataArray =
-        image[QLatin1String("__data__")].toByteArray();
+    QByteArray dataArray = getImageData(image);
 
     QString userLabel =
         image[QLatin1String("__label__")].toString();
@@ -504,8 +524,7 @@ ApiTraceState::ApiTraceState(const QVariantMap &parsedJson)
         int depth = buffer[QLatin1String("__depth__")].toInt();
         QString formatName = buffer[QLatin1String("__format__")].toString();
 
-        QByteArray dataArray =
-            buffer[QLatin1String("__data__")].toByteArray();
+        QByteArray dataArray = getImageData(buffer);
 
         QString label = itr.key();
         QString userLabel =
@@ -95,7 +95,7 @@ public:
             }
 
             if (rightStep - leftStep > 1) {
-                m_label = QString::fromStdString(call->name);
+                m_label = QString::fromStdString(m_profile->name(*call));
                 m_step = left;
                 m_stepWidth = rightStep - leftStep;
                 heatDuration = dtds;
@@ -413,7 +413,7 @@ public:
         const trace::Profile::Call& call = m_profile->calls[index];
 
         QString text;
-        text  = QString::fromStdString(call.name);
+        text  = QString::fromStdString(m_profile->name(call));
 
         text += QString("\nCall: %1").arg(call.no);
         text += QString("\nCPU Start: %1").arg(Profiling::getTimeString(call.cpuStart, 1e3));
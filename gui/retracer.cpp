@@ -4,14 +4,20 @@
 #include "thumbnail.h"
 
 #include "image.hpp"
+#include "os_shm.hpp"
 
 #include "trace_profiler.hpp"
 
+#include <QAtomicInt>
+#include <QCoreApplication>
 #include <QDebug>
 #include <QVariant>
 #include <QList>
 #include <QImage>
 
+#include <stdio.h>
+#include <string.h>
+
 #include "qubjson.h"
 
 
@@ -346,6 +352,9 @@ QStringList Retracer::retraceArguments() const
         if (m_profileMemory) {
             arguments << QLatin1String("--pmem");
         }
+
+        arguments << QLatin1String("--profile-format");
+        arguments << QLatin1String("binary");
     } else {
         if (!m_doubleBuffered) {
             arguments << QLatin1String("--sb");
@@ -400,7 +409,23 @@ void Retracer::run()
         return;
     }
 
-    arguments << retraceArguments() << m_fileName;
+    arguments << retraceArguments();
+
+    // Images can be handed over through shared memory when local.  The
+    // segments are named after a prefix unique to this run, so that they
+    // can all be removed once the retrace is over.
+    QByteArray shmPrefix;
+    if (m_remoteTarget.length() == 0 &&
+        (m_captureState || m_captureThumbnails) &&
+        os::SharedMemory::supported()) {
+        static QAtomicInt runCount;
+        shmPrefix = "/qapitrace." +
+                    QByteArray::number(QCoreApplication::applicationPid()) + "." +
+                    QByteArray::number(runCount.fetchAndAddRelaxed(1));
+        arguments << QLatin1String("--shared-memory=") + QString::fromLatin1(shmPrefix);
+    }
+
+    arguments << m_fileName;
 
     /*
      * Support remote execution on a separate target.
@@ -454,6 +479,45 @@ void Retracer::run()
              */
 
             while (!io.atEnd()) {
+                char tag[4];
+                if (io.peek(tag, sizeof tag) == sizeof tag &&
+                    memcmp(tag, "SHM ", sizeof tag) == 0) {
+                    /*
+                     * Snapshot left in a shared memory segment.
+                     */
+
+                    QByteArray line = io.readLine();
+                    char name[256];
+                    unsigned width, height, channels;
+                    int number;
+                    if (sscanf(line.constData(), "SHM %255s %u %u %u %d",
+                               name, &width, &height, &channels, &number) != 5 ||
+                        (channels != 3 && channels != 4)) {
+                        qDebug() << "error: invalid snapshot stream encountered";
+                        break;
+                    }
+
+                    os::SharedMemory *shm = new os::SharedMemory;
+                    if (!shm->open(name) ||
+                        shm->size() < size_t(width) * height * channels) {
+                        qDebug() << "error: failed to map snapshot" << name;
+                        delete shm;
+                        continue;
+                    }
+
+                    // Wrap the mapping without copying; it is unmapped when
+                    // the last QImage referring to it goes away.
+                    QImage snapshot((const uchar *)shm->data(), width, height,
+                                    width * channels,
+                                    channels == 4 ? QImage::Format_RGBX8888 : QImage::Format_RGB888,
+                                    [](void *info) { delete static_cast<os::SharedMemory *>(info); },
+                                    shm);
+
+                    QImage thumb = thumbnail(snapshot);
+                    thumbnails.insert(number, thumb);
+                    continue;
+                }
+
                 image::PNMInfo info;
 
                 char header[512];
@@ -504,16 +568,46 @@ void Retracer::run()
         } else if (isProfiling()) {
             profile = new trace::Profile();
 
-            while (!io.atEnd()) {
-                char line[256];
-                qint64 lineLength;
+            char header[PROFILE_HEADER_SIZE];
+            qint64 headerSize = io.peek(header, sizeof header);
 
-                lineLength = io.readLine(line, 256);
+            if (headerSize == sizeof header &&
+                trace::BinaryProfileParser::checkHeader(header, headerSize)) {
+                /*
+                 * Parse binary profile chunks as they are streamed.
+                 */
 
-                if (lineLength == -1)
-                    break;
+                trace::BinaryProfileParser parser;
+                trace::ProfileBuilder builder(profile);
+                QByteArray chunk;
+
+                io.read(header, sizeof header);
 
-                trace::Profiler::parseLine(line, profile);
+                while (!io.atEnd()) {
+                    unsigned char sizeBuf[4];
+                    if (io.read((char *)sizeBuf, sizeof sizeBuf) != sizeof sizeBuf) {
+                        break;
+                    }
+
+                    chunk.resize(trace::BinaryProfileParser::chunkSize(sizeBuf));
+                    if (io.read(chunk.data(), chunk.size()) != chunk.size() ||
+                        !parser.parseChunk(chunk.constData(), chunk.size(), builder)) {
+                        qDebug() << "error: invalid profile stream encountered";
+                        break;
+                    }
+                }
+            } else {
+                while (!io.atEnd()) {
+                    char line[256];
+                    qint64 lineLength;
+
+                    lineLength = io.readLine(line, 256);
+
+                    if (lineLength == -1)
+                        break;
+
+                    trace::Profiler::parseLine(line, profile);
+                }
             }
         } else {
             QByteArray output;
@@ -583,6 +677,15 @@ void Retracer::run()
         emit retraceErrors(errors);
     }
 
+    /*
+     * Remove the shared memory segments, whether they were mapped above
+     * or left behind by an error or a crash.
+     */
+
+    if (!shmPrefix.isEmpty()) {
+        os::SharedMemory::sweep(shmPrefix.constData());
+    }
+
     emit finished(msg);
 }
 
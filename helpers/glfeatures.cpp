@@ -370,6 +370,12 @@ Features::load(const Profile & profile, const Extensions & ext)
 
         primitive_restart = profile.versionGreaterOrEqual(3, 1) ||
                             ext.has("GL_NV_primitive_restart");
+
+        map_buffer_range = profile.versionGreaterOrEqual(3, 0) ||
+                           ext.has("GL_ARB_map_buffer_range");
+
+        sync = profile.versionGreaterOrEqual(3, 2) ||
+               ext.has("GL_ARB_sync");
     } else {
         texture_3d = 1;
 
@@ -391,6 +397,12 @@ Features::load(const Profile & profile, const Extensions & ext)
         query_buffer_object = 0;
 
         primitive_restart = 0;
+
+        // GL_EXT_map_buffer_range requires different entry points
+        map_buffer_range = profile.versionGreaterOrEqual(3, 0);
+
+        // GL_APPLE_sync requires different entry points
+        sync = profile.versionGreaterOrEqual(3, 0);
     }
 }
 
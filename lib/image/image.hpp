@@ -114,12 +114,21 @@ public:
     void
     writeMD5(std::ostream &os) const;
 
+    void
+    writeXXH64(std::ostream &os) const;
+
     bool
     writePNG(std::ostream &os, bool strip_alpha = false) const;
 
     bool
     writePNG(const char *filename, bool strip_alpha = false) const;
 
+    bool
+    writeQOI(std::ostream &os, bool strip_alpha = false) const;
+
+    bool
+    writeQOI(const char *filename, bool strip_alpha = false) const;
+
     void
     writeRAW(std::ostream &os) const;
 
@@ -134,6 +143,60 @@ readPNG(std::istream &is);
 Image *
 readPNG(const char *filename);
 
+Image *
+readQOI(const char *buffer, size_t size);
+
+
+/*
+ * Differences between two images, as measured by compare().
+ */
+struct Difference
+{
+    // Channel samples compared
+    unsigned long long samples = 0;
+
+    // Sum of the squared differences of all samples
+    unsigned long long squareError = 0;
+
+    // Pixels whose difference is above the threshold
+    unsigned long long mismatches = 0;
+
+    // Largest difference of any sample
+    unsigned maxError = 0;
+
+    // Peak signal to noise ratio in dB, infinite for identical images
+    double
+    psnr(void) const;
+
+    // Bits of precision, as scripts/snapdiff.py measured it
+    double
+    precision(void) const;
+};
+
+/*
+ * Compare two 8-bit images of the same size, as RGB, or RGBA if alpha is
+ * set.  A pixel mismatches when the luminance of its color difference, or
+ * its alpha difference, is above the threshold.  Returns false if the images
+ * can't be compared.
+ */
+bool
+compare(const Image &ref, const Image &src, Difference &difference,
+        unsigned threshold = 0, bool alpha = false);
+
+/*
+ * Faded copy of src with the pixels differing by 255*fuzz or more from ref
+ * in red, or NULL if the images can't be compared.
+ */
+Image *
+highlightDifferences(const Image &ref, const Image &src,
+                     double fuzz = 0.05, bool alpha = false);
+
+/*
+ * Scale an 8-bit image down to fit in a size x size box.
+ */
+Image *
+thumbnail(const Image &image, unsigned size);
+
 
 struct PNMInfo
 {
@@ -0,0 +1,229 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Measure how many frames per second each snapshot format can be written at,
+ * and compared at.
+ *
+ * Usage: image_bench [-n ITERATIONS] [IMAGE.png ...]
+ *
+ * Without images, a synthetic 1920x1080 RGB frame is used.
+ */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include "image.hpp"
+
+
+using namespace image;
+
+
+/*
+ * Discard output, only counting bytes.
+ */
+class CountingBuf : public std::streambuf
+{
+public:
+    size_t count = 0;
+
+protected:
+    std::streamsize
+    xsputn(const char *s, std::streamsize n) override {
+        count += n;
+        return n;
+    }
+
+    int_type
+    overflow(int_type c) override {
+        ++count;
+        return c;
+    }
+};
+
+
+static Image *
+createImage(unsigned width, unsigned height)
+{
+    Image *image = new Image(width, height, 3, true);
+    unsigned char *p = image->pixels;
+    uint32_t seed = 1;
+    for (unsigned y = 0; y < height; ++y) {
+        for (unsigned x = 0; x < width; ++x) {
+            // Smooth shading with a bit of noise, akin to a rendered frame
+            seed = seed * 1103515245 + 12345;
+            unsigned noise = (seed >> 16) & 3;
+            p[0] = (x * 255 / width) + noise;
+            p[1] = (y * 255 / height);
+            p[2] = ((x / 64 + y / 64) & 1) ? 200 : 40;
+            p += 3;
+        }
+    }
+    return image;
+}
+
+
+enum Format {
+    FORMAT_PNG,
+    FORMAT_QOI,
+    FORMAT_MD5,
+    FORMAT_XXH64,
+    FORMAT_RAW,
+};
+
+static const char *formatNames[] = {
+    "PNG",
+    "QOI",
+    "MD5",
+    "XXH64",
+    "RGB",
+};
+
+
+static void
+writeImage(const Image &image, std::ostream &os, Format format)
+{
+    switch (format) {
+    case FORMAT_PNG:
+        image.writePNG(os, true);
+        break;
+    case FORMAT_QOI:
+        image.writeQOI(os, true);
+        break;
+    case FORMAT_MD5:
+        image.writeMD5(os);
+        break;
+    case FORMAT_XXH64:
+        image.writeXXH64(os);
+        break;
+    case FORMAT_RAW:
+        image.writeRAW(os);
+        break;
+    }
+}
+
+
+int
+main(int argc, char **argv)
+{
+    unsigned iterations = 20;
+    int i = 1;
+    if (i + 1 < argc && strcmp(argv[i], "-n") == 0) {
+        iterations = atoi(argv[i + 1]);
+        i += 2;
+    }
+
+    std::vector<std::unique_ptr<Image>> images;
+    for (; i < argc; ++i) {
+        Image *image = readPNG(argv[i]);
+        if (!image) {
+            std::cerr << "error: failed to read " << argv[i] << "\n";
+            return 1;
+        }
+        images.emplace_back(image);
+    }
+    if (images.empty()) {
+        images.emplace_back(createImage(1920, 1080));
+    }
+
+    size_t pixels = 0;
+    for (auto &image : images) {
+        pixels += image->width * image->height;
+    }
+
+    std::cout << "format     frames/s     MB/s  bytes/frame\n";
+    for (unsigned f = 0; f < sizeof formatNames / sizeof formatNames[0]; ++f) {
+        Format format = static_cast<Format>(f);
+
+        CountingBuf buf;
+        std::ostream os(&buf);
+
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned n = 0; n < iterations; ++n) {
+            for (auto &image : images) {
+                writeImage(*image, os, format);
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        double seconds = std::chrono::duration<double>(end - start).count();
+        double frames = double(iterations) * images.size();
+        double megabytes = frames / images.size() * pixels * 3 / (1024.0 * 1024.0);
+
+        char line[128];
+        snprintf(line, sizeof line, "%-8s %10.1f %8.1f %12.0f\n",
+                 formatNames[f],
+                 frames / seconds,
+                 megabytes / seconds,
+                 buf.count / frames);
+        std::cout << line;
+    }
+
+    // Compare each frame against a copy with every 97th byte nudged, as
+    // `apitrace diff-images` does
+    std::vector<std::unique_ptr<Image>> copies;
+    for (auto &image : images) {
+        Image *copy = new Image(image->width, image->height, image->channels, image->flipped);
+        size_t size = image->height * image->_stride();
+        memcpy(copy->pixels, image->pixels, size);
+        for (size_t j = 0; j < size; j += 97) {
+            copy->pixels[j] ^= 1;
+        }
+        copies.emplace_back(copy);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    unsigned long long mismatches = 0;
+    for (unsigned n = 0; n < iterations; ++n) {
+        for (size_t j = 0; j < images.size(); ++j) {
+            Difference difference;
+            compare(*images[j], *copies[j], difference, 12);
+            mismatches += difference.mismatches;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    double frames = double(iterations) * images.size();
+    double megabytes = frames / images.size() * pixels * 3 / (1024.0 * 1024.0);
+
+    char line[128];
+    snprintf(line, sizeof line, "%-8s %10.1f %8.1f\n",
+             "compare",
+             frames / seconds,
+             megabytes / seconds);
+    std::cout << line;
+
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,358 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Pixel comparison of snapshots, for `apitrace diff-images`.
+ */
+
+
+#include <assert.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "image.hpp"
+
+
+#if \
+    (defined(__i386__) && defined(__SSE2__)) /* gcc */ || \
+    defined(_M_IX86) /* msvc */ || \
+    defined(__x86_64__) /* gcc */ || \
+    defined(_M_X64) /* msvc */ || \
+    defined(_M_AMD64) /* msvc */
+
+#  define HAVE_SSE2
+
+#endif
+
+
+#ifdef HAVE_SSE2
+#  include <emmintrin.h>
+#endif
+
+
+namespace image {
+
+
+/*
+ * Return row y of an 8-bit image as RGBA, expanding gray and RGB pixels
+ * into `scratch` as PIL's convert('RGBA') would.
+ */
+static const unsigned char *
+rgbaRow(const Image &image, unsigned y, std::vector<unsigned char> &scratch)
+{
+    const unsigned char *row = image.start() + (ptrdiff_t)y * image.stride();
+    if (image.channels == 4) {
+        return row;
+    }
+
+    scratch.resize(image.width * 4);
+    unsigned char *dst = &scratch[0];
+    for (unsigned x = 0; x < image.width; ++x) {
+        switch (image.channels) {
+        case 1:
+            dst[0] = dst[1] = dst[2] = row[x];
+            dst[3] = 255;
+            break;
+        case 2:
+            dst[0] = dst[1] = dst[2] = row[x*2 + 0];
+            dst[3] = row[x*2 + 1];
+            break;
+        default:
+            dst[0] = row[x*3 + 0];
+            dst[1] = row[x*3 + 1];
+            dst[2] = row[x*3 + 2];
+            dst[3] = 255;
+            break;
+        }
+        dst += 4;
+    }
+    return &scratch[0];
+}
+
+
+/*
+ * Whether the difference of an RGB or RGBA pixel is above the threshold.
+ * Color differences are weighted like PIL's RGB to L conversion, which
+ * scripts/snapdiff.py used.
+ */
+static inline bool
+pixelMismatch(const unsigned char *a, const unsigned char *b, unsigned channels,
+              unsigned threshold, bool alpha)
+{
+    unsigned dr = abs(a[0] - b[0]);
+    unsigned dg = abs(a[1] - b[1]);
+    unsigned db = abs(a[2] - b[2]);
+    unsigned luminance = (dr*19595 + dg*38470 + db*7471 + 0x8000) >> 16;
+    if (luminance > threshold) {
+        return true;
+    }
+    return alpha && channels == 4 && (unsigned)abs(a[3] - b[3]) > threshold;
+}
+
+
+/*
+ * Accumulate the differences of a row of RGB or RGBA pixels.
+ */
+static void
+compareRow(const unsigned char *a, const unsigned char *b,
+           unsigned width, unsigned channels,
+           unsigned threshold, bool alpha, Difference &difference)
+{
+    size_t size = (size_t)width * channels;
+    bool skipAlpha = channels == 4 && !alpha;
+    unsigned maxError = difference.maxError;
+    size_t i = 0;
+
+    // Pixels before this one were already checked for mismatches
+    unsigned checked = 0;
+
+#ifdef HAVE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mask = _mm_set1_epi32(skipAlpha ? 0x00ffffff : -1);
+    const __m128i limit = _mm_set1_epi8((char)std::min(threshold, 255U));
+    __m128i max = zero;
+
+    while (i + 16 <= size) {
+        // Flush the 32-bit sums of squares before they can overflow
+        size_t count = std::min<size_t>((size - i) / 16, 4096);
+        __m128i sum = zero;
+        for (size_t n = 0; n < count; ++n, i += 16) {
+            __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+            __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+            __m128i d = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+            d = _mm_and_si128(d, mask);
+
+            max = _mm_max_epu8(max, d);
+
+            __m128i lo = _mm_unpacklo_epi8(d, zero);
+            __m128i hi = _mm_unpackhi_epi8(d, zero);
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(lo, lo));
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(hi, hi));
+
+            // The luminance of a difference never exceeds its largest
+            // channel, so only the pixels overlapping samples above the
+            // threshold need a closer look.
+            __m128i below = _mm_cmpeq_epi8(_mm_subs_epu8(d, limit), zero);
+            if (_mm_movemask_epi8(below) != 0xffff) {
+                unsigned first = std::max<unsigned>(checked, i / channels);
+                unsigned last = (i + 15) / channels;
+                for (unsigned x = first; x <= last; ++x) {
+                    difference.mismatches += pixelMismatch(a + x*channels, b + x*channels, channels, threshold, alpha);
+                }
+                checked = last + 1;
+            }
+        }
+
+        uint32_t sums[4];
+        _mm_storeu_si128((__m128i *)sums, sum);
+        difference.squareError += (uint64_t)sums[0] + sums[1] + sums[2] + sums[3];
+    }
+
+    uint8_t maxes[16];
+    _mm_storeu_si128((__m128i *)maxes, max);
+    for (unsigned n = 0; n < 16; ++n) {
+        maxError = std::max(maxError, (unsigned)maxes[n]);
+    }
+#endif /* HAVE_SSE2 */
+
+    for (unsigned x = std::max<unsigned>(checked, i / channels); x < width; ++x) {
+        difference.mismatches += pixelMismatch(a + x*channels, b + x*channels, channels, threshold, alpha);
+    }
+
+    for (; i < size; ++i) {
+        if (skipAlpha && i % 4 == 3) {
+            continue;
+        }
+        unsigned d = abs(a[i] - b[i]);
+        difference.squareError += d*d;
+        maxError = std::max(maxError, d);
+    }
+
+    difference.maxError = maxError;
+}
+
+
+bool
+compare(const Image &ref, const Image &src, Difference &difference,
+        unsigned threshold, bool alpha)
+{
+    difference = Difference();
+
+    if (ref.width != src.width ||
+        ref.height != src.height ||
+        ref.channelType != TYPE_UNORM8 ||
+        src.channelType != TYPE_UNORM8) {
+        return false;
+    }
+
+    // Compare RGB and RGBA rows in place, and everything else as RGBA
+    bool direct = ref.channels == src.channels && ref.channels >= 3;
+
+    std::vector<unsigned char> refScratch;
+    std::vector<unsigned char> srcScratch;
+    for (unsigned y = 0; y < ref.height; ++y) {
+        if (direct) {
+            compareRow(ref.start() + (ptrdiff_t)y * ref.stride(),
+                       src.start() + (ptrdiff_t)y * src.stride(),
+                       ref.width, ref.channels, threshold, alpha, difference);
+        } else {
+            const unsigned char *refRow = rgbaRow(ref, y, refScratch);
+            const unsigned char *srcRow = rgbaRow(src, y, srcScratch);
+            compareRow(refRow, srcRow, ref.width, 4, threshold, alpha, difference);
+        }
+    }
+
+    difference.samples = (uint64_t)ref.width * ref.height * (alpha ? 4 : 3);
+
+    return true;
+}
+
+
+double
+Difference::psnr(void) const
+{
+    if (!squareError) {
+        return std::numeric_limits<double>::infinity();
+    }
+    return 10.0 * log10(255.0 * 255.0 * samples / squareError);
+}
+
+
+double
+Difference::precision(void) const
+{
+    if (!samples) {
+        return 0.0;
+    }
+    double relError = (squareError * 2.0 + 1.0) / (samples * 255.0 * 255.0 * 2.0);
+    return -log(relError) / log(2.0);
+}
+
+
+Image *
+highlightDifferences(const Image &ref, const Image &src, double fuzz, bool alpha)
+{
+    if (ref.width != src.width ||
+        ref.height != src.height ||
+        ref.channelType != TYPE_UNORM8 ||
+        src.channelType != TYPE_UNORM8) {
+        return NULL;
+    }
+
+    // Like ImageMagick's compare: a faded source image, with pixels whose
+    // largest channel difference reaches 255*fuzz in strong red.
+    static const unsigned char lowlight[3] = {0xff, 0xff, 0xff};
+    static const unsigned char highlight[3] = {0xf1, 0x00, 0x1e};
+    static const unsigned opacity = 0xcc;
+
+    Image *diff = new Image(src.width, src.height, 3);
+
+    std::vector<unsigned char> refScratch;
+    std::vector<unsigned char> srcScratch;
+    unsigned channels = alpha ? 4 : 3;
+    for (unsigned y = 0; y < src.height; ++y) {
+        const unsigned char *refRow = rgbaRow(ref, y, refScratch);
+        const unsigned char *srcRow = rgbaRow(src, y, srcScratch);
+        unsigned char *dst = diff->pixels + y * diff->_stride();
+        for (unsigned x = 0; x < src.width; ++x) {
+            unsigned maxError = 0;
+            for (unsigned c = 0; c < channels; ++c) {
+                maxError = std::max(maxError, (unsigned)abs(refRow[x*4 + c] - srcRow[x*4 + c]));
+            }
+            unsigned weight;
+            if (fuzz > 0.0) {
+                weight = (unsigned)std::min(maxError / fuzz, 255.0);
+            } else {
+                weight = maxError ? 255 : 0;
+            }
+            for (unsigned c = 0; c < 3; ++c) {
+                unsigned mark = (highlight[c]*weight + lowlight[c]*(255 - weight) + 127) / 255;
+                dst[x*3 + c] = (srcRow[x*4 + c]*(255 - opacity) + mark*opacity + 127) / 255;
+            }
+        }
+    }
+
+    return diff;
+}
+
+
+Image *
+thumbnail(const Image &image, unsigned size)
+{
+    assert(image.channelType == TYPE_UNORM8);
+
+    unsigned width = image.width;
+    unsigned height = image.height;
+    if (width >= height) {
+        height = std::max(1U, (unsigned)((uint64_t)height * size / std::max(width, 1U)));
+        width = size;
+    } else {
+        width = std::max(1U, (unsigned)((uint64_t)width * size / height));
+        height = size;
+    }
+
+    Image *thumb = new Image(width, height, image.channels);
+
+    // Average the boxes of source pixels each thumbnail pixel covers
+    unsigned channels = image.channels;
+    std::vector<unsigned> sums(width * channels);
+    for (unsigned y = 0; y < height; ++y) {
+        unsigned y0 = (uint64_t)y * image.height / height;
+        unsigned y1 = std::max(y0 + 1, (unsigned)((uint64_t)(y + 1) * image.height / height));
+        std::fill(sums.begin(), sums.end(), 0);
+        for (unsigned sy = y0; sy < y1; ++sy) {
+            const unsigned char *row = image.start() + (ptrdiff_t)sy * image.stride();
+            for (unsigned x = 0; x < width; ++x) {
+                unsigned x0 = (uint64_t)x * image.width / width;
+                unsigned x1 = std::max(x0 + 1, (unsigned)((uint64_t)(x + 1) * image.width / width));
+                for (unsigned sx = x0; sx < x1; ++sx) {
+                    for (unsigned c = 0; c < channels; ++c) {
+                        sums[x*channels + c] += row[sx*channels + c];
+                    }
+                }
+            }
+        }
+        unsigned char *dst = thumb->pixels + y * thumb->_stride();
+        for (unsigned x = 0; x < width; ++x) {
+            unsigned x0 = (uint64_t)x * image.width / width;
+            unsigned x1 = std::max(x0 + 1, (unsigned)((uint64_t)(x + 1) * image.width / width));
+            unsigned count = (x1 - x0) * (y1 - y0);
+            for (unsigned c = 0; c < channels; ++c) {
+                dst[x*channels + c] = (sums[x*channels + c] + count/2) / count;
+            }
+        }
+    }
+
+    return thumb;
+}
+
+
+} /* namespace image */
@@ -270,7 +270,7 @@ readPNG(const char *filename)
     if (!is) {
         return NULL;
     }
-    return readPNG(filename);
+    return readPNG(is);
 }
 
 
@@ -0,0 +1,362 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * QOI image format (https://qoiformat.org/).
+ *
+ * Lossless like PNG, but encodes in a single pass without entropy coding,
+ * which makes it several times faster to write.
+ */
+
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <fstream>
+#include <vector>
+
+#include "image.hpp"
+
+
+namespace image {
+
+
+enum {
+    QOI_OP_INDEX = 0x00,
+    QOI_OP_DIFF  = 0x40,
+    QOI_OP_LUMA  = 0x80,
+    QOI_OP_RUN   = 0xc0,
+    QOI_OP_RGB   = 0xfe,
+    QOI_OP_RGBA  = 0xff,
+    QOI_MASK_2   = 0xc0,
+};
+
+static const unsigned QOI_HEADER_SIZE = 14;
+static const unsigned char qoi_padding[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+
+union QOIPixel {
+    struct {
+        unsigned char r, g, b, a;
+    } rgba;
+    uint32_t v;
+};
+
+
+static inline unsigned
+qoiHash(const QOIPixel &px)
+{
+    return (px.rgba.r*3 + px.rgba.g*5 + px.rgba.b*7 + px.rgba.a*11) % 64;
+}
+
+
+static inline void
+write32BE(unsigned char *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+
+static inline uint32_t
+read32BE(const unsigned char *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+           (uint32_t)p[2] << 8  | (uint32_t)p[3];
+}
+
+
+struct QOIEncoder
+{
+    QOIPixel index[64];
+    QOIPixel prev;
+    unsigned run;
+
+    QOIEncoder() : run(0) {
+        memset(index, 0, sizeof index);
+        prev.v = 0;
+        prev.rgba.a = 255;
+    }
+
+    inline unsigned char *
+    flushRun(unsigned char *out) {
+        if (run) {
+            *out++ = QOI_OP_RUN | (run - 1);
+            run = 0;
+        }
+        return out;
+    }
+
+    inline unsigned char *
+    encode(unsigned char *out, QOIPixel px) {
+        if (px.v == prev.v) {
+            if (++run == 62) {
+                out = flushRun(out);
+            }
+            return out;
+        }
+
+        out = flushRun(out);
+
+        unsigned hash = qoiHash(px);
+        if (index[hash].v == px.v) {
+            *out++ = QOI_OP_INDEX | hash;
+        } else {
+            index[hash] = px;
+
+            if (px.rgba.a == prev.rgba.a) {
+                signed char vr = px.rgba.r - prev.rgba.r;
+                signed char vg = px.rgba.g - prev.rgba.g;
+                signed char vb = px.rgba.b - prev.rgba.b;
+                signed char vg_r = vr - vg;
+                signed char vg_b = vb - vg;
+
+                if (vr > -3 && vr < 2 &&
+                    vg > -3 && vg < 2 &&
+                    vb > -3 && vb < 2) {
+                    *out++ = QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2);
+                } else if (vg_r > -9 && vg_r < 8 &&
+                           vg > -33 && vg < 32 &&
+                           vg_b > -9 && vg_b < 8) {
+                    *out++ = QOI_OP_LUMA | (vg + 32);
+                    *out++ = (vg_r + 8) << 4 | (vg_b + 8);
+                } else {
+                    *out++ = QOI_OP_RGB;
+                    *out++ = px.rgba.r;
+                    *out++ = px.rgba.g;
+                    *out++ = px.rgba.b;
+                }
+            } else {
+                *out++ = QOI_OP_RGBA;
+                *out++ = px.rgba.r;
+                *out++ = px.rgba.g;
+                *out++ = px.rgba.b;
+                *out++ = px.rgba.a;
+            }
+        }
+
+        prev = px;
+        return out;
+    }
+};
+
+
+/*
+ * Encode one row, specialized on the number of source channels so that the
+ * pixel fetch is resolved at compile time.
+ */
+template< unsigned channels >
+static inline unsigned char *
+encodeRow(QOIEncoder &encoder, unsigned char *out, const unsigned char *row, unsigned width, bool strip_alpha)
+{
+    QOIPixel px;
+    px.rgba.a = 255;
+    for (unsigned x = 0; x < width; ++x, row += channels) {
+        switch (channels) {
+        case 1:
+            px.rgba.r = px.rgba.g = px.rgba.b = row[0];
+            break;
+        case 2:
+            px.rgba.r = px.rgba.g = px.rgba.b = row[0];
+            if (!strip_alpha) {
+                px.rgba.a = row[1];
+            }
+            break;
+        default:
+            px.rgba.r = row[0];
+            px.rgba.g = row[1];
+            px.rgba.b = row[2];
+            if (channels == 4 && !strip_alpha) {
+                px.rgba.a = row[3];
+            }
+            break;
+        }
+        out = encoder.encode(out, px);
+    }
+    return out;
+}
+
+
+bool
+Image::writeQOI(std::ostream &os, bool strip_alpha) const
+{
+    if (channelType != TYPE_UNORM8 ||
+        channels < 1 || channels > 4) {
+        return false;
+    }
+
+    bool alpha = (channels == 2 || channels == 4) && !strip_alpha;
+
+    unsigned char header[QOI_HEADER_SIZE];
+    memcpy(header, "qoif", 4);
+    write32BE(header + 4, width);
+    write32BE(header + 8, height);
+    header[12] = alpha ? 4 : 3;
+    header[13] = 0; // sRGB with linear alpha
+    os.write((const char *)header, sizeof header);
+
+    // Worst case is one tag byte plus all components for every pixel
+    std::vector<unsigned char> buffer(width * 5 + 1);
+
+    QOIEncoder encoder;
+    for (const unsigned char *row = start(); row != end(); row += stride()) {
+        unsigned char *out = buffer.data();
+        switch (channels) {
+        case 1:
+            out = encodeRow<1>(encoder, out, row, width, strip_alpha);
+            break;
+        case 2:
+            out = encodeRow<2>(encoder, out, row, width, strip_alpha);
+            break;
+        case 3:
+            out = encodeRow<3>(encoder, out, row, width, strip_alpha);
+            break;
+        case 4:
+            out = encodeRow<4>(encoder, out, row, width, strip_alpha);
+            break;
+        }
+        os.write((const char *)buffer.data(), out - buffer.data());
+    }
+
+    unsigned char *out = encoder.flushRun(buffer.data());
+    os.write((const char *)buffer.data(), out - buffer.data());
+
+    os.write((const char *)qoi_padding, sizeof qoi_padding);
+
+    return !os.fail();
+}
+
+
+bool
+Image::writeQOI(const char *filename, bool strip_alpha) const
+{
+    std::ofstream os(filename, std::ofstream::binary);
+    if (!os) {
+        return false;
+    }
+    return writeQOI(os, strip_alpha);
+}
+
+
+Image *
+readQOI(const char *buffer, size_t size)
+{
+    const unsigned char *p = (const unsigned char *)buffer;
+    const unsigned char *end = p + size;
+
+    if (size < QOI_HEADER_SIZE + sizeof qoi_padding ||
+        memcmp(p, "qoif", 4) != 0) {
+        return NULL;
+    }
+
+    unsigned width = read32BE(p + 4);
+    unsigned height = read32BE(p + 8);
+    unsigned channels = p[12];
+    if (width == 0 || height == 0 ||
+        (channels != 3 && channels != 4) ||
+        (uint64_t)width * height > (uint64_t)(end - p) * 62) {
+        return NULL;
+    }
+    p += QOI_HEADER_SIZE;
+    end -= sizeof qoi_padding;
+
+    Image *image = new Image(width, height, channels);
+
+    QOIPixel index[64];
+    memset(index, 0, sizeof index);
+    QOIPixel px;
+    px.v = 0;
+    px.rgba.a = 255;
+    unsigned run = 0;
+
+    unsigned char *dst = image->pixels;
+    unsigned char *dst_end = dst + width * height * channels;
+    while (dst < dst_end) {
+        if (run) {
+            --run;
+        } else if (p < end) {
+            unsigned char b1 = *p++;
+            if (b1 == QOI_OP_RGB) {
+                if (end - p < 3) {
+                    break;
+                }
+                px.rgba.r = p[0];
+                px.rgba.g = p[1];
+                px.rgba.b = p[2];
+                p += 3;
+            } else if (b1 == QOI_OP_RGBA) {
+                if (end - p < 4) {
+                    break;
+                }
+                px.rgba.r = p[0];
+                px.rgba.g = p[1];
+                px.rgba.b = p[2];
+                px.rgba.a = p[3];
+                p += 4;
+            } else if ((b1 & QOI_MASK_2) == QOI_OP_INDEX) {
+                px = index[b1];
+            } else if ((b1 & QOI_MASK_2) == QOI_OP_DIFF) {
+                px.rgba.r += ((b1 >> 4) & 0x03) - 2;
+                px.rgba.g += ((b1 >> 2) & 0x03) - 2;
+                px.rgba.b += ( b1       & 0x03) - 2;
+            } else if ((b1 & QOI_MASK_2) == QOI_OP_LUMA) {
+                if (p == end) {
+                    break;
+                }
+                unsigned char b2 = *p++;
+                int vg = (b1 & 0x3f) - 32;
+                px.rgba.r += vg - 8 + ((b2 >> 4) & 0x0f);
+                px.rgba.g += vg;
+                px.rgba.b += vg - 8 +  (b2       & 0x0f);
+            } else {
+                run = b1 & 0x3f;
+            }
+            index[qoiHash(px)] = px;
+        } else {
+            break;
+        }
+
+        dst[0] = px.rgba.r;
+        dst[1] = px.rgba.g;
+        dst[2] = px.rgba.b;
+        if (channels == 4) {
+            dst[3] = px.rgba.a;
+        }
+        dst += channels;
+    }
+
+    if (dst < dst_end) {
+        delete image;
+        return NULL;
+    }
+
+    return image;
+}
+
+
+} /* namespace image */
@@ -0,0 +1,273 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include "image.hpp"
+#include "xxh64.hpp"
+
+#include "gtest/gtest.h"
+
+using namespace image;
+
+
+static Image *
+createImage(unsigned channels, bool flipped)
+{
+    Image *image = new Image(67, 31, channels, flipped);
+    unsigned char *p = image->pixels;
+    for (unsigned y = 0; y < image->height; ++y) {
+        for (unsigned x = 0; x < image->width; ++x) {
+            for (unsigned c = 0; c < channels; ++c) {
+                // Mix smooth gradients, flat areas and noise so that every
+                // QOI op gets exercised
+                unsigned char v;
+                if (x < 20) {
+                    v = 128;
+                } else if (x < 40) {
+                    v = x + y + c;
+                } else {
+                    v = (x * 7919 + y * 104729 + c * 31) >> 3;
+                }
+                *p++ = v;
+            }
+        }
+    }
+    return image;
+}
+
+
+static void
+checkRoundTrip(unsigned channels, bool flipped)
+{
+    Image *src = createImage(channels, flipped);
+
+    std::stringstream ss;
+    EXPECT_TRUE(src->writeQOI(ss));
+    std::string data = ss.str();
+
+    Image *dst = readQOI(data.data(), data.size());
+    ASSERT_TRUE(dst != NULL);
+    EXPECT_EQ(src->width, dst->width);
+    EXPECT_EQ(src->height, dst->height);
+    EXPECT_EQ(channels, dst->channels);
+
+    // Decoded images are always top to bottom
+    const unsigned char *srcRow = src->start();
+    const unsigned char *dstRow = dst->start();
+    for (unsigned y = 0; y < src->height; ++y) {
+        EXPECT_EQ(0, memcmp(srcRow, dstRow, src->width * channels)) << "row " << y;
+        srcRow += src->stride();
+        dstRow += dst->stride();
+    }
+
+    delete dst;
+    delete src;
+}
+
+
+TEST(image, qoi_rgb)
+{
+    checkRoundTrip(3, false);
+    checkRoundTrip(3, true);
+}
+
+
+TEST(image, qoi_rgba)
+{
+    checkRoundTrip(4, false);
+    checkRoundTrip(4, true);
+}
+
+
+/*
+ * Stripping alpha must encode exactly as the same image without an alpha
+ * channel would.
+ */
+static void
+checkStripAlpha(unsigned channels)
+{
+    Image *src = createImage(channels, false);
+    Image *opaque = new Image(src->width, src->height, channels - 1, false);
+    for (unsigned i = 0; i < src->width * src->height; ++i) {
+        memcpy(opaque->pixels + i * opaque->channels, src->pixels + i * channels, opaque->channels);
+    }
+
+    std::stringstream ss;
+    EXPECT_TRUE(src->writeQOI(ss, true));
+    std::stringstream expected;
+    EXPECT_TRUE(opaque->writeQOI(expected));
+    EXPECT_EQ(expected.str(), ss.str());
+
+    delete opaque;
+    delete src;
+}
+
+
+TEST(image, qoi_strip_alpha)
+{
+    checkStripAlpha(2);
+    checkStripAlpha(4);
+}
+
+
+TEST(image, qoi_truncated)
+{
+    Image *src = createImage(3, false);
+    std::stringstream ss;
+    src->writeQOI(ss);
+    std::string data = ss.str();
+    delete src;
+
+    EXPECT_TRUE(readQOI(data.data(), data.size() / 2) == NULL);
+}
+
+
+static void
+checkDifference(unsigned channels, bool alpha)
+{
+    Image *ref = createImage(channels, false);
+    Image *src = createImage(channels, false);
+
+    Difference difference;
+    ASSERT_TRUE(compare(*ref, *src, difference, 12, alpha));
+    EXPECT_EQ(0U, difference.squareError);
+    EXPECT_EQ(0U, difference.mismatches);
+    EXPECT_EQ(0U, difference.maxError);
+    EXPECT_TRUE(std::isinf(difference.psnr()));
+
+    // Perturb pixels all over, including the unaligned ends of each row
+    unsigned long long squareError = 0;
+    unsigned long long mismatches = 0;
+    unsigned maxError = 0;
+    unsigned compared = channels == 4 && !alpha ? 3 : channels;
+    for (unsigned y = 0; y < src->height; ++y) {
+        for (unsigned x = (y * 13) % 5; x < src->width; x += 5) {
+            unsigned char *p = src->pixels + y * src->_stride() + x * channels;
+            unsigned char *q = ref->pixels + y * ref->_stride() + x * channels;
+            unsigned delta = (x * 31 + y * 17) % 40;
+            for (unsigned c = 0; c < channels; ++c) {
+                p[c] = q[c] >= delta ? q[c] - delta : q[c] + delta;
+            }
+            // Gray samples count for R, G, and B
+            unsigned samples = channels < 3 ? 3 : compared;
+            squareError += (unsigned long long)samples * delta * delta;
+            if (channels == 2 && alpha) {
+                squareError += delta * delta;
+            }
+            if (delta > 12) {
+                ++mismatches;
+            }
+            maxError = std::max(maxError, delta);
+        }
+    }
+
+    ASSERT_TRUE(compare(*ref, *src, difference, 12, alpha));
+    EXPECT_EQ(squareError, difference.squareError);
+    EXPECT_EQ(mismatches, difference.mismatches);
+    EXPECT_EQ(maxError, difference.maxError);
+    EXPECT_EQ((unsigned long long)ref->width * ref->height * (alpha ? 4 : 3), difference.samples);
+
+    Image *diff = highlightDifferences(*ref, *src);
+    ASSERT_TRUE(diff != NULL);
+    EXPECT_EQ(ref->width, diff->width);
+    EXPECT_EQ(3U, diff->channels);
+    delete diff;
+
+    delete src;
+    delete ref;
+}
+
+
+TEST(image, compare)
+{
+    checkDifference(1, false);
+    checkDifference(2, true);
+    checkDifference(3, false);
+    checkDifference(4, false);
+    checkDifference(4, true);
+
+    Image a(8, 8, 3);
+    Image b(8, 9, 3);
+    Difference difference;
+    EXPECT_FALSE(compare(a, b, difference));
+}
+
+
+TEST(image, thumbnail)
+{
+    Image *src = createImage(3, false);
+    Image *thumb = thumbnail(*src, 32);
+    EXPECT_EQ(32U, thumb->width);
+    EXPECT_EQ(14U, thumb->height);
+    EXPECT_EQ(3U, thumb->channels);
+    // The left of the image is flat
+    EXPECT_EQ(128, thumb->pixels[0]);
+    delete thumb;
+    delete src;
+}
+
+
+static std::string
+hexdigest(const char *s, size_t chunk)
+{
+    XXH64 hash;
+    size_t size = strlen(s);
+    for (size_t i = 0; i < size; i += chunk) {
+        hash.update(s + i, std::min(chunk, size - i));
+    }
+    char digest[17];
+    hash.hexdigest(digest);
+    return digest;
+}
+
+
+TEST(image, xxh64)
+{
+    EXPECT_EQ("ef46db3751d8e999", hexdigest("", 1));
+    EXPECT_EQ("d24ec4f1a98c6e5b", hexdigest("a", 1));
+    EXPECT_EQ("44bc2cf5ad770999", hexdigest("abc", 1));
+
+    // Digests must not depend on how the input is split
+    const char *text = "The quick brown fox jumps over the lazy dog, "
+                       "then jumps over it again, and again.";
+    std::string expected = hexdigest(text, strlen(text));
+    for (size_t chunk = 1; chunk < 40; ++chunk) {
+        EXPECT_EQ(expected, hexdigest(text, chunk));
+    }
+}
+
+
+int
+main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
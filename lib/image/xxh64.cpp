@@ -0,0 +1,206 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <string.h>
+
+#include "xxh64.hpp"
+
+
+static const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+static const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+
+static inline uint64_t
+rotl64(uint64_t x, unsigned r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+
+static inline uint64_t
+read64(const unsigned char *p)
+{
+    return (uint64_t)p[0]       | (uint64_t)p[1] <<  8 |
+           (uint64_t)p[2] << 16 | (uint64_t)p[3] << 24 |
+           (uint64_t)p[4] << 32 | (uint64_t)p[5] << 40 |
+           (uint64_t)p[6] << 48 | (uint64_t)p[7] << 56;
+}
+
+
+static inline uint32_t
+read32(const unsigned char *p)
+{
+    return (uint32_t)p[0]       | (uint32_t)p[1] <<  8 |
+           (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+
+static inline uint64_t
+round64(uint64_t acc, uint64_t input)
+{
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    acc *= PRIME64_1;
+    return acc;
+}
+
+
+static inline uint64_t
+mergeRound64(uint64_t acc, uint64_t val)
+{
+    acc ^= round64(0, val);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+
+/*
+ * Consume as many 32 byte stripes as available.  The four lanes are
+ * independent, so the compiler can interleave them.
+ */
+static inline const unsigned char *
+consumeStripes(uint64_t acc[4], const unsigned char *p, const unsigned char *end)
+{
+    uint64_t v1 = acc[0];
+    uint64_t v2 = acc[1];
+    uint64_t v3 = acc[2];
+    uint64_t v4 = acc[3];
+    while (end - p >= 32) {
+        v1 = round64(v1, read64(p));
+        v2 = round64(v2, read64(p + 8));
+        v3 = round64(v3, read64(p + 16));
+        v4 = round64(v4, read64(p + 24));
+        p += 32;
+    }
+    acc[0] = v1;
+    acc[1] = v2;
+    acc[2] = v3;
+    acc[3] = v4;
+    return p;
+}
+
+
+XXH64::XXH64(uint64_t _seed) :
+    seed(_seed),
+    totalSize(0),
+    pendingSize(0)
+{
+    acc[0] = seed + PRIME64_1 + PRIME64_2;
+    acc[1] = seed + PRIME64_2;
+    acc[2] = seed;
+    acc[3] = seed - PRIME64_1;
+}
+
+
+void
+XXH64::update(const void *data, size_t size)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    const unsigned char *end = p + size;
+
+    totalSize += size;
+
+    if (pendingSize) {
+        size_t fill = sizeof pending - pendingSize;
+        if (size < fill) {
+            memcpy(pending + pendingSize, p, size);
+            pendingSize += size;
+            return;
+        }
+        memcpy(pending + pendingSize, p, fill);
+        consumeStripes(acc, pending, pending + sizeof pending);
+        p += fill;
+        pendingSize = 0;
+    }
+
+    p = consumeStripes(acc, p, end);
+
+    pendingSize = end - p;
+    memcpy(pending, p, pendingSize);
+}
+
+
+uint64_t
+XXH64::digest(void) const
+{
+    uint64_t h;
+
+    if (totalSize >= 32) {
+        h = rotl64(acc[0], 1) + rotl64(acc[1], 7) +
+            rotl64(acc[2], 12) + rotl64(acc[3], 18);
+        h = mergeRound64(h, acc[0]);
+        h = mergeRound64(h, acc[1]);
+        h = mergeRound64(h, acc[2]);
+        h = mergeRound64(h, acc[3]);
+    } else {
+        h = seed + PRIME64_5;
+    }
+
+    h += totalSize;
+
+    const unsigned char *p = pending;
+    const unsigned char *end = pending + pendingSize;
+
+    while (end - p >= 8) {
+        h ^= round64(0, read64(p));
+        h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+        p += 8;
+    }
+
+    if (end - p >= 4) {
+        h ^= (uint64_t)read32(p) * PRIME64_1;
+        h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+
+    while (p < end) {
+        h ^= *p * PRIME64_5;
+        h = rotl64(h, 11) * PRIME64_1;
+        ++p;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+
+void
+XXH64::hexdigest(char *buffer) const
+{
+    static const char hex[] = "0123456789abcdef";
+    uint64_t h = digest();
+    for (unsigned i = 0; i < 16; ++i) {
+        buffer[i] = hex[(h >> (60 - 4*i)) & 0xf];
+    }
+    buffer[16] = '\0';
+}
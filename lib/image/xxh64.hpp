@@ -0,0 +1,63 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * XXH64 hash (https://github.com/Cyan4973/xxHash), computed incrementally.
+ *
+ * Much faster than MD5, and the digests match `xxhsum -H1`.
+ */
+
+#pragma once
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+class XXH64
+{
+public:
+    XXH64(uint64_t seed = 0);
+
+    void
+    update(const void *data, size_t size);
+
+    uint64_t
+    digest(void) const;
+
+    /*
+     * Write the digest as 16 lowercase hexadecimal digits plus a terminating
+     * NUL character.
+     */
+    void
+    hexdigest(char *buffer) const;
+
+private:
+    uint64_t seed;
+    uint64_t totalSize;
+    uint64_t acc[4];
+    unsigned char pending[32];
+    size_t pendingSize;
+};
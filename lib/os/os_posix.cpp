@@ -38,6 +38,11 @@
 #include <pwd.h>
 #include <fcntl.h>
 #include <signal.h>
+#ifndef __ANDROID__
+#include <sys/mman.h>
+#endif
+
+#include <mutex>
 
 #if defined(__linux__)
 #include <linux/limits.h> // PATH_MAX
@@ -71,6 +76,8 @@
 #include "os.hpp"
 #include "os_string.hpp"
 #include "os_backtrace.hpp"
+#include "os_shm.hpp"
+#include "os_mmap.hpp"
 
 
 namespace os {
@@ -216,11 +223,29 @@ String::exists(void) const
     return true;
 }
 
-int execute(char * const * args)
+static void
+redirect(const char *filename, int target)
+{
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        fprintf(stderr, "error: failed to open %s\n", filename);
+        _exit(-1);
+    }
+    dup2(fd, target);
+    close(fd);
+}
+
+int execute(char * const * args, const char *outputFilename, const char *errorFilename)
 {
     pid_t pid = fork();
     if (pid == 0) {
         // child
+        if (outputFilename) {
+            redirect(outputFilename, STDOUT_FILENO);
+        }
+        if (errorFilename) {
+            redirect(errorFilename, STDERR_FILENO);
+        }
         execvp(args[0], args);
         fprintf(stderr, "error: failed to execute:");
         for (unsigned i = 0; args[i]; ++i) {
@@ -426,6 +451,218 @@ resetExceptionCallback(void)
 #endif
 }
 
+static String sharedMemoryPrefix;
+static unsigned sharedMemoryCount = 0;
+static std::mutex sharedMemoryMutex;
+
+
+SharedMemory::SharedMemory() :
+    m_fd(-1),
+    m_data(NULL),
+    m_size(0),
+    m_mapSize(0)
+{
+}
+
+
+SharedMemory::~SharedMemory()
+{
+#ifndef __ANDROID__
+    if (m_data) {
+        munmap(m_data, m_mapSize);
+    }
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+#endif
+}
+
+
+bool
+SharedMemory::supported(void)
+{
+#ifdef __ANDROID__
+    return false;
+#else
+    return true;
+#endif
+}
+
+
+void
+SharedMemory::setPrefix(const char *prefix)
+{
+    std::lock_guard<std::mutex> lock(sharedMemoryMutex);
+    sharedMemoryPrefix = prefix;
+    sharedMemoryCount = 0;
+}
+
+
+bool
+SharedMemory::create(size_t size)
+{
+#ifdef __ANDROID__
+    return false;
+#else
+    assert(!m_data);
+
+    // Numbers are only used up by segments that were created, so that the
+    // sequence has no holes for sweep() to stop at.
+    std::lock_guard<std::mutex> lock(sharedMemoryMutex);
+
+    if (sharedMemoryPrefix.length() == 0) {
+        sharedMemoryPrefix = String::format("/apitrace.%u", (unsigned)getpid());
+    }
+    m_name = String::format("%s.%u", (const char *)sharedMemoryPrefix, sharedMemoryCount);
+
+    int fd = shm_open(m_name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        return false;
+    }
+
+    // Zero sized mappings are not allowed
+    size_t mapSize = size ? size : 1;
+    void *data = MAP_FAILED;
+    if (ftruncate(fd, mapSize) == 0) {
+        data = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+
+    if (data == MAP_FAILED) {
+        close(fd);
+        shm_unlink(m_name);
+        return false;
+    }
+
+    ++sharedMemoryCount;
+
+    m_fd = fd;
+    m_data = data;
+    m_size = mapSize;
+    m_mapSize = mapSize;
+    return true;
+#endif
+}
+
+
+bool
+SharedMemory::truncate(size_t size)
+{
+#ifdef __ANDROID__
+    return false;
+#else
+    assert(m_fd >= 0);
+    assert(size <= m_mapSize);
+
+    // Pages past the end are dropped, but stay in the mapping until unmapped
+    if (ftruncate(m_fd, size ? size : 1) != 0) {
+        return false;
+    }
+    m_size = size;
+    return true;
+#endif
+}
+
+
+bool
+SharedMemory::open(const char *name)
+{
+#ifdef __ANDROID__
+    return false;
+#else
+    assert(!m_data);
+
+    m_name = name;
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    void *data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    m_data = data;
+    m_size = st.st_size;
+    m_mapSize = st.st_size;
+    return true;
+#endif
+}
+
+
+unsigned
+SharedMemory::sweep(const char *prefix)
+{
+#ifdef __ANDROID__
+    return 0;
+#else
+    unsigned count = 0;
+    while (shm_unlink(String::format("%s.%u", prefix, count)) == 0) {
+        ++count;
+    }
+    return count;
+#endif
+}
+
+
+MappedFile::MappedFile() :
+    m_data(NULL),
+    m_size(0)
+{
+}
+
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+
+bool
+MappedFile::open(const char *filename)
+{
+    assert(!m_data);
+
+    int fd = ::open(filename, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    void *data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    m_data = static_cast<char *>(data);
+    m_size = st.st_size;
+    return true;
+}
+
+
+void
+MappedFile::close(void)
+{
+    if (m_data) {
+        munmap(m_data, m_size);
+        m_data = NULL;
+        m_size = 0;
+    }
+}
+
+
 #ifdef __ANDROID__
 #include "os_memory.hpp"
 #include <cassert>
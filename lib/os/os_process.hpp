@@ -82,7 +82,12 @@ unsetEnvironment(const char *name) {
 }
 
 
-int execute(char * const * args);
+/**
+ * Run a program to completion, returning its exit code.  When outputFilename
+ * (or errorFilename) is given, the program's standard output (or error) is
+ * redirected to it.
+ */
+int execute(char * const * args, const char *outputFilename = NULL, const char *errorFilename = NULL);
 
 
 } /* namespace os */
@@ -0,0 +1,117 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Named shared memory segments.
+ *
+ * Used to hand large images from the retracers to the GUI without pushing
+ * them through a pipe: the writer creates and fills a segment, and sends just
+ * its name; the reader maps it.  Segments are named after a prefix and a
+ * sequence number, so that the reader can remove every segment left behind
+ * once the writer exited, whether or not it got to map them.
+ *
+ * Only supported on POSIX systems.
+ */
+
+#pragma once
+
+
+#include <stddef.h>
+
+#include "os_string.hpp"
+
+
+namespace os {
+
+
+class SharedMemory
+{
+public:
+    SharedMemory();
+    ~SharedMemory();
+
+    /**
+     * Create the next segment in sequence, mapped for writing.  The size is
+     * an upper bound, as untouched pages take no memory.
+     */
+    bool
+    create(size_t size);
+
+    /**
+     * Shrink a segment created for writing to the size actually used.
+     */
+    bool
+    truncate(size_t size);
+
+    /**
+     * Map an existing segment for reading.
+     */
+    bool
+    open(const char *name);
+
+    const char *
+    name(void) const {
+        return m_name;
+    }
+
+    void *
+    data(void) const {
+        return m_data;
+    }
+
+    size_t
+    size(void) const {
+        return m_size;
+    }
+
+    static bool
+    supported(void);
+
+    /**
+     * Set the prefix of the segments created from now on.
+     */
+    static void
+    setPrefix(const char *prefix);
+
+    /**
+     * Remove the segments named after the prefix, in sequence up to the
+     * first missing one.  Returns how many were removed.
+     */
+    static unsigned
+    sweep(const char *prefix);
+
+private:
+    SharedMemory(const SharedMemory &) = delete;
+    SharedMemory & operator = (const SharedMemory &) = delete;
+
+    String m_name;
+    int m_fd;
+    void *m_data;
+    size_t m_size;
+    size_t m_mapSize;
+};
+
+
+} /* namespace os */
@@ -43,6 +43,12 @@
 #  include <unistd.h>
 #endif
 
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#  include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#  include <x86intrin.h>
+#endif
+
 
 namespace os {
 
@@ -90,6 +96,18 @@ namespace os {
 #endif
     }
 
+    // Cheap timestamp (the CPU's time stamp counter where available) in
+    // unspecified units, for timing short stretches of code; convert to
+    // seconds by calibrating against getTime
+    inline unsigned long long
+    getTicks(void) {
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+        return __rdtsc();
+#else
+        return getTime();
+#endif
+    }
+
     // Suspend execution
     inline void
     sleep(unsigned long usecs) {
@@ -36,6 +36,8 @@
 
 #include "os.hpp"
 #include "os_string.hpp"
+#include "os_shm.hpp"
+#include "os_mmap.hpp"
 
 
 namespace os {
@@ -168,7 +170,23 @@ quoteArg(std::string &s, const char *arg)
     s.push_back('"');
 }
 
-int execute(char * const * args)
+static HANDLE
+createOutput(const char *filename)
+{
+    SECURITY_ATTRIBUTES securityAttributes;
+    memset(&securityAttributes, 0, sizeof(securityAttributes));
+    securityAttributes.nLength = sizeof(securityAttributes);
+    securityAttributes.bInheritHandle = TRUE;
+    HANDLE hFile = CreateFileA(filename, GENERIC_WRITE, FILE_SHARE_READ,
+                               &securityAttributes, CREATE_ALWAYS,
+                               FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        log("error: failed to open %s\n", filename);
+    }
+    return hFile;
+}
+
+int execute(char * const * args, const char *outputFilename, const char *errorFilename)
 {
     std::string commandLine;
    
@@ -193,19 +211,53 @@ int execute(char * const * args)
     memset(&startupInfo, 0, sizeof(startupInfo));
     startupInfo.cb = sizeof(startupInfo);
 
+    HANDLE hOutput = INVALID_HANDLE_VALUE;
+    HANDLE hError = INVALID_HANDLE_VALUE;
+    bool redirect = outputFilename || errorFilename;
+    if (redirect) {
+        if (outputFilename) {
+            hOutput = createOutput(outputFilename);
+            if (hOutput == INVALID_HANDLE_VALUE) {
+                return -1;
+            }
+        }
+        if (errorFilename) {
+            hError = createOutput(errorFilename);
+            if (hError == INVALID_HANDLE_VALUE) {
+                if (hOutput != INVALID_HANDLE_VALUE) {
+                    CloseHandle(hOutput);
+                }
+                return -1;
+            }
+        }
+        startupInfo.dwFlags |= STARTF_USESTDHANDLES;
+        startupInfo.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+        startupInfo.hStdOutput = outputFilename ? hOutput : GetStdHandle(STD_OUTPUT_HANDLE);
+        startupInfo.hStdError = errorFilename ? hError : GetStdHandle(STD_ERROR_HANDLE);
+    }
+
     PROCESS_INFORMATION processInformation;
 
-    if (!CreateProcessA(NULL,
+    BOOL bSuccess = CreateProcessA(NULL,
                         const_cast<char *>(commandLine.c_str()), // only modified by CreateProcessW
                         0, // process attributes
                         0, // thread attributes
-                        FALSE, // inherit handles
+                        redirect ? TRUE : FALSE, // inherit handles
                         0, // creation flags,
                         NULL, // environment
                         NULL, // current directory
                         &startupInfo,
                         &processInformation
-                        )) {
+                        );
+
+    if (hOutput != INVALID_HANDLE_VALUE) {
+        CloseHandle(hOutput);
+    }
+    if (hError != INVALID_HANDLE_VALUE) {
+        CloseHandle(hError);
+    }
+
+    if (!bSuccess) {
         log("error: failed to execute %s\n", arg0);
         return -1;
     }
@@ -400,6 +452,112 @@ resetExceptionCallback(void)
 }
 
 
+/*
+ * Named file mappings are freed as soon as the last handle is closed, which
+ * makes them unfit for handing data to a process that outlives the writer.
+ */
+
+SharedMemory::SharedMemory() :
+    m_fd(-1),
+    m_data(NULL),
+    m_size(0),
+    m_mapSize(0)
+{
+}
+
+SharedMemory::~SharedMemory()
+{
+}
+
+bool
+SharedMemory::supported(void)
+{
+    return false;
+}
+
+bool
+SharedMemory::create(size_t size)
+{
+    return false;
+}
+
+bool
+SharedMemory::truncate(size_t size)
+{
+    return false;
+}
+
+bool
+SharedMemory::open(const char *name)
+{
+    return false;
+}
+
+void
+SharedMemory::setPrefix(const char *prefix)
+{
+}
+
+unsigned
+SharedMemory::sweep(const char *prefix)
+{
+    return 0;
+}
+
+
+MappedFile::MappedFile() :
+    m_data(NULL),
+    m_size(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool
+MappedFile::open(const char *filename)
+{
+    assert(!m_data);
+
+    HANDLE hFile = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    void *data = NULL;
+    if (GetFileSizeEx(hFile, &fileSize) && fileSize.QuadPart > 0) {
+        HANDLE hMapping = CreateFileMapping(hFile, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+        if (hMapping) {
+            data = MapViewOfFile(hMapping, FILE_MAP_COPY, 0, 0, 0);
+            CloseHandle(hMapping);
+        }
+    }
+    CloseHandle(hFile);
+
+    if (!data) {
+        return false;
+    }
+
+    m_data = static_cast<char *>(data);
+    m_size = static_cast<size_t>(fileSize.QuadPart);
+    return true;
+}
+
+void
+MappedFile::close(void)
+{
+    if (m_data) {
+        UnmapViewOfFile(m_data);
+        m_data = NULL;
+        m_size = 0;
+    }
+}
+
+
 } /* namespace os */
 
 #endif  // defined(_WIN32)
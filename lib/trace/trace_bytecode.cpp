@@ -0,0 +1,1255 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <iostream>
+#include <new>
+
+#include "trace_bytecode.hpp"
+
+
+namespace trace {
+
+
+/*
+ * File layout: a header followed by a sequence of records, each starting
+ * with a one byte record type.  Signatures are emitted once, before the first
+ * call referring to them.
+ */
+
+static const char bytecodeMagic[8] = {'a', 'p', 'i', 't', 'b', 'c', '\n', '\0'};
+static const uint32_t bytecodeByteOrder = 0x01020304;
+
+enum {
+    RECORD_CALL = 'C',
+    RECORD_FUNCTION = 'F',
+    RECORD_STRUCT = 'S',
+    RECORD_ENUM = 'E',
+    RECORD_BITMASK = 'B',
+};
+
+enum {
+    VALUE_ABSENT = 0,
+    VALUE_NULL,
+    VALUE_FALSE,
+    VALUE_TRUE,
+    VALUE_SINT,
+    VALUE_UINT,
+    VALUE_FLOAT,
+    VALUE_DOUBLE,
+    VALUE_STRING,
+    VALUE_WSTRING,
+    VALUE_ENUM,
+    VALUE_BITMASK,
+    VALUE_STRUCT,
+    VALUE_ARRAY,
+    VALUE_BLOB,
+    VALUE_POINTER,
+    VALUE_REPR,
+};
+
+static const size_t pageSize = 4096;
+
+// Page align blobs big enough to be worth it, so that drivers can take the
+// fast path when uploading them.
+static inline size_t
+blobAlignment(size_t size) {
+    return size >= pageSize ? pageSize : 16;
+}
+
+
+BytecodeWriter::BytecodeWriter() :
+    m_file(NULL),
+    m_offset(0),
+    m_failed(false)
+{
+}
+
+
+BytecodeWriter::~BytecodeWriter()
+{
+    close();
+}
+
+
+bool
+BytecodeWriter::open(const char *filename, unsigned long long version)
+{
+    assert(!m_file);
+
+    m_file = fopen(filename, "wb");
+    if (!m_file) {
+        return false;
+    }
+    m_offset = 0;
+    m_failed = false;
+
+    write(bytecodeMagic, sizeof bytecodeMagic);
+    write(bytecodeByteOrder);
+    write(static_cast<uint32_t>(sizeof(wchar_t)));
+    write(static_cast<uint64_t>(version));
+
+    return true;
+}
+
+
+bool
+BytecodeWriter::close(void)
+{
+    if (m_file) {
+        if (fclose(m_file) != 0) {
+            m_failed = true;
+        }
+        m_file = NULL;
+    }
+
+    functions.clear();
+    structs.clear();
+    enums.clear();
+    bitmasks.clear();
+
+    return !m_failed;
+}
+
+
+void
+BytecodeWriter::write(const void *data, size_t size)
+{
+    if (fwrite(data, 1, size, m_file) != size) {
+        m_failed = true;
+    }
+    m_offset += size;
+}
+
+
+void
+BytecodeWriter::align(size_t alignment)
+{
+    static const char zeros[pageSize] = {0};
+    size_t padding = (alignment - m_offset % alignment) % alignment;
+    write(zeros, padding);
+}
+
+
+void
+BytecodeWriter::writeString(const char *str)
+{
+    uint32_t len = static_cast<uint32_t>(strlen(str));
+    write(len);
+    write(str, len + 1);
+}
+
+
+template< class T >
+static inline bool
+lookup(std::vector<bool> &map, const T *sig) {
+    if (sig->id >= map.size()) {
+        map.resize(sig->id + 1);
+    } else if (map[sig->id]) {
+        return true;
+    }
+    map[sig->id] = true;
+    return false;
+}
+
+
+void
+BytecodeWriter::writeSig(const FunctionSig *sig)
+{
+    if (lookup(functions, sig)) {
+        return;
+    }
+    write(static_cast<uint8_t>(RECORD_FUNCTION));
+    write(static_cast<uint32_t>(sig->id));
+    writeString(sig->name);
+    write(static_cast<uint32_t>(sig->num_args));
+    for (unsigned i = 0; i < sig->num_args; ++i) {
+        writeString(sig->arg_names[i]);
+    }
+}
+
+
+void
+BytecodeWriter::writeSig(const StructSig *sig)
+{
+    if (lookup(structs, sig)) {
+        return;
+    }
+    write(static_cast<uint8_t>(RECORD_STRUCT));
+    write(static_cast<uint32_t>(sig->id));
+    writeString(sig->name);
+    write(static_cast<uint32_t>(sig->num_members));
+    for (unsigned i = 0; i < sig->num_members; ++i) {
+        writeString(sig->member_names[i]);
+    }
+}
+
+
+void
+BytecodeWriter::writeSig(const EnumSig *sig)
+{
+    if (lookup(enums, sig)) {
+        return;
+    }
+    write(static_cast<uint8_t>(RECORD_ENUM));
+    write(static_cast<uint32_t>(sig->id));
+    write(static_cast<uint32_t>(sig->num_values));
+    for (unsigned i = 0; i < sig->num_values; ++i) {
+        writeString(sig->values[i].name);
+        write(static_cast<int64_t>(sig->values[i].value));
+    }
+}
+
+
+void
+BytecodeWriter::writeSig(const BitmaskSig *sig)
+{
+    if (lookup(bitmasks, sig)) {
+        return;
+    }
+    write(static_cast<uint8_t>(RECORD_BITMASK));
+    write(static_cast<uint32_t>(sig->id));
+    write(static_cast<uint32_t>(sig->num_flags));
+    for (unsigned i = 0; i < sig->num_flags; ++i) {
+        writeString(sig->flags[i].name);
+        write(static_cast<uint64_t>(sig->flags[i].value));
+    }
+}
+
+
+/**
+ * Emits the signatures referred by a value.
+ */
+class BytecodeSigWriter : public Visitor
+{
+protected:
+    BytecodeWriter &writer;
+
+public:
+    BytecodeSigWriter(BytecodeWriter &_writer) :
+        writer(_writer) {
+    }
+
+    void visit(Null *) override {}
+    void visit(Bool *) override {}
+    void visit(SInt *) override {}
+    void visit(UInt *) override {}
+    void visit(Float *) override {}
+    void visit(Double *) override {}
+    void visit(String *) override {}
+    void visit(WString *) override {}
+    void visit(Blob *) override {}
+    void visit(Pointer *) override {}
+
+    void visit(Enum *node) override {
+        writer.writeSig(node->sig);
+    }
+
+    void visit(Bitmask *node) override {
+        writer.writeSig(node->sig);
+    }
+
+    void visit(Struct *node) override {
+        writer.writeSig(node->sig);
+        for (auto & member : node->members) {
+            _visit(member);
+        }
+    }
+
+    void visit(Array *node) override {
+        for (auto & value : node->values) {
+            _visit(value);
+        }
+    }
+
+    void visit(Repr *node) override {
+        _visit(node->humanValue);
+        _visit(node->machineValue);
+    }
+
+    void visit(Value *value) {
+        _visit(value);
+    }
+};
+
+
+class BytecodeValueWriter : public Visitor
+{
+protected:
+    BytecodeWriter &writer;
+
+    inline void tag(unsigned type) {
+        writer.write(static_cast<uint8_t>(type));
+    }
+
+public:
+    BytecodeValueWriter(BytecodeWriter &_writer) :
+        writer(_writer) {
+    }
+
+    void visit(Null *) override {
+        tag(VALUE_NULL);
+    }
+
+    void visit(Bool *node) override {
+        tag(node->value ? VALUE_TRUE : VALUE_FALSE);
+    }
+
+    void visit(SInt *node) override {
+        tag(VALUE_SINT);
+        writer.write(static_cast<int64_t>(node->value));
+    }
+
+    void visit(UInt *node) override {
+        tag(VALUE_UINT);
+        writer.write(static_cast<uint64_t>(node->value));
+    }
+
+    void visit(Float *node) override {
+        tag(VALUE_FLOAT);
+        writer.write(node->value);
+    }
+
+    void visit(Double *node) override {
+        tag(VALUE_DOUBLE);
+        writer.write(node->value);
+    }
+
+    void visit(String *node) override {
+        if (!node->value) {
+            tag(VALUE_NULL);
+            return;
+        }
+        tag(VALUE_STRING);
+        writer.writeString(node->value);
+    }
+
+    void visit(WString *node) override {
+        if (!node->value) {
+            tag(VALUE_NULL);
+            return;
+        }
+        tag(VALUE_WSTRING);
+        uint32_t len = static_cast<uint32_t>(wcslen(node->value));
+        writer.write(len);
+        writer.align(sizeof(wchar_t));
+        writer.write(node->value, (len + 1) * sizeof(wchar_t));
+    }
+
+    void visit(Enum *node) override {
+        tag(VALUE_ENUM);
+        writer.write(static_cast<uint32_t>(node->sig->id));
+        writer.write(static_cast<int64_t>(node->value));
+    }
+
+    void visit(Bitmask *node) override {
+        tag(VALUE_BITMASK);
+        writer.write(static_cast<uint32_t>(node->sig->id));
+        writer.write(static_cast<uint64_t>(node->value));
+    }
+
+    void visit(Struct *node) override {
+        tag(VALUE_STRUCT);
+        writer.write(static_cast<uint32_t>(node->sig->id));
+        for (unsigned i = 0; i < node->sig->num_members; ++i) {
+            visit(node->members[i]);
+        }
+    }
+
+    void visit(Array *node) override {
+        tag(VALUE_ARRAY);
+        writer.write(static_cast<uint32_t>(node->values.size()));
+        for (auto & value : node->values) {
+            visit(value);
+        }
+    }
+
+    void visit(Blob *node) override {
+        tag(VALUE_BLOB);
+        writer.write(static_cast<uint64_t>(node->size));
+        writer.align(blobAlignment(node->size));
+        writer.write(node->buf, node->size);
+    }
+
+    void visit(Pointer *node) override {
+        tag(VALUE_POINTER);
+        writer.write(static_cast<uint64_t>(node->value));
+    }
+
+    void visit(Repr *node) override {
+        tag(VALUE_REPR);
+        visit(node->humanValue);
+        visit(node->machineValue);
+    }
+
+    void visit(Value *value) {
+        if (value) {
+            value->visit(*this);
+        } else {
+            tag(VALUE_ABSENT);
+        }
+    }
+};
+
+
+void
+BytecodeWriter::writeCall(const Call *call)
+{
+    BytecodeSigWriter sigWriter(*this);
+    writeSig(call->sig);
+    for (auto & arg : call->args) {
+        sigWriter.visit(arg.value);
+    }
+    sigWriter.visit(call->ret);
+
+    write(static_cast<uint8_t>(RECORD_CALL));
+    write(static_cast<uint32_t>(call->sig->id));
+    write(static_cast<uint32_t>(call->no));
+    write(static_cast<uint32_t>(call->thread_id));
+    write(static_cast<uint32_t>(call->flags));
+    write(static_cast<uint32_t>(call->args.size()));
+
+    BytecodeValueWriter valueWriter(*this);
+    for (auto & arg : call->args) {
+        valueWriter.visit(arg.value);
+    }
+    valueWriter.visit(call->ret);
+}
+
+
+/*
+ * Values referring to the mapping rather than owning their memory.
+ */
+
+class MappedString : public String
+{
+public:
+    MappedString(const char *_value) : String(_value) {}
+    ~MappedString() { value = NULL; }
+};
+
+
+class MappedWString : public WString
+{
+public:
+    MappedWString(const wchar_t *_value) : WString(_value) {}
+    ~MappedWString() { value = NULL; }
+};
+
+
+class MappedBlob : public Blob
+{
+public:
+    MappedBlob(size_t _size, char *_buf) : Blob(_size, _buf) {}
+    ~MappedBlob() { buf = NULL; bound = false; }
+};
+
+
+/*
+ * Values recycled by BytecodeSlot, by type.  Scalars are reconstructed in
+ * place, while structs and arrays are resized so that their member vectors
+ * keep their capacity.
+ */
+
+template< class T >
+class ValuePool
+{
+public:
+    std::vector<T *> items;
+    size_t used = 0;
+
+    ~ValuePool() {
+        for (auto item : items) {
+            delete item;
+        }
+    }
+
+    template< class... Args >
+    inline T *
+    get(Args... args) {
+        if (used < items.size()) {
+            T *item = items[used++];
+            item->~T();
+            return new (item) T(args...);
+        }
+        T *item = new T(args...);
+        items.push_back(item);
+        ++used;
+        return item;
+    }
+};
+
+
+template<>
+template<>
+inline Struct *
+ValuePool<Struct>::get(StructSig *sig) {
+    if (used < items.size()) {
+        Struct *item = items[used++];
+        item->sig = sig;
+        item->members.resize(sig->num_members);
+        return item;
+    }
+    Struct *item = new Struct(sig);
+    items.push_back(item);
+    ++used;
+    return item;
+}
+
+
+template<>
+template<>
+inline Array *
+ValuePool<Array>::get(uint32_t len) {
+    if (used < items.size()) {
+        Array *item = items[used++];
+        item->values.resize(len);
+        return item;
+    }
+    Array *item = new Array(len);
+    items.push_back(item);
+    ++used;
+    return item;
+}
+
+
+struct BytecodeSlot::Values
+{
+    ValuePool<Null> nulls;
+    ValuePool<Bool> bools;
+    ValuePool<SInt> sints;
+    ValuePool<UInt> uints;
+    ValuePool<Float> floats;
+    ValuePool<Double> doubles;
+    ValuePool<MappedString> strings;
+    ValuePool<MappedWString> wstrings;
+    ValuePool<Enum> enums;
+    ValuePool<Bitmask> bitmasks;
+    ValuePool<Struct> structs;
+    ValuePool<Array> arrays;
+    ValuePool<MappedBlob> blobs;
+    ValuePool<Pointer> pointers;
+    ValuePool<Repr> reprs;
+
+    ~Values() {
+        // Members belong to the pools, not to their parents
+        for (auto item : structs.items) {
+            item->members.clear();
+        }
+        for (auto item : arrays.items) {
+            item->values.clear();
+        }
+    }
+
+    inline ValuePool<Null> &pool(Null *) { return nulls; }
+    inline ValuePool<Bool> &pool(Bool *) { return bools; }
+    inline ValuePool<SInt> &pool(SInt *) { return sints; }
+    inline ValuePool<UInt> &pool(UInt *) { return uints; }
+    inline ValuePool<Float> &pool(Float *) { return floats; }
+    inline ValuePool<Double> &pool(Double *) { return doubles; }
+    inline ValuePool<MappedString> &pool(MappedString *) { return strings; }
+    inline ValuePool<MappedWString> &pool(MappedWString *) { return wstrings; }
+    inline ValuePool<Enum> &pool(Enum *) { return enums; }
+    inline ValuePool<Bitmask> &pool(Bitmask *) { return bitmasks; }
+    inline ValuePool<Struct> &pool(Struct *) { return structs; }
+    inline ValuePool<Array> &pool(Array *) { return arrays; }
+    inline ValuePool<MappedBlob> &pool(MappedBlob *) { return blobs; }
+    inline ValuePool<Pointer> &pool(Pointer *) { return pointers; }
+    inline ValuePool<Repr> &pool(Repr *) { return reprs; }
+
+    void
+    reset(void) {
+        nulls.used = 0;
+        bools.used = 0;
+        sints.used = 0;
+        uints.used = 0;
+        floats.used = 0;
+        doubles.used = 0;
+        strings.used = 0;
+        wstrings.used = 0;
+        enums.used = 0;
+        bitmasks.used = 0;
+        structs.used = 0;
+        arrays.used = 0;
+        blobs.used = 0;
+        pointers.used = 0;
+        reprs.used = 0;
+    }
+};
+
+
+BytecodeSlot::BytecodeSlot() :
+    call(NULL),
+    values(new Values)
+{
+}
+
+
+BytecodeSlot::~BytecodeSlot()
+{
+    if (call) {
+        // Arguments belong to the pools
+        for (auto & arg : call->args) {
+            arg.value = NULL;
+        }
+        call->ret = NULL;
+        delete call;
+    }
+    delete values;
+}
+
+
+class BytecodeReader
+{
+protected:
+    char *begin;
+    char *end;
+    char *p;
+
+    const std::vector<StructSig *> &structs;
+    const std::vector<EnumSig *> &enums;
+    const std::vector<BitmaskSig *> &bitmasks;
+
+    // Where values come from, or NULL to allocate them
+    BytecodeSlot::Values *values;
+
+    template< class T, class... Args >
+    inline T *
+    make(Args... args) {
+        if (values) {
+            return values->pool(static_cast<T *>(NULL)).get(args...);
+        }
+        return new T(args...);
+    }
+
+public:
+    bool ok;
+
+    BytecodeReader(char *_begin, size_t size,
+                   const std::vector<StructSig *> &_structs,
+                   const std::vector<EnumSig *> &_enums,
+                   const std::vector<BitmaskSig *> &_bitmasks,
+                   BytecodeSlot::Values *_values = NULL) :
+        begin(_begin),
+        end(_begin + size),
+        p(_begin),
+        structs(_structs),
+        enums(_enums),
+        bitmasks(_bitmasks),
+        values(_values),
+        ok(true)
+    {}
+
+    inline bool
+    eof(void) const {
+        return p >= end;
+    }
+
+    inline size_t
+    tell(void) const {
+        return p - begin;
+    }
+
+    inline void
+    seek(size_t offset) {
+        p = begin + offset;
+    }
+
+    inline char *
+    skip(size_t size) {
+        if (size > static_cast<size_t>(end - p)) {
+            ok = false;
+            p = end;
+            return NULL;
+        }
+        char *data = p;
+        p += size;
+        return data;
+    }
+
+    template< class T >
+    inline T
+    read(void) {
+        T value = T();
+        const char *data = skip(sizeof value);
+        if (data) {
+            memcpy(&value, data, sizeof value);
+        }
+        return value;
+    }
+
+    inline void
+    align(size_t alignment) {
+        size_t offset = p - begin;
+        skip((alignment - offset % alignment) % alignment);
+    }
+
+    const char *
+    readString(void) {
+        uint32_t len = read<uint32_t>();
+        const char *str = skip(size_t(len) + 1);
+        if (!str || str[len] != '\0') {
+            ok = false;
+            return "";
+        }
+        return str;
+    }
+
+    template< class T >
+    inline T *
+    lookup(const std::vector<T *> &map) {
+        uint32_t id = read<uint32_t>();
+        if (id >= map.size() || !map[id]) {
+            ok = false;
+            return NULL;
+        }
+        return map[id];
+    }
+
+    Value *
+    readValue(void);
+
+    // Like readValue, but without decoding, for validating
+    bool
+    skipValue(void);
+};
+
+
+Value *
+BytecodeReader::readValue(void)
+{
+    uint8_t type = read<uint8_t>();
+    switch (type) {
+    case VALUE_ABSENT:
+        return NULL;
+    case VALUE_NULL:
+        return make<Null>();
+    case VALUE_FALSE:
+        return make<Bool>(false);
+    case VALUE_TRUE:
+        return make<Bool>(true);
+    case VALUE_SINT:
+        return make<SInt>(read<int64_t>());
+    case VALUE_UINT:
+        return make<UInt>(read<uint64_t>());
+    case VALUE_FLOAT:
+        return make<Float>(read<float>());
+    case VALUE_DOUBLE:
+        return make<Double>(read<double>());
+    case VALUE_STRING:
+        return make<MappedString>(readString());
+    case VALUE_WSTRING:
+        {
+            uint32_t len = read<uint32_t>();
+            align(sizeof(wchar_t));
+            const wchar_t *str = reinterpret_cast<const wchar_t *>(skip((size_t(len) + 1) * sizeof(wchar_t)));
+            if (!str || str[len] != 0) {
+                ok = false;
+                return NULL;
+            }
+            return make<MappedWString>(str);
+        }
+    case VALUE_ENUM:
+        {
+            EnumSig *sig = lookup(enums);
+            signed long long value = read<int64_t>();
+            return sig ? make<Enum>(sig, value) : NULL;
+        }
+    case VALUE_BITMASK:
+        {
+            BitmaskSig *sig = lookup(bitmasks);
+            unsigned long long value = read<uint64_t>();
+            return sig ? make<Bitmask>(sig, value) : NULL;
+        }
+    case VALUE_STRUCT:
+        {
+            StructSig *sig = lookup(structs);
+            if (!sig) {
+                return NULL;
+            }
+            Struct *value = make<Struct>(sig);
+            for (unsigned i = 0; i < sig->num_members && ok; ++i) {
+                value->members[i] = readValue();
+            }
+            return value;
+        }
+    case VALUE_ARRAY:
+        {
+            uint32_t len = read<uint32_t>();
+            // Every element takes at least one byte
+            if (len > static_cast<size_t>(end - p)) {
+                ok = false;
+                return NULL;
+            }
+            Array *value = make<Array>(len);
+            for (unsigned i = 0; i < len && ok; ++i) {
+                value->values[i] = readValue();
+            }
+            return value;
+        }
+    case VALUE_BLOB:
+        {
+            uint64_t size = read<uint64_t>();
+            if (size > static_cast<uint64_t>(end - p)) {
+                ok = false;
+                return NULL;
+            }
+            align(blobAlignment(size));
+            char *buf = skip(size);
+            return buf ? make<MappedBlob>(static_cast<size_t>(size), buf) : NULL;
+        }
+    case VALUE_POINTER:
+        return make<Pointer>(read<uint64_t>());
+    case VALUE_REPR:
+        {
+            Value *human = readValue();
+            Value *machine = readValue();
+            return make<Repr>(human, machine);
+        }
+    default:
+        ok = false;
+        return NULL;
+    }
+}
+
+
+bool
+BytecodeReader::skipValue(void)
+{
+    uint8_t type = read<uint8_t>();
+    switch (type) {
+    case VALUE_ABSENT:
+    case VALUE_NULL:
+    case VALUE_FALSE:
+    case VALUE_TRUE:
+        break;
+    case VALUE_SINT:
+    case VALUE_UINT:
+    case VALUE_DOUBLE:
+    case VALUE_POINTER:
+        skip(8);
+        break;
+    case VALUE_FLOAT:
+        skip(sizeof(float));
+        break;
+    case VALUE_STRING:
+        readString();
+        break;
+    case VALUE_WSTRING:
+        {
+            uint32_t len = read<uint32_t>();
+            align(sizeof(wchar_t));
+            const wchar_t *str = reinterpret_cast<const wchar_t *>(skip((size_t(len) + 1) * sizeof(wchar_t)));
+            if (!str || str[len] != 0) {
+                ok = false;
+            }
+        }
+        break;
+    case VALUE_ENUM:
+        lookup(enums);
+        skip(8);
+        break;
+    case VALUE_BITMASK:
+        lookup(bitmasks);
+        skip(8);
+        break;
+    case VALUE_STRUCT:
+        {
+            StructSig *sig = lookup(structs);
+            for (unsigned i = 0; sig && i < sig->num_members && ok; ++i) {
+                skipValue();
+            }
+        }
+        break;
+    case VALUE_ARRAY:
+        {
+            uint32_t len = read<uint32_t>();
+            for (unsigned i = 0; i < len && ok; ++i) {
+                skipValue();
+            }
+        }
+        break;
+    case VALUE_BLOB:
+        {
+            uint64_t size = read<uint64_t>();
+            if (size > static_cast<uint64_t>(end - p)) {
+                ok = false;
+                break;
+            }
+            align(blobAlignment(size));
+            skip(size);
+        }
+        break;
+    case VALUE_REPR:
+        skipValue();
+        skipValue();
+        break;
+    default:
+        ok = false;
+        break;
+    }
+    return ok;
+}
+
+
+template< class T >
+static inline bool
+define(std::vector<T *> &map, unsigned id, T *sig) {
+    if (id >= map.size()) {
+        map.resize(id + 1);
+    } else if (map[id]) {
+        return false;
+    }
+    sig->id = id;
+    map[id] = sig;
+    return true;
+}
+
+
+Call *
+BytecodeParser::readCall(BytecodeReader &reader, BytecodeSlot *slot)
+{
+    FunctionSig *sig = reader.lookup(functions);
+    unsigned no = reader.read<uint32_t>();
+    unsigned thread_id = reader.read<uint32_t>();
+    CallFlags flags = reader.read<uint32_t>();
+    uint32_t num_args = reader.read<uint32_t>();
+    // Every argument takes at least one byte
+    if (!sig || num_args > mapping.size()) {
+        reader.ok = false;
+        return NULL;
+    }
+
+    Call *call;
+    if (slot && slot->call) {
+        call = slot->call;
+        call->thread_id = thread_id;
+        call->sig = sig;
+        call->flags = flags;
+    } else {
+        call = new Call(sig, flags, thread_id);
+        if (slot) {
+            slot->call = call;
+        }
+    }
+    call->no = no;
+    call->args.resize(num_args);
+    for (auto & arg : call->args) {
+        arg.value = reader.readValue();
+    }
+    call->ret = reader.readValue();
+    return call;
+}
+
+
+bool
+BytecodeParser::skipCall(BytecodeReader &reader, CallFlags &flags)
+{
+    FunctionSig *sig = reader.lookup(functions);
+    reader.read<uint32_t>(); // no
+    reader.read<uint32_t>(); // thread_id
+    flags = reader.read<uint32_t>();
+    uint32_t num_args = reader.read<uint32_t>();
+    if (!sig) {
+        reader.ok = false;
+        return false;
+    }
+
+    for (unsigned i = 0; i < num_args && reader.ok; ++i) {
+        reader.skipValue();
+    }
+    reader.skipValue();
+    return reader.ok;
+}
+
+
+BytecodeParser::BytecodeParser() :
+    next(0),
+    m_lastFrame(0),
+    version(0)
+{
+}
+
+
+BytecodeParser::~BytecodeParser()
+{
+    close();
+}
+
+
+bool
+BytecodeParser::open(const char *filename)
+{
+    if (!mapping.open(filename)) {
+        std::cerr << "error: failed to map " << filename << "\n";
+        return false;
+    }
+
+    BytecodeReader reader(mapping.data(), mapping.size(), structs, enums, bitmasks);
+
+    const char *magic = reader.skip(sizeof bytecodeMagic);
+    if (!magic || memcmp(magic, bytecodeMagic, sizeof bytecodeMagic) != 0) {
+        std::cerr << "error: " << filename << " is not replay bytecode\n";
+        close();
+        return false;
+    }
+    if (reader.read<uint32_t>() != bytecodeByteOrder ||
+        reader.read<uint32_t>() != sizeof(wchar_t)) {
+        std::cerr << "error: " << filename << " was compiled for a different architecture\n";
+        close();
+        return false;
+    }
+    version = reader.read<uint64_t>();
+    if (version > TRACE_VERSION) {
+        std::cerr << "error: unsupported trace format version " << version << "\n";
+        close();
+        return false;
+    }
+
+    // Only calls' offsets are kept; they are decoded on demand
+    bool endFrame = false;
+    while (reader.ok && !reader.eof()) {
+        uint8_t record = reader.read<uint8_t>();
+        switch (record) {
+        case RECORD_CALL:
+            {
+                size_t offset = reader.tell();
+                CallFlags flags;
+                if (skipCall(reader, flags)) {
+                    if (endFrame) {
+                        m_lastFrame = offsets.size();
+                    }
+                    endFrame = flags & CALL_FLAG_END_FRAME;
+                    offsets.push_back(offset);
+                }
+            }
+            break;
+        case RECORD_FUNCTION:
+            {
+                FunctionSig *sig = new FunctionSig;
+                unsigned id = reader.read<uint32_t>();
+                sig->name = reader.readString();
+                sig->num_args = reader.read<uint32_t>();
+                if (sig->num_args > mapping.size()) {
+                    sig->num_args = 0;
+                    reader.ok = false;
+                }
+                const char **arg_names = new const char *[sig->num_args];
+                for (unsigned i = 0; i < sig->num_args; ++i) {
+                    arg_names[i] = reader.readString();
+                }
+                sig->arg_names = arg_names;
+                if (!define(functions, id, sig)) {
+                    delete [] sig->arg_names;
+                    delete sig;
+                    reader.ok = false;
+                }
+            }
+            break;
+        case RECORD_STRUCT:
+            {
+                StructSig *sig = new StructSig;
+                unsigned id = reader.read<uint32_t>();
+                sig->name = reader.readString();
+                sig->num_members = reader.read<uint32_t>();
+                if (sig->num_members > mapping.size()) {
+                    sig->num_members = 0;
+                    reader.ok = false;
+                }
+                const char **member_names = new const char *[sig->num_members];
+                for (unsigned i = 0; i < sig->num_members; ++i) {
+                    member_names[i] = reader.readString();
+                }
+                sig->member_names = member_names;
+                if (!define(structs, id, sig)) {
+                    delete [] sig->member_names;
+                    delete sig;
+                    reader.ok = false;
+                }
+            }
+            break;
+        case RECORD_ENUM:
+            {
+                EnumSig *sig = new EnumSig;
+                unsigned id = reader.read<uint32_t>();
+                sig->num_values = reader.read<uint32_t>();
+                if (sig->num_values > mapping.size()) {
+                    sig->num_values = 0;
+                    reader.ok = false;
+                }
+                EnumValue *values = new EnumValue[sig->num_values];
+                for (unsigned i = 0; i < sig->num_values; ++i) {
+                    values[i].name = reader.readString();
+                    values[i].value = reader.read<int64_t>();
+                }
+                sig->values = values;
+                if (!define(enums, id, sig)) {
+                    delete [] sig->values;
+                    delete sig;
+                    reader.ok = false;
+                }
+            }
+            break;
+        case RECORD_BITMASK:
+            {
+                BitmaskSig *sig = new BitmaskSig;
+                unsigned id = reader.read<uint32_t>();
+                sig->num_flags = reader.read<uint32_t>();
+                if (sig->num_flags > mapping.size()) {
+                    sig->num_flags = 0;
+                    reader.ok = false;
+                }
+                BitmaskFlag *flags = new BitmaskFlag[sig->num_flags];
+                for (unsigned i = 0; i < sig->num_flags; ++i) {
+                    flags[i].name = reader.readString();
+                    flags[i].value = reader.read<uint64_t>();
+                }
+                sig->flags = flags;
+                if (!define(bitmasks, id, sig)) {
+                    delete [] sig->flags;
+                    delete sig;
+                    reader.ok = false;
+                }
+            }
+            break;
+        default:
+            reader.ok = false;
+            break;
+        }
+    }
+
+    if (!reader.ok) {
+        std::cerr << "error: " << filename << " is truncated or corrupted\n";
+        close();
+        return false;
+    }
+
+    next = 0;
+
+    return true;
+}
+
+
+void
+BytecodeParser::close(void)
+{
+    offsets.clear();
+    next = 0;
+    m_lastFrame = 0;
+
+    // Names point into the mapping; only the arrays are ours
+    for (auto sig : functions) {
+        if (sig) {
+            delete [] sig->arg_names;
+            delete sig;
+        }
+    }
+    functions.clear();
+
+    for (auto sig : structs) {
+        if (sig) {
+            delete [] sig->member_names;
+            delete sig;
+        }
+    }
+    structs.clear();
+
+    for (auto sig : enums) {
+        if (sig) {
+            delete [] sig->values;
+            delete sig;
+        }
+    }
+    enums.clear();
+
+    for (auto sig : bitmasks) {
+        if (sig) {
+            delete [] sig->flags;
+            delete sig;
+        }
+    }
+    bitmasks.clear();
+
+    mapping.close();
+}
+
+
+Call *
+BytecodeParser::decode(size_t index)
+{
+    assert(index < offsets.size());
+    BytecodeReader reader(mapping.data(), mapping.size(), structs, enums, bitmasks);
+    reader.seek(offsets[index]);
+    Call *call = readCall(reader, NULL);
+    // Validated when opened
+    assert(reader.ok);
+    return call;
+}
+
+
+Call *
+BytecodeParser::decode(size_t index, BytecodeSlot &slot)
+{
+    assert(index < offsets.size());
+    slot.values->reset();
+    BytecodeReader reader(mapping.data(), mapping.size(), structs, enums, bitmasks, slot.values);
+    reader.seek(offsets[index]);
+    Call *call = readCall(reader, &slot);
+    assert(reader.ok);
+    return call;
+}
+
+
+Call *
+BytecodeParser::parse_call(void)
+{
+    if (next >= offsets.size()) {
+        return NULL;
+    }
+
+    return decode(next++);
+}
+
+
+void
+BytecodeParser::getBookmark(ParseBookmark &bookmark)
+{
+    bookmark.offset = File::Offset(next);
+    bookmark.next_call_no = 0;
+}
+
+
+void
+BytecodeParser::setBookmark(const ParseBookmark &bookmark)
+{
+    next = bookmark.offset.chunk;
+}
+
+
+} /* namespace trace */
@@ -0,0 +1,200 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Precompiled replay bytecode.
+ *
+ * A flat, uncompressed and mmappable rendition of a trace, meant to be
+ * replayed many times over.  Calls carry the flags the parser computed,
+ * scalars are stored in native representation, and large blobs are page
+ * aligned so they can be handed to the driver straight from the mapping.
+ *
+ * The encoding is native endian and word size, so bytecode is only meant to
+ * be replayed on the machine (or the same kind of machine) it was compiled
+ * on.
+ */
+
+#pragma once
+
+
+#include <stdio.h>
+
+#include <vector>
+
+#include "os_mmap.hpp"
+#include "trace_parser.hpp"
+
+
+namespace trace {
+
+
+class BytecodeReader;
+
+
+/**
+ * Reusable storage for one decoded call.
+ *
+ * Decoding into a slot recycles the Call and Value objects of the call
+ * previously decoded into it, so once the slot has held calls of every shape
+ * decoding no longer allocates.  The call is valid until the slot is reused
+ * or destroyed, and must not be deleted.
+ */
+class BytecodeSlot
+{
+public:
+    struct Values;
+
+    BytecodeSlot();
+    ~BytecodeSlot();
+
+    BytecodeSlot(const BytecodeSlot &) = delete;
+    BytecodeSlot & operator = (const BytecodeSlot &) = delete;
+
+private:
+    friend class BytecodeParser;
+
+    Call *call;
+    Values *values;
+};
+
+
+class BytecodeWriter
+{
+protected:
+    FILE *m_file;
+    unsigned long long m_offset;
+    bool m_failed;
+
+    std::vector<bool> functions;
+    std::vector<bool> structs;
+    std::vector<bool> enums;
+    std::vector<bool> bitmasks;
+
+public:
+    BytecodeWriter();
+    ~BytecodeWriter();
+
+    bool open(const char *filename, unsigned long long version);
+
+    /**
+     * Returns false if anything failed to be written.
+     */
+    bool close(void);
+
+    inline bool
+    failed(void) const {
+        return m_failed;
+    }
+
+    void writeCall(const Call *call);
+
+    // Used by the value encoder
+    void write(const void *data, size_t size);
+    void align(size_t alignment);
+
+    template< class T >
+    inline void write(const T &value) {
+        write(&value, sizeof value);
+    }
+
+    void writeString(const char *str);
+
+    void writeSig(const FunctionSig *sig);
+    void writeSig(const StructSig *sig);
+    void writeSig(const EnumSig *sig);
+    void writeSig(const BitmaskSig *sig);
+};
+
+
+/**
+ * Validates and indexes the bytecode when opened, and then decodes calls
+ * straight from the mapping on demand, so memory use doesn't grow with the
+ * trace besides the index.
+ *
+ * Strings and blobs are not copied but refer to the mapping, so decoded calls
+ * must not outlive the parser.
+ */
+class BytecodeParser : public AbstractParser
+{
+protected:
+    os::MappedFile mapping;
+
+    std::vector<size_t> offsets;
+    size_t next;
+    size_t m_lastFrame;
+
+    std::vector<FunctionSig *> functions;
+    std::vector<StructSig *> structs;
+    std::vector<EnumSig *> enums;
+    std::vector<BitmaskSig *> bitmasks;
+
+    unsigned long long version;
+
+    Call *readCall(BytecodeReader &reader, BytecodeSlot *slot);
+    bool skipCall(BytecodeReader &reader, CallFlags &flags);
+
+public:
+    BytecodeParser();
+    ~BytecodeParser();
+
+    bool open(const char *filename) override;
+    void close(void) override;
+
+    Call *parse_call(void) override;
+
+    void getBookmark(ParseBookmark &bookmark) override;
+    void setBookmark(const ParseBookmark &bookmark) override;
+
+    unsigned long long getVersion(void) const override {
+        return version;
+    }
+
+    inline size_t
+    size(void) const {
+        return offsets.size();
+    }
+
+    /**
+     * Index of the first call of the last frame, for looping.
+     */
+    inline size_t
+    lastFrame(void) const {
+        return m_lastFrame;
+    }
+
+    /**
+     * Decodes the call at the given index, handing over its ownership.
+     */
+    Call *decode(size_t index);
+
+    /**
+     * Decodes the call at the given index into a slot, without allocating
+     * once the slot is warmed up.
+     */
+    Call *decode(size_t index, BytecodeSlot &slot);
+};
+
+
+} /* namespace trace */
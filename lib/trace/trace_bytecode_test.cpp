@@ -0,0 +1,305 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sstream>
+
+#include "trace_bytecode.hpp"
+#include "trace_dump.hpp"
+
+#include "gtest/gtest.h"
+
+using namespace trace;
+
+
+// Counts allocations, to check that replay doesn't allocate per call
+static size_t allocations = 0;
+
+void *
+operator new(size_t size)
+{
+    ++allocations;
+    void *ptr = malloc(size ? size : 1);
+    if (!ptr) {
+        abort();
+    }
+    return ptr;
+}
+
+void
+operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+
+static const char *args_names[] = {"target", "size", "data", "usage"};
+static const FunctionSig bufferDataSig = {0, "glBufferData", 4, args_names};
+
+static const char *shader_names[] = {"shader", "count", "string", "length"};
+static const FunctionSig shaderSourceSig = {1, "glShaderSource", 4, shader_names};
+
+static const char *swap_names[] = {"dpy", "drawable"};
+static const FunctionSig swapSig = {2, "glXSwapBuffers", 2, swap_names};
+
+static const EnumValue target_values[] = {{"GL_ARRAY_BUFFER", 0x8892}};
+static const EnumSig targetSig = {0, 1, target_values};
+
+static const char *rect_names[] = {"x", "y"};
+static StructSig rectSig = {0, "Rect", 2, rect_names};
+
+
+static std::string
+toString(Call &call)
+{
+    std::stringstream ss;
+    dump(call, ss, DUMP_FLAG_NO_COLOR);
+    return ss.str();
+}
+
+
+TEST(Bytecode, RoundTrip)
+{
+    std::vector<Call *> calls;
+
+    Call *call = new Call(&bufferDataSig, 0, 0);
+    call->no = 0;
+    call->args[0].value = new Enum(&targetSig, 0x8892);
+    call->args[1].value = new UInt(8192);
+    Blob *blob = new Blob(8192);
+    for (size_t i = 0; i < blob->size; ++i) {
+        blob->buf[i] = static_cast<char>(i);
+    }
+    call->args[2].value = blob;
+    call->args[3].value = new SInt(-1);
+    calls.push_back(call);
+
+    call = new Call(&shaderSourceSig, 0, 1);
+    call->no = 1;
+    call->args[0].value = new UInt(3);
+    call->args[1].value = new SInt(2);
+    Array *strings = new Array(2);
+    strings->values[0] = new String(strdup("void main() {}"));
+    strings->values[1] = new Null;
+    call->args[2].value = strings;
+    Struct *rect = new Struct(&rectSig);
+    rect->members[0] = new Float(0.5f);
+    rect->members[1] = new Double(-2.25);
+    call->args[3].value = rect;
+    call->ret = new Bool(true);
+    calls.push_back(call);
+
+    call = new Call(&swapSig, CALL_FLAG_END_FRAME | CALL_FLAG_SWAP_RENDERTARGET, 0);
+    call->no = 2;
+    call->args[0].value = new Pointer(0x1234);
+    call->args[1].value = new Repr(new String(strdup("drawable")), new UInt(42));
+    calls.push_back(call);
+
+    const char *filename = "trace_bytecode_test.bc";
+
+    BytecodeWriter writer;
+    ASSERT_TRUE(writer.open(filename, TRACE_VERSION));
+    for (auto c : calls) {
+        writer.writeCall(c);
+    }
+    EXPECT_TRUE(writer.close());
+
+    BytecodeParser parser;
+    ASSERT_TRUE(parser.open(filename));
+    EXPECT_EQ(TRACE_VERSION, parser.getVersion());
+    ASSERT_EQ(calls.size(), parser.size());
+    EXPECT_EQ(0, parser.lastFrame());
+
+    for (size_t i = 0; i < calls.size(); ++i) {
+        Call *decoded = parser.decode(i);
+        EXPECT_EQ(calls[i]->no, decoded->no);
+        EXPECT_EQ(calls[i]->thread_id, decoded->thread_id);
+        EXPECT_EQ(calls[i]->flags, decoded->flags);
+        EXPECT_EQ(toString(*calls[i]), toString(*decoded));
+        delete decoded;
+    }
+
+    // Large blobs are mapped page aligned, and left untouched
+    Call *decoded = parser.decode(0);
+    Blob *decodedBlob = decoded->args[2].value->toBlob();
+    ASSERT_TRUE(decodedBlob != NULL);
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(decodedBlob->buf) % 4096);
+    EXPECT_EQ(0, memcmp(blob->buf, decodedBlob->buf, blob->size));
+    delete decoded;
+
+    // Calls are decoded again after rewinding
+    ParseBookmark bookmark;
+    parser.getBookmark(bookmark);
+    for (size_t i = 0; i < 2; ++i) {
+        parser.setBookmark(bookmark);
+        for (auto c : calls) {
+            Call *parsed = parser.parse_call();
+            ASSERT_TRUE(parsed != NULL);
+            EXPECT_EQ(toString(*c), toString(*parsed));
+            delete parsed;
+        }
+        EXPECT_TRUE(parser.parse_call() == NULL);
+    }
+
+    parser.close();
+    remove(filename);
+
+    for (auto c : calls) {
+        delete c;
+    }
+}
+
+
+TEST(Bytecode, LastFrame)
+{
+    const char *filename = "trace_bytecode_test_frames.bc";
+
+    BytecodeWriter writer;
+    ASSERT_TRUE(writer.open(filename, TRACE_VERSION));
+    for (unsigned no = 0; no < 5; ++no) {
+        // Two frames, and a trailing call past the last swap
+        bool swap = no == 1 || no == 3;
+        Call call(swap ? &swapSig : &bufferDataSig, swap ? CALL_FLAG_END_FRAME : 0, 0);
+        call.no = no;
+        writer.writeCall(&call);
+    }
+    EXPECT_TRUE(writer.close());
+
+    BytecodeParser parser;
+    ASSERT_TRUE(parser.open(filename));
+    EXPECT_EQ(5, parser.size());
+    EXPECT_EQ(4, parser.lastFrame());
+    parser.close();
+    remove(filename);
+}
+
+
+TEST(Bytecode, SlotsDontAllocate)
+{
+    const char *filename = "trace_bytecode_test_slots.bc";
+
+    // Calls of varying shapes
+    std::vector<Call *> calls;
+    for (unsigned no = 0; no < 12; ++no) {
+        Call *call;
+        switch (no % 3) {
+        case 0:
+            call = new Call(&bufferDataSig, 0, 0);
+            call->args[0].value = new Enum(&targetSig, 0x8892);
+            call->args[1].value = new UInt(64);
+            call->args[2].value = new Blob(64);
+            memset(call->args[2].value->toBlob()->buf, no, 64);
+            call->args[3].value = new SInt(-1);
+            break;
+        case 1:
+            {
+                call = new Call(&shaderSourceSig, 0, 0);
+                call->args[0].value = new UInt(no);
+                Array *strings = new Array(no % 4 + 1);
+                for (auto & value : strings->values) {
+                    value = new String(strdup("void main() {}"));
+                }
+                call->args[1].value = new SInt(strings->size());
+                call->args[2].value = strings;
+                Struct *rect = new Struct(&rectSig);
+                rect->members[0] = new Float(0.5f);
+                rect->members[1] = new Double(no);
+                call->args[3].value = rect;
+                call->ret = new Bool(true);
+            }
+            break;
+        default:
+            call = new Call(&swapSig, CALL_FLAG_END_FRAME, 0);
+            call->args[0].value = new Pointer(0x1234);
+            call->args[1].value = new Repr(new String(strdup("drawable")), new UInt(no));
+            break;
+        }
+        call->no = no;
+        calls.push_back(call);
+    }
+
+    BytecodeWriter writer;
+    ASSERT_TRUE(writer.open(filename, TRACE_VERSION));
+    for (auto c : calls) {
+        writer.writeCall(c);
+    }
+    EXPECT_TRUE(writer.close());
+
+    BytecodeParser parser;
+    ASSERT_TRUE(parser.open(filename));
+    ASSERT_EQ(calls.size(), parser.size());
+
+    // Decode into a ring of slots like the replay loop does, where the first
+    // pass over the trace warms the slots up
+    std::vector<BytecodeSlot> slots(2);
+    for (size_t pass = 0; pass < 2; ++pass) {
+        size_t allocated = 0;
+        for (size_t i = 0; i < calls.size(); ++i) {
+            size_t before = allocations;
+            Call *decoded = parser.decode(i, slots[i % slots.size()]);
+            allocated += allocations - before;
+            EXPECT_EQ(calls[i]->no, decoded->no);
+            EXPECT_EQ(toString(*calls[i]), toString(*decoded));
+        }
+        if (pass > 0) {
+            EXPECT_EQ(0, allocated);
+        }
+    }
+
+    parser.close();
+    remove(filename);
+
+    for (auto c : calls) {
+        delete c;
+    }
+}
+
+
+#ifdef __linux__
+TEST(Bytecode, WriteFailure)
+{
+    BytecodeWriter writer;
+    ASSERT_TRUE(writer.open("/dev/full", TRACE_VERSION));
+
+    Call call(&bufferDataSig, 0, 0);
+    call.args[2].value = new Blob(65536);
+    writer.writeCall(&call);
+
+    EXPECT_TRUE(writer.failed());
+    EXPECT_FALSE(writer.close());
+}
+#endif
+
+
+int
+main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
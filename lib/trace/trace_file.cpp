@@ -32,6 +32,10 @@
 using namespace trace;
 
 
+bool File::timeDecompression = false;
+unsigned long long File::decompressTicks = 0;
+
+
 File::File(void)
 {
 }
@@ -58,3 +62,12 @@ void File::setCurrentOffset(const File::Offset &offset)
     assert(0);
 }
 
+bool File::readRawChunk(uint64_t &chunkOffset, std::string &data)
+{
+    return false;
+}
+
+void File::enableReadAhead(void)
+{
+}
+
@@ -27,6 +27,7 @@
 #pragma once
 
 #include <fstream>
+#include <string>
 #include <stdint.h>
 
 
@@ -64,6 +65,37 @@ public:
     virtual bool supportsOffsets(void) const;
     virtual File::Offset currentOffset(void) const;
     virtual void setCurrentOffset(const File::Offset &offset);
+
+    /*
+     * Chunked formats only: read the chunk at `chunkOffset` as is, (i.e.,
+     * still compressed), and advance `chunkOffset` to the next chunk.  Used
+     * to copy chunks verbatim into another trace.  It moves the read position,
+     * so setCurrentOffset() must be called before reading again.
+     */
+    virtual bool readRawChunk(uint64_t &chunkOffset, std::string &data);
+
+    /*
+     * Chunked formats only: decompress upcoming chunks on a background
+     * thread, so that decompression overlaps with parsing.  Meant for
+     * sequential reading; seeking turns it off again.
+     */
+    virtual void enableReadAhead(void);
+
+    /*
+     * Number of uncompressed bytes read or skipped since the file was
+     * opened.
+     */
+    uint64_t bytesRead(void) const {
+        return m_bytesRead;
+    }
+
+    /*
+     * When set, the time spent reading and decompressing chunks is added to
+     * decompressTicks (in os::getTicks units.)  Only chunked formats account
+     * for it; for streamed ones it is indistinguishable from parsing.
+     */
+    static bool timeDecompression;
+    static unsigned long long decompressTicks;
 protected:
     virtual bool rawOpen(const char *filename) = 0;
     virtual size_t rawRead(void *buffer, size_t length) = 0;
@@ -74,6 +106,7 @@ protected:
 
 protected:
     bool m_isOpened = false;
+    uint64_t m_bytesRead = 0;
 };
 
 inline bool File::isOpened(void) const
@@ -87,6 +120,7 @@ inline bool File::open(const char *filename)
         close();
     }
     m_isOpened = rawOpen(filename);
+    m_bytesRead = 0;
 
     return m_isOpened;
 }
@@ -96,7 +130,9 @@ inline size_t File::read(void *buffer, size_t length)
     if (!m_isOpened) {
         return 0;
     }
-    return rawRead(buffer, length);
+    size_t result = rawRead(buffer, length);
+    m_bytesRead += result;
+    return result;
 }
 
 inline int File::percentRead(void)
@@ -120,7 +156,9 @@ inline int File::getc(void)
     if (!m_isOpened) {
         return -1;
     }
-    return rawGetc();
+    int c = rawGetc();
+    m_bytesRead += c >= 0;
+    return c;
 }
 
 inline bool File::skip(size_t length)
@@ -128,7 +166,11 @@ inline bool File::skip(size_t length)
     if (!m_isOpened) {
         return false;
     }
-    return rawSkip(length);
+    if (!rawSkip(length)) {
+        return false;
+    }
+    m_bytesRead += length;
+    return true;
 }
 
 
@@ -30,6 +30,7 @@
 #include <assert.h>
 #include <string.h>
 
+#include <algorithm>
 #include <iostream>
 
 #include <brotli/dec/decode.h>
@@ -108,6 +109,23 @@ size_t BrotliFile::rawRead(void *buffer, size_t length)
                 }
             }
             next_in = input;
+        } else if (result == BROTLI_RESULT_SUCCESS && available_out) {
+            /* The file may hold several concatenated streams, (as
+             * written by `apitrace repack --brotli --jobs`), so start
+             * over if there is more input. */
+            if (!available_in) {
+                if (m_stream.fail()) {
+                    break;
+                }
+                m_stream.read((char *)input, kFileBufferSize);
+                available_in = m_stream.gcount();
+                next_in = input;
+                if (!available_in) {
+                    break;
+                }
+            }
+            BrotliStateCleanup(&state);
+            BrotliStateInit(&state);
         } else {
             assert(result == BROTLI_RESULT_NEEDS_MORE_OUTPUT ||
                    result == BROTLI_RESULT_SUCCESS);
@@ -134,9 +152,17 @@ void BrotliFile::rawClose()
     m_stream.close();
 }
 
-bool BrotliFile::rawSkip(size_t)
+bool BrotliFile::rawSkip(size_t length)
 {
-    return false;
+    uint8_t buffer[4096];
+    while (length) {
+        size_t chunkLength = std::min(length, sizeof buffer);
+        if (rawRead(buffer, chunkLength) != chunkLength) {
+            return false;
+        }
+        length -= chunkLength;
+    }
+    return true;
 }
 
 int BrotliFile::rawPercentRead(void)
@@ -56,17 +56,17 @@
 
 #include <iostream>
 #include <algorithm>
+#include <deque>
 
 #include <assert.h>
 #include <string.h>
 
+#include "os_thread.hpp"
+#include "os_time.hpp"
 #include "trace_file.hpp"
 #include "trace_snappy.hpp"
 
 
-#define SNAPPY_CHUNK_SIZE (1 * 1024 * 1024)
-
-
 
 using namespace trace;
 
@@ -79,6 +79,8 @@ public:
     virtual bool supportsOffsets(void) const override;
     virtual File::Offset currentOffset(void) const override;
     virtual void setCurrentOffset(const File::Offset &offset) override;
+    virtual bool readRawChunk(uint64_t &chunkOffset, std::string &data) override;
+    virtual void enableReadAhead(void) override;
 protected:
     virtual bool rawOpen(const char *filename) override;
     virtual size_t rawRead(void *buffer, size_t length) override;
@@ -104,12 +106,28 @@ private:
     }
     inline bool endOfData(void) const
     {
+        if (m_readAhead) {
+            // The stream belongs to the read-ahead thread; the end is
+            // reached once its end marker was taken.
+            return m_cacheSize == 0;
+        }
         return m_stream.eof() && freeCacheSize() == 0;
     }
     void flushWriteCache(void);
     void flushReadCache(size_t skipLength = 0);
+    void readChunk(size_t skipLength);
     void createCache(size_t size);
     size_t readCompressedLength();
+
+    struct DecompressedChunk {
+        uint64_t offset;
+        char *data;
+        size_t size;
+    };
+    void decompressChunk(DecompressedChunk &chunk);
+    void readAheadThread(void);
+    void takeReadAheadChunk(void);
+    void disableReadAhead(void);
 private:
     std::ifstream m_stream;
     size_t m_cacheMaxSize;
@@ -121,6 +139,19 @@ private:
 
     uint64_t m_currentChunkOffset;
     std::streampos m_endPos;
+
+    /*
+     * Read-ahead.  While enabled, the stream belongs to the read-ahead
+     * thread, which queues up to READ_AHEAD_CHUNKS decompressed chunks.  An
+     * empty chunk marks the end of the file.
+     */
+    static const size_t READ_AHEAD_CHUNKS = 4;
+    bool m_readAhead = false;
+    bool m_readAheadStop = false;
+    os::thread m_readAheadThread;
+    os::mutex m_readAheadMutex;
+    os::condition_variable m_readAheadCond;
+    std::deque<DecompressedChunk> m_readAheadChunks;
 };
 
 SnappyFile::SnappyFile(void)
@@ -206,6 +237,7 @@ int SnappyFile::rawGetc(void)
 
 void SnappyFile::rawClose(void)
 {
+    disableReadAhead();
     m_stream.close();
     delete [] m_cache;
     m_cache = NULL;
@@ -214,6 +246,20 @@ void SnappyFile::rawClose(void)
 
 void SnappyFile::flushReadCache(size_t skipLength)
 {
+    unsigned long long startTicks = timeDecompression ? os::getTicks() : 0;
+    readChunk(skipLength);
+    if (timeDecompression) {
+        decompressTicks += os::getTicks() - startTicks;
+    }
+}
+
+void SnappyFile::readChunk(size_t skipLength)
+{
+    if (m_readAhead) {
+        takeReadAheadChunk();
+        return;
+    }
+
     //assert(m_cachePtr == m_cache + m_cacheSize);
     m_currentChunkOffset = m_stream.tellg();
     size_t compressedLength;
@@ -304,6 +350,7 @@ File::Offset SnappyFile::currentOffset(void) const
 
 void SnappyFile::setCurrentOffset(const File::Offset &offset)
 {
+    disableReadAhead();
     // to remove eof bit
     m_stream.clear();
     // seek to the start of a chunk
@@ -316,6 +363,26 @@ void SnappyFile::setCurrentOffset(const File::Offset &offset)
 
 }
 
+bool SnappyFile::readRawChunk(uint64_t &chunkOffset, std::string &data)
+{
+    disableReadAhead();
+    m_stream.clear();
+    m_stream.seekg(chunkOffset, std::ios::beg);
+    size_t compressedLength = readCompressedLength();
+    if (!compressedLength) {
+        return false;
+    }
+
+    data.resize(compressedLength);
+    m_stream.read(&data[0], compressedLength);
+    if (m_stream.fail()) {
+        return false;
+    }
+
+    chunkOffset += 4 + compressedLength;
+    return true;
+}
+
 bool SnappyFile::rawSkip(size_t length)
 {
     if (endOfData()) {
@@ -344,10 +411,135 @@ bool SnappyFile::rawSkip(size_t length)
 
 int SnappyFile::rawPercentRead(void)
 {
+    if (m_readAhead) {
+        // The stream position is ahead, and owned by the read-ahead thread
+        return int(100 * (double(m_currentChunkOffset) / double(m_endPos)));
+    }
     return int(100 * (double(m_stream.tellg()) / double(m_endPos)));
 }
 
 
+/*
+ * Read and decompress the next chunk into a new buffer, (an empty chunk at
+ * the end of the file.)  Used by the read-ahead thread.
+ */
+void SnappyFile::decompressChunk(DecompressedChunk &chunk)
+{
+    chunk.offset = m_stream.tellg();
+    chunk.data = NULL;
+    chunk.size = 0;
+
+    size_t compressedLength = readCompressedLength();
+    if (!compressedLength) {
+        chunk.offset = m_endPos;
+        return;
+    }
+
+    m_stream.read((char*)m_compressedCache, compressedLength);
+    bool truncated = m_stream.fail();
+    if (truncated) {
+        std::cerr << "warning: unexpected end of file while reading trace\n";
+        compressedLength = m_stream.gcount();
+    }
+
+    size_t size;
+    if (!snappy::GetUncompressedLength(m_compressedCache, compressedLength,
+                                       &size)) {
+        return;
+    }
+
+    chunk.data = new char[size];
+    if (truncated) {
+        snappy::ByteArraySource source(m_compressedCache, compressedLength);
+        snappy::UncheckedByteArraySink sink(chunk.data);
+        chunk.size = snappy::UncompressAsMuchAsPossible(&source, &sink);
+    } else {
+        snappy::RawUncompress(m_compressedCache, compressedLength, chunk.data);
+        chunk.size = size;
+    }
+}
+
+void SnappyFile::readAheadThread(void)
+{
+    DecompressedChunk chunk;
+    do {
+        decompressChunk(chunk);
+
+        os::unique_lock<os::mutex> lock(m_readAheadMutex);
+        while (!m_readAheadStop &&
+               m_readAheadChunks.size() >= READ_AHEAD_CHUNKS) {
+            m_readAheadCond.wait(lock);
+        }
+        if (m_readAheadStop) {
+            delete [] chunk.data;
+            return;
+        }
+        m_readAheadChunks.push_back(chunk);
+        m_readAheadCond.notify_all();
+    } while (chunk.size != 0);
+}
+
+void SnappyFile::takeReadAheadChunk(void)
+{
+    DecompressedChunk chunk;
+    {
+        os::unique_lock<os::mutex> lock(m_readAheadMutex);
+        while (m_readAheadChunks.empty()) {
+            m_readAheadCond.wait(lock);
+        }
+        chunk = m_readAheadChunks.front();
+        if (chunk.size != 0) {
+            m_readAheadChunks.pop_front();
+            m_readAheadCond.notify_all();
+        }
+    }
+
+    m_currentChunkOffset = chunk.offset;
+    if (chunk.size == 0) {
+        // Leave the end marker queued, for any later reads
+        createCache(0);
+        return;
+    }
+
+    delete [] m_cache;
+    m_cache = chunk.data;
+    m_cacheMaxSize = chunk.size;
+    m_cachePtr = m_cache;
+    m_cacheSize = chunk.size;
+}
+
+void SnappyFile::enableReadAhead(void)
+{
+    if (m_readAhead || !m_stream.is_open() || endOfData()) {
+        return;
+    }
+    m_readAhead = true;
+    m_readAheadStop = false;
+    m_readAheadThread = os::thread(&SnappyFile::readAheadThread, this);
+}
+
+void SnappyFile::disableReadAhead(void)
+{
+    if (!m_readAhead) {
+        return;
+    }
+
+    {
+        os::unique_lock<os::mutex> lock(m_readAheadMutex);
+        m_readAheadStop = true;
+        m_readAheadCond.notify_all();
+    }
+    m_readAheadThread.join();
+    m_readAheadThread = os::thread();
+    m_readAhead = false;
+
+    for (auto & chunk : m_readAheadChunks) {
+        delete [] chunk.data;
+    }
+    m_readAheadChunks.clear();
+}
+
+
 File* File::createSnappy(void) {
     return new SnappyFile;
 }
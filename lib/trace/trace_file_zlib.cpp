@@ -128,9 +128,10 @@ void ZLibFile::rawClose()
     }
 }
 
-bool ZLibFile::rawSkip(size_t)
+bool ZLibFile::rawSkip(size_t length)
 {
-    return false;
+    // zlib emulates forward seeks on read streams by decompressing
+    return gzseek(m_gzFile, z_off_t(length), SEEK_CUR) != -1;
 }
 
 int ZLibFile::rawPercentRead(void)
@@ -44,6 +44,8 @@ Call::~Call() {
     if (ret) {
         delete ret;
     }
+
+    delete backtrace;
 }
 
 Value &
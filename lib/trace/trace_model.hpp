@@ -31,6 +31,7 @@
 
 
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 #include <map>
@@ -350,6 +351,15 @@ public:
     size_t size;
     char *buf;
     bool bound;
+
+protected:
+    // For subclasses wrapping memory they don't own.  They must reset `buf`
+    // in their destructor.
+    Blob(size_t _size, char *_buf) :
+        size(_size),
+        buf(_buf),
+        bound(false)
+    {}
 };
 
 
@@ -565,13 +575,21 @@ public:
     CallFlags flags;
     Backtrace* backtrace;
 
+    // Uncompressed size of the call's enter and leave events in the trace
+    // file (as filled by the parser, including any signature definitions),
+    // and how much of that is blob data.
+    uint64_t encodedSize;
+    uint64_t blobSize;
+
     Call(const FunctionSig *_sig, const CallFlags &_flags, unsigned _thread_id) :
         thread_id(_thread_id), 
         sig(_sig), 
         args(_sig->num_args), 
         ret(0),
         flags(_flags),
-        backtrace(0) {
+        backtrace(0),
+        encodedSize(0),
+        blobSize(0) {
     }
 
     ~Call();
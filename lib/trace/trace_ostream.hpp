@@ -39,6 +39,14 @@ public:
 
     virtual bool write(const void *buffer, size_t length) = 0;
     virtual void flush(void) = 0;
+
+    /*
+     * Chunked formats only: end the current chunk, and append an already
+     * compressed one, as obtained from File::readRawChunk.
+     */
+    virtual bool writeRawChunk(const void *buffer, size_t length) {
+        return false;
+    }
 };
 
 
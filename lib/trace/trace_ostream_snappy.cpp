@@ -38,9 +38,6 @@
 #include "trace_snappy.hpp"
 
 
-#define SNAPPY_CHUNK_SIZE (1 * 1024 * 1024)
-
-
 using namespace trace;
 
 
@@ -52,6 +49,7 @@ public:
     SnappyOutStream(void);
     bool write(const void *buffer, size_t length) override;
     void flush(void) override;
+    bool writeRawChunk(const void *buffer, size_t length) override;
     bool isOpen(void) {
         return m_stream.is_open();
     }
@@ -164,6 +162,14 @@ void SnappyOutStream::flush(void)
     m_stream.flush();
 }
 
+bool SnappyOutStream::writeRawChunk(const void *buffer, size_t length)
+{
+    flushWriteCache();
+    writeCompressedLength(length);
+    m_stream.write((const char *)buffer, length);
+    return !m_stream.fail();
+}
+
 void SnappyOutStream::flushWriteCache(void)
 {
     size_t inputLength = usedCacheSize();
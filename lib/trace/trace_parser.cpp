@@ -47,6 +47,9 @@ Parser::Parser() {
     api = API_UNKNOWN;
 
     glGetErrorSig = NULL;
+    scanFilter = NULL;
+    eventStart = 0;
+    eventBlobSize = 0;
 }
 
 
@@ -169,9 +172,38 @@ void Parser::setBookmark(const ParseBookmark &bookmark) {
 }
 
 
+template<class T>
+static void
+getDefined(const std::vector<T *> &map, const File::Offset &offset, std::vector<bool> &defined)
+{
+    defined.assign(map.size(), false);
+    for (size_t id = 0; id < map.size(); ++id) {
+        if (map[id] && map[id]->fileOffset <= offset) {
+            defined[id] = true;
+        }
+    }
+}
+
+
+void Parser::getDefinitions(const File::Offset &offset,
+                            std::vector<bool> &functionsDefined,
+                            std::vector<bool> &structsDefined,
+                            std::vector<bool> &enumsDefined,
+                            std::vector<bool> &bitmasksDefined,
+                            std::vector<bool> &framesDefined) const {
+    getDefined(functions, offset, functionsDefined);
+    getDefined(structs, offset, structsDefined);
+    getDefined(enums, offset, enumsDefined);
+    getDefined(bitmasks, offset, bitmasksDefined);
+    getDefined(frames, offset, framesDefined);
+}
+
+
 Call *Parser::parse_call(Mode mode) {
     do {
         Call *call;
+        eventStart = file->bytesRead();
+        eventBlobSize = 0;
         int c = read_byte();
         switch (c) {
         case trace::EVENT_ENTER:
@@ -239,6 +271,7 @@ Parser::parse_function_sig(void) {
         }
         sig->arg_names = arg_names;
         sig->flags = lookupCallFlags(sig->name);
+        sig->parseDetails = scanFilter && scanFilter(sig->name);
         sig->fileOffset = file->currentOffset();
         functions[id] = sig;
 
@@ -438,7 +471,13 @@ void Parser::parse_enter(Mode mode) {
 
     call->no = next_call_no++;
 
+    if (mode == SCAN && sig->parseDetails) {
+        mode = FULL;
+    }
+
     if (parse_call_details(call, mode)) {
+        call->encodedSize = file->bytesRead() - eventStart;
+        call->blobSize = eventBlobSize;
         calls.push_back(call);
     } else {
         delete call;
@@ -468,7 +507,14 @@ Call *Parser::parse_leave(Mode mode) {
         return NULL;
     }
 
+    if (mode == SCAN &&
+        static_cast<const FunctionSigFlags *>(call->sig)->parseDetails) {
+        mode = FULL;
+    }
+
     if (parse_call_details(call, mode)) {
+        call->encodedSize += file->bytesRead() - eventStart;
+        call->blobSize += eventBlobSize;
         return call;
     } else {
         delete call;
@@ -859,6 +905,7 @@ void Parser::scan_array(void) {
 
 Value *Parser::parse_blob(void) {
     size_t size = read_uint();
+    eventBlobSize += size;
     Blob *blob = new Blob(size);
     if (size) {
         file->read(blob->buf, size);
@@ -869,6 +916,7 @@ Value *Parser::parse_blob(void) {
 
 void Parser::scan_blob(void) {
     size_t size = read_uint();
+    eventBlobSize += size;
     if (size) {
         file->skip(size);
     }
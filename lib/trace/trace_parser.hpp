@@ -75,6 +75,8 @@ protected:
 
     struct FunctionSigFlags : public FunctionSig {
         CallFlags flags;
+        // Whether to parse the arguments of this call even when scanning.
+        bool parseDetails;
     };
 
     // Helper template that extends a base signature structure, with additional
@@ -107,6 +109,16 @@ protected:
 
     FunctionSig *glGetErrorSig;
 
+public:
+    typedef bool (*FunctionFilter)(const char *name);
+
+protected:
+    FunctionFilter scanFilter;
+
+    // Where the event being parsed started, and how many blob bytes it had.
+    uint64_t eventStart;
+    uint64_t eventBlobSize;
+
     unsigned next_call_no;
 
     unsigned long long version;
@@ -147,6 +159,42 @@ public:
         return parse_call(SCAN);
     }
 
+    /*
+     * Select which functions scan_call() should still parse fully.  The
+     * filter is consulted once per signature, so lightweight analyses can
+     * inspect the arguments of the few calls they care about while skipping
+     * over the rest.  Must be set before parsing starts.
+     */
+    void setScanFilter(FunctionFilter filter) {
+        scanFilter = filter;
+    }
+
+    /* Decompress ahead of parsing, (see File::enableReadAhead.) */
+    void enableReadAhead(void) {
+        file->enableReadAhead();
+    }
+
+    /* Uncompressed bytes consumed so far, (see File::bytesRead.) */
+    uint64_t bytesRead(void) const {
+        return file->bytesRead();
+    }
+
+    /* Whether some calls were entered but not left yet. */
+    bool hasPendingCalls(void) const {
+        return !calls.empty();
+    }
+
+    /*
+     * Which signatures have their definition before the given offset, (as
+     * needed by Writer::resync.)
+     */
+    void getDefinitions(const File::Offset &offset,
+                        std::vector<bool> &functionsDefined,
+                        std::vector<bool> &structsDefined,
+                        std::vector<bool> &enumsDefined,
+                        std::vector<bool> &bitmasksDefined,
+                        std::vector<bool> &framesDefined) const;
+
 protected:
     Call *parse_call(Mode mode);
 
@@ -244,5 +292,15 @@ AbstractParser *
 lastFrameLoopParser(AbstractParser *parser, int loopCount);
 
 
+/*
+ * Callback invoked for every call as soon as it is parsed, up to `distance`
+ * calls before it is returned by parse_call.  The call must not be retained.
+ */
+typedef void (*LookaheadCallback)(Call &call);
+
+AbstractParser *
+lookaheadParser(AbstractParser *parser, unsigned distance, LookaheadCallback callback);
+
+
 } /* namespace trace */
 
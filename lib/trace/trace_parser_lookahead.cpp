@@ -0,0 +1,159 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <deque>
+
+#include "trace_parser.hpp"
+
+
+namespace trace {
+
+
+// Decorator for parser which parses ahead, so that upcoming calls can be
+// inspected before they are replayed
+class LookaheadParser : public AbstractParser  {
+public:
+    LookaheadParser(AbstractParser *p, unsigned d, LookaheadCallback c) {
+        parser = p;
+        distance = d;
+        callback = c;
+        eof = false;
+    }
+
+    ~LookaheadParser() {
+        clear();
+        delete parser;
+    }
+
+    Call *parse_call(void) override;
+
+    void getBookmark(ParseBookmark &bookmark) override;
+    void setBookmark(const ParseBookmark &bookmark) override;
+    bool open(const char *filename) override;
+    void close(void) override;
+
+    // Delegate to Parser
+    unsigned long long getVersion(void) const override { return parser->getVersion(); }
+private:
+    struct Pending {
+        ParseBookmark bookmark;
+        Call *call;
+    };
+
+    AbstractParser *parser;
+    unsigned distance;
+    LookaheadCallback callback;
+    std::deque<Pending> pending;
+    bool eof;
+
+    void
+    clear(void);
+};
+
+
+void
+LookaheadParser::clear(void)
+{
+    for (auto & entry : pending) {
+        delete entry.call;
+    }
+    pending.clear();
+    eof = false;
+}
+
+
+bool
+LookaheadParser::open(const char *filename)
+{
+    clear();
+    return parser->open(filename);
+}
+
+
+void
+LookaheadParser::close(void)
+{
+    clear();
+    parser->close();
+}
+
+
+Call *
+LookaheadParser::parse_call(void)
+{
+    while (!eof && pending.size() <= distance) {
+        Pending entry;
+        parser->getBookmark(entry.bookmark);
+        entry.call = parser->parse_call();
+        if (!entry.call) {
+            eof = true;
+            break;
+        }
+        callback(*entry.call);
+        pending.push_back(entry);
+    }
+
+    if (pending.empty()) {
+        return NULL;
+    }
+
+    Call *call = pending.front().call;
+    pending.pop_front();
+    return call;
+}
+
+
+/*
+ * Bookmarks refer to the next call to be returned, not the next call to be
+ * parsed.
+ */
+void
+LookaheadParser::getBookmark(ParseBookmark &bookmark)
+{
+    if (pending.empty()) {
+        parser->getBookmark(bookmark);
+    } else {
+        bookmark = pending.front().bookmark;
+    }
+}
+
+
+void
+LookaheadParser::setBookmark(const ParseBookmark &bookmark)
+{
+    clear();
+    parser->setBookmark(bookmark);
+}
+
+
+AbstractParser *
+lookaheadParser(AbstractParser *parser, unsigned distance, LookaheadCallback callback)
+{
+    return new LookaheadParser(parser, distance, callback);
+}
+
+
+} /* namespace trace */
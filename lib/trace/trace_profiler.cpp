@@ -27,6 +27,9 @@
 #include "trace_profiler.hpp"
 #include "os_time.hpp"
 #include <iostream>
+#include <algorithm>
+#include <iomanip>
+#include <stdio.h>
 #include <string.h>
 #include <sstream>
 
@@ -40,23 +43,54 @@ Profiler::Profiler()
       cpuTimes(false),
       gpuTimes(true),
       pixelsDrawn(false),
-      memoryUsage(false)
+      memoryUsage(false),
+      format(FORMAT_TEXT),
+      lastNo(0),
+      lastGpuStart(0),
+      lastCpuStart(0),
+      lastVsizeStart(0),
+      lastRssStart(0),
+      firstEvent(true),
+      frameNo(0),
+      frameStart(-1),
+      lastCpuEnd(0)
 {
 }
 
 Profiler::~Profiler()
 {
+    flush();
+
+    if (format == FORMAT_CHROME) {
+        std::cout << "\n]\n";
+        std::cout.flush();
+    }
 }
 
-void Profiler::setup(bool cpuTimes_, bool gpuTimes_, bool pixelsDrawn_, bool memoryUsage_)
+void Profiler::setup(bool cpuTimes_, bool gpuTimes_, bool pixelsDrawn_, bool memoryUsage_,
+                     Format format_)
 {
     cpuTimes = cpuTimes_;
     gpuTimes = gpuTimes_;
     pixelsDrawn = pixelsDrawn_;
     memoryUsage = memoryUsage_;
+    format = format_;
     totalGpuTime = 0;
     totalCpuTime = 0;
-    std::cout << "# call no gpu_start gpu_dura cpu_start cpu_dura vsize_start vsize_dura rss_start rss_dura pixels program name" << std::endl;
+
+    if (format == FORMAT_BINARY) {
+        char header[PROFILE_HEADER_SIZE] = PROFILE_MAGIC;
+        header[PROFILE_HEADER_SIZE - 1] = PROFILE_VERSION;
+        std::cout.write(header, sizeof header);
+        chunk.reserve(PROFILE_CHUNK_SIZE + 256);
+    } else if (format == FORMAT_CHROME) {
+        // The closing bracket is optional in the trace event format, so
+        // the output remains loadable even if the replay is interrupted.
+        std::cout << "[";
+        writeThreadName(0, 0, "frames");
+    } else {
+        ProfileTextWriter(std::cout).writeHeader();
+    }
 }
 
 int64_t Profiler::getBaseCpuTime()
@@ -111,7 +145,8 @@ void Profiler::addCall(unsigned no,
                        int64_t gpuStart, int64_t gpuDuration,
                        int64_t cpuStart, int64_t cpuDuration,
                        int64_t vsizeStart, int64_t vsizeDuration,
-                       int64_t rssStart, int64_t rssDuration)
+                       int64_t rssStart, int64_t rssDuration,
+                       unsigned thread)
 {
     if (gpuTimes && gpuStart) {
         gpuStart -= baseGpuTime;
@@ -143,52 +178,602 @@ void Profiler::addCall(unsigned no,
     totalGpuTime += gpuDuration;
     totalCpuTime += cpuDuration;
 
-    std::cout << "call"
-              << " " << no
-              << " " << gpuStart
-              << " " << gpuDuration
-              << " " << cpuStart
-              << " " << cpuDuration
-              << " " << vsizeStart
-              << " " << vsizeDuration
-              << " " << rssStart
-              << " " << rssDuration
-              << " " << pixels
-              << " " << program
-              << " " << name
-              << std::endl;
+    if (format == FORMAT_TEXT) {
+        Profile::Call call;
+        call.no = no;
+        call.program = program;
+        call.gpuStart = gpuStart;
+        call.gpuDuration = gpuDuration;
+        call.cpuStart = cpuStart;
+        call.cpuDuration = cpuDuration;
+        call.vsizeStart = vsizeStart;
+        call.vsizeDuration = vsizeDuration;
+        call.rssStart = rssStart;
+        call.rssDuration = rssDuration;
+        call.pixels = pixels;
+        call.function = 0;
+        ProfileTextWriter(std::cout).visitCall(call, name);
+        return;
+    }
+
+    if (format == FORMAT_CHROME) {
+        if (lastGpuEnd.find(thread) == lastGpuEnd.end()) {
+            std::ostringstream trackName;
+            trackName << "thread " << thread;
+            writeThreadName(1, thread, trackName.str().c_str());
+            writeThreadName(2, thread, trackName.str().c_str());
+            lastGpuEnd[thread] = 0;
+        }
+
+        if (frameStart < 0) {
+            frameStart = cpuStart;
+        }
+        if (lastCpuEnd < cpuStart + cpuDuration) {
+            lastCpuEnd = cpuStart + cpuDuration;
+        }
+
+        beginEvent("X", 1, thread, cpuStart);
+        std::cout << ",\"dur\":";
+        writeTime(cpuDuration);
+        std::cout << ",\"name\":";
+        writeString(name);
+        std::cout << ",\"args\":{\"call\":" << no
+                  << ",\"program\":" << program;
+        if (pixels > 0) {
+            std::cout << ",\"pixels\":" << pixels;
+        }
+        std::cout << "}}";
+
+        if (gpuDuration) {
+            // Without GPU timestamps, lay GPU work out back to back, never
+            // starting before the CPU submitted it.
+            int64_t &gpuEnd = lastGpuEnd[thread];
+            if (!gpuStart) {
+                gpuStart = std::max(gpuEnd, cpuStart);
+            }
+            gpuEnd = gpuStart + gpuDuration;
+
+            beginEvent("X", 2, thread, gpuStart);
+            std::cout << ",\"dur\":";
+            writeTime(gpuDuration);
+            std::cout << ",\"name\":";
+            writeString(name);
+            std::cout << ",\"args\":{\"call\":" << no
+                      << ",\"program\":" << program << "}}";
+        }
+        return;
+    }
+
+    unsigned function;
+    auto it = functionIds.find(name);
+    if (it == functionIds.end()) {
+        function = unsigned(functionIds.size());
+        functionIds[name] = function;
+        writeFunction(function, name);
+    } else {
+        function = it->second;
+    }
+
+    unsigned fields = 0;
+    if (gpuStart || gpuDuration) {
+        fields |= PROFILE_FIELD_GPU;
+    }
+    if (cpuStart || cpuDuration) {
+        fields |= PROFILE_FIELD_CPU;
+    }
+    if (vsizeStart || vsizeDuration || rssStart || rssDuration) {
+        fields |= PROFILE_FIELD_MEMORY;
+    }
+    if (pixels) {
+        fields |= PROFILE_FIELD_PIXELS;
+    }
+    if (program) {
+        fields |= PROFILE_FIELD_PROGRAM;
+    }
+
+    chunk.push_back(PROFILE_RECORD_CALL);
+    chunk.push_back(char(fields));
+    writeSInt(int64_t(no) - int64_t(lastNo));
+    writeUInt(function);
+    lastNo = no;
+    if (fields & PROFILE_FIELD_PROGRAM) {
+        writeUInt(program);
+    }
+    if (fields & PROFILE_FIELD_GPU) {
+        writeSInt(gpuStart - lastGpuStart);
+        writeSInt(gpuDuration);
+        lastGpuStart = gpuStart;
+    }
+    if (fields & PROFILE_FIELD_CPU) {
+        writeSInt(cpuStart - lastCpuStart);
+        writeSInt(cpuDuration);
+        lastCpuStart = cpuStart;
+    }
+    if (fields & PROFILE_FIELD_MEMORY) {
+        writeSInt(vsizeStart - lastVsizeStart);
+        writeSInt(vsizeDuration);
+        writeSInt(rssStart - lastRssStart);
+        writeSInt(rssDuration);
+        lastVsizeStart = vsizeStart;
+        lastRssStart = rssStart;
+    }
+    if (fields & PROFILE_FIELD_PIXELS) {
+        writeSInt(pixels);
+    }
+    endRecord();
+}
+
+void Profiler::pushMarker(unsigned thread, const char *name, int64_t cpuTime)
+{
+    if (format != FORMAT_CHROME) {
+        return;
+    }
+
+    beginEvent("B", 1, thread, cpuTime - baseCpuTime);
+    std::cout << ",\"name\":";
+    writeString(name);
+    std::cout << "}";
+}
+
+void Profiler::popMarker(unsigned thread, int64_t cpuTime)
+{
+    if (format != FORMAT_CHROME) {
+        return;
+    }
+
+    beginEvent("E", 1, thread, cpuTime - baseCpuTime);
+    std::cout << "}";
+}
+
+void Profiler::beginEvent(const char *phase, unsigned pid, unsigned tid, int64_t ts)
+{
+    // One event per line, timestamps in microseconds.
+    std::cout << (firstEvent ? "\n" : ",\n")
+              << "{\"ph\":\"" << phase << "\""
+              << ",\"pid\":" << pid
+              << ",\"tid\":" << tid
+              << ",\"ts\":";
+    writeTime(ts);
+    firstEvent = false;
+}
+
+void Profiler::writeTime(int64_t ns)
+{
+    // Microseconds, leaving the stream's formatting as it was
+    std::ios_base::fmtflags flags = std::cout.flags();
+    std::streamsize precision = std::cout.precision();
+    std::cout << std::fixed << std::setprecision(3) << ns / 1000.0;
+    std::cout.flags(flags);
+    std::cout.precision(precision);
+}
+
+void Profiler::writeString(const char *s)
+{
+    std::cout << '"';
+    for (const char *c = s ? s : ""; *c; ++c) {
+        unsigned char u = *c;
+        if (u == '"' || u == '\\') {
+            std::cout << '\\' << *c;
+        } else if (u < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof buf, "\\u%04x", u);
+            std::cout << buf;
+        } else {
+            std::cout << *c;
+        }
+    }
+    std::cout << '"';
+}
+
+void Profiler::writeThreadName(unsigned pid, unsigned tid, const char *name)
+{
+    static const char *processNames[] = { "Frames", "CPU", "GPU" };
+
+    beginEvent("M", pid, tid, 0);
+    std::cout << ",\"name\":\"process_name\",\"args\":{\"name\":";
+    writeString(processNames[pid]);
+    std::cout << "}}";
+    beginEvent("M", pid, tid, 0);
+    std::cout << ",\"name\":\"thread_name\",\"args\":{\"name\":";
+    writeString(name);
+    std::cout << "}}";
 }
 
 void Profiler::addFrameEnd()
 {
-    std::cout << "frame_end: gpu " << totalGpuTime << " cpu " << totalCpuTime << std::endl;
+    if (format == FORMAT_CHROME) {
+        if (frameStart >= 0) {
+            beginEvent("X", 0, 0, frameStart);
+            std::cout << ",\"dur\":";
+            writeTime(lastCpuEnd - frameStart);
+            std::cout << ",\"name\":\"frame " << frameNo << "\""
+                      << ",\"args\":{\"gpu\":" << totalGpuTime
+                      << ",\"cpu\":" << totalCpuTime << "}}";
+        }
+        ++frameNo;
+        frameStart = -1;
+    } else if (format == FORMAT_TEXT) {
+        ProfileTextWriter(std::cout).visitFrameEnd(totalGpuTime, totalCpuTime);
+    } else {
+        chunk.push_back(PROFILE_RECORD_FRAME_END);
+        writeSInt(totalGpuTime);
+        writeSInt(totalCpuTime);
+        endRecord();
+    }
     totalGpuTime = 0;
     totalCpuTime = 0;
 }
 
+void Profiler::flush(void)
+{
+    if (format == FORMAT_CHROME) {
+        std::cout.flush();
+        return;
+    }
+
+    if (chunk.empty()) {
+        return;
+    }
+
+    uint32_t size = uint32_t(chunk.size());
+    unsigned char buf[4];
+    buf[0] = size & 0xff;
+    buf[1] = (size >> 8) & 0xff;
+    buf[2] = (size >> 16) & 0xff;
+    buf[3] = (size >> 24) & 0xff;
+    std::cout.write((const char *)buf, sizeof buf);
+    std::cout.write(chunk.data(), chunk.size());
+    std::cout.flush();
+
+    // Every chunk starts afresh, so that it can be decoded on its own.
+    chunk.clear();
+    lastNo = 0;
+    lastGpuStart = 0;
+    lastCpuStart = 0;
+    lastVsizeStart = 0;
+    lastRssStart = 0;
+}
+
+void Profiler::writeFunction(unsigned id, const char *name)
+{
+    size_t len = strlen(name);
+    chunk.push_back(PROFILE_RECORD_FUNCTION);
+    writeUInt(id);
+    writeUInt(len);
+    chunk.insert(chunk.end(), name, name + len);
+}
+
+void Profiler::writeUInt(uint64_t value)
+{
+    do {
+        unsigned char byte = value & 0x7f;
+        value >>= 7;
+        if (value) {
+            byte |= 0x80;
+        }
+        chunk.push_back(char(byte));
+    } while (value);
+}
+
+void Profiler::writeSInt(int64_t value)
+{
+    writeUInt((uint64_t(value) << 1) ^ uint64_t(value >> 63));
+}
+
+void Profiler::endRecord(void)
+{
+    if (chunk.size() >= PROFILE_CHUNK_SIZE) {
+        flush();
+    }
+}
+
+
+unsigned Profile::internFunction(const std::string &name)
+{
+    auto it = functionIds.find(name);
+    if (it != functionIds.end()) {
+        return it->second;
+    }
+    unsigned id = unsigned(functions.size());
+    functions.push_back(name);
+    functionIds[name] = id;
+    return id;
+}
+
+void Profile::addCall(const Call &call)
+{
+    if (lastGpuTime < call.gpuStart + call.gpuDuration) {
+        lastGpuTime = call.gpuStart + call.gpuDuration;
+    }
+
+    if (lastCpuTime < call.cpuStart + call.cpuDuration) {
+        lastCpuTime = call.cpuStart + call.cpuDuration;
+    }
+
+    if (lastVsizeUsage < call.vsizeStart + call.vsizeDuration) {
+        lastVsizeUsage = call.vsizeStart + call.vsizeDuration;
+    }
+
+    if (lastRssUsage < call.rssStart + call.rssDuration) {
+        lastRssUsage = call.rssStart + call.rssDuration;
+    }
+
+    calls.push_back(call);
+
+    if (call.pixels >= 0) {
+        if (programs.size() <= call.program) {
+            programs.resize(call.program + 1);
+        }
+
+        Program& program = programs[call.program];
+        program.cpuTotal += call.cpuDuration;
+        program.gpuTotal += call.gpuDuration;
+        program.pixelTotal += call.pixels;
+        program.vsizeTotal += call.vsizeDuration;
+        program.rssTotal += call.rssDuration;
+        program.calls.push_back((unsigned int)(calls.size() - 1));
+    }
+}
+
+void Profile::addFrameEnd(void)
+{
+    Frame frame;
+    frame.no = unsigned(frames.size());
+
+    if (frame.no == 0) {
+        frame.gpuStart = 0;
+        frame.cpuStart = 0;
+        frame.vsizeStart = 0;
+        frame.rssStart = 0;
+        frame.calls.begin = 0;
+    } else {
+        frame.gpuStart = frames.back().gpuStart + frames.back().gpuDuration;
+        frame.cpuStart = frames.back().cpuStart + frames.back().cpuDuration;
+        frame.vsizeStart = frames.back().vsizeStart + frames.back().vsizeDuration;
+        frame.rssStart = frames.back().rssStart + frames.back().rssDuration;
+        frame.calls.begin = frames.back().calls.end + 1;
+    }
+
+    frame.gpuDuration = lastGpuTime - frame.gpuStart;
+    frame.cpuDuration = lastCpuTime - frame.cpuStart;
+    frame.vsizeDuration = lastVsizeUsage - frame.vsizeStart;
+    frame.rssDuration = lastRssUsage - frame.rssStart;
+    frame.calls.end = (unsigned int)(calls.size() - 1);
+
+    frames.push_back(frame);
+}
+
+
+void ProfileBuilder::visitCall(const Profile::Call &call, const char *name)
+{
+    Profile::Call copy = call;
+    copy.function = profile->internFunction(name);
+    profile->addCall(copy);
+}
+
+void ProfileBuilder::visitFrameEnd(int64_t gpuTotal, int64_t cpuTotal)
+{
+    profile->addFrameEnd();
+}
+
+
+void ProfileTextWriter::writeHeader(void)
+{
+    os << "# call no gpu_start gpu_dura cpu_start cpu_dura vsize_start vsize_dura rss_start rss_dura pixels program name" << std::endl;
+}
+
+void ProfileTextWriter::visitCall(const Profile::Call &call, const char *name)
+{
+    os << "call"
+       << " " << call.no
+       << " " << call.gpuStart
+       << " " << call.gpuDuration
+       << " " << call.cpuStart
+       << " " << call.cpuDuration
+       << " " << call.vsizeStart
+       << " " << call.vsizeDuration
+       << " " << call.rssStart
+       << " " << call.rssDuration
+       << " " << call.pixels
+       << " " << call.program
+       << " " << name
+       << std::endl;
+}
+
+void ProfileTextWriter::visitFrameEnd(int64_t gpuTotal, int64_t cpuTotal)
+{
+    os << "frame_end: gpu " << gpuTotal << " cpu " << cpuTotal << std::endl;
+}
+
+
+bool BinaryProfileParser::checkHeader(const void *data, size_t size)
+{
+    const char *header = static_cast<const char *>(data);
+    return size >= PROFILE_HEADER_SIZE &&
+           memcmp(header, PROFILE_MAGIC, PROFILE_HEADER_SIZE - 1) == 0 &&
+           header[PROFILE_HEADER_SIZE - 1] == PROFILE_VERSION;
+}
+
+namespace {
+
+class ChunkReader
+{
+public:
+    const unsigned char *ptr;
+    const unsigned char *end;
+    bool ok = true;
+
+    ChunkReader(const void *data, size_t size) :
+        ptr(static_cast<const unsigned char *>(data)),
+        end(ptr + size)
+    {}
+
+    inline bool atEnd(void) const {
+        return ptr >= end;
+    }
+
+    inline unsigned readByte(void) {
+        if (ptr >= end) {
+            ok = false;
+            return 0;
+        }
+        return *ptr++;
+    }
+
+    inline uint64_t readUInt(void) {
+        uint64_t value = 0;
+        unsigned shift = 0;
+        unsigned byte;
+        do {
+            byte = readByte();
+            value |= uint64_t(byte & 0x7f) << shift;
+            shift += 7;
+        } while ((byte & 0x80) && ok && shift < 64);
+        return value;
+    }
+
+    inline int64_t readSInt(void) {
+        uint64_t value = readUInt();
+        return int64_t(value >> 1) ^ -int64_t(value & 1);
+    }
+};
+
+} /* anonymous namespace */
+
+bool BinaryProfileParser::parseChunk(const void *data, size_t size, ProfileVisitor &visitor)
+{
+    ChunkReader reader(data, size);
+
+    unsigned lastNo = 0;
+    int64_t lastGpuStart = 0;
+    int64_t lastCpuStart = 0;
+    int64_t lastVsizeStart = 0;
+    int64_t lastRssStart = 0;
+
+    while (reader.ok && !reader.atEnd()) {
+        switch (reader.readByte()) {
+        case PROFILE_RECORD_FUNCTION: {
+            unsigned id = unsigned(reader.readUInt());
+            size_t len = size_t(reader.readUInt());
+            if (!reader.ok || size_t(reader.end - reader.ptr) < len) {
+                return false;
+            }
+            if (functions.size() <= id) {
+                functions.resize(id + 1);
+            }
+            functions[id].assign((const char *)reader.ptr, len);
+            reader.ptr += len;
+            break;
+        }
+        case PROFILE_RECORD_CALL: {
+            Profile::Call call;
+            unsigned fields = reader.readByte();
+            call.no = unsigned(lastNo + reader.readSInt());
+            call.function = unsigned(reader.readUInt());
+            lastNo = call.no;
+
+            call.program = (fields & PROFILE_FIELD_PROGRAM) ? unsigned(reader.readUInt()) : 0;
+
+            call.gpuStart = 0;
+            call.gpuDuration = 0;
+            if (fields & PROFILE_FIELD_GPU) {
+                call.gpuStart = lastGpuStart + reader.readSInt();
+                call.gpuDuration = reader.readSInt();
+                lastGpuStart = call.gpuStart;
+            }
+
+            call.cpuStart = 0;
+            call.cpuDuration = 0;
+            if (fields & PROFILE_FIELD_CPU) {
+                call.cpuStart = lastCpuStart + reader.readSInt();
+                call.cpuDuration = reader.readSInt();
+                lastCpuStart = call.cpuStart;
+            }
+
+            call.vsizeStart = 0;
+            call.vsizeDuration = 0;
+            call.rssStart = 0;
+            call.rssDuration = 0;
+            if (fields & PROFILE_FIELD_MEMORY) {
+                call.vsizeStart = lastVsizeStart + reader.readSInt();
+                call.vsizeDuration = reader.readSInt();
+                call.rssStart = lastRssStart + reader.readSInt();
+                call.rssDuration = reader.readSInt();
+                lastVsizeStart = call.vsizeStart;
+                lastRssStart = call.rssStart;
+            }
+
+            call.pixels = (fields & PROFILE_FIELD_PIXELS) ? reader.readSInt() : 0;
+
+            if (!reader.ok || call.function >= functions.size()) {
+                return false;
+            }
+
+            visitor.visitCall(call, functions[call.function].c_str());
+            break;
+        }
+        case PROFILE_RECORD_FRAME_END: {
+            int64_t gpuTotal = reader.readSInt();
+            int64_t cpuTotal = reader.readSInt();
+            if (!reader.ok) {
+                return false;
+            }
+            visitor.visitFrameEnd(gpuTotal, cpuTotal);
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+
+    return reader.ok;
+}
+
+bool BinaryProfileParser::parse(std::istream &is, ProfileVisitor &visitor)
+{
+    char header[PROFILE_HEADER_SIZE];
+    is.read(header, sizeof header);
+    if (!is || !checkHeader(header, sizeof header)) {
+        return false;
+    }
+
+    std::vector<char> buf;
+    while (true) {
+        unsigned char sizeBuf[4];
+        is.read((char *)sizeBuf, sizeof sizeBuf);
+        if (is.gcount() == 0) {
+            return true;
+        }
+        if (!is) {
+            return false;
+        }
+
+        buf.resize(chunkSize(sizeBuf));
+        is.read(buf.data(), buf.size());
+        if (!is) {
+            return false;
+        }
+
+        if (!parseChunk(buf.data(), buf.size(), visitor)) {
+            return false;
+        }
+    }
+}
+
+
 void Profiler::parseLine(const char* in, Profile* profile)
 {
     std::stringstream line(in, std::ios_base::in);
     std::string type;
-    static int64_t lastGpuTime;
-    static int64_t lastCpuTime;
-    static int64_t lastVsizeUsage;
-    static int64_t lastRssUsage;
 
     if (in[0] == '#' || strlen(in) < 4)
         return;
 
-    if (profile->programs.size() == 0 && profile->calls.size() == 0 && profile->frames.size() == 0) {
-        lastGpuTime = 0;
-        lastCpuTime = 0;
-        lastVsizeUsage = 0;
-        lastRssUsage = 0;
-    }
-
     line >> type;
 
     if (type.compare("call") == 0) {
         Profile::Call call;
+        std::string name;
 
         line >> call.no
              >> call.gpuStart
@@ -201,64 +786,13 @@ void Profiler::parseLine(const char* in, Profile* profile)
              >> call.rssDuration
              >> call.pixels
              >> call.program
-             >> call.name;
-
-        if (lastGpuTime < call.gpuStart + call.gpuDuration) {
-            lastGpuTime = call.gpuStart + call.gpuDuration;
-        }
-
-        if (lastCpuTime < call.cpuStart + call.cpuDuration) {
-            lastCpuTime = call.cpuStart + call.cpuDuration;
-        }
-
-        if (lastVsizeUsage < call.vsizeStart + call.vsizeDuration) {
-            lastVsizeUsage = call.vsizeStart + call.vsizeDuration;
-        }
-
-        if (lastRssUsage < call.rssStart + call.rssDuration) {
-            lastRssUsage = call.rssStart + call.rssDuration;
-        }
-
-        profile->calls.push_back(call);
-
-        if (call.pixels >= 0) {
-            if (profile->programs.size() <= call.program) {
-                profile->programs.resize(call.program + 1);
-            }
-
-            Profile::Program& program = profile->programs[call.program];
-            program.cpuTotal += call.cpuDuration;
-            program.gpuTotal += call.gpuDuration;
-            program.pixelTotal += call.pixels;
-            program.vsizeTotal += call.vsizeDuration;
-            program.rssTotal += call.rssDuration;
-            program.calls.push_back((unsigned int)(profile->calls.size() - 1));
-        }
-    } else if (type.compare("frame_end") == 0) {
-        Profile::Frame frame;
-        frame.no = unsigned(profile->frames.size());
-
-        if (frame.no == 0) {
-            frame.gpuStart = 0;
-            frame.cpuStart = 0;
-            frame.vsizeStart = 0;
-            frame.rssStart = 0;
-            frame.calls.begin = 0;
-        } else {
-            frame.gpuStart = profile->frames.back().gpuStart + profile->frames.back().gpuDuration;
-            frame.cpuStart = profile->frames.back().cpuStart + profile->frames.back().cpuDuration;
-            frame.vsizeStart = profile->frames.back().vsizeStart + profile->frames.back().vsizeDuration;
-            frame.rssStart = profile->frames.back().rssStart + profile->frames.back().rssDuration;
-            frame.calls.begin = profile->frames.back().calls.end + 1;
-        }
-
-        frame.gpuDuration = lastGpuTime - frame.gpuStart;
-        frame.cpuDuration = lastCpuTime - frame.cpuStart;
-        frame.vsizeDuration = lastVsizeUsage - frame.vsizeStart;
-        frame.rssDuration = lastRssUsage - frame.rssStart;
-        frame.calls.end = (unsigned int)(profile->calls.size() - 1);
+             >> name;
 
-        profile->frames.push_back(frame);
+        call.function = profile->internFunction(name);
+        profile->addCall(call);
+    } else if (type.compare("frame_end") == 0 ||
+               type.compare("frame_end:") == 0) {
+        profile->addFrameEnd();
     }
 }
 }
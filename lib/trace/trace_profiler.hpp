@@ -28,6 +28,10 @@
 
 #include <string>
 #include <vector>
+#include <map>
+#include <unordered_map>
+#include <ostream>
+#include <istream>
 #include <stdint.h>
 
 namespace trace
@@ -52,7 +56,8 @@ struct Profile {
 
         int64_t pixels;
 
-        std::string name;
+        /* Index to profile->functions array */
+        unsigned function;
     };
 
     struct Frame {
@@ -77,7 +82,7 @@ struct Profile {
     };
 
     struct Program {
-        Program() : gpuTotal(0), cpuTotal(0), pixelTotal(0) {}
+        Program() : gpuTotal(0), cpuTotal(0), pixelTotal(0), vsizeTotal(0), rssTotal(0) {}
 
         uint64_t gpuTotal;
         uint64_t cpuTotal;
@@ -92,6 +97,147 @@ struct Profile {
     std::vector<Call> calls;
     std::vector<Frame> frames;
     std::vector<Program> programs;
+
+    /* Interned function names, shared by all calls */
+    std::vector<std::string> functions;
+    std::map<std::string, unsigned> functionIds;
+
+    unsigned internFunction(const std::string &name);
+
+    inline const std::string &
+    name(const Call &call) const {
+        return functions[call.function];
+    }
+
+    void addCall(const Call &call);
+    void addFrameEnd(void);
+
+private:
+    int64_t lastGpuTime = 0;
+    int64_t lastCpuTime = 0;
+    int64_t lastVsizeUsage = 0;
+    int64_t lastRssUsage = 0;
+};
+
+
+/*
+ * Binary profile format.
+ * ----------------------
+ *
+ * A compact alternative to the line based text output, selected with
+ * `glretrace --profile-format=binary`.  The stream starts with an 8 bytes
+ * header (the "apiprof" magic followed by the format version), followed by
+ * any number of chunks:
+ *
+ * chunk {
+ *     uint32 - payload length, in little endian
+ *     payload - sequence of records
+ * }
+ *
+ * Each record starts with a PROFILE_RECORD_* byte, and all integers are
+ * encoded as LEB128 variable length numbers (zig-zag encoded when signed).
+ *
+ * Function names are interned: a PROFILE_RECORD_FUNCTION record defines an
+ * id the first time a name is used, and calls refer to it by id afterwards.
+ * Call numbers and start timestamps are delta encoded relative to the
+ * previous call.  Delta state is reset at the start of every chunk, so
+ * chunks can be decoded independently given the function table.
+ */
+
+#define PROFILE_MAGIC "apiprof"
+#define PROFILE_VERSION 1
+#define PROFILE_HEADER_SIZE 8
+#define PROFILE_CHUNK_SIZE (64 * 1024)
+
+enum ProfileRecord {
+    PROFILE_RECORD_FUNCTION = 1,
+    PROFILE_RECORD_CALL,
+    PROFILE_RECORD_FRAME_END,
+};
+
+/* Which optional fields are present on a PROFILE_RECORD_CALL record */
+enum {
+    PROFILE_FIELD_GPU    = (1 << 0),
+    PROFILE_FIELD_CPU    = (1 << 1),
+    PROFILE_FIELD_MEMORY = (1 << 2),
+    PROFILE_FIELD_PIXELS = (1 << 3),
+    PROFILE_FIELD_PROGRAM = (1 << 4),
+};
+
+
+/**
+ * Receives the records of a profile, regardless of its encoding.
+ */
+class ProfileVisitor
+{
+public:
+    virtual ~ProfileVisitor() {}
+
+    virtual void visitCall(const Profile::Call &call, const char *name) = 0;
+    virtual void visitFrameEnd(int64_t gpuTotal, int64_t cpuTotal) = 0;
+};
+
+
+/**
+ * Accumulates profile records into a Profile.
+ */
+class ProfileBuilder : public ProfileVisitor
+{
+public:
+    ProfileBuilder(Profile *profile) : profile(profile) {}
+
+    void visitCall(const Profile::Call &call, const char *name) override;
+    void visitFrameEnd(int64_t gpuTotal, int64_t cpuTotal) override;
+
+private:
+    Profile *profile;
+};
+
+
+/**
+ * Writes profile records in the text format.
+ */
+class ProfileTextWriter : public ProfileVisitor
+{
+public:
+    ProfileTextWriter(std::ostream &os) : os(os) {}
+
+    void writeHeader(void);
+
+    void visitCall(const Profile::Call &call, const char *name) override;
+    void visitFrameEnd(int64_t gpuTotal, int64_t cpuTotal) override;
+
+private:
+    std::ostream &os;
+};
+
+
+/**
+ * Incremental decoder for the binary profile format.
+ *
+ * The caller is responsible for reading the header and framing the chunks,
+ * so that the decoder can be fed from any kind of stream.
+ */
+class BinaryProfileParser
+{
+public:
+    static bool checkHeader(const void *data, size_t size);
+
+    static inline uint32_t
+    chunkSize(const unsigned char buf[4]) {
+        return (uint32_t)buf[0] |
+               ((uint32_t)buf[1] << 8) |
+               ((uint32_t)buf[2] << 16) |
+               ((uint32_t)buf[3] << 24);
+    }
+
+    bool parseChunk(const void *data, size_t size, ProfileVisitor &visitor);
+
+    /* Parse a whole binary profile stream, header included */
+    bool parse(std::istream &is, ProfileVisitor &visitor);
+
+private:
+    std::vector<std::string> functions;
 };
 
 class Profiler
@@ -100,7 +246,14 @@ public:
     Profiler();
     ~Profiler();
 
-    void setup(bool cpuTimes_, bool gpuTimes_, bool pixelsDrawn_, bool memoryUsage_);
+    enum Format {
+        FORMAT_TEXT = 0,
+        FORMAT_BINARY,
+        FORMAT_CHROME,
+    };
+
+    void setup(bool cpuTimes_, bool gpuTimes_, bool pixelsDrawn_, bool memoryUsage_,
+               Format format_ = FORMAT_TEXT);
 
     void addCall(unsigned no,
                  const char* name,
@@ -109,7 +262,12 @@ public:
                  int64_t gpuStart, int64_t gpuDuration,
                  int64_t cpuStart, int64_t cpuDuration,
                  int64_t vsizeStart, int64_t vsizeDuration,
-                 int64_t rssStart, int64_t rssDuration);
+                 int64_t rssStart, int64_t rssDuration,
+                 unsigned thread = 0);
+
+    /* Debug group markers, only used by the timeline formats */
+    void pushMarker(unsigned thread, const char *name, int64_t cpuTime);
+    void popMarker(unsigned thread, int64_t cpuTime);
 
     void addFrameEnd();
 
@@ -125,9 +283,22 @@ public:
     int64_t getBaseVsizeUsage();
     int64_t getBaseRssUsage();
 
+    /* Write out any buffered binary records */
+    void flush(void);
+
     static void parseLine(const char* line, Profile* profile);
 
 private:
+    void writeFunction(unsigned id, const char *name);
+    void writeUInt(uint64_t value);
+    void writeSInt(int64_t value);
+    void endRecord(void);
+
+    void beginEvent(const char *phase, unsigned pid, unsigned tid, int64_t ts);
+    void writeThreadName(unsigned pid, unsigned tid, const char *name);
+    void writeTime(int64_t ns);
+    void writeString(const char *s);
+
     int64_t baseGpuTime;
     int64_t baseCpuTime;
     int64_t minCpuTime;
@@ -140,6 +311,24 @@ private:
     bool gpuTimes;
     bool pixelsDrawn;
     bool memoryUsage;
+
+    Format format;
+
+    /* Binary format state */
+    std::unordered_map<std::string, unsigned> functionIds;
+    std::vector<char> chunk;
+    unsigned lastNo;
+    int64_t lastGpuStart;
+    int64_t lastCpuStart;
+    int64_t lastVsizeStart;
+    int64_t lastRssStart;
+
+    /* Chrome trace event format state */
+    bool firstEvent;
+    unsigned frameNo;
+    int64_t frameStart;
+    int64_t lastCpuEnd;
+    std::map<unsigned, int64_t> lastGpuEnd;
 };
 }
 
@@ -0,0 +1,174 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <sstream>
+
+#include "trace_profiler.hpp"
+
+#include "gtest/gtest.h"
+
+using namespace trace;
+
+
+/**
+ * Redirect std::cout to a string stream for the lifetime of the object, as
+ * the profiler always writes to standard output.
+ */
+class CaptureStdout
+{
+    std::streambuf *saved;
+public:
+    std::stringstream ss;
+
+    CaptureStdout() {
+        saved = std::cout.rdbuf(ss.rdbuf());
+    }
+
+    ~CaptureStdout() {
+        std::cout.rdbuf(saved);
+    }
+};
+
+
+static void
+addCalls(Profiler &profiler)
+{
+    profiler.addCall(10, "glClear", 0, 100, 0, 500, 0, 0, 0, 0, 0, 0);
+    profiler.addCall(11, "glDrawArrays", 3, 200, 700, 1000, 0, 0, 0, 0, 0, 0);
+    profiler.addCall(13, "glDrawArrays", 3, -1, 0, 0, 0, 0, 0, 0, 0, 0);
+    profiler.addFrameEnd();
+    profiler.addCall(20, "glDrawElements", 5, 300, 2000, 250, 0, 0, 0, 0, 0, 0);
+    profiler.addFrameEnd();
+}
+
+
+TEST(trace_profiler, binary_to_text)
+{
+    std::string text;
+    {
+        CaptureStdout capture;
+        Profiler profiler;
+        profiler.setup(false, true, true, false, Profiler::FORMAT_TEXT);
+        addCalls(profiler);
+        text = capture.ss.str();
+    }
+
+    std::string binary;
+    {
+        CaptureStdout capture;
+        Profiler profiler;
+        profiler.setup(false, true, true, false, Profiler::FORMAT_BINARY);
+        addCalls(profiler);
+        profiler.flush();
+        binary = capture.ss.str();
+    }
+
+    EXPECT_LT(binary.size(), text.size());
+
+    std::istringstream is(binary);
+    std::ostringstream os;
+    ProfileTextWriter writer(os);
+    writer.writeHeader();
+    BinaryProfileParser parser;
+    EXPECT_TRUE(parser.parse(is, writer));
+
+    EXPECT_EQ(text, os.str());
+}
+
+
+TEST(trace_profiler, binary_to_profile)
+{
+    std::string binary;
+    {
+        CaptureStdout capture;
+        Profiler profiler;
+        profiler.setup(false, true, true, false, Profiler::FORMAT_BINARY);
+        addCalls(profiler);
+        profiler.flush();
+        binary = capture.ss.str();
+    }
+
+    Profile profile;
+    ProfileBuilder builder(&profile);
+    BinaryProfileParser parser;
+    std::istringstream is(binary);
+    EXPECT_TRUE(parser.parse(is, builder));
+
+    ASSERT_EQ(4, profile.calls.size());
+    ASSERT_EQ(2, profile.frames.size());
+    EXPECT_EQ(3, profile.functions.size());
+
+    EXPECT_EQ(11, profile.calls[1].no);
+    EXPECT_EQ(700, profile.calls[1].gpuStart);
+    EXPECT_EQ(1000, profile.calls[1].gpuDuration);
+    EXPECT_EQ(-1, profile.calls[2].pixels);
+    EXPECT_EQ("glDrawArrays", profile.name(profile.calls[2]));
+    EXPECT_EQ(profile.calls[1].function, profile.calls[2].function);
+
+    EXPECT_EQ(0, profile.frames[0].calls.begin);
+    EXPECT_EQ(2, profile.frames[0].calls.end);
+    EXPECT_EQ(3, profile.frames[1].calls.begin);
+
+    EXPECT_EQ(2, profile.programs[3].calls.size() + profile.programs[5].calls.size());
+}
+
+
+TEST(trace_profiler, chrome)
+{
+    std::string json;
+    std::ios_base::fmtflags flags;
+    std::streamsize precision;
+    {
+        CaptureStdout capture;
+        flags = std::cout.flags();
+        precision = std::cout.precision();
+        {
+            Profiler profiler;
+            profiler.setup(true, true, false, false, Profiler::FORMAT_CHROME);
+            profiler.pushMarker(0, "pass \"a\"\n", 1000);
+            profiler.addCall(1, "glDraw\\Arrays", 3, 0, 0, 500, 1000, 2000, 0, 0, 0, 0);
+            profiler.popMarker(0, 3000);
+            profiler.addFrameEnd();
+        }
+        EXPECT_EQ(flags, std::cout.flags());
+        EXPECT_EQ(precision, std::cout.precision());
+        json = capture.ss.str();
+    }
+
+    EXPECT_NE(std::string::npos, json.find("\"name\":\"pass \\\"a\\\"\\u000a\""));
+    EXPECT_NE(std::string::npos, json.find("\"name\":\"glDraw\\\\Arrays\""));
+    EXPECT_NE(std::string::npos, json.find("\"ts\":1.000,"));
+    EXPECT_NE(std::string::npos, json.find("\"dur\":2.000,"));
+    EXPECT_EQ(std::string::npos, json.find("\n\""));
+}
+
+
+int
+main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
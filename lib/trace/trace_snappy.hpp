@@ -31,4 +31,7 @@
 #define SNAPPY_BYTE1 'a'
 #define SNAPPY_BYTE2 't'
 
+/* Maximum size of an uncompressed chunk. */
+#define SNAPPY_CHUNK_SIZE (1 * 1024 * 1024)
+
 
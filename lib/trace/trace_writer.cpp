@@ -58,7 +58,7 @@ Writer::close(void) {
 }
 
 bool
-Writer::open(const char *filename) {
+Writer::open(const char *filename, bool writeHeader) {
     close();
 
     m_file = createSnappyStream(filename);
@@ -73,7 +73,9 @@ Writer::open(const char *filename) {
     bitmasks.clear();
     frames.clear();
 
-    _writeUInt(TRACE_VERSION);
+    if (writeHeader) {
+        _writeUInt(TRACE_VERSION);
+    }
 
     return true;
 }
@@ -354,6 +356,28 @@ void Writer::writeBitmask(const BitmaskSig *sig, unsigned long long value) {
     _writeUInt(value);
 }
 
+void Writer::writeRaw(const void *data, size_t size) {
+    _write(data, size);
+}
+
+bool Writer::writeRawChunk(const void *data, size_t size) {
+    return m_file->writeRawChunk(data, size);
+}
+
+void Writer::resync(unsigned next_call_no,
+                    const std::vector<bool> &functionsDefined,
+                    const std::vector<bool> &structsDefined,
+                    const std::vector<bool> &enumsDefined,
+                    const std::vector<bool> &bitmasksDefined,
+                    const std::vector<bool> &framesDefined) {
+    call_no = next_call_no;
+    functions = functionsDefined;
+    structs = structsDefined;
+    enums = enumsDefined;
+    bitmasks = bitmasksDefined;
+    frames = framesDefined;
+}
+
 void Writer::writeNull(void) {
     _writeByte(trace::TYPE_NULL);
 }
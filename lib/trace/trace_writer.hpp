@@ -54,7 +54,7 @@ namespace trace {
         Writer();
         ~Writer();
 
-        bool open(const char *filename);
+        bool open(const char *filename, bool writeHeader = true);
         void close(void);
 
         unsigned beginEnter(const FunctionSig *sig, unsigned thread_id);
@@ -102,6 +102,22 @@ namespace trace {
 
         void writeCall(Call *call);
 
+        /*
+         * Verbatim copying of events from an existing trace of the same
+         * version, (used by apitrace trim.)  If the copy includes the trace
+         * header, the writer must be opened without one.  Afterwards, the
+         * writer must be told about the calls and signatures definitions
+         * that were copied with resync().
+         */
+        void writeRaw(const void *data, size_t size);
+        bool writeRawChunk(const void *data, size_t size);
+        void resync(unsigned next_call_no,
+                    const std::vector<bool> &functionsDefined,
+                    const std::vector<bool> &structsDefined,
+                    const std::vector<bool> &enumsDefined,
+                    const std::vector<bool> &bitmasksDefined,
+                    const std::vector<bool> &framesDefined);
+
     protected:
         void inline _write(const void *sBuffer, size_t dwBytesToWrite);
         void inline _writeByte(char c);
@@ -25,6 +25,11 @@
 
 #pragma once
 
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
 #include "glws.hpp"
 #include "retrace.hpp"
 #include "metric_backend.hpp"
@@ -35,11 +40,32 @@
 
 namespace glretrace {
 
+struct PrecompiledShader {
+    GLenum type;
+    GLuint shader;
+};
+
+/*
+ * State of the objects shared by a group of contexts.
+ */
+struct ShareGroup
+{
+    // Shaders compiled by the look-ahead and not handed out yet, indexed by
+    // the number of the glCreateShader call they were compiled for
+    std::map<unsigned, PrecompiledShader> precompiledShaders;
+
+    // Precompiled shaders handed out, whose first compilation is skipped
+    std::set<GLuint> compiledShaders;
+
+    unsigned lookaheadGeneration = 0;
+};
+
 class Context
 {
 public:
-    Context(glws::Context* context)
-        : wsContext(context)
+    Context(glws::Context* context, Context *shareContext = nullptr)
+        : wsContext(context),
+          shareGroup(shareContext ? shareContext->shareGroup : std::make_shared<ShareGroup>())
     {
     }
 
@@ -64,6 +90,10 @@ public:
 
     glws::Context* wsContext;
 
+    // Objects left when the last context of the group is destroyed are
+    // freed along with it
+    std::shared_ptr<ShareGroup> shareGroup;
+
     // Bound drawable
     glws::Drawable *drawable = nullptr;
 
@@ -78,11 +108,28 @@ public:
     bool insideList = false;
     bool needsFlush = false;
 
+    // KHR/ARB_parallel_shader_compile
+    bool parallelShaderCompileChecked = false;
+    bool parallelShaderCompile = false;
+
+    // GL 4.1, GLES 3.0, or ARB/OES_get_program_binary
+    bool programBinaryChecked = false;
+    bool programBinary = false;
+    bool programBinaryOES = false;
+
     bool used = false;
 
     bool KHR_debug = false;
     GLsizei maxDebugMessageLength = 0;
 
+    // Pixel pack buffers available for asynchronous snapshots.  Only kept
+    // while the context is current, as it may be destroyed at any point
+    // after, and buffers shared with other contexts would then outlive it.
+    std::vector<GLuint> snapshotBuffers;
+
+    void
+    deleteSnapshotBuffers(void);
+
     inline glfeatures::Profile
     profile(void) const {
         return wsContext->profile;
@@ -151,10 +198,56 @@ createContext(Context *shareContext = 0);
 bool
 makeCurrent(trace::Call &call, glws::Drawable *drawable, Context *context);
 
+void
+unbindContext(void);
+
+/**
+ * Release all contexts in a window system binding's context map (the current
+ * one must have been unbound first), and clear it.
+ */
+template< class ContextMap >
+inline void
+releaseContexts(ContextMap &contexts) {
+    for (typename ContextMap::iterator it = contexts.begin(); it != contexts.end(); ++it) {
+        it->second->release();
+    }
+    contexts.clear();
+}
+
+/**
+ * Delete all drawables in a window system binding's drawable map, and clear
+ * it.  Several handles (or maps) may refer to the same drawable, so the ones
+ * already deleted are tracked in destroyed.
+ */
+template< class DrawableMap >
+inline void
+destroyDrawables(DrawableMap &drawables, std::set<glws::Drawable *> &destroyed) {
+    for (typename DrawableMap::iterator it = drawables.begin(); it != drawables.end(); ++it) {
+        if (it->second && destroyed.insert(it->second).second) {
+            delete it->second;
+        }
+    }
+    drawables.clear();
+}
+
+template< class DrawableMap >
+inline void
+destroyDrawables(DrawableMap &drawables) {
+    std::set<glws::Drawable *> destroyed;
+    destroyDrawables(drawables, destroyed);
+}
+
 
 void
 checkGlError(trace::Call &call);
 
+/**
+ * Hand back errors which were taken out of the way with glGetError on behalf
+ * of the current call, for checkGlError to report them.
+ */
+void
+restoreGlErrors(const std::vector<GLenum> &errors);
+
 void
 insertCallMarker(trace::Call &call, Context *currentContext);
 
@@ -185,6 +278,20 @@ void listMetricsCLI();
 
 void enableMetricsFromCLI(const char* metrics, QueryBoundary pollingRule);
 
+// Persistent program binary cache
+void
+enableProgramCache(const char *path);
+
+void
+reportProgramCache(void);
+
+// Look-ahead shader compilation
+void
+enableShaderLookahead(void);
+
+void
+deleteStalePrecompiledShaders(Context *context);
+
 GLenum
 blockOnFence(trace::Call &call, GLsync sync, GLbitfield flags);
 
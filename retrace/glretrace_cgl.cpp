@@ -459,6 +459,15 @@ static void retrace_CGLTexImageIOSurface2D(trace::Call &call) {
 }
 
 
+static void resetCgl(void) {
+    unbindContext();
+    releaseContexts(context_map);
+    sharedContext = NULL;
+    destroyDrawables(drawable_map);
+}
+
+static int resetCglRegistered = retrace::addResetCallback(&resetCgl);
+
 const retrace::Entry glretrace::cgl_callbacks[] = {
     {"CGLChoosePixelFormat", &retrace_CGLChoosePixelFormat},
     {"CGLClearDrawable", &retrace_CGLClearDrawable},
@@ -282,6 +282,19 @@ static void retrace_eglSwapBuffers(trace::Call &call) {
     }
 }
 
+static void resetEgl(void) {
+    unbindContext();
+    releaseContexts(context_map);
+    destroyDrawables(drawable_map);
+    delete null_drawable;
+    null_drawable = NULL;
+    profile_map.clear();
+    current_api = EGL_OPENGL_ES_API;
+    last_profile = glfeatures::Profile(glfeatures::API_GLES, 2, 0);
+}
+
+static int resetEglRegistered = retrace::addResetCallback(&resetEgl);
+
 const retrace::Entry glretrace::egl_callbacks[] = {
     {"eglGetError", &retrace::ignore},
     {"eglGetDisplay", &retrace::ignore},
@@ -205,6 +205,8 @@ static void retrace_glXDestroyPbuffer(trace::Call &call) {
     }
 
     delete drawable;
+
+    drawable_map.erase(call.arg(1).toUInt());
 }
 
 static void retrace_glXMakeContextCurrent(trace::Call &call) {
@@ -220,6 +222,14 @@ static void retrace_glXMakeContextCurrent(trace::Call &call) {
     glretrace::makeCurrent(call, new_drawable, new_context);
 }
 
+static void resetGlx(void) {
+    unbindContext();
+    releaseContexts(context_map);
+    destroyDrawables(drawable_map);
+}
+
+static int resetGlxRegistered = retrace::addResetCallback(&resetGlx);
+
 const retrace::Entry glretrace::glx_callbacks[] = {
     //{"glXBindChannelToWindowSGIX", &retrace_glXBindChannelToWindowSGIX},
     //{"glXBindSwapBarrierNV", &retrace_glXBindSwapBarrierNV},
@@ -28,6 +28,7 @@
 
 #include <string.h>
 
+#include <deque>
 #include <map>
 #include <sstream>
 
@@ -38,6 +39,7 @@
 #include "os_time.hpp"
 #include "os_memory.hpp"
 #include "highlight.hpp"
+#include "image.hpp"
 
 /* Synchronous debug output may reduce performance however,
  * without it the callNo in the callback may be inaccurate
@@ -64,6 +66,9 @@ struct CallQuery
 {
     GLuint ids[NUM_QUERIES];
     unsigned call;
+    unsigned thread;
+    trace::CallFlags flags;
+    std::string marker;
     bool isDraw;
     GLuint program;
     const trace::FunctionSig *sig;
@@ -91,9 +96,30 @@ maxWarningCount = 100;
 
 static std::map< uint64_t, unsigned > errorCounts;
 
+static std::vector<GLenum> restoredErrors;
+
+void
+restoreGlErrors(const std::vector<GLenum> &errors) {
+    // Only checkGlError consumes them
+    if (!retrace::debug) {
+        return;
+    }
+    restoredErrors.insert(restoredErrors.end(), errors.begin(), errors.end());
+}
+
+static GLenum
+getGlError(void) {
+    if (!restoredErrors.empty()) {
+        GLenum error = restoredErrors.front();
+        restoredErrors.erase(restoredErrors.begin());
+        return error;
+    }
+    return glGetError();
+}
+
 void
 checkGlError(trace::Call &call) {
-    GLenum error = glGetError();
+    GLenum error = getGlError();
     while (error != GL_NO_ERROR) {
         uint64_t errorHash = call.sig->id ^ uint64_t(error) << 32;
         size_t errorCount = errorCounts[errorHash]++;
@@ -141,7 +167,7 @@ checkGlError(trace::Call &call) {
             os << std::endl;
         }
 
-        error = glGetError();
+        error = getGlError();
     }
 }
 
@@ -258,8 +284,16 @@ completeCallQuery(CallQuery& query) {
 
     glDeleteQueries(NUM_QUERIES, query.ids);
 
+    if (query.flags & trace::CALL_FLAG_MARKER_PUSH) {
+        retrace::profiler.pushMarker(query.thread, query.marker.c_str(), query.cpuStart);
+    }
+
     /* Add call to profile */
-    retrace::profiler.addCall(query.call, query.sig->name, query.program, pixels, gpuStart, gpuDuration, query.cpuStart, cpuDuration, query.vsizeStart, vsizeDuration, query.rssStart, rssDuration);
+    retrace::profiler.addCall(query.call, query.sig->name, query.program, pixels, gpuStart, gpuDuration, query.cpuStart, cpuDuration, query.vsizeStart, vsizeDuration, query.rssStart, rssDuration, query.thread);
+
+    if (query.flags & trace::CALL_FLAG_MARKER_POP) {
+        retrace::profiler.popMarker(query.thread, query.cpuStart + cpuDuration);
+    }
 }
 
 void
@@ -310,6 +344,8 @@ beginProfile(trace::Call &call, bool isDraw) {
     CallQuery query;
     query.isDraw = isDraw;
     query.call = call.no;
+    query.thread = call.thread_id;
+    query.flags = call.flags;
     query.sig = call.sig;
     query.program = currentContext ? currentContext->currentUserProgram : 0;
 
@@ -347,6 +383,15 @@ beginProfile(trace::Call &call, bool isDraw) {
     	//callQueries.push_back(query);
     }
        
+    /* Debug group name (always the last argument of glPushDebugGroup and
+     * glPushGroupMarkerEXT), for timeline profile formats */
+    if ((call.flags & trace::CALL_FLAG_MARKER_PUSH) && !call.args.empty()) {
+        const char *marker = call.args.back().value->toString();
+        if (marker) {
+            query.marker = marker;
+        }
+    }
+
     if (isDraw || retrace::profilingCpuTimes) 
     	callQueries.push_back(query);
         
@@ -602,6 +647,9 @@ frame_complete(trace::Call &call) {
 void
 beforeContextSwitch()
 {
+    // Snapshot pixel buffers belong to the outgoing context
+    retrace::flushSnapshots();
+
     if (profilingContextAcquired && retrace::profilingWithBackends &&
         curMetricBackend)
     {
@@ -820,6 +868,58 @@ debugOutputCallback(GLenum source, GLenum type, GLuint id, GLenum severity,
 
 
 class GLDumper : public retrace::Dumper {
+    struct PendingSnapshot {
+        glretrace::Context *context;
+        GLuint buffer;
+        GLsync sync;
+        image::Image *image;
+        unsigned tag;
+    };
+
+    std::deque<PendingSnapshot> pending;
+
+    // Number of read backs left in flight before blocking on the oldest
+    static const size_t maxPending = 2;
+
+    image::Image *
+    mapSnapshot(const PendingSnapshot &snapshot) {
+        image::Image *image = snapshot.image;
+
+        if (snapshot.context != glretrace::getCurrentContext()) {
+            std::cerr << "warning: snapshot " << snapshot.tag << " read back from another context\n";
+            delete image;
+            return NULL;
+        }
+
+        GLenum result = glClientWaitSync(snapshot.sync, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(snapshot.sync);
+
+        GLint pixel_pack_buffer_binding = 0;
+        glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &pixel_pack_buffer_binding);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, snapshot.buffer);
+
+        GLsizeiptr size = image->height * image->_stride();
+        void *map = NULL;
+        if (result != GL_WAIT_FAILED) {
+            map = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+        }
+        if (map) {
+            memcpy(image->pixels, map, size);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pixel_pack_buffer_binding);
+        snapshot.context->snapshotBuffers.push_back(snapshot.buffer);
+
+        if (!map) {
+            std::cerr << "warning: failed to map snapshot " << snapshot.tag << "\n";
+            delete image;
+            return NULL;
+        }
+
+        return image;
+    }
+
 public:
     image::Image *
     getSnapshot(void) override {
@@ -829,6 +929,64 @@ public:
         return glstate::getDrawBufferImage();
     }
 
+    bool
+    queueSnapshot(unsigned tag) override {
+        glretrace::Context *currentContext = glretrace::getCurrentContext();
+        if (!currentContext) {
+            return false;
+        }
+
+        const glfeatures::Features &features = currentContext->features();
+        if (!features.pixel_buffer_object ||
+            !features.map_buffer_range ||
+            !features.sync) {
+            return false;
+        }
+
+        GLuint buffer = 0;
+        if (currentContext->snapshotBuffers.empty()) {
+            glGenBuffers(1, &buffer);
+        } else {
+            buffer = currentContext->snapshotBuffers.back();
+            currentContext->snapshotBuffers.pop_back();
+        }
+
+        image::Image *image = glstate::getDrawBufferImage(buffer);
+        if (!image) {
+            currentContext->snapshotBuffers.push_back(buffer);
+            return false;
+        }
+
+        GLsync sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        pending.push_back({currentContext, buffer, sync, image, tag});
+
+        return true;
+    }
+
+    image::Image *
+    dequeueSnapshot(unsigned &tag, bool wait) override {
+        while (!pending.empty()) {
+            if (!wait && pending.size() <= maxPending) {
+                GLenum result = glClientWaitSync(pending.front().sync, 0, 0);
+                if (result == GL_TIMEOUT_EXPIRED) {
+                    return NULL;
+                }
+            }
+
+            PendingSnapshot snapshot = pending.front();
+            pending.pop_front();
+
+            image::Image *image = mapSnapshot(snapshot);
+            if (image) {
+                tag = snapshot.tag;
+                return image;
+            }
+        }
+
+        return NULL;
+    }
+
     bool
     canDump(void) override {
         glretrace::Context *currentContext = glretrace::getCurrentContext();
@@ -860,6 +1018,12 @@ void
 retrace::setUp(void) {
     glws::init();
     dumper = &glDumper;
+    if (retrace::programCacheDir) {
+        glretrace::enableProgramCache(retrace::programCacheDir);
+    }
+    if (retrace::lookaheadDistance) {
+        glretrace::enableShaderLookahead();
+    }
 }
 
 
@@ -933,5 +1097,6 @@ retrace::waitForInput(void) {
 
 void
 retrace::cleanUp(void) {
+    glretrace::reportProgramCache();
     glws::cleanup();
 }
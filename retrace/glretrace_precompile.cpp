@@ -0,0 +1,336 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Look-ahead shader compilation.
+ *
+ * The parser is run some calls ahead of the replay, and whenever an upcoming
+ * glCompileShader is seen, a shader object with the same type and source is
+ * created and compiled right away.  With KHR/ARB_parallel_shader_compile the
+ * driver compiles it on its own worker threads, so by the time the replay
+ * reaches the original glCreateShader the precompiled object is handed out
+ * instead, and the subsequent glCompileShader is skipped.
+ *
+ * Precompiled shaders are tracked per share group, so that they can be
+ * handed out on any context sharing objects with the one that compiled them,
+ * and deleted once stale from any of these contexts.
+ *
+ * glCreateShader/glCompileShader are intercepted at the dispatch level, so
+ * the generated retrace code is unaware of this.
+ */
+
+
+#include <assert.h>
+#include <string.h>
+
+#include <map>
+#include <string>
+
+#include "glproc.hpp"
+#include "glretrace.hpp"
+#include "trace_parser.hpp"
+
+
+namespace glretrace {
+
+
+struct TraceShader {
+    unsigned createCallNo;
+    GLenum type;
+    std::string source;
+    bool hasSource;
+};
+
+// Shaders seen by the look-ahead, indexed by their traced names
+static std::map<GLuint, TraceShader> traceShaders;
+
+static bool enabled = false;
+
+// Bumped on reset, to discard what share groups hold from previous replays
+static unsigned generation = 0;
+
+static PFN_GLCREATESHADER real_glCreateShader;
+static PFN_GLCOMPILESHADER real_glCompileShader;
+static PFN_GLDELETESHADER real_glDeleteShader;
+
+
+template< typename Proc >
+static inline Proc
+getProc(Proc &proc, const char *name)
+{
+    if (!proc) {
+        proc = reinterpret_cast<Proc>(_getPrivateProcAddress(name));
+    }
+    return proc;
+}
+
+
+/*
+ * Delete the precompiled shaders of the context's share group whose
+ * glCreateShader call is behind, and return the group.  The context must be
+ * current.
+ */
+static ShareGroup &
+getShareGroup(Context *context)
+{
+    assert(context == getCurrentContext());
+    ShareGroup &group = *context->shareGroup;
+
+    bool reset = group.lookaheadGeneration != generation;
+    group.lookaheadGeneration = generation;
+    if (reset) {
+        group.compiledShaders.clear();
+    }
+
+    std::map<unsigned, PrecompiledShader>::iterator it = group.precompiledShaders.begin();
+    while (it != group.precompiledShaders.end() &&
+           (reset || it->first < retrace::callNo)) {
+        if (getProc(real_glDeleteShader, "glDeleteShader")) {
+            real_glDeleteShader(it->second.shader);
+        }
+        it = group.precompiledShaders.erase(it);
+    }
+
+    return group;
+}
+
+
+void
+deleteStalePrecompiledShaders(Context *context)
+{
+    if (enabled) {
+        getShareGroup(context);
+    }
+}
+
+
+static bool
+supportsParallelCompile(Context *context)
+{
+    if (!context->parallelShaderCompileChecked) {
+        context->parallelShaderCompileChecked = true;
+        glws::Context *wsContext = context->wsContext;
+        if (wsContext->hasExtension("GL_ARB_parallel_shader_compile")) {
+            glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+            context->parallelShaderCompile = true;
+        } else if (wsContext->hasExtension("GL_KHR_parallel_shader_compile")) {
+            typedef void (APIENTRY * PFN_GLMAXSHADERCOMPILERTHREADSKHR)(GLuint count);
+            PFN_GLMAXSHADERCOMPILERTHREADSKHR pfnMaxShaderCompilerThreadsKHR =
+                reinterpret_cast<PFN_GLMAXSHADERCOMPILERTHREADSKHR>(
+                    _getPrivateProcAddress("glMaxShaderCompilerThreadsKHR"));
+            if (pfnMaxShaderCompilerThreadsKHR) {
+                pfnMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+            }
+            context->parallelShaderCompile = true;
+        }
+    }
+    return context->parallelShaderCompile;
+}
+
+
+static void
+precompileShader(const TraceShader &traceShader)
+{
+    if (traceShader.createCallNo <= retrace::callNo) {
+        // Too late
+        return;
+    }
+
+    Context *context = getCurrentContext();
+    if (!context ||
+        context->insideBeginEnd ||
+        context->insideList) {
+        return;
+    }
+
+    ShareGroup &group = getShareGroup(context);
+    if (group.precompiledShaders.find(traceShader.createCallNo) != group.precompiledShaders.end()) {
+        // Compiled more than once
+        return;
+    }
+
+    if (!supportsParallelCompile(context) ||
+        !getProc(real_glCreateShader, "glCreateShader") ||
+        !getProc(real_glCompileShader, "glCompileShader")) {
+        return;
+    }
+
+    GLuint shader = real_glCreateShader(traceShader.type);
+    if (!shader) {
+        return;
+    }
+    const GLchar *string = traceShader.source.c_str();
+    GLint length = traceShader.source.size();
+    glShaderSource(shader, 1, &string, &length);
+    real_glCompileShader(shader);
+
+    PrecompiledShader &precompiled = group.precompiledShaders[traceShader.createCallNo];
+    precompiled.type = traceShader.type;
+    precompiled.shader = shader;
+}
+
+
+static void
+lookahead(trace::Call &call)
+{
+    const char *name = call.name();
+    if (strcmp(name, "glCreateShader") == 0) {
+        if (call.ret) {
+            TraceShader &traceShader = traceShaders[call.ret->toUInt()];
+            traceShader.createCallNo = call.no;
+            traceShader.type = call.arg(0).toUInt();
+            traceShader.source.clear();
+            traceShader.hasSource = false;
+        }
+    } else if (strcmp(name, "glShaderSource") == 0) {
+        std::map<GLuint, TraceShader>::iterator it = traceShaders.find(call.arg(0).toUInt());
+        if (it == traceShaders.end()) {
+            return;
+        }
+        TraceShader &traceShader = it->second;
+        traceShader.source.clear();
+        traceShader.hasSource = false;
+        const trace::Array *strings = call.arg(2).toArray();
+        const trace::Array *lengths = call.arg(3).toArray();
+        if (!strings) {
+            return;
+        }
+        for (size_t i = 0; i < strings->values.size(); ++i) {
+            const char *string = strings->values[i]->toString();
+            if (!string) {
+                return;
+            }
+            GLint length = -1;
+            if (lengths && i < lengths->values.size()) {
+                length = lengths->values[i]->toSInt();
+            }
+            if (length < 0) {
+                traceShader.source.append(string);
+            } else {
+                traceShader.source.append(string, strnlen(string, length));
+            }
+        }
+        traceShader.hasSource = true;
+    } else if (strcmp(name, "glShaderBinary") == 0) {
+        // SPIR-V or vendor binaries; leave these alone
+        const trace::Array *shaders = call.arg(1).toArray();
+        if (shaders) {
+            for (auto value : shaders->values) {
+                traceShaders.erase(value->toUInt());
+            }
+        }
+    } else if (strcmp(name, "glCompileShader") == 0) {
+        std::map<GLuint, TraceShader>::iterator it = traceShaders.find(call.arg(0).toUInt());
+        if (it != traceShaders.end() && it->second.hasSource) {
+            precompileShader(it->second);
+            traceShaders.erase(it);
+        }
+    } else if (strcmp(name, "glDeleteShader") == 0) {
+        traceShaders.erase(call.arg(0).toUInt());
+    }
+}
+
+
+static GLuint APIENTRY
+createShader(GLenum type)
+{
+    Context *context = getCurrentContext();
+    if (context) {
+        ShareGroup &group = getShareGroup(context);
+        std::map<unsigned, PrecompiledShader>::iterator it = group.precompiledShaders.find(retrace::callNo);
+        if (it != group.precompiledShaders.end() &&
+            it->second.type == type) {
+            GLuint shader = it->second.shader;
+            group.precompiledShaders.erase(it);
+            group.compiledShaders.insert(shader);
+            return shader;
+        }
+    }
+
+    if (!getProc(real_glCreateShader, "glCreateShader")) {
+        return 0;
+    }
+    return real_glCreateShader(type);
+}
+
+
+static void APIENTRY
+compileShader(GLuint shader)
+{
+    Context *context = getCurrentContext();
+    if (context) {
+        ShareGroup &group = getShareGroup(context);
+        std::set<GLuint>::iterator it = group.compiledShaders.find(shader);
+        if (it != group.compiledShaders.end()) {
+            // Same source was already compiled by the look-ahead
+            group.compiledShaders.erase(it);
+            return;
+        }
+    }
+
+    if (getProc(real_glCompileShader, "glCompileShader")) {
+        real_glCompileShader(shader);
+    }
+}
+
+
+static void APIENTRY
+deleteShader(GLuint shader)
+{
+    // The name may be reused
+    Context *context = getCurrentContext();
+    if (context) {
+        getShareGroup(context).compiledShaders.erase(shader);
+    }
+
+    if (getProc(real_glDeleteShader, "glDeleteShader")) {
+        real_glDeleteShader(shader);
+    }
+}
+
+
+static void
+resetShaderLookahead(void)
+{
+    traceShaders.clear();
+    ++generation;
+}
+
+static int resetShaderLookaheadRegistered = retrace::addResetCallback(&resetShaderLookahead);
+
+
+void
+enableShaderLookahead(void)
+{
+    retrace::lookaheadCallback = &lookahead;
+    enabled = true;
+
+    _glCreateShader = &createShader;
+    _glCompileShader = &compileShader;
+    _glDeleteShader = &deleteShader;
+}
+
+
+} /* namespace glretrace */
@@ -0,0 +1,549 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * On-disk cache of program binaries.
+ *
+ * glLinkProgram is intercepted at the dispatch level, so that programs which
+ * were linked in a previous replay are loaded through glProgramBinary
+ * instead.  Entries are keyed by a hash of the driver identification strings,
+ * the attached shaders' sources, and the state that influences linking
+ * (attribute/fragment data locations, transform feedback varyings, and
+ * program parameters), which is tracked by intercepting the respective calls
+ * too.
+ */
+
+
+#include <assert.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "os_process.hpp"
+#include "os_string.hpp"
+#include "glproc.hpp"
+#include "glretrace.hpp"
+#include "xxh64.hpp"
+
+
+namespace glretrace {
+
+
+static std::string cacheDir;
+
+static unsigned cacheHits = 0;
+static unsigned cacheMisses = 0;
+
+// State set on each program which affects linking, as values keyed by
+// what they bind, so that setting it again replaces the previous value
+typedef std::map<std::string, std::string> LinkState;
+static std::map<GLuint, LinkState> linkStates;
+
+
+static PFN_GLLINKPROGRAM real_glLinkProgram;
+static PFN_GLDELETEPROGRAM real_glDeleteProgram;
+static PFN_GLBINDATTRIBLOCATION real_glBindAttribLocation;
+static PFN_GLBINDFRAGDATALOCATION real_glBindFragDataLocation;
+static PFN_GLBINDFRAGDATALOCATIONEXT real_glBindFragDataLocationEXT;
+static PFN_GLBINDFRAGDATALOCATIONINDEXED real_glBindFragDataLocationIndexed;
+static PFN_GLTRANSFORMFEEDBACKVARYINGS real_glTransformFeedbackVaryings;
+static PFN_GLTRANSFORMFEEDBACKVARYINGSEXT real_glTransformFeedbackVaryingsEXT;
+static PFN_GLPROGRAMPARAMETERI real_glProgramParameteri;
+static PFN_GLPROGRAMPARAMETERIARB real_glProgramParameteriARB;
+static PFN_GLPROGRAMPARAMETERIEXT real_glProgramParameteriEXT;
+
+
+/*
+ * Resolve the real entry-point on first use, like the dispatch stubs do.
+ */
+template< typename Proc >
+static inline Proc
+getProc(Proc &proc, const char *name)
+{
+    if (!proc) {
+        proc = reinterpret_cast<Proc>(_getPrivateProcAddress(name));
+        if (!proc) {
+            std::cerr << "warning: ignoring call to unavailable function " << name << "\n";
+        }
+    }
+    return proc;
+}
+
+
+static void
+recordLinkState(GLuint program, char kind, const char *name, GLint value)
+{
+    std::string key(1, kind);
+    key += name ? name : "";
+    linkStates[program][key] = std::to_string(value);
+}
+
+
+/*
+ * Varyings replace the previous list as a whole.
+ */
+static void
+recordVaryings(GLuint program, GLsizei count, const GLchar * const *varyings, GLenum bufferMode)
+{
+    LinkState &state = linkStates[program];
+    state.erase(state.lower_bound("V"), state.lower_bound("W"));
+    state["T"] = std::to_string(bufferMode);
+    for (GLsizei i = 0; i < count; ++i) {
+        state["V" + std::to_string(i)] = varyings[i] ? varyings[i] : "";
+    }
+}
+
+
+static void APIENTRY
+bindAttribLocation(GLuint program, GLuint index, const GLchar *name)
+{
+    recordLinkState(program, 'A', name, index);
+    if (getProc(real_glBindAttribLocation, "glBindAttribLocation")) {
+        real_glBindAttribLocation(program, index, name);
+    }
+}
+
+
+static void APIENTRY
+bindFragDataLocation(GLuint program, GLuint color, const GLchar *name)
+{
+    recordLinkState(program, 'F', name, color * 2);
+    if (getProc(real_glBindFragDataLocation, "glBindFragDataLocation")) {
+        real_glBindFragDataLocation(program, color, name);
+    }
+}
+
+
+static void APIENTRY
+bindFragDataLocationEXT(GLuint program, GLuint color, const GLchar *name)
+{
+    recordLinkState(program, 'F', name, color * 2);
+    if (getProc(real_glBindFragDataLocationEXT, "glBindFragDataLocationEXT")) {
+        real_glBindFragDataLocationEXT(program, color, name);
+    }
+}
+
+
+static void APIENTRY
+bindFragDataLocationIndexed(GLuint program, GLuint colorNumber, GLuint index, const GLchar *name)
+{
+    recordLinkState(program, 'F', name, colorNumber * 2 + index);
+    if (getProc(real_glBindFragDataLocationIndexed, "glBindFragDataLocationIndexed")) {
+        real_glBindFragDataLocationIndexed(program, colorNumber, index, name);
+    }
+}
+
+
+static void APIENTRY
+transformFeedbackVaryings(GLuint program, GLsizei count, const GLchar * const *varyings, GLenum bufferMode)
+{
+    recordVaryings(program, count, varyings, bufferMode);
+    if (getProc(real_glTransformFeedbackVaryings, "glTransformFeedbackVaryings")) {
+        real_glTransformFeedbackVaryings(program, count, varyings, bufferMode);
+    }
+}
+
+
+static void APIENTRY
+transformFeedbackVaryingsEXT(GLuint program, GLsizei count, const GLchar * const *varyings, GLenum bufferMode)
+{
+    recordVaryings(program, count, varyings, bufferMode);
+    if (getProc(real_glTransformFeedbackVaryingsEXT, "glTransformFeedbackVaryingsEXT")) {
+        real_glTransformFeedbackVaryingsEXT(program, count, varyings, bufferMode);
+    }
+}
+
+
+static void APIENTRY
+programParameteri(GLuint program, GLenum pname, GLint value)
+{
+    recordLinkState(program, 'P', std::to_string(pname).c_str(), value);
+    if (getProc(real_glProgramParameteri, "glProgramParameteri")) {
+        real_glProgramParameteri(program, pname, value);
+    }
+}
+
+
+static void APIENTRY
+programParameteriARB(GLuint program, GLenum pname, GLint value)
+{
+    recordLinkState(program, 'P', std::to_string(pname).c_str(), value);
+    if (getProc(real_glProgramParameteriARB, "glProgramParameteriARB")) {
+        real_glProgramParameteriARB(program, pname, value);
+    }
+}
+
+
+static void APIENTRY
+programParameteriEXT(GLuint program, GLenum pname, GLint value)
+{
+    recordLinkState(program, 'P', std::to_string(pname).c_str(), value);
+    if (getProc(real_glProgramParameteriEXT, "glProgramParameteriEXT")) {
+        real_glProgramParameteriEXT(program, pname, value);
+    }
+}
+
+
+static void APIENTRY
+deleteProgram(GLuint program)
+{
+    linkStates.erase(program);
+    if (getProc(real_glDeleteProgram, "glDeleteProgram")) {
+        real_glDeleteProgram(program);
+    }
+}
+
+
+/*
+ * Whether the current context supports program binaries at all, checked
+ * once per context so that unsupported queries don't raise errors.
+ */
+static bool
+supportsProgramBinary(void)
+{
+    Context *context = getCurrentContext();
+    if (!context) {
+        return false;
+    }
+    if (!context->programBinaryChecked) {
+        context->programBinaryChecked = true;
+        glfeatures::Profile profile = context->actualProfile();
+        if (profile.versionGreaterOrEqual(glfeatures::API_GL, 4, 1) ||
+            profile.versionGreaterOrEqual(glfeatures::API_GLES, 3, 0) ||
+            context->hasExtension("GL_ARB_get_program_binary")) {
+            context->programBinary = true;
+        } else if (context->hasExtension("GL_OES_get_program_binary")) {
+            context->programBinary = true;
+            context->programBinaryOES = true;
+        }
+    }
+    return context->programBinary;
+}
+
+
+static inline bool
+usesProgramBinaryOES(void)
+{
+    return getCurrentContext()->programBinaryOES;
+}
+
+
+/*
+ * Take pending errors out of the way, so that the cache's own calls can be
+ * checked, and the pending errors still be reported for the call.
+ */
+static void
+saveErrors(std::vector<GLenum> &errors)
+{
+    // Bounded, as lost contexts may keep reporting errors
+    for (unsigned i = 0; i < 16; ++i) {
+        GLenum error = glGetError();
+        if (error == GL_NO_ERROR) {
+            break;
+        }
+        errors.push_back(error);
+    }
+}
+
+
+/*
+ * Drop errors raised by the cache's own calls.
+ */
+static void
+discardErrors(void)
+{
+    std::vector<GLenum> errors;
+    saveErrors(errors);
+}
+
+
+/*
+ * Compute the cache key for the program about to be linked, or return false
+ * if the program can't be cached.
+ */
+static bool
+getProgramKey(GLuint program, std::string &key)
+{
+    GLint numFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+    if (numFormats <= 0) {
+        return false;
+    }
+
+    GLint numShaders = 0;
+    glGetProgramiv(program, GL_ATTACHED_SHADERS, &numShaders);
+    if (numShaders <= 0) {
+        return false;
+    }
+    std::vector<GLuint> shaders(numShaders);
+    glGetAttachedShaders(program, numShaders, NULL, &shaders[0]);
+
+    // Sort by type and source, so that the key doesn't depend on the
+    // attachment order nor shader names
+    std::vector< std::pair<GLint, std::string> > sources;
+    for (GLuint shader : shaders) {
+        GLint compiled = GL_FALSE;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+        if (!compiled) {
+            return false;
+        }
+        GLint type = 0;
+        glGetShaderiv(shader, GL_SHADER_TYPE, &type);
+        GLint length = 0;
+        glGetShaderiv(shader, GL_SHADER_SOURCE_LENGTH, &length);
+        std::string source(length, '\0');
+        if (length > 0) {
+            glGetShaderSource(shader, length, NULL, &source[0]);
+        }
+        sources.emplace_back(type, std::move(source));
+    }
+    std::sort(sources.begin(), sources.end());
+
+    XXH64 hasher;
+
+    static const GLenum driverStrings[] = {
+        GL_VENDOR,
+        GL_RENDERER,
+        GL_VERSION,
+    };
+    for (GLenum name : driverStrings) {
+        const char *s = reinterpret_cast<const char *>(glGetString(name));
+        if (!s) {
+            s = "";
+        }
+        hasher.update(s, strlen(s) + 1);
+    }
+
+    for (auto & source : sources) {
+        hasher.update(&source.first, sizeof source.first);
+        hasher.update(source.second.c_str(), source.second.size() + 1);
+    }
+
+    std::map<GLuint, LinkState>::const_iterator it = linkStates.find(program);
+    if (it != linkStates.end()) {
+        for (auto & entry : it->second) {
+            hasher.update(entry.first.c_str(), entry.first.size() + 1);
+            hasher.update(entry.second.c_str(), entry.second.size() + 1);
+        }
+    }
+
+    char digest[17];
+    hasher.hexdigest(digest);
+    key = digest;
+    return true;
+}
+
+
+static std::string
+getCachePath(const std::string &key)
+{
+    return cacheDir + "/" + key + ".bin";
+}
+
+
+/*
+ * Try to link the program from a cached binary.
+ */
+static bool
+loadProgramBinary(GLuint program, const std::string &key)
+{
+    std::string path = getCachePath(key);
+    std::ifstream stream(path.c_str(), std::ios::in | std::ios::binary);
+    if (!stream) {
+        return false;
+    }
+
+    std::string contents((std::istreambuf_iterator<char>(stream)),
+                         std::istreambuf_iterator<char>());
+    stream.close();
+
+    uint32_t format = 0;
+    if (contents.size() <= sizeof format) {
+        remove(path.c_str());
+        return false;
+    }
+    memcpy(&format, contents.data(), sizeof format);
+
+    if (usesProgramBinaryOES()) {
+        glProgramBinaryOES(program, format,
+                           contents.data() + sizeof format,
+                           contents.size() - sizeof format);
+    } else {
+        glProgramBinary(program, format,
+                        contents.data() + sizeof format,
+                        contents.size() - sizeof format);
+    }
+
+    GLint linkStatus = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+    if (!linkStatus) {
+        // Rejected by the driver (e.g., after an update), so fall back to
+        // linking from source.
+        remove(path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+
+static void
+storeProgramBinary(GLuint program, const std::string &key)
+{
+    GLint linkStatus = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+    if (!linkStatus) {
+        return;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    if (usesProgramBinaryOES()) {
+        glGetProgramBinaryOES(program, length, NULL, &format, &binary[0]);
+    } else {
+        glGetProgramBinary(program, length, NULL, &format, &binary[0]);
+    }
+    if (glGetError() != GL_NO_ERROR) {
+        return;
+    }
+
+    // Write to a temporary file first, so that concurrent replays never see
+    // partial entries
+    std::string path = getCachePath(key);
+    std::stringstream tmp;
+    tmp << path << "." << os::getCurrentProcessId() << ".tmp";
+    std::string tmpPath = tmp.str();
+
+    std::ofstream stream(tmpPath.c_str(), std::ios::out | std::ios::binary);
+    if (!stream) {
+        return;
+    }
+    uint32_t format32 = format;
+    stream.write(reinterpret_cast<const char *>(&format32), sizeof format32);
+    stream.write(&binary[0], length);
+    stream.close();
+    if (!stream ||
+        rename(tmpPath.c_str(), path.c_str()) != 0) {
+        remove(tmpPath.c_str());
+    }
+}
+
+
+static void APIENTRY
+linkProgram(GLuint program)
+{
+    if (!getProc(real_glLinkProgram, "glLinkProgram")) {
+        return;
+    }
+
+    if (!supportsProgramBinary()) {
+        real_glLinkProgram(program);
+        return;
+    }
+
+    // Errors pending before the cache's calls, and those raised by linking
+    // itself, are reported for the call; the cache's own are dropped.
+    std::vector<GLenum> errors;
+    saveErrors(errors);
+
+    std::string key;
+    bool cacheable = getProgramKey(program, key);
+    discardErrors();
+
+    if (!cacheable) {
+        real_glLinkProgram(program);
+    } else if (loadProgramBinary(program, key)) {
+        discardErrors();
+        ++cacheHits;
+    } else {
+        ++cacheMisses;
+        if (!usesProgramBinaryOES() &&
+            getProc(real_glProgramParameteri, "glProgramParameteri")) {
+            real_glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        discardErrors();
+        real_glLinkProgram(program);
+        saveErrors(errors);
+        storeProgramBinary(program, key);
+        discardErrors();
+    }
+
+    restoreGlErrors(errors);
+}
+
+
+static void
+resetProgramCache(void)
+{
+    linkStates.clear();
+}
+
+static int resetProgramCacheRegistered = retrace::addResetCallback(&resetProgramCache);
+
+
+void
+enableProgramCache(const char *path)
+{
+    cacheDir = path;
+    os::createDirectory(cacheDir.c_str());
+
+    _glLinkProgram = &linkProgram;
+    _glDeleteProgram = &deleteProgram;
+    _glBindAttribLocation = &bindAttribLocation;
+    _glBindFragDataLocation = &bindFragDataLocation;
+    _glBindFragDataLocationEXT = &bindFragDataLocationEXT;
+    _glBindFragDataLocationIndexed = &bindFragDataLocationIndexed;
+    _glTransformFeedbackVaryings = &transformFeedbackVaryings;
+    _glTransformFeedbackVaryingsEXT = &transformFeedbackVaryingsEXT;
+    _glProgramParameteri = &programParameteri;
+    _glProgramParameteriARB = &programParameteriARB;
+    _glProgramParameteriEXT = &programParameteriEXT;
+}
+
+
+void
+reportProgramCache(void)
+{
+    if (!cacheDir.empty() && retrace::verbosity > 0) {
+        std::cout << "Program cache: " << cacheHits << " hits, " << cacheMisses << " misses\n";
+    }
+}
+
+
+} /* namespace glretrace */
@@ -426,6 +426,18 @@ static void retrace_wglUseFontOutlinesAW(trace::Call &call)
 
 
 
+static void resetWgl(void) {
+    unbindContext();
+    releaseContexts(context_map);
+
+    // Pbuffers are also reachable through their DCs in drawable_map
+    std::set<glws::Drawable *> destroyed;
+    destroyDrawables(pbuffer_map, destroyed);
+    destroyDrawables(drawable_map, destroyed);
+}
+
+static int resetWglRegistered = retrace::addResetCallback(&resetWgl);
+
 const retrace::Entry glretrace::wgl_callbacks[] = {
     {"glAddSwapHintRectWIN", &retrace::ignore},
     {"wglBindTexImageARB", &retrace_wglBindTexImageARB},
@@ -125,7 +125,7 @@ createContext(Context *shareContext, glfeatures::Profile profile) {
         exit(1);
     }
 
-    return new Context(ctx);
+    return new Context(ctx, shareContext);
 }
 
 
@@ -144,6 +144,20 @@ Context::~Context()
 }
 
 
+/**
+ * Must be called while the context is current.
+ */
+void
+Context::deleteSnapshotBuffers(void)
+{
+    assert(this == getCurrentContext());
+    if (!snapshotBuffers.empty()) {
+        glDeleteBuffers(snapshotBuffers.size(), snapshotBuffers.data());
+        snapshotBuffers.clear();
+    }
+}
+
+
 OS_THREAD_LOCAL Context *
 currentContextPtr;
 
@@ -170,6 +184,11 @@ makeCurrent(trace::Call &call, glws::Drawable *drawable, Context *context)
 
     beforeContextSwitch();
 
+    if (currentContext && context != currentContext) {
+        currentContext->deleteSnapshotBuffers();
+        deleteStalePrecompiledShaders(currentContext);
+    }
+
     bool success = glws::makeCurrent(drawable, context ? context->wsContext : NULL);
 
     if (!success) {
@@ -202,6 +221,30 @@ makeCurrent(trace::Call &call, glws::Drawable *drawable, Context *context)
 }
 
 
+/**
+ * Release the current context, if any, so it can be destroyed.
+ */
+void
+unbindContext(void)
+{
+    Context *currentContext = currentContextPtr;
+    if (!currentContext) {
+        return;
+    }
+
+    glFlush();
+    flushQueries();
+    beforeContextSwitch();
+    currentContext->deleteSnapshotBuffers();
+    deleteStalePrecompiledShaders(currentContext);
+
+    glws::makeCurrent(NULL, NULL);
+
+    currentContextPtr = NULL;
+    currentContext->release();
+}
+
+
 /**
  * Grow the current drawble.
  *
@@ -28,6 +28,8 @@
 
 #include <algorithm>
 #include <iostream>
+#include <map>
+#include <string>
 
 #include "image.hpp"
 #include "state_writer.hpp"
@@ -41,6 +43,39 @@
 namespace glstate {
 
 
+Context::Context(void)
+{
+    profile = glfeatures::getCurrentContextProfile();
+    glfeatures::Extensions exts;
+    exts.getCurrentContextExtensions(profile);
+    load(profile, exts);
+
+    // Contexts of the same profile are assumed to share the implementation
+    // constants.
+    static std::map<std::string, ConstantCache> caches;
+    constants = &caches[profile.str()];
+}
+
+
+bool
+Context::replayConstant(StateWriter &writer, GLenum pname) const
+{
+    ConstantCache::const_iterator it = constants->find(pname);
+    if (it == constants->end()) {
+        return false;
+    }
+    it->second.replay(writer);
+    return true;
+}
+
+
+void
+Context::storeConstant(GLenum pname, StateRecorder &recorder)
+{
+    (*constants)[pname] = std::move(recorder);
+}
+
+
 PixelPackState::PixelPackState(const Context &context)
 {
     desktop = !context.ES;
@@ -64,8 +64,15 @@ dumpCurrentContext(StateWriter &writer);
 bool
 getDrawableBounds(GLint *width, GLint *height);
 
+/**
+ * Read back the current draw buffer.
+ *
+ * When a non-zero pixel pack buffer object is given, the pixels are read into
+ * it instead, and it is up to the caller to copy them into the returned
+ * image once the read back completes.
+ */
 image::Image *
-getDrawBufferImage(void);
+getDrawBufferImage(GLuint pack_buffer = 0);
 
 
 } /* namespace glstate */
@@ -961,7 +961,7 @@ getFramebufferAttachmentDesc(Context &context, GLenum target, GLenum attachment,
 
 
 image::Image *
-getDrawBufferImage()
+getDrawBufferImage(GLuint pack_buffer)
 {
     Context context;
 
@@ -1057,7 +1057,14 @@ getDrawBufferImage()
     {
         // TODO: reset imaging state too
         PixelPackState pps(context);
-        glReadPixels(0, 0, desc.width, desc.height, format, type, image->pixels);
+        if (pack_buffer) {
+            assert(context.pixel_buffer_object);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pack_buffer);
+            glBufferData(GL_PIXEL_PACK_BUFFER, image->height * image->_stride(), NULL, GL_STREAM_READ);
+            glReadPixels(0, 0, desc.width, desc.height, format, type, 0);
+        } else {
+            glReadPixels(0, 0, desc.width, desc.height, format, type, image->pixels);
+        }
     }
 
 
@@ -28,24 +28,39 @@
 
 #include <stdint.h>
 
+#include <map>
+
 #include "glimports.hpp"
 #include "glproc.hpp"
 #include "glfeatures.hpp"
 #include "image.hpp"
+#include "state_recorder.hpp"
 
 
-class StateWriter;
+namespace glstate {
 
 
-namespace glstate {
+/*
+ * Cache of implementation-constant parameters (limits, version strings,
+ * etc), so that consecutive state dumps only query them once.
+ */
+typedef std::map<GLenum, StateRecorder> ConstantCache;
 
 
 struct Context : public glfeatures::Features
 {
-    inline Context(void)
-    {
-        load();
-    }
+    glfeatures::Profile profile;
+
+    ConstantCache *constants;
+
+    Context(void);
+
+    // Write a cached constant parameter, returning false if not yet cached
+    bool
+    replayConstant(StateWriter &writer, GLenum pname) const;
+
+    void
+    storeConstant(GLenum pname, StateRecorder &recorder);
 };
 
 
@@ -41,6 +41,50 @@ framebuffer_targets = [
     ('GL_READ_FRAMEBUFFER', 'GL_READ_FRAMEBUFFER_BINDING'),
 ]
 
+# Parameters which are implementation dependent but never change during a
+# replay.  (GL_CONTEXT_FLAGS is deliberately absent, as it varies among
+# contexts of the same profile.)
+constant_params = set([
+    'GL_ALIASED_LINE_WIDTH_RANGE',
+    'GL_ALIASED_POINT_SIZE_RANGE',
+    'GL_COMPRESSED_TEXTURE_FORMATS',
+    'GL_CONTEXT_PROFILE_MASK',
+    'GL_EXTENSIONS',
+    'GL_LAYER_PROVOKING_VERTEX',
+    'GL_LINE_WIDTH_GRANULARITY',
+    'GL_LINE_WIDTH_RANGE',
+    'GL_MAJOR_VERSION',
+    'GL_MINOR_VERSION',
+    'GL_MIN_MAP_BUFFER_ALIGNMENT',
+    'GL_MIN_PROGRAM_TEXEL_OFFSET',
+    'GL_NUM_COMPRESSED_TEXTURE_FORMATS',
+    'GL_NUM_EXTENSIONS',
+    'GL_NUM_PROGRAM_BINARY_FORMATS',
+    'GL_NUM_SHADER_BINARY_FORMATS',
+    'GL_POINT_SIZE_GRANULARITY',
+    'GL_POINT_SIZE_RANGE',
+    'GL_PROGRAM_BINARY_FORMATS',
+    'GL_RENDERER',
+    'GL_SHADER_BINARY_FORMATS',
+    'GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT',
+    'GL_SHADING_LANGUAGE_VERSION',
+    'GL_SUBPIXEL_BITS',
+    'GL_TEXTURE_BUFFER_OFFSET_ALIGNMENT',
+    'GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT',
+    'GL_VENDOR',
+    'GL_VERSION',
+    'GL_VIEWPORT_BOUNDS_RANGE',
+    'GL_VIEWPORT_INDEX_PROVOKING_VERTEX',
+    'GL_VIEWPORT_SUBPIXEL_BITS',
+])
+
+def is_constant(name):
+    if name == 'GL_MAX_SHADER_COMPILER_THREADS_ARB':
+        # Set by glMaxShaderCompilerThreadsARB
+        return False
+    return name.startswith('GL_MAX_') or name in constant_params
+
+
 class GetInflector:
     '''Objects that describes how to inflect.'''
 
@@ -232,30 +276,34 @@ class JsonWriter(Visitor):
     '''Type visitor that will dump a value of the specified type through the
     JSON writer.
     
-    It expects a previously declared StateWriter instance named "writer".'''
+    It expects a previously declared StateWriter instance named "writer",
+    unless a different name is given.'''
+
+    def __init__(self, writer = 'writer'):
+        self.writer = writer
 
     def visitLiteral(self, literal, instance):
         if literal.kind == 'Bool':
-            print '    writer.writeBool(%s);' % instance
+            print '    %s.writeBool(%s);' % (self.writer, instance)
         elif literal.kind in ('SInt', 'Uint'):
-            print '    writer.writeInt(%s);' % instance
+            print '    %s.writeInt(%s);' % (self.writer, instance)
         elif literal.kind in ('Float', 'Double'):
-            print '    writer.writeFloat(%s);' % instance
+            print '    %s.writeFloat(%s);' % (self.writer, instance)
         else:
             raise NotImplementedError
 
     def visitString(self, string, instance):
         assert string.length is None
-        print '    writer.writeString((const char *)%s);' % instance
+        print '    %s.writeString((const char *)%s);' % (self.writer, instance)
 
     def visitEnum(self, enum, instance):
         if enum is GLboolean:
-            print '    dumpBoolean(writer, %s);' % instance
+            print '    dumpBoolean(%s, %s);' % (self.writer, instance)
         elif enum is GLenum:
-            print '    dumpEnum(writer, %s);' % instance
+            print '    dumpEnum(%s, %s);' % (self.writer, instance)
         else:
             assert False
-            print '    writer.writeInt(%s);' % instance
+            print '    %s.writeInt(%s);' % (self.writer, instance)
 
     def visitBitmask(self, bitmask, instance):
         raise NotImplementedError
@@ -264,18 +312,18 @@ class JsonWriter(Visitor):
         self.visit(alias.type, instance)
 
     def visitOpaque(self, opaque, instance):
-        print '    writer.writeInt((size_t)%s);' % instance
+        print '    %s.writeInt((size_t)%s);' % (self.writer, instance)
 
     __index = 0
 
     def visitArray(self, array, instance):
         index = '_i%u' % JsonWriter.__index
         JsonWriter.__index += 1
-        print '    writer.beginArray();'
+        print '    %s.beginArray();' % self.writer
         print '    for (unsigned %s = 0; %s < %s; ++%s) {' % (index, index, array.length, index)
         self.visit(array.type, '%s[%s]' % (instance, index))
         print '    }'
-        print '    writer.endArray();'
+        print '    %s.endArray();' % self.writer
 
 
 
@@ -666,18 +714,30 @@ class StateDumper:
     def dump_atom(self, getter, *args):
         name = args[getter.pnameIdx]
 
+        # Implementation constants are only queried once, and replayed from
+        # the cache on subsequent dumps.
+        constant = getter is glGet and is_constant(name)
+        writer = '_recorder' if constant else 'writer'
+
         print '        // %s' % name
-        print '        {'
+        if constant:
+            print '        if (!context.replayConstant(writer, %s)) {' % name
+            print '            StateRecorder _recorder;'
+        else:
+            print '        {'
         print '            flushErrors();'
         type, value = getter(*args)
         print '            if (glGetError() != GL_NO_ERROR) {'
         #print '                std::cerr << "warning: %s(%s) failed\\n";' % (inflection, name)
         print '                flushErrors();'
         print '            } else {'
-        print '                writer.beginMember("%s");' % name
-        JsonWriter().visit(type, value)
-        print '                writer.endMember();'
+        print '                %s.beginMember("%s");' % (writer, name)
+        JsonWriter(writer).visit(type, value)
+        print '                %s.endMember();' % writer
         print '            }'
+        if constant:
+            print '            _recorder.replay(writer);'
+            print '            context.storeConstant(%s, _recorder);' % name
         print '        }'
         print
 
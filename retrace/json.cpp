@@ -29,24 +29,40 @@
 
 
 #include <assert.h>
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-#include <sstream>
+#include <algorithm>
+#include <cmath> // for std::isinf, std::isnan; as C99 macros are unavailable in C++11
+#include <limits>
 
 #include "json.hpp"
 
 
+void
+JSONWriter::flush(void) {
+    os.write(buffer, bufferSize);
+    bufferSize = 0;
+}
+
 void
 JSONWriter::newline(void) {
-    os << "\n";
-    for (int i = 0; i < level; ++i)
-        os << "  ";
+    static const char spaces[] = "                                                                ";
+    put('\n');
+    size_t indent = 2 * level;
+    while (indent) {
+        size_t n = std::min(indent, sizeof spaces - 1);
+        write(spaces, n);
+        indent -= n;
+    }
 }
 
 void
 JSONWriter::separator(void) {
     if (value) {
-        os << ",";
+        put(',');
         switch (space) {
         case '\0':
             break;
@@ -54,7 +70,7 @@ JSONWriter::separator(void) {
             newline();
             break;
         default:
-            os << space;
+            put(space);
             break;
         }
     } else {
@@ -64,36 +80,90 @@ JSONWriter::separator(void) {
     }
 }
 
-static void
-escapeAsciiString(std::ostream &os, const char *str) {
-    os << "\"";
 
-    const unsigned char *src = (const unsigned char *)str;
-    unsigned char c;
-    while ((c = *src++)) {
+/*
+ * Whether any of the 8 characters packed in w is not a plain printable ASCII
+ * character, that is, either a control character, '"', '\\', DEL, or
+ * non-ASCII.  Checking a word at a time lets the common case of strings
+ * without anything to escape be copied in bulk.
+ */
+static inline bool
+needsEscaping(uint64_t w) {
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+    uint64_t quote = w ^ (ones * '"');
+    uint64_t backslash = w ^ (ones * '\\');
+    uint64_t del = w ^ (ones * 0x7f);
+    return ((w & highs) |
+            ((w - ones * 0x20) & ~w & highs) |
+            ((quote - ones) & ~quote & highs) |
+            ((backslash - ones) & ~backslash & highs) |
+            ((del - ones) & ~del & highs)) != 0;
+}
+
+static inline bool
+isPlain(unsigned char c) {
+    return c >= 0x20 && c <= 0x7e && c != '"' && c != '\\';
+}
+
+void
+JSONWriter::escapeString(const char *str, bool unicode) {
+    put('"');
+
+    const char *src = str;
+    const char *end = str + strlen(str);
+    while (src < end) {
+        // Copy runs of plain characters verbatim
+        const char *run = src;
+        uint64_t w;
+        while (end - src >= 8) {
+            memcpy(&w, src, sizeof w);
+            if (needsEscaping(w)) {
+                break;
+            }
+            src += 8;
+        }
+        while (src < end && isPlain(*src)) {
+            ++src;
+        }
+        write(run, src - run);
+        if (src == end) {
+            break;
+        }
+
+        unsigned char c = *src;
         if ((c == '\"') ||
             (c == '\\')) {
             // escape character
-            os << '\\' << (unsigned char)c;
-        } else if ((c >= 0x20 && c <= 0x7e) ||
-                    c == '\t' ||
-                    c == '\r' ||
-                    c == '\n') {
+            put('\\');
+            put(c);
+        } else if (c == '\t' ||
+                   c == '\r' ||
+                   c == '\n') {
             // pass-through character
-            os << (unsigned char)c;
-        } else {
+            put(c);
+        } else if (!unicode) {
             assert(0);
-            os << "?";
+            put('?');
+        } else if (c < 0x80) {
+            // ASCII control characters
+            char buf[8];
+            snprintf(buf, sizeof buf, "\\u%04x", c);
+            write(buf, 6);
+        } else {
+            // Multi-byte characters depend on the locale, so leave the rest
+            // of the string to the slow path
+            escapeUnicodeString(src);
+            break;
         }
+        ++src;
     }
 
-    os << "\"";
+    put('"');
 }
 
-static void
-escapeUnicodeString(std::ostream &os, const char *str) {
-    os << "\"";
-
+void
+JSONWriter::escapeUnicodeString(const char *str) {
     const char *locale = setlocale(LC_CTYPE, "");
     const char *src = str;
     mbstate_t state;
@@ -110,65 +180,84 @@ escapeUnicodeString(std::ostream &os, const char *str) {
             break;
         } if (written == (size_t)-1) {
             // conversion error -- skip
-            os << "?";
+            put('?');
             do {
                 ++src;
             } while (*src & 0x80);
         } else if ((c == '\"') ||
                    (c == '\\')) {
             // escape character
-            os << '\\' << (unsigned char)c;
+            put('\\');
+            put((unsigned char)c);
         } else if ((c >= 0x20 && c <= 0x7e) ||
                     c == '\t' ||
                     c == '\r' ||
                     c == '\n') {
             // pass-through character
-            os << (unsigned char)c;
+            put((unsigned char)c);
         } else {
             // unicode
-            os << "\\u" << std::hex << std::setfill('0') << std::setw(4) << (unsigned)c << std::setfill(' ') << std::dec;
+            char buf[16];
+            int n = snprintf(buf, sizeof buf, "\\u%04x", (unsigned)c);
+            write(buf, n);
         }
     } while (src);
 
     setlocale(LC_CTYPE, locale);
-
-    os << "\"";
 }
 
-static void
-encodeBase64String(std::ostream &os, const unsigned char *bytes, size_t size) {
-    const char *table64 = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-    unsigned char c0, c1, c2, c3;
-    char buf[4];
-    unsigned written;
-
-    os << "\"";
 
-    written = 0;
-    while (size >= 3) {
-        c0 = bytes[0] >> 2;
-        c1 = ((bytes[0] & 0x03) << 4) | ((bytes[1] & 0xf0) >> 4);
-        c2 = ((bytes[1] & 0x0f) << 2) | ((bytes[2] & 0xc0) >> 6);
-        c3 = bytes[2] & 0x3f;
+/*
+ * Base64 encoding, producing two characters per 12 input bits with a lookup
+ * table rather than one at a time.
+ */
+class Base64Table
+{
+public:
+    char pairs[4096][2];
+
+    Base64Table() {
+        const char *table64 = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for (unsigned i = 0; i < 4096; ++i) {
+            pairs[i][0] = table64[i >> 6];
+            pairs[i][1] = table64[i & 0x3f];
+        }
+    }
+};
 
-        buf[0] = table64[c0];
-        buf[1] = table64[c1];
-        buf[2] = table64[c2];
-        buf[3] = table64[c3];
+void
+JSONWriter::encodeBase64String(const unsigned char *bytes, size_t size) {
+    static const Base64Table table;
+    const char *table64 = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
-        os.write(buf, 4);
+    // Lines are broken every 76 characters
+    const size_t groupsPerLine = 76/4;
 
-        bytes += 3;
-        size -= 3;
-        ++written;
+    put('"');
 
-        if (written >= 76/4 && size) {
-            os << "\n";
-            written = 0;
+    while (size >= 3) {
+        size_t groups = std::min(size / 3, groupsPerLine);
+        char *dst = reserve(groups * 4 + 1);
+        for (size_t i = 0; i < groups; ++i) {
+            uint32_t triple = (uint32_t)bytes[0] << 16 |
+                              (uint32_t)bytes[1] << 8 |
+                              (uint32_t)bytes[2];
+            memcpy(dst, table.pairs[triple >> 12], 2);
+            memcpy(dst + 2, table.pairs[triple & 0xfff], 2);
+            dst += 4;
+            bytes += 3;
         }
+        size -= groups * 3;
+        if (groups == groupsPerLine && size) {
+            *dst++ = '\n';
+        }
+        bufferSize = dst - buffer;
     }
 
     if (size > 0) {
+        unsigned char c0, c1, c2;
+        char buf[4];
+
         c0 = bytes[0] >> 2;
         c1 = ((bytes[0] & 0x03) << 4);
 
@@ -183,17 +272,86 @@ encodeBase64String(std::ostream &os, const unsigned char *bytes, size_t size) {
         buf[1] = table64[c1];
         buf[0] = table64[c0];
 
-        os.write(buf, 4);
+        write(buf, 4);
     }
 
-    os << "\"";
+    put('"');
 }
 
+
+void
+JSONWriter::formatUInt(unsigned long long n) {
+    char buf[20];
+    char *p = buf + sizeof buf;
+    do {
+        *--p = '0' + n % 10;
+        n /= 10;
+    } while (n);
+    write(p, buf + sizeof buf - p);
+}
+
+
+/*
+ * Format floating point numbers with the same significant digits as
+ * iostreams did (digits10 + 1), adding digits, up to max_digits10, only when
+ * needed for the number to read back exactly.
+ */
+void
+JSONWriter::formatFloat(double n, bool single) {
+    if (std::isnan(n)) {
+        // NaN is non-standard but widely supported
+        write("NaN");
+        return;
+    }
+
+    if (std::isinf(n)) {
+        // Infinite is non-standard but widely supported
+        if (n < 0) {
+            put('-');
+        }
+        write("Infinity");
+        return;
+    }
+
+    int precision;
+    int maxPrecision;
+    if (single) {
+        precision = std::numeric_limits<float>::digits10 + 1;
+        maxPrecision = std::numeric_limits<float>::max_digits10;
+    } else {
+        precision = std::numeric_limits<double>::digits10 + 1;
+        maxPrecision = std::numeric_limits<double>::max_digits10;
+    }
+
+    // Integers with no more digits than the precision are printed as such
+    // by "%g", so skip the formatting machinery for them
+    double limit = single ? 1e7 : 1e16;
+    if (n > -limit && n < limit && n == (double)(long long)n &&
+        !(n == 0 && std::signbit(n))) {
+        formatInt((long long)n);
+        return;
+    }
+
+    char buf[32];
+    int len;
+    do {
+        len = snprintf(buf, sizeof buf, "%.*g", precision, n);
+        bool exact = single ? strtof(buf, NULL) == (float)n
+                            : strtod(buf, NULL) == n;
+        if (exact) {
+            break;
+        }
+    } while (++precision <= maxPrecision);
+    write(buf, len);
+}
+
+
 JSONWriter::JSONWriter(std::ostream &_os) :
     os(_os),
     level(0),
     value(false),
-    space(0)
+    space(0),
+    bufferSize(0)
 {
     beginObject();
 }
@@ -201,12 +359,13 @@ JSONWriter::JSONWriter(std::ostream &_os) :
 JSONWriter::~JSONWriter() {
     endObject();
     newline();
+    flush();
 }
 
 void
 JSONWriter::beginObject() {
     separator();
-    os << "{";
+    put('{');
     ++level;
     value = false;
 }
@@ -216,7 +375,7 @@ JSONWriter::endObject() {
     --level;
     if (value)
         newline();
-    os << "}";
+    put('}');
     value = true;
     space = '\n';
 }
@@ -226,8 +385,8 @@ JSONWriter::beginMember(const char * name) {
     space = 0;
     separator();
     newline();
-    escapeAsciiString(os, name);
-    os << ": ";
+    escapeString(name, false);
+    write(": ");
     value = false;
 }
 
@@ -241,7 +400,7 @@ JSONWriter::endMember(void) {
 void
 JSONWriter::beginArray() {
     separator();
-    os << "[";
+    put('[');
     ++level;
     value = false;
     space = 0;
@@ -253,7 +412,7 @@ JSONWriter::endArray(void) {
     if (space == '\n') {
         newline();
     }
-    os << "]";
+    put(']');
     value = true;
     space = '\n';
 }
@@ -266,7 +425,7 @@ JSONWriter::writeString(const char *s) {
     }
 
     separator();
-    escapeUnicodeString(os, s);
+    escapeString(s, true);
     value = true;
     space = ' ';
 }
@@ -274,7 +433,7 @@ JSONWriter::writeString(const char *s) {
 void
 JSONWriter::writeBase64(const void *bytes, size_t size) {
     separator();
-    encodeBase64String(os, (const unsigned char *)bytes, size);
+    encodeBase64String((const unsigned char *)bytes, size);
     value = true;
     space = ' ';
 }
@@ -282,7 +441,7 @@ JSONWriter::writeBase64(const void *bytes, size_t size) {
 void
 JSONWriter::writeNull(void) {
     separator();
-    os << "null";
+    write("null");
     value = true;
     space = ' ';
 }
@@ -290,7 +449,11 @@ JSONWriter::writeNull(void) {
 void
 JSONWriter::writeBool(bool b) {
     separator();
-    os << (b ? "true" : "false");
+    if (b) {
+        write("true");
+    } else {
+        write("false");
+    }
     value = true;
     space = ' ';
 }
@@ -32,14 +32,13 @@
 
 
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 #include <wchar.h>
 
-#include <cmath> // for std::isinf, std::isnan; as C99 macros are unavailable in C++11
-
-#include <iomanip>
-#include <limits>
 #include <ostream>
 #include <string>
+#include <type_traits>
 
 
 class JSONWriter
@@ -51,12 +50,83 @@ private:
     bool value;
     char space;
 
+    /*
+     * Output is accumulated here and handed to the stream in large chunks, as
+     * going through std::ostream for every token dominates the cost of
+     * writing big state dumps.
+     */
+    enum { BUFFER_SIZE = 64 * 1024 };
+    char buffer[BUFFER_SIZE];
+    size_t bufferSize;
+
+    void
+    flush(void);
+
+    /**
+     * Ensure there is room for n more characters, returning where to put them.
+     */
+    inline char *
+    reserve(size_t n) {
+        if (bufferSize + n > BUFFER_SIZE) {
+            flush();
+        }
+        return buffer + bufferSize;
+    }
+
+    inline void
+    put(char c) {
+        *reserve(1) = c;
+        ++bufferSize;
+    }
+
+    inline void
+    write(const char *s, size_t n) {
+        if (n > BUFFER_SIZE) {
+            flush();
+            os.write(s, n);
+            return;
+        }
+        memcpy(reserve(n), s, n);
+        bufferSize += n;
+    }
+
+    template< size_t N >
+    inline void
+    write(const char (&s)[N]) {
+        write(s, N - 1);
+    }
+
     void
     newline(void);
 
     void
     separator(void);
 
+    void
+    escapeString(const char *str, bool unicode);
+
+    void
+    escapeUnicodeString(const char *str);
+
+    void
+    encodeBase64String(const unsigned char *bytes, size_t size);
+
+    void
+    formatUInt(unsigned long long n);
+
+    inline void
+    formatInt(long long n) {
+        if (n < 0) {
+            put('-');
+            formatUInt(0ULL - static_cast<unsigned long long>(n));
+        } else {
+            formatUInt(n);
+        }
+    }
+
+    void
+    formatFloat(double n, bool single);
+
 public:
     JSONWriter(std::ostream &_os);
 
@@ -103,50 +173,33 @@ public:
     writeBool(bool b);
 
     /**
-     * Special case for char to prevent it to be written as a literal
-     * character.
+     * Characters are written as numbers too, rather than literal characters.
      */
+    template<class T>
     inline void
-    writeInt(signed char n) {
+    writeInt(T n) {
         separator();
-        os << std::dec << static_cast<int>(n);
+        if (std::is_signed<T>::value) {
+            formatInt(static_cast<long long>(n));
+        } else {
+            formatUInt(static_cast<unsigned long long>(n));
+        }
         value = true;
         space = ' ';
     }
 
     inline void
-    writeInt(unsigned char n) {
+    writeFloat(float n) {
         separator();
-        os << std::dec << static_cast<unsigned>(n);
+        formatFloat(n, true);
         value = true;
         space = ' ';
     }
 
-    template<class T>
     inline void
-    writeInt(T n) {
-        separator();
-        os << std::dec << n;
-        value = true;
-        space = ' ';
-    }
-
-    template<class T>
-    void
-    writeFloat(T n) {
+    writeFloat(double n) {
         separator();
-        if (std::isnan(n)) {
-            // NaN is non-standard but widely supported
-            os << "NaN";
-        } else if (std::isinf(n)) {
-            // Infinite is non-standard but widely supported
-            if (n < 0) {
-                os << '-';
-            }
-            os << "Infinity";
-        } else {
-            os << std::dec << std::setprecision(std::numeric_limits<T>::digits10 + 1) << n;
-        }
+        formatFloat(n, false);
         value = true;
         space = ' ';
     }
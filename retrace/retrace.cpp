@@ -24,11 +24,14 @@
  **************************************************************************/
 
 
+#include <stdlib.h>
 #include <string.h>
+#include <algorithm>
 #include <iostream>
 
 #include "os_time.hpp"
 #include "retrace.hpp"
+#include "retrace_fastforward.hpp"
 
 #ifdef _WIN32
 #include <dxerr.h>
@@ -120,6 +123,48 @@ void Retracer::addCallbacks(const Entry *entries) {
 }
 
 
+void Retracer::reset(void) {
+    // Signature ids are only meaningful within a single trace
+    callbacks.clear();
+    frame = 0;
+}
+
+
+static FastForward fastForwarder;
+
+
+typedef std::vector<ResetCallback> ResetCallbacks;
+
+static ResetCallbacks &
+resetCallbacks(void) {
+    // Function local, as registration happens during static initialization
+    static ResetCallbacks callbacks;
+    return callbacks;
+}
+
+
+int
+addResetCallback(ResetCallback callback) {
+    ResetCallbacks &callbacks = resetCallbacks();
+    callbacks.push_back(callback);
+    return (int)callbacks.size();
+}
+
+
+void
+resetState(void) {
+    ResetCallbacks &callbacks = resetCallbacks();
+    for (ResetCallbacks::iterator it = callbacks.begin(); it != callbacks.end(); ++it) {
+        (*it)();
+    }
+
+    frameNo = 0;
+    callNo = 0;
+
+    fastForwarder.reset();
+}
+
+
 void Retracer::retrace(trace::Call &call) {
     call_dumped = false;
 
@@ -174,6 +219,25 @@ void Retracer::retrace(trace::Call &call) {
     }
 
 #endif
+    // --fast-forward
+    if (frameNo < fastForwardFrame) {
+        const char *message;
+        bool skip = fastForwarder.skip(call, callback != &ignore, message);
+        if (message) {
+            warning(call) << message << "\n";
+        }
+        if (fastForwardStrict && fastForwarder.lossy()) {
+            std::cerr << "error: fast-forwarding can't reproduce call " << call.no << "\n";
+            exit(1);
+        }
+        if (skip) {
+            if (call.flags & trace::CALL_FLAG_END_FRAME) {
+                ++frameNo;
+            }
+            return;
+        }
+    }
+
     //--skip-frames
     if (skipFrames.contains(frameNo))
     {
@@ -214,6 +278,13 @@ void Retracer::retrace(trace::Call &call) {
         (*it->second)(call);
     }
 
+    unsigned long long startTicks = 0;
+    unsigned long long driverTicks = 0;
+    if (stageTiming) {
+        startTicks = os::getTicks();
+        driverTicks = stageTicks[STAGE_DRIVER];
+    }
+
     //use --debug-begin to set the call need debug
     if (debugCalls.contains(call.no))
     {
@@ -224,6 +295,18 @@ void Retracer::retrace(trace::Call &call) {
         callback(call);
     }
 
+    // --stage-times
+    if (stageTiming) {
+        unsigned long long ticks = os::getTicks() - startTicks;
+        if (call.flags & trace::CALL_FLAG_END_FRAME) {
+            stageTicks[STAGE_DRIVER] = driverTicks;
+            stageTicks[STAGE_SWAP] += ticks;
+        } else {
+            driverTicks = stageTicks[STAGE_DRIVER] - driverTicks;
+            stageTicks[STAGE_RETRACE] += ticks - std::min(ticks, driverTicks);
+        }
+    }
+
 #if MYPERF
     profilingFamseGpuTimes = 0;
     profiling = 0;
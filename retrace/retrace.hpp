@@ -45,6 +45,7 @@
 #include "trace_callset.hpp"
 
 #include "scoped_allocator.hpp"
+#include "retrace_stats.hpp"
 
 
 namespace image {
@@ -120,6 +121,8 @@ extern trace::CallSet flushCalls;
 extern trace::CallSet finishCalls;
 extern trace::CallSet skipFrames;
 extern trace::CallSet skipCalls;
+extern unsigned fastForwardFrame;
+extern bool fastForwardStrict;
 
 /**
  * Call no markers.
@@ -156,6 +159,24 @@ extern int profilingFamseGpuTimes;
 extern bool dumpingState;
 extern bool dumpingSnapshots;
 
+/**
+ * Hand snapshot and state images over through shared memory segments, instead
+ * of writing them inline (for qapitrace.)
+ */
+extern bool sharedMemory;
+
+/**
+ * Directory for caching program binaries across replays, or NULL.
+ */
+extern const char *programCacheDir;
+
+/**
+ * Number of calls to parse ahead of the replay, and the retracer's callback
+ * to inspect them.
+ */
+extern unsigned lookaheadDistance;
+extern trace::LookaheadCallback lookaheadCallback;
+
 
 enum Driver {
     DRIVER_DEFAULT,
@@ -226,6 +247,11 @@ public:
     void addCallback(const Entry *entry);
     void addCallbacks(const Entry *entries);
 
+    /**
+     * Forget the callbacks resolved for the current trace's signatures.
+     */
+    void reset(void);
+
     void retrace(trace::Call &call);
 };
 
@@ -236,6 +262,26 @@ public:
     virtual image::Image *
     getSnapshot(void) = 0;
 
+    /**
+     * Start reading back a snapshot asynchronously, identified by tag.
+     *
+     * Returns false when asynchronous read backs are not possible, in which
+     * case getSnapshot() should be used instead.
+     */
+    virtual bool
+    queueSnapshot(unsigned tag) {
+        return false;
+    }
+
+    /**
+     * Return the oldest queued snapshot, in queue order, or NULL if none is
+     * ready.  When wait is true, block until it becomes ready.
+     */
+    virtual image::Image *
+    dequeueSnapshot(unsigned &tag, bool wait) {
+        return NULL;
+    }
+
     virtual bool
     canDump(void) = 0;
 
@@ -260,6 +306,32 @@ void
 frameComplete(trace::Call &call);
 
 
+typedef void (*ResetCallback)(void);
+
+/**
+ * Register a function which discards per-trace state (handle maps, contexts,
+ * etc.) so that another trace can be replayed in the same process.
+ *
+ * Meant to be called from static initializers; the return value is only there
+ * to make that convenient.
+ */
+int
+addResetCallback(ResetCallback callback);
+
+/**
+ * Discard all per-trace state, by calling all reset callbacks.
+ */
+void
+resetState(void);
+
+
+/**
+ * Write out all queued snapshots (called before switching contexts or
+ * threads.)
+ */
+void
+flushSnapshots(void);
+
 /**
  * Flush rendering (called when switching threads).
  */
@@ -501,11 +501,14 @@ class Retracer:
 
     def invokeFunction(self, function):
         arg_names = ", ".join(function.argNames())
+        print '    retrace::beginDriverCall();'
         if function.type is not stdapi.Void:
             print '    _result = %s(%s);' % (function.name, arg_names)
+            print '    retrace::endDriverCall();'
             self.checkResult(None, function)
         else:
             print '    %s(%s);' % (function.name, arg_names)
+            print '    retrace::endDriverCall();'
 
     def doInvokeInterfaceMethod(self, interface, method):
         # Same as invokeInterfaceMethod, but without error checking
@@ -513,10 +516,12 @@ class Retracer:
         # XXX: Find a better name
 
         arg_names = ", ".join(method.argNames())
+        print '    retrace::beginDriverCall();'
         if method.type is not stdapi.Void:
             print '    _result = _this->%s(%s);' % (method.name, arg_names)
         else:
             print '    _this->%s(%s);' % (method.name, arg_names)
+        print '    retrace::endDriverCall();'
 
         # Adjust reference count when QueryInterface fails.  This is
         # particularly useful when replaying traces on older Direct3D runtimes
@@ -612,6 +617,15 @@ class Retracer:
                 handle_names.add(handle.name)
         print
 
+        # Handles are only meaningful within the trace they were recorded in
+        print 'static void _resetHandleMaps(void) {'
+        for handle_name in sorted(handle_names):
+            print '    _%s_map.clear();' % handle_name
+        print '}'
+        print
+        print 'static int _resetHandleMapsRegistered = retrace::addResetCallback(&_resetHandleMaps);'
+        print
+
         functions = filter(self.filterFunction, api.getAllFunctions())
         for function in functions:
             if function.sideeffects and not function.internal:
@@ -0,0 +1,549 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <iostream>
+#include <string>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#include "retrace.hpp"
+#include "retrace_checkpoint.hpp"
+
+
+namespace retrace {
+
+
+struct CheckpointServer::Event
+{
+    unsigned type;
+    pid_t pid;
+    unsigned position;
+    unsigned ok;
+};
+
+enum {
+    EVENT_STARTED,
+    EVENT_CHECKPOINT,
+    EVENT_DONE,
+};
+
+
+CheckpointServer::CheckpointServer(const char *_filename, unsigned _interval, size_t _budget) :
+    filename(_filename),
+    interval(_interval ? _interval : 1),
+    budget(_budget)
+{
+    events[0] = -1;
+    events[1] = -1;
+
+#ifdef __linux__
+    char *path = realpath(_filename, NULL);
+    if (path) {
+        filename = path;
+        free(path);
+    }
+#endif
+}
+
+
+CheckpointServer::~CheckpointServer()
+{
+}
+
+
+#ifdef __linux__
+
+
+bool
+CheckpointServer::supported(void)
+{
+    return true;
+}
+
+
+std::string
+CheckpointServer::fifoPath(pid_t pid) const
+{
+    return dir + "/" + std::to_string(pid);
+}
+
+
+static bool
+parseRequest(const std::string &line, CheckpointRequest &request)
+{
+    char action[16];
+    unsigned callNo;
+    if (sscanf(line.c_str(), "%15s %u", action, &callNo) != 2) {
+        return false;
+    }
+    if (strcmp(action, "snapshot") == 0) {
+        request.action = CheckpointRequest::SNAPSHOT;
+    } else if (strcmp(action, "state") == 0) {
+        request.action = CheckpointRequest::STATE;
+    } else {
+        return false;
+    }
+    request.callNo = callNo;
+    return true;
+}
+
+
+/**
+ * Memory private to a process, which is what it costs to keep it around.
+ */
+static size_t
+privateMemory(pid_t pid)
+{
+    std::string path = "/proc/" + std::to_string(pid) + "/smaps_rollup";
+    FILE *fp = fopen(path.c_str(), "rt");
+    if (!fp) {
+        return 0;
+    }
+
+    size_t total = 0;
+    char line[256];
+    while (fgets(line, sizeof line, fp)) {
+        unsigned long kb;
+        if (sscanf(line, "Private_Clean: %lu kB", &kb) == 1 ||
+            sscanf(line, "Private_Dirty: %lu kB", &kb) == 1) {
+            total += size_t(kb) * 1024;
+        }
+    }
+    fclose(fp);
+    return total;
+}
+
+
+/**
+ * Trace files are read through file descriptors inherited across fork(),
+ * whose offset is shared by all processes.  So take note of where the reads
+ * are when pausing, and reopen the files when resuming.
+ */
+void
+CheckpointServer::saveTraceOffsets(void)
+{
+    traceOffsets.clear();
+
+    DIR *fds = opendir("/proc/self/fd");
+    if (!fds) {
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(fds)) != NULL) {
+        char *end;
+        long fd = strtol(entry->d_name, &end, 10);
+        if (*end != '\0' || fd == dirfd(fds)) {
+            continue;
+        }
+
+        std::string link = std::string("/proc/self/fd/") + entry->d_name;
+        char target[PATH_MAX];
+        ssize_t len = readlink(link.c_str(), target, sizeof target - 1);
+        if (len <= 0) {
+            continue;
+        }
+        target[len] = '\0';
+
+        if (filename == target) {
+            off_t offset = lseek(fd, 0, SEEK_CUR);
+            if (offset >= 0) {
+                traceOffsets.push_back(std::make_pair(int(fd), offset));
+            }
+        }
+    }
+
+    closedir(fds);
+}
+
+
+void
+CheckpointServer::restoreTraceOffsets(void)
+{
+    for (auto & fdOffset : traceOffsets) {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "error: failed to reopen " << filename << "\n";
+            _exit(1);
+        }
+        dup2(fd, fdOffset.first);
+        close(fd);
+        lseek(fdOffset.first, fdOffset.second, SEEK_SET);
+    }
+}
+
+
+void
+CheckpointServer::sendEvent(unsigned type, unsigned position, bool ok)
+{
+    // Small enough for the write to be atomic
+    Event event;
+    event.type = type;
+    event.pid = getpid();
+    event.position = position;
+    event.ok = ok;
+    ssize_t written;
+    do {
+        written = write(events[1], &event, sizeof event);
+    } while (written < 0 && errno == EINTR);
+}
+
+
+bool
+CheckpointServer::resume(pid_t pid, const std::string &command)
+{
+    // Don't block if the checkpoint is gone
+    int fd = open(fifoPath(pid).c_str(), O_WRONLY | O_NONBLOCK);
+    if (fd < 0) {
+        return false;
+    }
+    ssize_t written = write(fd, command.data(), command.size());
+    close(fd);
+    return written == ssize_t(command.size());
+}
+
+
+void
+CheckpointServer::removeCheckpoint(std::map<unsigned, pid_t>::iterator it)
+{
+    kill(it->second, SIGKILL);
+    unlink(fifoPath(it->second).c_str());
+    checkpoints.erase(it);
+}
+
+
+/**
+ * Kill checkpoints until they fit in the memory budget, keeping the
+ * survivors evenly spread, and always keeping the furthest one.
+ */
+void
+CheckpointServer::evict(void)
+{
+    if (!budget) {
+        return;
+    }
+
+    std::map<unsigned, size_t> costs;
+    size_t total = 0;
+    for (auto & checkpoint : checkpoints) {
+        size_t cost = privateMemory(checkpoint.second);
+        costs[checkpoint.first] = cost;
+        total += cost;
+    }
+
+    while (total > budget && checkpoints.size() > 1) {
+        auto victim = checkpoints.end();
+        unsigned smallestGap = UINT_MAX;
+        unsigned prev = 0;
+        for (auto it = checkpoints.begin(); std::next(it) != checkpoints.end(); ++it) {
+            unsigned gap = std::next(it)->first - prev;
+            if (gap < smallestGap) {
+                smallestGap = gap;
+                victim = it;
+            }
+            prev = it->first;
+        }
+        assert(victim != checkpoints.end());
+
+        if (retrace::verbosity > 0) {
+            std::cerr << "checkpoint: evicting call " << victim->first << "\n";
+        }
+        total -= costs[victim->first];
+        removeCheckpoint(victim);
+    }
+}
+
+
+bool
+CheckpointServer::serve(CheckpointRequest &request)
+{
+    const char *tmp = getenv("TMPDIR");
+    std::string tmpl = std::string(tmp ? tmp : "/tmp") + "/glretrace.XXXXXX";
+    if (!mkdtemp(&tmpl[0])) {
+        std::cerr << "error: failed to create " << tmpl << "\n";
+        return false;
+    }
+    dir = tmpl;
+
+    if (pipe(events) != 0) {
+        std::cerr << "error: failed to create pipe\n";
+        return false;
+    }
+
+    // Nobody waits for checkpoints to exit
+    signal(SIGCHLD, SIG_IGN);
+
+    // Root of all replays
+    saveTraceOffsets();
+
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        if (line == "quit") {
+            break;
+        }
+
+        CheckpointRequest next;
+        if (!parseRequest(line, next)) {
+            std::cout << "error: invalid request `" << line << "`\n" << std::flush;
+            continue;
+        }
+        std::string command = line + "\n";
+
+        // Resume from the last checkpoint at or before the requested call.
+        // Snapshots of swaps are taken before the swap, so only states can
+        // be served from right after the call.
+        pid_t worker = 0;
+        bool resumed = false;
+        unsigned furthest = next.callNo;
+        if (next.action == CheckpointRequest::STATE) {
+            ++furthest;
+        }
+        auto it = checkpoints.upper_bound(furthest);
+        while (!resumed && it != checkpoints.begin()) {
+            --it;
+            if (resume(it->second, command)) {
+                if (retrace::verbosity > 0) {
+                    std::cerr << "checkpoint: resuming from call " << it->first << "\n";
+                }
+                resumed = true;
+            } else {
+                // Gone
+                unlink(fifoPath(it->second).c_str());
+                it = checkpoints.erase(it);
+            }
+        }
+
+        if (!resumed) {
+            // Replay from the start
+            std::cout.flush();
+            fflush(stdout);
+            worker = fork();
+            if (worker == 0) {
+                close(events[0]);
+                restoreTraceOffsets();
+                request = next;
+                return true;
+            }
+            if (worker < 0) {
+                std::cout << "error " << next.callNo << "\n" << std::flush;
+                continue;
+            }
+        }
+
+        bool done = false;
+        bool ok = false;
+        while (!done) {
+            struct pollfd pfd;
+            pfd.fd = events[0];
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            int ret = poll(&pfd, 1, 1000);
+            if (ret < 0 && errno == EINTR) {
+                continue;
+            }
+            if (ret == 0) {
+                if (worker && kill(worker, 0) != 0) {
+                    // Crashed
+                    done = true;
+                }
+                continue;
+            }
+
+            Event event;
+            if (read(events[0], &event, sizeof event) != sizeof event) {
+                continue;
+            }
+
+            switch (event.type) {
+            case EVENT_STARTED:
+                worker = event.pid;
+                break;
+            case EVENT_CHECKPOINT:
+            case EVENT_DONE:
+                it = checkpoints.find(event.position);
+                if (it == checkpoints.end()) {
+                    checkpoints[event.position] = event.pid;
+                } else if (it->second != event.pid) {
+                    // Already have one there
+                    kill(event.pid, SIGKILL);
+                    unlink(fifoPath(event.pid).c_str());
+                }
+                if (event.type == EVENT_DONE) {
+                    ok = event.ok;
+                    done = true;
+                }
+                break;
+            }
+        }
+
+        std::cout << (ok ? "done " : "error ") << next.callNo << "\n" << std::flush;
+
+        evict();
+    }
+
+    while (!checkpoints.empty()) {
+        removeCheckpoint(checkpoints.begin());
+    }
+    rmdir(dir.c_str());
+    close(events[0]);
+    close(events[1]);
+
+    return false;
+}
+
+
+void
+CheckpointServer::pause(unsigned type, unsigned position, bool ok, CheckpointRequest &request)
+{
+    std::string path = fifoPath(getpid());
+    int fd = -1;
+    if (mkfifo(path.c_str(), 0600) == 0) {
+        // Opening for writing too keeps reads from ever hitting EOF
+        fd = open(path.c_str(), O_RDWR);
+    }
+
+    sendEvent(type, position, ok);
+
+    if (fd < 0) {
+        _exit(1);
+    }
+
+    std::string line;
+    while (true) {
+        char c;
+        ssize_t n = read(fd, &c, 1);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            _exit(0);
+        }
+        if (c != '\n') {
+            line += c;
+            continue;
+        }
+
+        CheckpointRequest next;
+        if (!parseRequest(line, next)) {
+            unlink(path.c_str());
+            _exit(0);
+        }
+        line.clear();
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(fd);
+            restoreTraceOffsets();
+            request = next;
+            sendEvent(EVENT_STARTED, position, true);
+            return;
+        }
+        if (pid < 0) {
+            sendEvent(EVENT_DONE, position, false);
+        }
+    }
+}
+
+
+void
+CheckpointServer::checkpoint(unsigned position, CheckpointRequest &request)
+{
+    saveTraceOffsets();
+
+    // Don't let buffered output be written twice
+    std::cout.flush();
+    std::cerr.flush();
+    fflush(stdout);
+    fflush(stderr);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        pause(EVENT_CHECKPOINT, position, true, request);
+    }
+}
+
+
+void
+CheckpointServer::finish(unsigned position, bool ok, CheckpointRequest &request)
+{
+    saveTraceOffsets();
+
+    std::cout.flush();
+    std::cerr.flush();
+    fflush(stdout);
+    fflush(stderr);
+
+    pause(EVENT_DONE, position, ok, request);
+}
+
+
+#else /* !__linux__ */
+
+
+bool
+CheckpointServer::supported(void)
+{
+    return false;
+}
+
+
+bool
+CheckpointServer::serve(CheckpointRequest &request)
+{
+    return false;
+}
+
+
+void
+CheckpointServer::checkpoint(unsigned position, CheckpointRequest &request)
+{
+}
+
+
+void
+CheckpointServer::finish(unsigned position, bool ok, CheckpointRequest &request)
+{
+}
+
+
+#endif /* !__linux__ */
+
+
+} /* namespace retrace */
@@ -0,0 +1,151 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Fork based replay checkpoints.
+ *
+ * With software renderers the whole API state lives in process memory, so
+ * fork() makes for cheap copy-on-write checkpoints.  The checkpoint server
+ * reads requests for calls from stdin, and serves each one by resuming from
+ * the closest checkpoint at or before it, rather than replaying from the
+ * start.  Forked replays leave checkpoints behind every N frames, and pause
+ * at the requested call, serving as checkpoints themselves afterwards.
+ *
+ * Only supported on Linux.
+ */
+
+#pragma once
+
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+
+namespace retrace {
+
+
+struct CheckpointRequest
+{
+    enum Action {
+        SNAPSHOT,
+        STATE,
+    };
+
+    Action action;
+    unsigned callNo;
+};
+
+
+class CheckpointServer
+{
+public:
+    /**
+     * @param interval frames between checkpoints
+     * @param budget memory budget for checkpoints, in bytes
+     */
+    CheckpointServer(const char *filename, unsigned interval, size_t budget);
+    ~CheckpointServer();
+
+    static bool
+    supported(void);
+
+    /**
+     * Serve requests from stdin until told to quit, returning false then.
+     *
+     * Returns true in forked replays only, with the request to replay to.
+     */
+    bool
+    serve(CheckpointRequest &request);
+
+    inline bool
+    isCheckpointDue(unsigned frameNo) const {
+        return frameNo % interval == 0;
+    }
+
+    /**
+     * Leave a checkpoint behind just before a frame ends, `position` being
+     * the number of the next call to replay (the swap).
+     *
+     * Returns straight away, unless the checkpoint gets resumed, in which
+     * case it returns with a new request in a freshly forked replay.
+     */
+    void
+    checkpoint(unsigned position, CheckpointRequest &request);
+
+    /**
+     * Report the request as done, and pause, serving as a checkpoint.
+     *
+     * Returns with a new request in a freshly forked replay.
+     */
+    void
+    finish(unsigned position, bool ok, CheckpointRequest &request);
+
+private:
+    struct Event;
+
+    void
+    pause(unsigned type, unsigned position, bool ok, CheckpointRequest &request);
+
+    void
+    sendEvent(unsigned type, unsigned position, bool ok);
+
+    void
+    saveTraceOffsets(void);
+
+    void
+    restoreTraceOffsets(void);
+
+    bool
+    resume(pid_t pid, const std::string &command);
+
+    void
+    evict(void);
+
+    void
+    removeCheckpoint(std::map<unsigned, pid_t>::iterator it);
+
+    std::string
+    fifoPath(pid_t pid) const;
+
+    std::string filename;
+    unsigned interval;
+    size_t budget;
+
+    std::string dir;
+    int events[2];
+
+    // Checkpoints by position, as known by the server
+    std::map<unsigned, pid_t> checkpoints;
+
+    // Trace file descriptors, and their offsets when paused
+    std::vector< std::pair<int, off_t> > traceOffsets;
+};
+
+
+} /* namespace retrace */
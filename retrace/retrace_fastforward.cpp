@@ -0,0 +1,163 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <string.h>
+
+#include "retrace_fastforward.hpp"
+
+
+namespace retrace {
+
+
+void
+FastForward::reset(void)
+{
+    insideBeginEnd = false;
+    insideList = false;
+    drawFramebuffer = false;
+    readFramebuffer = false;
+    packBuffer = false;
+    transformFeedback = false;
+    skippedWindow = false;
+    readStaleWindow = false;
+}
+
+
+static inline bool
+startsWith(const char *name, const char *prefix) {
+    return strncmp(name, prefix, strlen(prefix)) == 0;
+}
+
+
+bool
+FastForward::skip(trace::Call &call, bool retraced, const char * &warning)
+{
+    const char *name = call.name();
+
+    warning = nullptr;
+
+    if (call.flags & trace::CALL_FLAG_END_FRAME) {
+        return true;
+    }
+
+    // Display lists record rather than render
+    if (strcmp(name, "glNewList") == 0) {
+        insideList = true;
+        return false;
+    }
+    if (strcmp(name, "glEndList") == 0) {
+        insideList = false;
+        return false;
+    }
+    if (insideList) {
+        return false;
+    }
+
+    // Rendering into framebuffer objects or transform feedback buffers may
+    // be consumed by later frames, so only rendering to the window is skipped
+    bool render = drawFramebuffer || transformFeedback;
+
+    // Skip immediate mode rendering as a whole
+    if (strcmp(name, "glBegin") == 0 && !render) {
+        insideBeginEnd = true;
+        skippedWindow = true;
+        return true;
+    }
+    if (insideBeginEnd) {
+        if (strcmp(name, "glEnd") == 0) {
+            insideBeginEnd = false;
+        }
+        return true;
+    }
+
+    if (startsWith(name, "glBindFramebuffer")) {
+        unsigned target = call.arg(0).toUInt();
+        bool bound = call.arg(1).toUInt() != 0;
+        if (target != 0x8CA8 /* GL_READ_FRAMEBUFFER */) {
+            drawFramebuffer = bound;
+        }
+        if (target != 0x8CA9 /* GL_DRAW_FRAMEBUFFER */) {
+            readFramebuffer = bound;
+        }
+        return false;
+    }
+
+    if (startsWith(name, "glBindBuffer") &&
+        call.arg(0).toUInt() == 0x88EB /* GL_PIXEL_PACK_BUFFER */) {
+        packBuffer = call.arg(1).toUInt() != 0;
+        return false;
+    }
+
+    if (startsWith(name, "glBeginTransformFeedback")) {
+        transformFeedback = true;
+        return false;
+    }
+    if (startsWith(name, "glEndTransformFeedback")) {
+        transformFeedback = false;
+        return false;
+    }
+
+    // Copies from the window get whatever was last rendered to it
+    bool readWindow = !readFramebuffer &&
+        (startsWith(name, "glCopyTex") ||
+         startsWith(name, "glCopyMultiTex") ||
+         (startsWith(name, "glBlitFramebuffer") && drawFramebuffer) ||
+         (packBuffer && (startsWith(name, "glReadPixels") ||
+                         startsWith(name, "glReadnPixels"))));
+    if (readWindow && skippedWindow && !readStaleWindow) {
+        warning = "window contents read while fast-forwarding are stale, as rendering to the window is skipped";
+        readStaleWindow = true;
+    }
+
+    if (call.flags & trace::CAAL_FLAG_NO_SKIP) {
+        return false;
+    }
+
+    if (call.flags & trace::CALL_FLAG_RENDER) {
+        // glCallList(s) may hold state changes too
+        if (startsWith(name, "glCallList")) {
+            return false;
+        }
+        if (render) {
+            return false;
+        }
+        skippedWindow = true;
+        return true;
+    }
+
+    // Queries are skipped, unless the retracer records what they return,
+    // like the locations of glGetProgramResourceLocation, which later calls
+    // are translated with.
+    if ((call.flags & trace::CALL_FLAG_NO_SIDE_EFFECTS) &&
+        !(retraced && call.ret)) {
+        return true;
+    }
+
+    return false;
+}
+
+
+} /* namespace retrace */
@@ -0,0 +1,86 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Call filter for --fast-forward.
+ */
+
+#pragma once
+
+
+#include "trace_model.hpp"
+
+
+namespace retrace {
+
+
+/**
+ * Decides which calls to skip while fast-forwarding to a frame.
+ *
+ * Everything which creates, uploads or changes state is still executed,
+ * including rendering into framebuffer objects and transform feedback, as
+ * later frames may consume it.  Rendering to the window, presentation and
+ * pure queries are not.
+ */
+class FastForward
+{
+public:
+    FastForward() {
+        reset();
+    }
+
+    void
+    reset(void);
+
+    /**
+     * Whether to skip the call.  `retraced` tells whether the retracer does
+     * anything with it at all.  `warning` is set to a message to report for
+     * the call, at most once per kind.
+     */
+    bool
+    skip(trace::Call &call, bool retraced, const char * &warning);
+
+    /**
+     * Whether calls were fed with the window's contents, which are stale, as
+     * rendering to the window is skipped.
+     */
+    inline bool
+    lossy(void) const {
+        return readStaleWindow;
+    }
+
+private:
+    bool insideBeginEnd;
+    bool insideList;
+    bool drawFramebuffer;
+    bool readFramebuffer;
+    bool packBuffer;
+    bool transformFeedback;
+    bool skippedWindow;
+    bool readStaleWindow;
+};
+
+
+} /* namespace retrace */
@@ -0,0 +1,147 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include "retrace_fastforward.hpp"
+#include "trace_parser.hpp"
+
+#include "gtest/gtest.h"
+
+using namespace trace;
+using namespace retrace;
+
+
+static const char *location_names[] = {"program", "programInterface", "name"};
+static const FunctionSig locationSig = {0, "glGetProgramResourceLocation", 3, location_names};
+
+static const char *get_names[] = {"pname", "data"};
+static const FunctionSig getSig = {1, "glGetIntegerv", 2, get_names};
+
+static const char *draw_names[] = {"mode", "first", "count"};
+static const FunctionSig drawSig = {2, "glDrawArrays", 3, draw_names};
+
+static const char *program_names[] = {"program"};
+static const FunctionSig useProgramSig = {3, "glUseProgram", 1, program_names};
+
+static const char *swap_names[] = {"dpy", "drawable"};
+static const FunctionSig swapSig = {4, "glXSwapBuffers", 2, swap_names};
+
+static const char *framebuffer_names[] = {"target", "framebuffer"};
+static const FunctionSig bindFramebufferSig = {5, "glBindFramebuffer", 2, framebuffer_names};
+
+static const char *copy_names[] = {"target", "level", "xoffset", "yoffset", "x", "y", "width", "height"};
+static const FunctionSig copyTexSubImageSig = {6, "glCopyTexSubImage2D", 8, copy_names};
+
+
+/**
+ * Make a call with unsigned arguments, flagged like the parser would.
+ */
+static Call *
+makeCall(const FunctionSig &sig, std::initializer_list<unsigned> args)
+{
+    Call *call = new Call(&sig, Parser::lookupCallFlags(sig.name), 0);
+    unsigned i = 0;
+    for (unsigned arg : args) {
+        call->args[i++].value = new UInt(arg);
+    }
+    return call;
+}
+
+
+static bool
+skip(FastForward &fastForward, Call *call, bool retraced = true)
+{
+    const char *warning;
+    bool result = fastForward.skip(*call, retraced, warning);
+    delete call;
+    return result;
+}
+
+
+TEST(fast_forward, queries)
+{
+    FastForward fastForward;
+
+    // Locations are recorded by the retracer to translate later uniform
+    // calls, so the query has to run
+    Call *call = makeCall(locationSig, {1, 0x92E1 /* GL_UNIFORM */, 0});
+    call->ret = new SInt(3);
+    EXPECT_FALSE(skip(fastForward, call));
+
+    call = makeCall(locationSig, {1, 0x92E1 /* GL_UNIFORM */, 0});
+    call->ret = new SInt(3);
+    EXPECT_TRUE(skip(fastForward, call, false));
+
+    EXPECT_TRUE(skip(fastForward, makeCall(getSig, {0x0BA2 /* GL_VIEWPORT */, 0})));
+    EXPECT_FALSE(skip(fastForward, makeCall(useProgramSig, {1})));
+    EXPECT_TRUE(skip(fastForward, makeCall(drawSig, {4, 0, 3})));
+    EXPECT_TRUE(skip(fastForward, makeCall(swapSig, {0, 1})));
+
+    // Past a frame, the location query still runs
+    call = makeCall(locationSig, {2, 0x92E1 /* GL_UNIFORM */, 0});
+    call->ret = new SInt(0);
+    EXPECT_FALSE(skip(fastForward, call));
+}
+
+
+TEST(fast_forward, framebuffers)
+{
+    FastForward fastForward;
+    const char *warning;
+
+    // Rendering to the window is skipped
+    EXPECT_TRUE(skip(fastForward, makeCall(drawSig, {4, 0, 3})));
+
+    // Rendering into framebuffer objects is not, as later frames may sample
+    // from them
+    EXPECT_FALSE(skip(fastForward, makeCall(bindFramebufferSig, {0x8D40 /* GL_FRAMEBUFFER */, 1})));
+    EXPECT_FALSE(skip(fastForward, makeCall(drawSig, {4, 0, 3})));
+    EXPECT_FALSE(fastForward.lossy());
+
+    // Reading from the window, which wasn't rendered to, is lossy
+    Call *bind = makeCall(bindFramebufferSig, {0x8CA8 /* GL_READ_FRAMEBUFFER */, 0});
+    EXPECT_FALSE(fastForward.skip(*bind, true, warning));
+    EXPECT_EQ(nullptr, warning);
+    delete bind;
+
+    Call *copy = makeCall(copyTexSubImageSig, {0x0DE1 /* GL_TEXTURE_2D */, 0, 0, 0, 0, 0, 16, 16});
+    EXPECT_FALSE(fastForward.skip(*copy, true, warning));
+    EXPECT_NE(nullptr, warning);
+    EXPECT_TRUE(fastForward.lossy());
+    EXPECT_FALSE(fastForward.skip(*copy, true, warning));
+    EXPECT_EQ(nullptr, warning);
+    delete copy;
+
+    fastForward.reset();
+    EXPECT_FALSE(fastForward.lossy());
+}
+
+
+int
+main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
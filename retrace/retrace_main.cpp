@@ -28,8 +28,12 @@
 
 #include <string.h>
 #include <limits.h> // for CHAR_MAX
+#include <algorithm>
 #include <memory> // for unique_ptr
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
 #include <getopt.h>
 #ifndef _WIN32
 #include <unistd.h> // for isatty()
@@ -37,15 +41,19 @@
 
 #include "os_binary.hpp"
 #include "os_crtdbg.hpp"
+#include "os_shm.hpp"
 #include "os_time.hpp"
 #include "os_thread.hpp"
 #include "image.hpp"
 #include "threaded_snapshot.hpp"
+#include "trace_bytecode.hpp"
 #include "trace_callset.hpp"
 #include "trace_dump.hpp"
 #include "trace_option.hpp"
 #include "retrace.hpp"
+#include "retrace_checkpoint.hpp"
 #include "state_writer.hpp"
+#include "state_writer_delta.hpp"
 #include "ws.hpp"
 
 
@@ -55,13 +63,42 @@ static const char *snapshotPrefix = "";
 static enum {
     PNM_FMT,
     RAW_RGB,
-    RAW_MD5
+    RAW_MD5,
+    RAW_XXH64,
+    PNG_FMT,
+    QOI_FMT
 } snapshotFormat = PNM_FMT;
 
 static trace::CallSet snapshotFrequency;
 static unsigned snapshotInterval = 0;
+static unsigned snapshotNo = 0;
+static bool snapshotSync = false;
 
-static unsigned dumpStateCallNo = ~0;
+static trace::CallSet dumpStateCalls;
+static bool dumpStatePending = false;
+static DeltaStateWriter *deltaStateWriter = nullptr;
+
+static trace::Profiler::Format profileFormat = trace::Profiler::FORMAT_TEXT;
+
+static int loopCount = 0;
+
+static bool bytecode = false;
+static trace::BytecodeParser *bytecodeParser = nullptr;
+
+static unsigned checkpointInterval = 0;
+static size_t checkpointBudget = size_t(1024) << 20;
+
+static const char *batchFilename = nullptr;
+static const char *batchTraceName = nullptr;
+
+static unsigned endFrame = 0;
+
+static bool stageTimes = false;
+static const char *stageTimesFilename = nullptr;
+
+// Set instead of exiting when the replay ends early in batch mode or with
+// --end-frame
+static bool stopReplay = false;
 
 retrace::Retracer retracer;
 
@@ -79,12 +116,18 @@ bool markers = false;
 bool forceWindowed = true;
 bool dumpingState = false;
 bool dumpingSnapshots = false;
+bool sharedMemory = false;
+const char *programCacheDir = NULL;
+unsigned lookaheadDistance = 0;
+trace::LookaheadCallback lookaheadCallback = NULL;
 
 trace::CallSet debugCalls;
 trace::CallSet flushCalls;
 trace::CallSet finishCalls;
 trace::CallSet skipFrames;
 trace::CallSet skipCalls;
+unsigned fastForwardFrame = 0;
+bool fastForwardStrict = false;
 
 Driver driver = DRIVER_DEFAULT;
 const char *driverModule = NULL;
@@ -158,63 +201,185 @@ typedef StateWriter *(*StateWriterFactory)(std::ostream &);
 static StateWriterFactory stateWriterFactory = createJSONStateWriter;
 
 
+/**
+ * Dump the state.
+ *
+ * When dumping state at several calls, each dump is a separate top level
+ * object, tagged with the call number, and holding only the state that
+ * changed since the previous dump.
+ */
+static void
+dumpStateAt(unsigned callNo)
+{
+    StateWriter *writer = stateWriterFactory(std::cout);
+    if (dumpStateCalls.empty() ||
+        dumpStateCalls.getFirst() == dumpStateCalls.getLast()) {
+        dumper->dumpState(*writer);
+    } else {
+        if (!deltaStateWriter) {
+            deltaStateWriter = new DeltaStateWriter;
+        }
+        writer->writeIntMember("__call__", callNo);
+        deltaStateWriter->begin(*writer);
+        dumper->dumpState(*deltaStateWriter);
+        deltaStateWriter->end();
+    }
+    delete writer;
+}
+
+
 static Snapshotter *snapshotter;
 
 
+/**
+ * Write out a snapshot, taking ownership of the image.
+ */
+static void
+writeSnapshot(image::Image *src, unsigned no) {
+    if (snapshotPrefix[0] == '-' && snapshotPrefix[1] == 0 &&
+        snapshotFormat == PNM_FMT &&
+        sharedMemory &&
+        src->channelType == image::TYPE_UNORM8 &&
+        (src->channels == 3 || src->channels == 4)) {
+        /*
+         * Copy the pixels, top row first, into a shared memory segment and
+         * only write a line describing it:
+         *
+         *   SHM <name> <width> <height> <channels> <number>
+         */
+        size_t rowSize = src->width * src->bytesPerPixel;
+        os::SharedMemory shm;
+        if (shm.create(rowSize * src->height)) {
+            unsigned char *dst = (unsigned char *)shm.data();
+            for (const unsigned char *row = src->start(); row != src->end(); row += src->stride()) {
+                memcpy(dst, row, rowSize);
+                dst += rowSize;
+            }
+            std::cout << "SHM " << shm.name() << " "
+                      << src->width << " " << src->height << " "
+                      << src->channels << " " << no << "\n";
+            delete src;
+            return;
+        }
+    }
+
+    if (snapshotPrefix[0] == '-' && snapshotPrefix[1] == 0) {
+        char comment[21];
+        snprintf(comment, sizeof comment, "%u", no);
+        switch (snapshotFormat) {
+        case PNM_FMT:
+            src->writePNM(std::cout, comment);
+            break;
+        case RAW_RGB:
+            src->writeRAW(std::cout);
+            break;
+        case RAW_MD5:
+            src->writeMD5(std::cout);
+            break;
+        case RAW_XXH64:
+            src->writeXXH64(std::cout);
+            break;
+        case PNG_FMT:
+            src->writePNG(std::cout, true);
+            break;
+        case QOI_FMT:
+            src->writeQOI(std::cout, true);
+            break;
+        default:
+            assert(0);
+            break;
+        }
+        delete src;
+    } else {
+        bool qoi = snapshotFormat == QOI_FMT;
+        os::String filename = os::String::format("%s%010u.%s",
+                                                 snapshotPrefix,
+                                                 no,
+                                                 qoi ? "qoi" : "png");
+
+        // Here we release our ownership on the Image, it is now the
+        // responsibility of the snapshotter to delete it.
+        snapshotter->writeImage(filename, src, qoi ? ENCODING_QOI : ENCODING_PNG);
+    }
+}
+
+
+/**
+ * Write out queued snapshots whose read back has completed, or all of them
+ * when wait is true.
+ */
+static void
+dequeueSnapshots(bool wait) {
+    image::Image *src;
+    unsigned no;
+    while ((src = dumper->dequeueSnapshot(no, wait))) {
+        writeSnapshot(src, no);
+    }
+}
+
+
+void
+flushSnapshots(void) {
+    if (dumpingSnapshots) {
+        dequeueSnapshots(true);
+    }
+}
+
+
 /**
  * Take snapshots.
  */
 static void
 takeSnapshot(unsigned call_no) {
-    static unsigned snapshot_no = 0;
-
     assert(dumpingSnapshots);
     assert(snapshotPrefix);
 
+    unsigned no = useCallNos ? call_no : snapshotNo;
+    bool write = snapshotInterval == 0 ||
+                 (snapshotNo % snapshotInterval) == 0;
+
+    // Prefer reading back asynchronously, so that the replay doesn't stall
+    // waiting for the GPU; the image is written out a frame or two later.
+    if (write && !snapshotSync && dumper->queueSnapshot(no)) {
+        snapshotNo++;
+        dequeueSnapshots(false);
+        return;
+    }
+
     std::unique_ptr<image::Image> src(dumper->getSnapshot());
     if (!src) {
         std::cerr << call_no << ": warning: failed to get snapshot\n";
         return;
     }
 
-    if ((snapshotInterval == 0 ||
-        (snapshot_no % snapshotInterval) == 0)) {
-
-        if (snapshotPrefix[0] == '-' && snapshotPrefix[1] == 0) {
-            char comment[21];
-            snprintf(comment, sizeof comment, "%u",
-                     useCallNos ? call_no : snapshot_no);
-            switch (snapshotFormat) {
-            case PNM_FMT:
-                src->writePNM(std::cout, comment);
-                break;
-            case RAW_RGB:
-                src->writeRAW(std::cout);
-                break;
-            case RAW_MD5:
-                src->writeMD5(std::cout);
-                break;
-            default:
-                assert(0);
-                break;
-            }
-        } else {
-            os::String filename = os::String::format("%s%010u.png",
-                                                     snapshotPrefix,
-                                                     useCallNos ? call_no : snapshot_no);
+    if (write) {
+        // Don't overtake snapshots still in flight
+        flushSnapshots();
 
-            // Here we release our ownership on the Image, it is now the
-            // responsibility of the snapshotter to delete it.
-            snapshotter->writePNG(filename, src.release());
-        }
+        writeSnapshot(src.release(), no);
     }
 
-    snapshot_no++;
+    snapshotNo++;
 
     return;
 }
 
 
+/**
+ * Parse the next call, timing it for --stage-times.
+ */
+static inline trace::Call *
+parseCall(void) {
+    if (!stageTiming) {
+        return parser->parse_call();
+    }
+    unsigned long long startTicks = os::getTicks();
+    trace::Call *call = parser->parse_call();
+    stageTicks[STAGE_PARSE] += os::getTicks() - startTicks;
+    return call;
+}
+
+
 /**
  * Retrace one call.
  *
@@ -227,7 +392,9 @@ retraceCall(trace::Call *call) {
 
     bool swapRenderTarget = call->flags &
         trace::CALL_FLAG_SWAP_RENDERTARGET;
-    bool doSnapshot = snapshotFrequency.contains(*call);
+    // Frames skipped by --fast-forward aren't rendered, so don't snapshot them
+    bool doSnapshot = frameNo >= fastForwardFrame &&
+                      snapshotFrequency.contains(*call);
 
     // For calls which cause rendertargets to be swaped, we take the
     // snapshot _before_ swapping the rendertargets.
@@ -243,8 +410,14 @@ retraceCall(trace::Call *call) {
         }
     }
 
+    unsigned callFrameNo = frameNo;
+
     retracer.retrace(*call);
 
+    if (stageTiming && frameNo != callFrameNo) {
+        endStageFrame();
+    }
+
     static bool flag = 0;
     static int testCallNo = -1;
     //retrace_glFlush(*call);
@@ -255,16 +428,35 @@ retraceCall(trace::Call *call) {
             takeSnapshot(call->no);
         }
         if (call->no >= snapshotFrequency.getLast()) {
+            flushSnapshots();
+            if (batchFilename || endFrame) {
+                stopReplay = true;
+                return;
+            }
             exit(0);
         }
     }
 
-    if (call->no >= dumpStateCallNo &&
-        dumper->canDump()) {
-        StateWriter *writer = stateWriterFactory(std::cout);
-        dumper->dumpState(*writer);
-        delete writer;
-        exit(0);
+    if (dumpingState) {
+        // Calls which can't dump state (e.g., inside glBegin/glEnd) postpone
+        // the dump to the next call that can.
+        if (dumpStateCalls.contains(*call) ||
+            call->no >= dumpStateCalls.getLast()) {
+            dumpStatePending = true;
+        }
+        if (dumpStatePending &&
+            dumper->canDump()) {
+            dumpStatePending = false;
+            flushSnapshots();
+            dumpStateAt(call->no);
+            if (call->no >= dumpStateCalls.getLast()) {
+                exit(0);
+            }
+        }
+    }
+
+    if (endFrame && frameNo >= endFrame) {
+        stopReplay = true;
     }
 }
 
@@ -403,10 +595,13 @@ public:
 
             retraceCall(call);
             delete call;
-            call = parser->parse_call();
+            call = parseCall();
 
         } while (call && call->thread_id == leg);
 
+        // Queued snapshots must be read back by this thread
+        flushSnapshots();
+
         if (call) {
             /* Pass the baton */
             assert(call->thread_id != leg);
@@ -505,7 +700,7 @@ RelayRace::getRunner(unsigned leg) {
 void
 RelayRace::run(void) {
     trace::Call *call;
-    call = parser->parse_call();
+    call = parseCall();
     if (!call) {
         /* Nothing to do */
         return;
@@ -563,6 +758,141 @@ RelayRace::stopRunners(void) {
 }
 
 
+/**
+ * Replay bytecode, decoding calls straight from the mapping as they are
+ * needed, with nothing to parse nor decompress in between calls.
+ *
+ * Calls are all replayed on the current thread.
+ */
+static void
+bytecodeLoop(void) {
+    size_t numCalls = bytecodeParser->size();
+    if (!numCalls) {
+        return;
+    }
+
+    // Where the final frame starts, for --loop
+    size_t loopStart = bytecodeParser->lastFrame();
+
+    // Calls decoded ahead of time for the look-ahead callback, in [i, ahead),
+    // each into the slot of its index modulo the window size so that the
+    // replay loop itself doesn't allocate
+    size_t window = lookaheadCallback ? lookaheadDistance + 1 : 1;
+    std::vector<trace::BytecodeSlot> slots(window);
+    std::vector<trace::Call *> calls(window);
+
+    int loops = loopCount;
+    size_t ahead = 0;
+    size_t i = 0;
+    while (true) {
+        for (; i < numCalls && !stopReplay; ++i) {
+            size_t until = std::min(numCalls, i + window);
+            for (; ahead < until; ++ahead) {
+                trace::Call *call = bytecodeParser->decode(ahead, slots[ahead % window]);
+                if (lookaheadCallback) {
+                    lookaheadCallback(*call);
+                }
+                calls[ahead % window] = call;
+            }
+
+            retraceCall(calls[i % window]);
+        }
+
+        if (!loops || stopReplay) {
+            break;
+        }
+        if (loops > 0) {
+            --loops;
+        }
+        i = ahead = loopStart;
+    }
+
+    flushSnapshots();
+}
+
+
+/**
+ * Replay calls on behalf of the checkpoint server.
+ */
+static void
+checkpointLoop(const char *filename) {
+    addCallbacks(retracer);
+
+    frameNo = 0;
+
+    CheckpointServer server(filename, checkpointInterval, checkpointBudget);
+    CheckpointRequest request;
+    if (!server.serve(request)) {
+        return;
+    }
+
+    // Only forked replays get this far
+    unsigned position = 0;
+    trace::Call *call = nullptr;
+    while (true) {
+        if (request.action == CheckpointRequest::SNAPSHOT && !dumpingSnapshots) {
+            std::cerr << "error: snapshot requests need -s PREFIX\n";
+            server.finish(position, false, request);
+            continue;
+        }
+
+        if (position > request.callNo) {
+            bool ok = true;
+            if (request.action == CheckpointRequest::SNAPSHOT) {
+                takeSnapshot(request.callNo);
+                flushSnapshots();
+            } else if (dumper->canDump()) {
+                dumpStateAt(request.callNo);
+            } else {
+                std::cerr << request.callNo << ": error: can't dump state here\n";
+                ok = false;
+            }
+            server.finish(position, ok, request);
+            continue;
+        }
+
+        if (!call) {
+            call = parser->parse_call();
+            if (!call) {
+                std::cerr << "error: call " << request.callNo << " is past the end of the trace\n";
+                server.finish(position, false, request);
+                continue;
+            }
+
+            // Leave checkpoints before frames end, so that they can serve
+            // snapshots of the swaps too.  The call is kept pending, as
+            // resumed checkpoints may be asked for the state before it.
+            if ((call->flags & trace::CALL_FLAG_END_FRAME) &&
+                call->no <= request.callNo &&
+                server.isCheckpointDue(frameNo + 1)) {
+                position = call->no;
+                server.checkpoint(position, request);
+                continue;
+            }
+        }
+
+        // As with -S, snapshot swaps before they happen
+        bool snapshotBefore =
+            call->no == request.callNo &&
+            request.action == CheckpointRequest::SNAPSHOT &&
+            (call->flags & trace::CALL_FLAG_SWAP_RENDERTARGET);
+        if (snapshotBefore) {
+            takeSnapshot(call->no);
+            flushSnapshots();
+        }
+
+        retraceCall(call);
+        position = call->no + 1;
+        delete call;
+        call = nullptr;
+
+        if (snapshotBefore) {
+            server.finish(position, true, request);
+        }
+    }
+}
+
+
 static void
 mainLoop() {
     addCallbacks(retracer);
@@ -570,28 +900,59 @@ mainLoop() {
     long long startTime = 0; 
     frameNo = 0;
 
+    if (stageTimes || stageTimesFilename) {
+        startStageTiming();
+    }
+
     startTime = os::getTime();
 
-    if (singleThread) {
+    if (bytecodeParser) {
+        bytecodeLoop();
+    } else if (singleThread) {
         trace::Call *call;
-        while ((call = parser->parse_call())) {
+        while (!stopReplay && (call = parseCall())) {
             retraceCall(call);
             delete call;
         }
+        flushSnapshots();
     } else {
         RelayRace race;
         race.run();
     }
     finishRendering();
 
+    profiler.flush();
+
     long long endTime = os::getTime();
     float timeInterval = (endTime - startTime) * (1.0 / os::timeFrequency);
 
-    if ((retrace::verbosity >= -1) || (retrace::profiling)) {
+    // Don't interleave text with binary or JSON profile output
+    if (((retrace::verbosity >= -1) || (retrace::profiling)) &&
+        profileFormat == trace::Profiler::FORMAT_TEXT) {
+        if (batchTraceName) {
+            std::cout << batchTraceName << ": ";
+        }
         std::cout << 
             "Rendered " << frameNo << " frames"
             " in " <<  timeInterval << " secs,"
             " average of " << (frameNo/timeInterval) << " fps\n";
+
+        if (stageTimes) {
+            reportStageTimes(std::cout);
+        }
+    }
+
+    if (stageTimesFilename) {
+        if (strcmp(stageTimesFilename, "-") == 0) {
+            reportStageTimesJSON(std::cout);
+        } else {
+            std::ofstream os(stageTimesFilename);
+            if (os) {
+                reportStageTimesJSON(os);
+            } else {
+                std::cerr << "error: failed to write " << stageTimesFilename << "\n";
+            }
+        }
     }
 
     if (waitOnFinish) {
@@ -605,6 +966,195 @@ mainLoop() {
 } /* namespace retrace */
 
 
+static void
+setSnapshotPrefix(const char *prefix_) {
+    retrace::dumpingSnapshots = true;
+    snapshotPrefix = prefix_;
+    if (snapshotFrequency.empty()) {
+        snapshotFrequency = trace::CallSet(trace::FREQUENCY_FRAME);
+    }
+    if (snapshotPrefix[0] == '-' && snapshotPrefix[1] == 0) {
+        os::setBinaryMode(stdout);
+        retrace::verbosity = -2;
+    } else {
+        /*
+         * Create the snapshot directory if it does not exist.
+         *
+         * We can't just use trimFilename() because when applied to
+         * "/foo/boo/" it would merely return "/foo".
+         *
+         * XXX: create nested directories.
+         */
+        os::String prefix(snapshotPrefix);
+        os::String::iterator sep = prefix.rfindSep(false);
+        if (sep != prefix.end()) {
+            prefix.erase(sep, prefix.end());
+            if (!prefix.exists() && !os::createDirectory(prefix)) {
+                std::cerr << "error: failed to create `" << prefix.str() << "` directory\n";
+            }
+        }
+    }
+}
+
+
+static trace::AbstractParser *
+createParser(void) {
+    using namespace retrace;
+
+    if (bytecode) {
+        // Looping and look-ahead are handled by bytecodeLoop
+        bytecodeParser = new trace::BytecodeParser;
+        return bytecodeParser;
+    }
+
+    trace::AbstractParser *p = new trace::Parser;
+    if (loopCount) {
+        p = lastFrameLoopParser(p, loopCount);
+    }
+    if (lookaheadDistance && lookaheadCallback) {
+        p = lookaheadParser(p, lookaheadDistance, lookaheadCallback);
+    }
+    return p;
+}
+
+
+struct BatchEntry
+{
+    std::string filename;
+    std::string snapshotPrefix;
+    std::string snapshotCalls;
+};
+
+
+/**
+ * Read a --batch list: one trace per line, optionally followed by its own
+ * `-s PREFIX` and `-S CALLSET` options.  Blank lines and lines starting with
+ * `#` are ignored.
+ */
+static bool
+readBatch(const char *filename, std::vector<BatchEntry> &entries) {
+    std::ifstream file;
+    std::istream *is = &std::cin;
+    if (strcmp(filename, "-") != 0) {
+        file.open(filename);
+        if (!file) {
+            std::cerr << "error: failed to open " << filename << "\n";
+            return false;
+        }
+        is = &file;
+    }
+
+    std::string line;
+    unsigned lineNo = 0;
+    while (std::getline(*is, line)) {
+        ++lineNo;
+
+        std::istringstream words(line);
+        std::string word;
+        if (!(words >> word) || word[0] == '#') {
+            continue;
+        }
+
+        BatchEntry entry;
+        entry.filename = word;
+        while (words >> word) {
+            std::string *value;
+            if (word == "-s") {
+                value = &entry.snapshotPrefix;
+            } else if (word == "-S") {
+                value = &entry.snapshotCalls;
+            } else {
+                std::cerr << filename << ":" << lineNo << ": error: unsupported option `" << word << "`\n";
+                return false;
+            }
+            if (!(words >> *value)) {
+                std::cerr << filename << ":" << lineNo << ": error: `" << word << "` needs an argument\n";
+                return false;
+            }
+        }
+
+        if (entry.snapshotPrefix == "-") {
+            std::cerr << filename << ":" << lineNo << ": error: snapshots can't be written to stdout in batch mode\n";
+            return false;
+        }
+
+        entries.push_back(entry);
+    }
+
+    return true;
+}
+
+
+/**
+ * Replay the traces in turn, resetting all per-trace state in between, but
+ * keeping the window system connection, visuals and dispatch tables.
+ *
+ * Returns the number of traces which failed.
+ */
+static unsigned
+batchLoop(const std::vector<BatchEntry> &entries) {
+    using namespace retrace;
+
+    // Command line snapshot options are the defaults for every trace
+    const char *defaultSnapshotPrefix = snapshotPrefix;
+    bool defaultDumpingSnapshots = dumpingSnapshots;
+    trace::CallSet defaultSnapshotFrequency = snapshotFrequency;
+
+    unsigned failures = 0;
+    long long startTime = os::getTime();
+
+    for (std::vector<BatchEntry>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+        const BatchEntry &entry = *it;
+
+        snapshotPrefix = defaultSnapshotPrefix;
+        dumpingSnapshots = defaultDumpingSnapshots;
+        snapshotFrequency = defaultSnapshotFrequency;
+        if (!entry.snapshotCalls.empty()) {
+            dumpingSnapshots = true;
+            snapshotFrequency = trace::CallSet();
+            snapshotFrequency.merge(entry.snapshotCalls.c_str());
+        }
+        if (!entry.snapshotPrefix.empty()) {
+            setSnapshotPrefix(entry.snapshotPrefix.c_str());
+        }
+        snapshotNo = 0;
+        stopReplay = false;
+
+        batchTraceName = entry.filename.c_str();
+
+        parser = createParser();
+        if (parser->open(batchTraceName)) {
+            mainLoop();
+            parser->close();
+        } else {
+            std::cerr << batchTraceName << ": error: failed to open trace\n";
+            ++failures;
+        }
+
+        delete parser;
+        parser = NULL;
+        bytecodeParser = nullptr;
+
+        retracer.reset();
+        resetState();
+    }
+
+    batchTraceName = nullptr;
+
+    long long endTime = os::getTime();
+    float timeInterval = (endTime - startTime) * (1.0 / os::timeFrequency);
+
+    if (profileFormat == trace::Profiler::FORMAT_TEXT) {
+        std::cout <<
+            "Replayed " << entries.size() << " traces"
+            " (" << failures << " failed)"
+            " in " << timeInterval << " secs\n";
+    }
+
+    return failures;
+}
+
+
 static void
 usage(const char *argv0) {
     std::cout <<
@@ -612,6 +1162,8 @@ usage(const char *argv0) {
         "Replay TRACE.\n"
         "\n"
         "  -b, --benchmark         benchmark mode (no error checking or warning messages)\n"
+        "      --stage-times       break the replay time down by stage (parsing, driver calls, etc.)\n"
+        "      --stage-times-json=FILE  write the breakdown and every frame's time as JSON to FILE\n"
         "  -d, --debug             increase debugging checks\n"
         "      --markers           insert call no markers in the command stream\n"
         "      --pcpu              cpu profiling (cpu times per call)\n"
@@ -621,6 +1173,8 @@ usage(const char *argv0) {
         "      --pcalls            call profiling metrics selection\n"
         "      --pframes           frame profiling metrics selection\n"
         "      --pdrawcalls        draw call profiling metrics selection\n"
+        "      --profile-format=FMT  profile output format (`text`, `binary`, or `chrome`\n"
+        "                            trace event JSON; default is text)\n"
         "      --list-metrics      list all available metrics for TRACE\n"
         "      --gen-passes        generate profiling passes and output passes number\n"
         "      --call-nos[=BOOL]   use call numbers in snapshot filenames\n"
@@ -632,13 +1186,22 @@ usage(const char *argv0) {
         "      --headless          don't show windows\n"
         "      --sb                use a single buffer visual\n"
         "  -s, --snapshot-prefix=PREFIX    take snapshots; `-` for PNM stdout output\n"
-        "      --snapshot-format=FMT       use (PNM, RGB, or MD5; default is PNM) when writing to stdout output\n"
+        "      --snapshot-format=FMT       use (PNM, RGB, MD5, XXH64, PNG or QOI; default is PNM) when writing to stdout output,\n"
+        "                                  or (PNG or QOI; default is PNG) when writing to files\n"
         "  -S, --snapshot=CALLSET  calls to snapshot (default is every frame)\n"
         "      --snapshot-interval=N    specify a frame interval when generating snaphots (default is 0)\n"
         "  -t, --snapshot-threaded encode screenshots on multiple threads\n"
+        "      --snapshot-sync     read back snapshots synchronously, instead of through pixel buffer objects\n"
         "  -v, --verbose           increase output verbosity\n"
-        "  -D, --dump-state=CALL   dump state at specific call no\n"
+        "  -D, --dump-state=CALLSET  dump state at specific calls (after the first, dumps only hold what changed)\n"
         "      --dump-format=FORMAT dump state format (`json` or `ubjson`)\n"
+        "      --shared-memory[=PREFIX]  pass snapshot and state images through shared memory segments named PREFIX.N (for qapitrace)\n"
+        "      --program-cache=DIR cache linked program binaries in DIR across replays (OpenGL only)\n"
+        "      --lookahead=N       parse N calls ahead, compiling upcoming shaders in parallel (OpenGL only)\n"
+        "      --bytecode          replay bytecode made by `apitrace compile` instead of traces, on a single thread\n"
+        "      --checkpoint-server=N  serve `snapshot CALL` (written to -s PREFIX) and `state CALL` requests from stdin, forking checkpoints every N frames (software renderers only)\n"
+        "      --checkpoint-memory=MB  memory budget for checkpoints (default 1024)\n"
+        "      --batch=FILE        replay each trace listed in FILE (`-` for stdin), one per line with optional -s/-S\n"
         "  -w, --wait              waitOnFinish on final frame\n"
         "      --loop[=N]          loop N times (N<0 continuously) replaying final frame.\n"
         "      --singlethread      use a single thread to replay command stream\n"
@@ -646,6 +1209,9 @@ usage(const char *argv0) {
         "      --flush-call=CALL    add flush to the calls\n"
         "      --insert-finish=CALL    insert finish before the calls\n"
         "      --skip-frames=FRAME    skip the frames\n"
+        "      --fast-forward=FRAME   only create and upload resources and change state until FRAME, then replay normally\n"
+        "      --fast-forward-strict  fail if fast-forwarding skipped rendering which later calls read back\n"
+        "      --end-frame=FRAME      stop before FRAME, on a single thread\n"
         "      --skip-calls=CALL      skip the calls\n";
 }
 
@@ -664,6 +1230,7 @@ enum {
     PCALLS_OPT,
     PFRAMES_OPT,
     PDRAWCALLS_OPT,
+    PFORMAT_OPT,
     PLMETRICS_OPT,
     GENPASS_OPT,
     SB_OPT,
@@ -671,12 +1238,25 @@ enum {
     LOOP_OPT,
     SINGLETHREAD_OPT,
     SNAPSHOT_INTERVAL_OPT,
+    SNAPSHOT_SYNC_OPT,
+    SHARED_MEMORY_OPT,
+    PROGRAM_CACHE_OPT,
+    LOOKAHEAD_OPT,
+    BYTECODE_OPT,
+    CHECKPOINT_SERVER_OPT,
+    CHECKPOINT_MEMORY_OPT,
+    BATCH_OPT,
+    END_FRAME_OPT,
+    STAGE_TIMES_OPT,
+    STAGE_TIMES_JSON_OPT,
     DUMP_FORMAT_OPT,
     MARKERS_OPT,
     DEBUG_OPT,
     FLUSH_OPT,
     FINISH_OPT,
     SKIP_FRAME_OPT,
+    FAST_FORWARD_OPT,
+    FAST_FORWARD_STRICT_OPT,
     SKIP_CALL_OPT
 };
 
@@ -686,6 +1266,8 @@ shortOptions = "bdD:hs:S:vwt";
 const static struct option
 longOptions[] = {
     {"benchmark", no_argument, 0, 'b'},
+    {"stage-times", no_argument, 0, STAGE_TIMES_OPT},
+    {"stage-times-json", required_argument, 0, STAGE_TIMES_JSON_OPT},
     {"debug", no_argument, 0, 'd'},
     {"markers", no_argument, 0, MARKERS_OPT},
     {"call-nos", optional_argument, 0, CALL_NOS_OPT },
@@ -705,6 +1287,7 @@ longOptions[] = {
     {"pcalls", required_argument, 0, PCALLS_OPT},
     {"pframes", required_argument, 0, PFRAMES_OPT},
     {"pdrawcalls", required_argument, 0, PDRAWCALLS_OPT},
+    {"profile-format", required_argument, 0, PFORMAT_OPT},
     {"list-metrics", no_argument, 0, PLMETRICS_OPT},
     {"gen-passes", no_argument, 0, GENPASS_OPT},
     {"sb", no_argument, 0, SB_OPT},
@@ -713,6 +1296,14 @@ longOptions[] = {
     {"snapshot", required_argument, 0, 'S'},
     {"snapshot-interval", required_argument, 0, SNAPSHOT_INTERVAL_OPT},
     {"snapshot-threaded", no_argument, 0, 't'},
+    {"snapshot-sync", no_argument, 0, SNAPSHOT_SYNC_OPT},
+    {"shared-memory", optional_argument, 0, SHARED_MEMORY_OPT},
+    {"program-cache", required_argument, 0, PROGRAM_CACHE_OPT},
+    {"lookahead", required_argument, 0, LOOKAHEAD_OPT},
+    {"bytecode", no_argument, 0, BYTECODE_OPT},
+    {"checkpoint-server", required_argument, 0, CHECKPOINT_SERVER_OPT},
+    {"checkpoint-memory", required_argument, 0, CHECKPOINT_MEMORY_OPT},
+    {"batch", required_argument, 0, BATCH_OPT},
     {"verbose", no_argument, 0, 'v'},
     {"wait", no_argument, 0, 'w'},
     {"loop", optional_argument, 0, LOOP_OPT},
@@ -721,6 +1312,9 @@ longOptions[] = {
     { "flush-call", required_argument, 0,FLUSH_OPT },
     { "insert-finish", required_argument, 0,FINISH_OPT },
     { "skip-frames", required_argument, 0,SKIP_FRAME_OPT },
+    { "fast-forward", required_argument, 0, FAST_FORWARD_OPT },
+    { "fast-forward-strict", no_argument, 0, FAST_FORWARD_STRICT_OPT },
+    { "end-frame", required_argument, 0, END_FRAME_OPT },
     {"skip-calls", required_argument, 0,SKIP_CALL_OPT },
     {0, 0, 0, 0}
 };
@@ -736,7 +1330,6 @@ extern "C"
 int main(int argc, char **argv)
 {
     using namespace retrace;
-    int loopCount = 0;
     int i;
     bool snapshotThreaded = false;
 
@@ -757,6 +1350,12 @@ int main(int argc, char **argv)
         case MARKERS_OPT:
             retrace::markers = true;
             break;
+        case STAGE_TIMES_OPT:
+            stageTimes = true;
+            break;
+        case STAGE_TIMES_JSON_OPT:
+            stageTimesFilename = optarg;
+            break;
         case 'd':
             ++retrace::debug;
             break;
@@ -764,7 +1363,7 @@ int main(int argc, char **argv)
             useCallNos = trace::boolOption(optarg);
             break;
         case 'D':
-            dumpStateCallNo = atoi(optarg);
+            dumpStateCalls.merge(optarg);
             dumpingState = true;
             retrace::verbosity = -2;
             break;
@@ -780,6 +1379,15 @@ int main(int argc, char **argv)
         case SKIP_FRAME_OPT:
             retrace::skipFrames.merge(optarg);
             break;
+        case FAST_FORWARD_OPT:
+            retrace::fastForwardFrame = trace::intOption(optarg, 0);
+            break;
+        case FAST_FORWARD_STRICT_OPT:
+            retrace::fastForwardStrict = true;
+            break;
+        case END_FRAME_OPT:
+            endFrame = trace::intOption(optarg, 0);
+            break;
         case SKIP_CALL_OPT:
             retrace::skipCalls.merge(optarg);
             break;
@@ -830,38 +1438,19 @@ int main(int argc, char **argv)
             retrace::singleThread = true;
             break;
         case 's':
-            dumpingSnapshots = true;
-            snapshotPrefix = optarg;
-            if (snapshotFrequency.empty()) {
-                snapshotFrequency = trace::CallSet(trace::FREQUENCY_FRAME);
-            }
-            if (snapshotPrefix[0] == '-' && snapshotPrefix[1] == 0) {
-                os::setBinaryMode(stdout);
-                retrace::verbosity = -2;
-            } else {
-                /*
-                 * Create the snapshot directory if it does not exist.
-                 *
-                 * We can't just use trimFilename() because when applied to
-                 * "/foo/boo/" it would merely return "/foo".
-                 *
-                 * XXX: create nested directories.
-                 */
-                os::String prefix(snapshotPrefix);
-                os::String::iterator sep = prefix.rfindSep(false);
-                if (sep != prefix.end()) {
-                    prefix.erase(sep, prefix.end());
-                    if (!prefix.exists() && !os::createDirectory(prefix)) {
-                        std::cerr << "error: failed to create `" << prefix.str() << "` directory\n";
-                    }
-                }
-            }
+            setSnapshotPrefix(optarg);
             break;
         case SNAPSHOT_FORMAT_OPT:
             if (strcmp(optarg, "RGB") == 0)
                 snapshotFormat = RAW_RGB;
             else if (strcmp(optarg, "MD5") == 0)
                 snapshotFormat = RAW_MD5;
+            else if (strcmp(optarg, "XXH64") == 0)
+                snapshotFormat = RAW_XXH64;
+            else if (strcmp(optarg, "PNG") == 0)
+                snapshotFormat = PNG_FMT;
+            else if (strcmp(optarg, "QOI") == 0)
+                snapshotFormat = QOI_FMT;
             else
                 snapshotFormat = PNM_FMT;
             break;
@@ -875,6 +1464,48 @@ int main(int argc, char **argv)
         case 't':
             snapshotThreaded = true;
             break;
+        case SNAPSHOT_SYNC_OPT:
+            snapshotSync = true;
+            break;
+        case SHARED_MEMORY_OPT:
+            if (!os::SharedMemory::supported()) {
+                std::cerr << "error: shared memory is not supported on this platform\n";
+                return 1;
+            }
+            if (optarg) {
+                if (optarg[0] != '/' || strchr(optarg + 1, '/')) {
+                    std::cerr << "error: shared memory prefix must start with, and contain no other, '/'\n";
+                    return 1;
+                }
+                os::SharedMemory::setPrefix(optarg);
+            }
+            retrace::sharedMemory = true;
+            break;
+        case PROGRAM_CACHE_OPT:
+            retrace::programCacheDir = optarg;
+            break;
+        case LOOKAHEAD_OPT:
+            retrace::lookaheadDistance = trace::intOption(optarg, 0);
+            break;
+        case BYTECODE_OPT:
+            bytecode = true;
+            break;
+        case CHECKPOINT_SERVER_OPT:
+            if (!retrace::CheckpointServer::supported()) {
+                std::cerr << "error: checkpoints are not supported on this platform\n";
+                return 1;
+            }
+            checkpointInterval = trace::intOption(optarg, 1);
+            if (!checkpointInterval) {
+                checkpointInterval = 1;
+            }
+            break;
+        case CHECKPOINT_MEMORY_OPT:
+            checkpointBudget = size_t(trace::intOption(optarg, 1024)) << 20;
+            break;
+        case BATCH_OPT:
+            batchFilename = optarg;
+            break;
         case 'v':
             ++retrace::verbosity;
             break;
@@ -933,6 +1564,19 @@ int main(int argc, char **argv)
             retrace::profilingWithBackends = true;
             retrace::profilingDrawCallsMetricsString = optarg;
             break;
+        case PFORMAT_OPT:
+            if (strcasecmp(optarg, "text") == 0) {
+                profileFormat = trace::Profiler::FORMAT_TEXT;
+            } else if (strcasecmp(optarg, "binary") == 0) {
+                os::setBinaryMode(stdout);
+                profileFormat = trace::Profiler::FORMAT_BINARY;
+            } else if (strcasecmp(optarg, "chrome") == 0) {
+                profileFormat = trace::Profiler::FORMAT_CHROME;
+            } else {
+                std::cerr << "error: unsupported profile format `" << optarg << "`\n";
+                return EXIT_FAILURE;
+            }
+            break;
         case PLMETRICS_OPT:
             retrace::debug = 0;
             retrace::profiling = true;
@@ -970,6 +1614,56 @@ int main(int argc, char **argv)
     }
 #endif
 
+    if (checkpointInterval) {
+        if (argc - optind != 1) {
+            std::cerr << "error: the checkpoint server takes exactly one trace\n";
+            return 1;
+        }
+
+        // Requests replace -S and -D
+        snapshotFrequency = trace::CallSet();
+        dumpStateCalls = trace::CallSet();
+        dumpingState = true;
+        if (dumpingSnapshots && snapshotPrefix[0] == '-' && snapshotPrefix[1] == 0) {
+            std::cerr << "error: the checkpoint server answers on stdout, so snapshots can't be written there\n";
+            return 1;
+        }
+        snapshotSync = true;
+
+        // Only the forking thread survives fork(), so do without threads
+        snapshotThreaded = false;
+        retrace::singleThread = true;
+#ifndef _WIN32
+        setenv("LP_NUM_THREADS", "0", 0);
+#endif
+    }
+
+    std::vector<BatchEntry> batchEntries;
+    if (batchFilename) {
+        if (argc != optind) {
+            std::cerr << "error: traces are listed in the batch file, not on the command line\n";
+            return 1;
+        }
+        if (dumpingState || checkpointInterval) {
+            std::cerr << "error: --batch can't be combined with -D or --checkpoint-server\n";
+            return 1;
+        }
+        if (snapshotPrefix[0] == '-' && snapshotPrefix[1] == 0) {
+            std::cerr << "error: snapshots can't be written to stdout in batch mode\n";
+            return 1;
+        }
+        if (!readBatch(batchFilename, batchEntries)) {
+            return 1;
+        }
+
+        // Stopping after the last snapshot is simpler without relay threads
+        retrace::singleThread = true;
+    }
+
+    if (endFrame) {
+        retrace::singleThread = true;
+    }
+
     if (snapshotThreaded) {
         snapshotter = new ThreadedSnapshotter(os::thread::hardware_concurrency());
     } else {
@@ -978,30 +1672,44 @@ int main(int argc, char **argv)
 
     retrace::setUp();
     if (retrace::profiling && !retrace::profilingWithBackends) {
-        retrace::profiler.setup(retrace::profilingCpuTimes, retrace::profilingGpuTimes, retrace::profilingPixelsDrawn, retrace::profilingMemoryUsage);
+        // Timelines are laid out on CPU timestamps
+        if (profileFormat == trace::Profiler::FORMAT_CHROME) {
+            retrace::profilingCpuTimes = true;
+        }
+
+        retrace::profiler.setup(retrace::profilingCpuTimes, retrace::profilingGpuTimes, retrace::profilingPixelsDrawn, retrace::profilingMemoryUsage, profileFormat);
     }
 
     os::setExceptionCallback(exceptionCallback);
 
-    for (retrace::curPass = 0; retrace::curPass < retrace::numPasses;
-         retrace::curPass++)
-    {
-        for (i = optind; i < argc; ++i) {
-            parser = new trace::Parser;
-            if (loopCount) {
-                parser = lastFrameLoopParser(parser, loopCount);
-            }
-
-            if (!parser->open(argv[i])) {
-                return 1;
-            }
+    int ret = 0;
+    if (batchFilename) {
+        if (batchLoop(batchEntries)) {
+            ret = 1;
+        }
+    } else {
+        for (retrace::curPass = 0; retrace::curPass < retrace::numPasses;
+             retrace::curPass++)
+        {
+            for (i = optind; i < argc; ++i) {
+                parser = createParser();
+
+                if (!parser->open(argv[i])) {
+                    return 1;
+                }
 
-            retrace::mainLoop();
+                if (checkpointInterval) {
+                    retrace::checkpointLoop(argv[i]);
+                } else {
+                    retrace::mainLoop();
+                }
 
-            parser->close();
+                parser->close();
 
-            delete parser;
-            parser = NULL;
+                delete parser;
+                parser = NULL;
+                bytecodeParser = nullptr;
+            }
         }
     }
 
@@ -1018,7 +1726,7 @@ int main(int argc, char **argv)
     }
 #endif
 
-    return 0;
+    return ret;
 }
 
 
@@ -0,0 +1,328 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include <assert.h>
+#include <math.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <vector>
+
+#include "trace_file.hpp"
+#include "retrace_stats.hpp"
+
+
+namespace retrace {
+
+
+bool stageTiming = false;
+
+unsigned long long stageTicks[NUM_STAGES];
+
+unsigned long long driverStartTicks = 0;
+
+
+static const char *
+stageNames[NUM_STAGES] = {
+    "decompress",
+    "parse",
+    "retrace",
+    "driver",
+    "swap",
+    "other",
+};
+
+
+struct FrameTicks
+{
+    unsigned long long stages[NUM_STAGES];
+    unsigned long long total;
+};
+
+static std::vector<FrameTicks> frames;
+
+static long long startTime;
+static unsigned long long startTicks;
+static unsigned long long lastFrameTicks;
+static unsigned long long lastStageTicks[NUM_STAGES];
+static unsigned long long baseDecompressTicks;
+
+
+void
+startStageTiming(void) {
+    stageTiming = true;
+    trace::File::timeDecompression = true;
+
+    frames.clear();
+    std::fill(stageTicks, stageTicks + NUM_STAGES, 0);
+    std::fill(lastStageTicks, lastStageTicks + NUM_STAGES, 0);
+    baseDecompressTicks = trace::File::decompressTicks;
+
+    startTime = os::getTime();
+    startTicks = lastFrameTicks = os::getTicks();
+}
+
+
+void
+endStageFrame(void) {
+    unsigned long long now = os::getTicks();
+
+    FrameTicks frame;
+    frame.total = now - lastFrameTicks;
+    lastFrameTicks = now;
+
+    stageTicks[STAGE_DECOMPRESS] = trace::File::decompressTicks - baseDecompressTicks;
+
+    unsigned long long accounted = 0;
+    for (unsigned stage = 0; stage < STAGE_OTHER; ++stage) {
+        frame.stages[stage] = stageTicks[stage] - lastStageTicks[stage];
+        lastStageTicks[stage] = stageTicks[stage];
+    }
+
+    // Decompression happens while parsing
+    frame.stages[STAGE_PARSE] -= std::min(frame.stages[STAGE_PARSE], frame.stages[STAGE_DECOMPRESS]);
+
+    for (unsigned stage = 0; stage < STAGE_OTHER; ++stage) {
+        accounted += frame.stages[stage];
+    }
+    frame.stages[STAGE_OTHER] = frame.total > accounted ? frame.total - accounted : 0;
+
+    frames.push_back(frame);
+}
+
+
+namespace {
+
+struct Summary
+{
+    double seconds;
+    double mean;
+    double p50;
+    double p95;
+    double p99;
+    double max;
+};
+
+struct Histogram
+{
+    // Bucket i holds frames of [2^(i-1), 2^i) ms, and bucket 0 [0, 1) ms
+    std::vector<unsigned> counts;
+
+    static double
+    lowerBound(unsigned i) {
+        return i ? ldexp(1.0, i - 1) : 0.0;
+    }
+
+    static double
+    upperBound(unsigned i) {
+        return ldexp(1.0, i);
+    }
+};
+
+struct Report
+{
+    unsigned numFrames;
+    Summary frame;
+    Summary stages[NUM_STAGES];
+    Histogram histogram;
+    std::vector<double> frameMs;
+};
+
+}
+
+
+static double
+percentile(const std::vector<double> &sorted, unsigned p) {
+    assert(!sorted.empty());
+    size_t rank = (sorted.size() * p + 99) / 100;
+    return sorted[rank ? rank - 1 : 0];
+}
+
+
+static void
+summarize(std::vector<double> ms, Summary &summary) {
+    summary = Summary();
+    if (ms.empty()) {
+        return;
+    }
+    double total = 0.0;
+    for (size_t i = 0; i < ms.size(); ++i) {
+        total += ms[i];
+    }
+    std::sort(ms.begin(), ms.end());
+    summary.seconds = total * 1e-3;
+    summary.mean = total / ms.size();
+    summary.p50 = percentile(ms, 50);
+    summary.p95 = percentile(ms, 95);
+    summary.p99 = percentile(ms, 99);
+    summary.max = ms.back();
+}
+
+
+static void
+makeReport(Report &report) {
+    // Calibrate ticks against the OS clock
+    double seconds = double(os::getTime() - startTime) / os::timeFrequency;
+    unsigned long long ticks = os::getTicks() - startTicks;
+    double msPerTick = ticks ? seconds * 1e3 / ticks : 0.0;
+
+    report.numFrames = frames.size();
+
+    report.frameMs.resize(frames.size());
+    std::vector<double> stageMs[NUM_STAGES];
+    for (size_t i = 0; i < frames.size(); ++i) {
+        report.frameMs[i] = frames[i].total * msPerTick;
+        for (unsigned stage = 0; stage < NUM_STAGES; ++stage) {
+            stageMs[stage].push_back(frames[i].stages[stage] * msPerTick);
+        }
+    }
+
+    summarize(report.frameMs, report.frame);
+    for (unsigned stage = 0; stage < NUM_STAGES; ++stage) {
+        summarize(stageMs[stage], report.stages[stage]);
+    }
+
+    std::vector<unsigned> &counts = report.histogram.counts;
+    for (size_t i = 0; i < report.frameMs.size(); ++i) {
+        unsigned bucket = 0;
+        while (report.frameMs[i] >= Histogram::upperBound(bucket)) {
+            ++bucket;
+        }
+        if (bucket >= counts.size()) {
+            counts.resize(bucket + 1);
+        }
+        ++counts[bucket];
+    }
+}
+
+
+void
+reportStageTimes(std::ostream &os) {
+    Report report;
+    makeReport(report);
+    if (!report.numFrames) {
+        return;
+    }
+
+    std::ios::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+
+    os << std::fixed << std::setprecision(3);
+    os << std::left << std::setw(12) << "stage" << std::right
+       << std::setw(12) << "total (s)"
+       << std::setw(9) << "share"
+       << std::setw(12) << "p50 (ms)"
+       << std::setw(12) << "p95 (ms)"
+       << std::setw(12) << "p99 (ms)"
+       << "\n";
+    for (unsigned stage = 0; stage <= NUM_STAGES; ++stage) {
+        const char *name = stage < NUM_STAGES ? stageNames[stage] : "frame";
+        const Summary &summary = stage < NUM_STAGES ? report.stages[stage] : report.frame;
+        double share = report.frame.seconds ? summary.seconds / report.frame.seconds : 0.0;
+        os << std::left << std::setw(12) << name << std::right
+           << std::setw(12) << summary.seconds
+           << std::setw(8) << std::setprecision(1) << share * 100.0 << "%" << std::setprecision(3)
+           << std::setw(12) << summary.p50
+           << std::setw(12) << summary.p95
+           << std::setw(12) << summary.p99
+           << "\n";
+    }
+
+    os << "frame times:\n";
+    const std::vector<unsigned> &counts = report.histogram.counts;
+    unsigned maxCount = *std::max_element(counts.begin(), counts.end());
+    for (unsigned i = 0; i < counts.size(); ++i) {
+        unsigned bar = (counts[i] * 40 + maxCount - 1) / maxCount;
+        os << std::setprecision(0)
+           << std::setw(8) << Histogram::lowerBound(i) << " - "
+           << std::setw(6) << Histogram::upperBound(i) << " ms"
+           << std::setw(8) << counts[i] << "  "
+           << std::string(bar, '#') << "\n";
+    }
+
+    os.flags(flags);
+    os.precision(precision);
+}
+
+
+static void
+writeSummaryJSON(std::ostream &os, const Summary &summary) {
+    os << "{\"seconds\": " << summary.seconds
+       << ", \"mean_ms\": " << summary.mean
+       << ", \"p50_ms\": " << summary.p50
+       << ", \"p95_ms\": " << summary.p95
+       << ", \"p99_ms\": " << summary.p99
+       << ", \"max_ms\": " << summary.max
+       << "}";
+}
+
+
+void
+reportStageTimesJSON(std::ostream &os) {
+    Report report;
+    makeReport(report);
+
+    std::ios::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(6);
+
+    os << "{\n";
+    os << "  \"frames\": " << report.numFrames << ",\n";
+    os << "  \"frame\": ";
+    writeSummaryJSON(os, report.frame);
+    os << ",\n";
+
+    os << "  \"stages\": {\n";
+    for (unsigned stage = 0; stage < NUM_STAGES; ++stage) {
+        os << "    \"" << stageNames[stage] << "\": ";
+        writeSummaryJSON(os, report.stages[stage]);
+        os << (stage + 1 < NUM_STAGES ? ",\n" : "\n");
+    }
+    os << "  },\n";
+
+    os << "  \"histogram\": [";
+    const std::vector<unsigned> &counts = report.histogram.counts;
+    for (unsigned i = 0; i < counts.size(); ++i) {
+        os << (i ? ",\n    " : "\n    ")
+           << "{\"min_ms\": " << Histogram::lowerBound(i)
+           << ", \"max_ms\": " << Histogram::upperBound(i)
+           << ", \"frames\": " << counts[i] << "}";
+    }
+    os << "\n  ],\n";
+
+    os << "  \"frame_times_ms\": [";
+    for (size_t i = 0; i < report.frameMs.size(); ++i) {
+        os << (i ? ", " : "") << report.frameMs[i];
+    }
+    os << "]\n";
+    os << "}\n";
+
+    os.flags(flags);
+    os.precision(precision);
+}
+
+
+} /* namespace retrace */
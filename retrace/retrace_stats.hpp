@@ -0,0 +1,106 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Breakdown of the replay time by stage, for --stage-times.
+ *
+ * Stages are timed with os::getTicks, accumulated into stageTicks, and
+ * split per frame at each frame's end.
+ */
+
+#pragma once
+
+
+#include <ostream>
+
+#include "os_time.hpp"
+
+
+namespace retrace {
+
+
+enum Stage {
+    STAGE_DECOMPRESS,   // reading and decompressing trace chunks
+    STAGE_PARSE,        // decoding calls
+    STAGE_RETRACE,      // unpacking arguments, swizzling handles, etc.
+    STAGE_DRIVER,       // the API calls proper
+    STAGE_SWAP,         // calls ending frames
+    STAGE_OTHER,        // everything else (snapshots, waiting, ...)
+    NUM_STAGES
+};
+
+
+extern bool stageTiming;
+
+extern unsigned long long stageTicks[NUM_STAGES];
+
+extern unsigned long long driverStartTicks;
+
+
+/*
+ * Called by generated code around each API call.
+ */
+inline void
+beginDriverCall(void) {
+    if (stageTiming) {
+        driverStartTicks = os::getTicks();
+    }
+}
+
+inline void
+endDriverCall(void) {
+    if (stageTiming) {
+        stageTicks[STAGE_DRIVER] += os::getTicks() - driverStartTicks;
+    }
+}
+
+
+/**
+ * Start (or restart) timing a replay.
+ */
+void
+startStageTiming(void);
+
+/**
+ * Attribute the time since the previous frame's end to a new frame.
+ */
+void
+endStageFrame(void);
+
+/**
+ * Write per-stage totals and frame time percentiles, and a frame time
+ * histogram.
+ */
+void
+reportStageTimes(std::ostream &os);
+
+/**
+ * Same as reportStageTimes, as JSON, including every frame's time.
+ */
+void
+reportStageTimesJSON(std::ostream &os);
+
+
+} /* namespace retrace */
@@ -334,4 +334,13 @@ toObjPointer(trace::Call &call, trace::Value &value) {
 }
 
 
+static void
+resetSwizzle(void) {
+    regionMap.clear();
+    _obj_map.clear();
+}
+
+static int resetSwizzleRegistered = addResetCallback(&resetSwizzle);
+
+
 } /* retrace */
@@ -65,6 +65,10 @@ public:
         return base.find(key);
     }
 
+    void clear(void) {
+        base.clear();
+    }
+
     T & operator[] (const T &key) {
         typename base_type::iterator it;
         it = base.find(key);
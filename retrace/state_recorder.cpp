@@ -0,0 +1,322 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include "state_recorder.hpp"
+
+#include <assert.h>
+#include <string.h>
+
+#include "image.hpp"
+#include "xxh64.hpp"
+
+
+StateRecorder::StateRecorder()
+{
+}
+
+
+StateRecorder::~StateRecorder()
+{
+}
+
+
+StateRecorder::StateRecorder(StateRecorder &&) = default;
+
+
+StateRecorder &
+StateRecorder::operator = (StateRecorder &&) = default;
+
+
+StateRecorder::Op &
+StateRecorder::push(OpCode code)
+{
+    ops.emplace_back();
+    Op &op = ops.back();
+    op.code = code;
+    // Zero the whole union so that hashing it is deterministic
+    op.value.u = 0;
+    op.offset = 0;
+    op.size = 0;
+    return op;
+}
+
+
+void
+StateRecorder::pushBytes(OpCode code, const void *data, size_t size)
+{
+    Op &op = push(code);
+    op.offset = bytes.size();
+    op.size = size;
+    bytes.append(static_cast<const char *>(data), size);
+}
+
+
+void
+StateRecorder::beginObject(void)
+{
+    push(OP_BEGIN_OBJECT);
+}
+
+
+void
+StateRecorder::endObject(void)
+{
+    push(OP_END_OBJECT);
+}
+
+
+void
+StateRecorder::endMember(void)
+{
+    push(OP_END_MEMBER);
+}
+
+
+void
+StateRecorder::beginArray(void)
+{
+    push(OP_BEGIN_ARRAY);
+}
+
+
+void
+StateRecorder::endArray(void)
+{
+    push(OP_END_ARRAY);
+}
+
+
+void
+StateRecorder::writeNull(void)
+{
+    push(OP_NULL);
+}
+
+
+void
+StateRecorder::beginMember(const char * name)
+{
+    pushBytes(OP_BEGIN_MEMBER, name, strlen(name));
+}
+
+
+void
+StateRecorder::writeString(const char *s)
+{
+    pushBytes(OP_STRING, s, strlen(s));
+}
+
+
+void
+StateRecorder::writeBlob(const void *data, size_t size)
+{
+    pushBytes(OP_BLOB, data, size);
+}
+
+
+void
+StateRecorder::writeBool(bool b)
+{
+    push(OP_BOOL).value.b = b;
+}
+
+
+void
+StateRecorder::writeSInt(signed long long i)
+{
+    push(OP_SINT).value.i = i;
+}
+
+
+void
+StateRecorder::writeUInt(unsigned long long u)
+{
+    push(OP_UINT).value.u = u;
+}
+
+
+void
+StateRecorder::writeFloat(float f)
+{
+    push(OP_FLOAT).value.f = f;
+}
+
+
+void
+StateRecorder::writeFloat(double d)
+{
+    push(OP_DOUBLE).value.d = d;
+}
+
+
+void
+StateRecorder::writeImage(image::Image *image, const ImageDesc & desc)
+{
+    assert(image);
+    if (!image) {
+        writeNull();
+        return;
+    }
+
+    image::Image *copy = new image::Image(image->width, image->height,
+                                          image->channels, image->flipped,
+                                          image->channelType);
+    memcpy(copy->pixels, image->pixels, image->height * image->_stride());
+    copy->label = image->label;
+
+    Op &op = push(OP_IMAGE);
+    op.offset = images.size();
+
+    images.emplace_back();
+    images.back().image.reset(copy);
+    images.back().desc = desc;
+}
+
+
+void
+StateRecorder::clear(void)
+{
+    ops.clear();
+    bytes.clear();
+    images.clear();
+}
+
+
+void
+StateRecorder::replay(StateWriter &writer) const
+{
+    for (auto & op : ops) {
+        switch (op.code) {
+        case OP_BEGIN_OBJECT:
+            writer.beginObject();
+            break;
+        case OP_END_OBJECT:
+            writer.endObject();
+            break;
+        case OP_BEGIN_MEMBER:
+            writer.beginMember(bytes.substr(op.offset, op.size));
+            break;
+        case OP_END_MEMBER:
+            writer.endMember();
+            break;
+        case OP_BEGIN_ARRAY:
+            writer.beginArray();
+            break;
+        case OP_END_ARRAY:
+            writer.endArray();
+            break;
+        case OP_STRING:
+            writer.writeString(bytes.substr(op.offset, op.size));
+            break;
+        case OP_BLOB:
+            writer.writeBlob(bytes.data() + op.offset, op.size);
+            break;
+        case OP_NULL:
+            writer.writeNull();
+            break;
+        case OP_BOOL:
+            writer.writeBool(op.value.b);
+            break;
+        case OP_SINT:
+            writer.writeSInt(op.value.i);
+            break;
+        case OP_UINT:
+            writer.writeUInt(op.value.u);
+            break;
+        case OP_FLOAT:
+            writer.writeFloat(op.value.f);
+            break;
+        case OP_DOUBLE:
+            writer.writeFloat(op.value.d);
+            break;
+        case OP_IMAGE:
+            {
+                const RecordedImage &recorded = images[op.offset];
+                writer.writeImage(recorded.image.get(), recorded.desc);
+            }
+            break;
+        default:
+            assert(0);
+        }
+    }
+}
+
+
+void
+StateRecorder::hash(XXH64 &hasher) const
+{
+    for (auto & op : ops) {
+        unsigned char code = op.code;
+        hasher.update(&code, sizeof code);
+
+        switch (op.code) {
+        case OP_BEGIN_MEMBER:
+        case OP_STRING:
+        case OP_BLOB:
+            {
+                uint64_t size = op.size;
+                hasher.update(&size, sizeof size);
+                hasher.update(bytes.data() + op.offset, op.size);
+            }
+            break;
+        case OP_IMAGE:
+            {
+                const RecordedImage &recorded = images[op.offset];
+                const image::Image *image = recorded.image.get();
+                uint32_t header[5] = {
+                    image->width,
+                    image->height,
+                    image->channels,
+                    static_cast<uint32_t>(image->channelType),
+                    recorded.desc.depth,
+                };
+                hasher.update(header, sizeof header);
+                hasher.update(recorded.desc.format.c_str(), recorded.desc.format.size() + 1);
+                hasher.update(image->label.c_str(), image->label.size() + 1);
+                // Hash top-down, so that flipped and unflipped copies of the
+                // same pixels match
+                const unsigned char *row = image->start();
+                for (unsigned y = 0; y < image->height; ++y) {
+                    hasher.update(row, image->_stride());
+                    row += image->stride();
+                }
+            }
+            break;
+        default:
+            hasher.update(&op.value, sizeof op.value);
+            break;
+        }
+    }
+}
+
+
+uint64_t
+StateRecorder::hash(void) const
+{
+    XXH64 hasher;
+    hash(hasher);
+    return hasher.digest();
+}
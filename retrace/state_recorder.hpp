@@ -0,0 +1,143 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * State writer which records the writes, so they can be hashed and replayed
+ * later into another writer.
+ */
+
+#pragma once
+
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "state_writer.hpp"
+
+
+class XXH64;
+
+
+class StateRecorder : public StateWriter
+{
+public:
+    StateRecorder();
+    ~StateRecorder();
+
+    StateRecorder(StateRecorder &&);
+    StateRecorder & operator = (StateRecorder &&);
+
+    void beginObject(void) override;
+    void endObject(void) override;
+    void beginMember(const char * name) override;
+    void endMember(void) override;
+    void beginArray(void) override;
+    void endArray(void) override;
+    void writeString(const char *s) override;
+    void writeBlob(const void *bytes, size_t size) override;
+    void writeNull(void) override;
+    void writeBool(bool b) override;
+    void writeSInt(signed long long i) override;
+    void writeUInt(unsigned long long u) override;
+    void writeFloat(float f) override;
+    void writeFloat(double f) override;
+
+    using StateWriter::writeImage;
+
+    /*
+     * Keep a copy of the image, as the caller will delete it.  Images are
+     * only encoded when replayed.
+     */
+    void writeImage(image::Image *image, const ImageDesc & desc) override;
+
+    bool
+    empty(void) const {
+        return ops.empty();
+    }
+
+    void
+    clear(void);
+
+    void
+    replay(StateWriter &writer) const;
+
+    void
+    hash(XXH64 &hasher) const;
+
+    uint64_t
+    hash(void) const;
+
+private:
+    enum OpCode {
+        OP_BEGIN_OBJECT,
+        OP_END_OBJECT,
+        OP_BEGIN_MEMBER,
+        OP_END_MEMBER,
+        OP_BEGIN_ARRAY,
+        OP_END_ARRAY,
+        OP_STRING,
+        OP_BLOB,
+        OP_NULL,
+        OP_BOOL,
+        OP_SINT,
+        OP_UINT,
+        OP_FLOAT,
+        OP_DOUBLE,
+        OP_IMAGE,
+    };
+
+    struct Op {
+        OpCode code;
+        union {
+            bool b;
+            signed long long i;
+            unsigned long long u;
+            float f;
+            double d;
+        } value;
+        // Offset/size into `bytes` for strings and blobs, or index into
+        // `images` for images
+        size_t offset;
+        size_t size;
+    };
+
+    struct RecordedImage {
+        std::unique_ptr<image::Image> image;
+        ImageDesc desc;
+    };
+
+    std::vector<Op> ops;
+    std::string bytes;
+    std::vector<RecordedImage> images;
+
+    Op &
+    push(OpCode code);
+
+    void
+    pushBytes(OpCode code, const void *data, size_t size);
+};
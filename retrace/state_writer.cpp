@@ -28,10 +28,14 @@
 #include "state_writer.hpp"
 
 #include <assert.h>
+#include <string.h>
 
+#include <algorithm>
 #include <sstream>
 
 #include "image.hpp"
+#include "os_shm.hpp"
+#include "retrace.hpp"
 
 
 StateWriter::~StateWriter()
@@ -39,6 +43,64 @@ StateWriter::~StateWriter()
 }
 
 
+/*
+ * Output stream buffer writing in place into a fixed size memory area.
+ */
+class SpanBuf : public std::streambuf
+{
+public:
+    SpanBuf(void *data, size_t size) {
+        char *begin = static_cast<char *>(data);
+        setp(begin, begin + size);
+    }
+
+    size_t
+    used(void) const {
+        return pptr() - pbase();
+    }
+};
+
+
+/*
+ * Encode the image straight into a shared memory segment, skipping PNG
+ * compression.  PNM can't hold RGBA8, so use QOI for those.
+ */
+bool
+StateWriter::writeSharedImage(const image::Image *image)
+{
+    bool qoi = image->channelType == image::TYPE_UNORM8 &&
+               image->channels == 4;
+
+    // Upper bound of the encoded size, with room for the PNM header or
+    // the QOI tag bytes
+    size_t pixels = size_t(image->width) * image->height;
+    size_t size = qoi ? 64 + pixels * 5
+                      : 64 + pixels * std::max(image->bytesPerPixel, 3 * image->bytesPerChannel);
+
+    os::SharedMemory shm;
+    if (!shm.create(size)) {
+        return false;
+    }
+
+    SpanBuf buf(shm.data(), size);
+    std::ostream os(&buf);
+    if (qoi) {
+        image->writeQOI(os);
+    } else {
+        image->writePNM(os);
+    }
+
+    // A segment that can't be used is still removed along with the others
+    // by the reader, so its number must not be reused
+    if (!os || !shm.truncate(buf.used())) {
+        return false;
+    }
+
+    writeStringMember("__shm__", shm.name());
+    return true;
+}
+
+
 void
 StateWriter::writeImage(image::Image *image,
                         const ImageDesc & desc)
@@ -64,6 +126,11 @@ StateWriter::writeImage(image::Image *image,
         writeStringMember("__label__", image->label.c_str());
     }
 
+    if (retrace::sharedMemory && writeSharedImage(image)) {
+        endObject();
+        return;
+    }
+
     beginMember("__data__");
     std::stringstream ss;
 
@@ -162,7 +162,7 @@ public:
         {}
     };
 
-    void
+    virtual void
     writeImage(image::Image *image, const ImageDesc & desc);
 
     inline void
@@ -171,6 +171,9 @@ public:
         writeImage(image, desc);
     }
 
+private:
+    bool
+    writeSharedImage(const image::Image *image);
 };
 
 
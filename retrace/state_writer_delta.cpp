@@ -0,0 +1,282 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include "state_writer_delta.hpp"
+
+#include <assert.h>
+
+
+DeltaStateWriter::DeltaStateWriter() :
+    writer(nullptr),
+    level(0),
+    sectionStarted(false),
+    sectionIsObject(false),
+    sectionEmitted(false)
+{
+}
+
+
+DeltaStateWriter::~DeltaStateWriter()
+{
+}
+
+
+void
+DeltaStateWriter::begin(StateWriter &_writer)
+{
+    assert(!writer);
+    writer = &_writer;
+    level = 0;
+    hashes.clear();
+}
+
+
+void
+DeltaStateWriter::end(void)
+{
+    assert(writer);
+    assert(level == 0);
+
+    bool removed = false;
+    for (auto & entry : previousHashes) {
+        if (hashes.find(entry.first) == hashes.end()) {
+            if (!removed) {
+                writer->beginMember("__removed__");
+                writer->beginArray();
+                removed = true;
+            }
+            writer->writeString(entry.first);
+        }
+    }
+    if (removed) {
+        writer->endArray();
+        writer->endMember(); // __removed__
+    }
+
+    previousHashes.swap(hashes);
+    hashes.clear();
+    writer = nullptr;
+}
+
+
+bool
+DeltaStateWriter::changed(const std::string &key)
+{
+    uint64_t hash = recorder.hash();
+    hashes[key] = hash;
+    HashMap::const_iterator it = previousHashes.find(key);
+    return it == previousHashes.end() || it->second != hash;
+}
+
+
+/*
+ * Called before any value written directly into a top level member, to
+ * determine whether it will be compared as a whole or member by member.
+ */
+void
+DeltaStateWriter::value(void)
+{
+    if (level == 1 && !sectionStarted) {
+        sectionStarted = true;
+        sectionIsObject = false;
+    }
+}
+
+
+void
+DeltaStateWriter::beginObject(void)
+{
+    if (level == 1 && !sectionStarted) {
+        sectionStarted = true;
+        sectionIsObject = true;
+
+        // Always emit new sections, even if empty
+        hashes[section] = 0;
+        if (previousHashes.find(section) == previousHashes.end()) {
+            writer->beginMember(section);
+            writer->beginObject();
+            sectionEmitted = true;
+        }
+        return;
+    }
+    if (level == 1 && sectionIsObject) {
+        return;
+    }
+    recorder.beginObject();
+}
+
+
+void
+DeltaStateWriter::endObject(void)
+{
+    if (level == 1 && sectionIsObject) {
+        return;
+    }
+    recorder.endObject();
+}
+
+
+void
+DeltaStateWriter::beginMember(const char * name)
+{
+    assert(writer);
+    if (level == 0) {
+        section = name;
+        sectionStarted = false;
+        sectionIsObject = false;
+        sectionEmitted = false;
+        recorder.clear();
+    } else if (level == 1 && sectionIsObject) {
+        member = name;
+        recorder.clear();
+    } else {
+        recorder.beginMember(name);
+    }
+    ++level;
+}
+
+
+void
+DeltaStateWriter::endMember(void)
+{
+    assert(level > 0);
+    --level;
+
+    if (level == 1 && sectionIsObject) {
+        if (changed(section + "/" + member)) {
+            if (!sectionEmitted) {
+                writer->beginMember(section);
+                writer->beginObject();
+                sectionEmitted = true;
+            }
+            writer->beginMember(member);
+            recorder.replay(*writer);
+            writer->endMember();
+        }
+        recorder.clear();
+    } else if (level == 0) {
+        if (sectionIsObject) {
+            if (sectionEmitted) {
+                writer->endObject();
+                writer->endMember();
+            }
+        } else if (changed(section)) {
+            writer->beginMember(section);
+            recorder.replay(*writer);
+            writer->endMember();
+        }
+        recorder.clear();
+    } else {
+        recorder.endMember();
+    }
+}
+
+
+void
+DeltaStateWriter::beginArray(void)
+{
+    value();
+    recorder.beginArray();
+}
+
+
+void
+DeltaStateWriter::endArray(void)
+{
+    recorder.endArray();
+}
+
+
+void
+DeltaStateWriter::writeString(const char *s)
+{
+    value();
+    recorder.writeString(s);
+}
+
+
+void
+DeltaStateWriter::writeBlob(const void *bytes, size_t size)
+{
+    value();
+    recorder.writeBlob(bytes, size);
+}
+
+
+void
+DeltaStateWriter::writeNull(void)
+{
+    value();
+    recorder.writeNull();
+}
+
+
+void
+DeltaStateWriter::writeBool(bool b)
+{
+    value();
+    recorder.writeBool(b);
+}
+
+
+void
+DeltaStateWriter::writeSInt(signed long long i)
+{
+    value();
+    recorder.writeSInt(i);
+}
+
+
+void
+DeltaStateWriter::writeUInt(unsigned long long u)
+{
+    value();
+    recorder.writeUInt(u);
+}
+
+
+void
+DeltaStateWriter::writeFloat(float f)
+{
+    value();
+    recorder.writeFloat(f);
+}
+
+
+void
+DeltaStateWriter::writeFloat(double f)
+{
+    value();
+    recorder.writeFloat(f);
+}
+
+
+void
+DeltaStateWriter::writeImage(image::Image *image, const ImageDesc & desc)
+{
+    value();
+    recorder.writeImage(image, desc);
+}
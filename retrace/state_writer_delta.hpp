@@ -0,0 +1,110 @@
+/**************************************************************************
+ *
+ * Copyright 2026 apitrace contributors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * State writer for batches of state dumps, which only forwards the state that
+ * changed since the previous dump.
+ *
+ * State is compared at the granularity of the second level members (e.g.,
+ * "parameters/GL_BLEND", "buffers/GL_ARRAY_BUFFER", or a texture level),
+ * through their content hashes.
+ */
+
+#pragma once
+
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+
+#include "state_recorder.hpp"
+
+
+class DeltaStateWriter : public StateWriter
+{
+public:
+    DeltaStateWriter();
+    ~DeltaStateWriter();
+
+    /*
+     * Start a new dump, forwarding the changed members to the given writer.
+     */
+    void
+    begin(StateWriter &writer);
+
+    /*
+     * Finish the dump, listing the members which disappeared since the
+     * previous dump in a "__removed__" member.
+     */
+    void
+    end(void);
+
+    void beginObject(void) override;
+    void endObject(void) override;
+    void beginMember(const char * name) override;
+    void endMember(void) override;
+    void beginArray(void) override;
+    void endArray(void) override;
+    void writeString(const char *s) override;
+    void writeBlob(const void *bytes, size_t size) override;
+    void writeNull(void) override;
+    void writeBool(bool b) override;
+    void writeSInt(signed long long i) override;
+    void writeUInt(unsigned long long u) override;
+    void writeFloat(float f) override;
+    void writeFloat(double f) override;
+
+    using StateWriter::writeImage;
+
+    void writeImage(image::Image *image, const ImageDesc & desc) override;
+
+private:
+    StateWriter *writer;
+
+    // Number of open members
+    unsigned level;
+
+    // Current top level member, and whether its value is an object
+    std::string section;
+    bool sectionStarted;
+    bool sectionIsObject;
+    bool sectionEmitted;
+
+    // Current second level member
+    std::string member;
+
+    StateRecorder recorder;
+
+    typedef std::map<std::string, uint64_t> HashMap;
+    HashMap hashes;
+    HashMap previousHashes;
+
+    void
+    value(void);
+
+    bool
+    changed(const std::string &key);
+};
@@ -41,13 +41,30 @@ namespace retrace {
 }
 
 
+enum SnapshotEncoding {
+    ENCODING_PNG,
+    ENCODING_QOI,
+};
+
+
 static void
-actuallyWritePNG(const os::String& filename, image::Image *image) {
+actuallyWriteImage(const os::String& filename, image::Image *image, SnapshotEncoding encoding) {
     // Alpha channel often has bogus data, so strip it when writing
-    // PNG images to disk to simplify visualization.
+    // images to disk to simplify visualization.
     bool strip_alpha = true;
 
-    if (image->writePNG(filename, strip_alpha) &&
+    bool written;
+    switch (encoding) {
+    case ENCODING_QOI:
+        written = image->writeQOI(filename, strip_alpha);
+        break;
+    case ENCODING_PNG:
+    default:
+        written = image->writePNG(filename, strip_alpha);
+        break;
+    }
+
+    if (written &&
         retrace::verbosity >= 0) {
         std::cout << "Wrote " << filename << "\n";
     }
@@ -66,8 +83,8 @@ public:
     virtual ~Snapshotter() {}
 
     virtual void
-    writePNG(const os::String& filename, image::Image *image) {
-        actuallyWritePNG(filename, image);
+    writeImage(const os::String& filename, image::Image *image, SnapshotEncoding encoding) {
+        actuallyWriteImage(filename, image, encoding);
     }
 };
 
@@ -85,7 +102,7 @@ public:
     ThreadedSnapshotter(size_t nb_threads) : pool(nb_threads) {}
 
     virtual void
-    writePNG(const os::String& filename, image::Image *image) override {
-        pool.enqueue(actuallyWritePNG, filename, image);
+    writeImage(const os::String& filename, image::Image *image, SnapshotEncoding encoding) override {
+        pool.enqueue(actuallyWriteImage, filename, image, encoding);
     }
 };